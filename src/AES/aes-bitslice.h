@@ -0,0 +1,447 @@
+/*
+** Template for a bitsliced, constant-time AES engine.
+**
+** The state of BS_BLOCKS blocks is held in eight vectors q[0..7], one
+** per bit of each byte (q[0] holds the least significant bits).  Each
+** vector is made of 64-bit lanes and each lane carries four blocks:
+** bit 16 * row + 4 * column + block of plane i is bit i of byte
+** (row, column) of that block.  With that layout ShiftRows is a few
+** masked shifts within a lane, and MixColumns needs only lane rotations
+** by 16 and 32 bits, so no table lookups (and no byte shuffles) are
+** needed anywhere, and the running time does not depend on the data.
+** SubBytes is the Boyar-Peralta circuit of 113 gates; InvSubBytes runs
+** it between two applications of the inverse affine map, and
+** InvMixColumns is MixColumns after multiplying by 04x^2 + 05.
+**
+** This file is included by aes.c once per vector width.  Before
+** including it, define:
+**   BS_V             vector type (64 * BS_BLOCKS / 4 bits wide)
+**   BS_BLOCKS        blocks processed per call: 4 per 64-bit lane
+**   BS_PREFIX        prefix for the generated function names
+**   BS_ATTR          function attribute (e.g. a target() spec)
+**   BS_XOR(a,b), BS_AND(a,b), BS_OR(a,b), BS_NOT(a)
+**   BS_SHL(x,n)      shift each 64-bit lane left by constant n
+**   BS_SHR(x,n)      shift each 64-bit lane right by constant n
+**   BS_ROT32(x)      swap the 32-bit halves of each 64-bit lane
+**   BS_SET1(u)       broadcast a 64-bit constant to every lane
+**   BS_LOAD(q,in)    load 16 * BS_BLOCKS bytes into q[0..7] so that
+**                    lane L of q[4 * p + b] holds, as byte k, byte
+**                    4 * (2 * (k & 1) + p) + (k >> 1) of block 4 * L + b
+**   BS_STORE(out,q)  the inverse of BS_LOAD
+** All of these are undefined again at the end of the file.
+**
+** The generated function is
+**   static void BS_PREFIX##crypt(const aes_context *ctx, int dec,
+**                                const uint8 *in, uint8 *out);
+** which encrypts (or, if dec, decrypts) BS_BLOCKS blocks using the
+** bitsliced round keys ctx->bsk built by aes_set_key().
+*/
+
+#define BS_CAT2(a, b)   a ## b
+#define BS_CAT(a, b)    BS_CAT2(a, b)
+#define BS_F(name)      BS_CAT(BS_PREFIX, name)
+
+/* exchange the bits of x selected by cl with the bits of y in ch */
+#define BS_SWAPN(cl, ch, s, x, y)                                   \
+    {                                                               \
+        BS_V a_ = (x), b_ = (y);                                    \
+        (x) = BS_OR(BS_AND(a_, BS_SET1(cl)),                        \
+                    BS_SHL(BS_AND(b_, BS_SET1(cl)), s));            \
+        (y) = BS_OR(BS_SHR(BS_AND(a_, BS_SET1(ch)), s),             \
+                    BS_AND(b_, BS_SET1(ch)));                       \
+    }
+
+/* transpose each 8x8 bit matrix: bytes to bit planes and back */
+BS_ATTR
+static inline void BS_F(ortho)(BS_V *q)
+{
+    BS_SWAPN(0x5555555555555555ULL, 0xAAAAAAAAAAAAAAAAULL, 1, q[0], q[1]);
+    BS_SWAPN(0x5555555555555555ULL, 0xAAAAAAAAAAAAAAAAULL, 1, q[2], q[3]);
+    BS_SWAPN(0x5555555555555555ULL, 0xAAAAAAAAAAAAAAAAULL, 1, q[4], q[5]);
+    BS_SWAPN(0x5555555555555555ULL, 0xAAAAAAAAAAAAAAAAULL, 1, q[6], q[7]);
+
+    BS_SWAPN(0x3333333333333333ULL, 0xCCCCCCCCCCCCCCCCULL, 2, q[0], q[2]);
+    BS_SWAPN(0x3333333333333333ULL, 0xCCCCCCCCCCCCCCCCULL, 2, q[1], q[3]);
+    BS_SWAPN(0x3333333333333333ULL, 0xCCCCCCCCCCCCCCCCULL, 2, q[4], q[6]);
+    BS_SWAPN(0x3333333333333333ULL, 0xCCCCCCCCCCCCCCCCULL, 2, q[5], q[7]);
+
+    BS_SWAPN(0x0F0F0F0F0F0F0F0FULL, 0xF0F0F0F0F0F0F0F0ULL, 4, q[0], q[4]);
+    BS_SWAPN(0x0F0F0F0F0F0F0F0FULL, 0xF0F0F0F0F0F0F0F0ULL, 4, q[1], q[5]);
+    BS_SWAPN(0x0F0F0F0F0F0F0F0FULL, 0xF0F0F0F0F0F0F0F0ULL, 4, q[2], q[6]);
+    BS_SWAPN(0x0F0F0F0F0F0F0F0FULL, 0xF0F0F0F0F0F0F0F0ULL, 4, q[3], q[7]);
+}
+
+/* SubBytes: the Boyar-Peralta circuit, x0 being the top bit */
+BS_ATTR
+static inline void BS_F(sbox)(BS_V *q)
+{
+    BS_V x0, x1, x2, x3, x4, x5, x6, x7;
+    BS_V y1, y2, y3, y4, y5, y6, y7, y8, y9, y10, y11;
+    BS_V y12, y13, y14, y15, y16, y17, y18, y19, y20, y21;
+    BS_V z0, z1, z2, z3, z4, z5, z6, z7, z8, z9, z10, z11;
+    BS_V z12, z13, z14, z15, z16, z17;
+    BS_V t0, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11, t12;
+    BS_V t13, t14, t15, t16, t17, t18, t19, t20, t21, t22, t23;
+    BS_V t24, t25, t26, t27, t28, t29, t30, t31, t32, t33, t34;
+    BS_V t35, t36, t37, t38, t39, t40, t41, t42, t43, t44, t45;
+    BS_V t46, t47, t48, t49, t50, t51, t52, t53, t54, t55, t56;
+    BS_V t57, t58, t59, t60, t61, t62, t63, t64, t65, t66, t67;
+    BS_V s0, s1, s2, s3, s4, s5, s6, s7;
+
+    x0 = q[7];
+    x1 = q[6];
+    x2 = q[5];
+    x3 = q[4];
+    x4 = q[3];
+    x5 = q[2];
+    x6 = q[1];
+    x7 = q[0];
+
+    /* top linear transformation */
+    y14 = BS_XOR(x3, x5);
+    y13 = BS_XOR(x0, x6);
+    y9 = BS_XOR(x0, x3);
+    y8 = BS_XOR(x0, x5);
+    t0 = BS_XOR(x1, x2);
+    y1 = BS_XOR(t0, x7);
+    y4 = BS_XOR(y1, x3);
+    y12 = BS_XOR(y13, y14);
+    y2 = BS_XOR(y1, x0);
+    y5 = BS_XOR(y1, x6);
+    y3 = BS_XOR(y5, y8);
+    t1 = BS_XOR(x4, y12);
+    y15 = BS_XOR(t1, x5);
+    y20 = BS_XOR(t1, x1);
+    y6 = BS_XOR(y15, x7);
+    y10 = BS_XOR(y15, t0);
+    y11 = BS_XOR(y20, y9);
+    y7 = BS_XOR(x7, y11);
+    y17 = BS_XOR(y10, y11);
+    y19 = BS_XOR(y10, y8);
+    y16 = BS_XOR(t0, y11);
+    y21 = BS_XOR(y13, y16);
+    y18 = BS_XOR(x0, y16);
+
+    /* non-linear section: inversion in GF(2^8) */
+    t2 = BS_AND(y12, y15);
+    t3 = BS_AND(y3, y6);
+    t4 = BS_XOR(t3, t2);
+    t5 = BS_AND(y4, x7);
+    t6 = BS_XOR(t5, t2);
+    t7 = BS_AND(y13, y16);
+    t8 = BS_AND(y5, y1);
+    t9 = BS_XOR(t8, t7);
+    t10 = BS_AND(y2, y7);
+    t11 = BS_XOR(t10, t7);
+    t12 = BS_AND(y9, y11);
+    t13 = BS_AND(y14, y17);
+    t14 = BS_XOR(t13, t12);
+    t15 = BS_AND(y8, y10);
+    t16 = BS_XOR(t15, t12);
+    t17 = BS_XOR(t4, t14);
+    t18 = BS_XOR(t6, t16);
+    t19 = BS_XOR(t9, t14);
+    t20 = BS_XOR(t11, t16);
+    t21 = BS_XOR(t17, y20);
+    t22 = BS_XOR(t18, y19);
+    t23 = BS_XOR(t19, y21);
+    t24 = BS_XOR(t20, y18);
+
+    t25 = BS_XOR(t21, t22);
+    t26 = BS_AND(t21, t23);
+    t27 = BS_XOR(t24, t26);
+    t28 = BS_AND(t25, t27);
+    t29 = BS_XOR(t28, t22);
+    t30 = BS_XOR(t23, t24);
+    t31 = BS_XOR(t22, t26);
+    t32 = BS_AND(t31, t30);
+    t33 = BS_XOR(t32, t24);
+    t34 = BS_XOR(t23, t33);
+    t35 = BS_XOR(t27, t33);
+    t36 = BS_AND(t24, t35);
+    t37 = BS_XOR(t36, t34);
+    t38 = BS_XOR(t27, t36);
+    t39 = BS_AND(t29, t38);
+    t40 = BS_XOR(t25, t39);
+
+    t41 = BS_XOR(t40, t37);
+    t42 = BS_XOR(t29, t33);
+    t43 = BS_XOR(t29, t40);
+    t44 = BS_XOR(t33, t37);
+    t45 = BS_XOR(t42, t41);
+    z0 = BS_AND(t44, y15);
+    z1 = BS_AND(t37, y6);
+    z2 = BS_AND(t33, x7);
+    z3 = BS_AND(t43, y16);
+    z4 = BS_AND(t40, y1);
+    z5 = BS_AND(t29, y7);
+    z6 = BS_AND(t42, y11);
+    z7 = BS_AND(t45, y17);
+    z8 = BS_AND(t41, y10);
+    z9 = BS_AND(t44, y12);
+    z10 = BS_AND(t37, y3);
+    z11 = BS_AND(t33, y4);
+    z12 = BS_AND(t43, y13);
+    z13 = BS_AND(t40, y5);
+    z14 = BS_AND(t29, y2);
+    z15 = BS_AND(t42, y9);
+    z16 = BS_AND(t45, y14);
+    z17 = BS_AND(t41, y8);
+
+    /* bottom linear transformation */
+    t46 = BS_XOR(z15, z16);
+    t47 = BS_XOR(z10, z11);
+    t48 = BS_XOR(z5, z13);
+    t49 = BS_XOR(z9, z10);
+    t50 = BS_XOR(z2, z12);
+    t51 = BS_XOR(z2, z5);
+    t52 = BS_XOR(z7, z8);
+    t53 = BS_XOR(z0, z3);
+    t54 = BS_XOR(z6, z7);
+    t55 = BS_XOR(z16, z17);
+    t56 = BS_XOR(z12, t48);
+    t57 = BS_XOR(t50, t53);
+    t58 = BS_XOR(z4, t46);
+    t59 = BS_XOR(z3, t54);
+    t60 = BS_XOR(t46, t57);
+    t61 = BS_XOR(z14, t57);
+    t62 = BS_XOR(t52, t58);
+    t63 = BS_XOR(t49, t58);
+    t64 = BS_XOR(z4, t59);
+    t65 = BS_XOR(t61, t62);
+    t66 = BS_XOR(z1, t63);
+    s0 = BS_XOR(t59, t63);
+    s6 = BS_XOR(t56, BS_NOT(t62));
+    s7 = BS_XOR(t48, BS_NOT(t60));
+    t67 = BS_XOR(t64, t65);
+    s3 = BS_XOR(t53, t66);
+    s4 = BS_XOR(t51, t66);
+    s5 = BS_XOR(t47, t65);
+    s1 = BS_XOR(t64, BS_NOT(s3));
+    s2 = BS_XOR(t55, BS_NOT(t67));
+
+    q[7] = s0;
+    q[6] = s1;
+    q[5] = s2;
+    q[4] = s3;
+    q[3] = s4;
+    q[2] = s5;
+    q[1] = s6;
+    q[0] = s7;
+}
+
+/* the inverse affine map: bit i is v(i+2) ^ v(i+5) ^ v(i+7) ^ 0x05(i) */
+BS_ATTR
+static inline void BS_F(inv_affine)(BS_V *q)
+{
+    BS_V v[8];
+    int i;
+
+    for (i = 0; i < 8; i++)
+        v[i] = q[i];
+    for (i = 0; i < 8; i++)
+        q[i] = BS_XOR(BS_XOR(v[(i + 2) & 7], v[(i + 5) & 7]), v[(i + 7) & 7]);
+    q[0] = BS_NOT(q[0]);
+    q[2] = BS_NOT(q[2]);
+}
+
+/*
+ * InvSubBytes: with S(x) = A(x^-1) + 0x63 and g(v) = A^-1(v + 0x63),
+ * x^-1 = g(S(x)), so S^-1(y) = (g(y))^-1 = g(S(g(y))).
+ */
+BS_ATTR
+static inline void BS_F(inv_sbox)(BS_V *q)
+{
+    BS_F(inv_affine)(q);
+    BS_F(sbox)(q);
+    BS_F(inv_affine)(q);
+}
+
+#define BS_MASKED(x, m, op, n)  op(BS_AND(x, BS_SET1(m)), n)
+
+BS_ATTR
+static inline void BS_F(shift_rows)(BS_V *q)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        BS_V x = q[i];
+        q[i] = BS_OR(BS_OR(BS_OR(BS_AND(x, BS_SET1(0x000000000000FFFFULL)),
+                      BS_MASKED(x, 0x00000000FFF00000ULL, BS_SHR, 4)),
+                      BS_OR(BS_MASKED(x, 0x00000000000F0000ULL, BS_SHL, 12),
+                            BS_MASKED(x, 0x0000FF0000000000ULL, BS_SHR, 8))),
+                      BS_OR(BS_MASKED(x, 0x000000FF00000000ULL, BS_SHL, 8),
+                      BS_OR(BS_MASKED(x, 0xF000000000000000ULL, BS_SHR, 12),
+                            BS_MASKED(x, 0x0FFF000000000000ULL, BS_SHL, 4))));
+    }
+}
+
+BS_ATTR
+static inline void BS_F(inv_shift_rows)(BS_V *q)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        BS_V x = q[i];
+        q[i] = BS_OR(BS_OR(BS_OR(BS_AND(x, BS_SET1(0x000000000000FFFFULL)),
+                      BS_MASKED(x, 0x000000000FFF0000ULL, BS_SHL, 4)),
+                      BS_OR(BS_MASKED(x, 0x00000000F0000000ULL, BS_SHR, 12),
+                            BS_MASKED(x, 0x000000FF00000000ULL, BS_SHL, 8))),
+                      BS_OR(BS_MASKED(x, 0x0000FF0000000000ULL, BS_SHR, 8),
+                      BS_OR(BS_MASKED(x, 0x000F000000000000ULL, BS_SHL, 12),
+                            BS_MASKED(x, 0xFFF0000000000000ULL, BS_SHR, 4))));
+    }
+}
+
+/* rotate each lane down one row: row r + 1 of x becomes row r */
+#define BS_ROT16(x)     BS_OR(BS_SHR(x, 16), BS_SHL(x, 48))
+
+/*
+ * MixColumns: s'(r) = 2 (s(r) + s(r+1)) + s(r+1) + s(r+2) + s(r+3),
+ * multiplication by 2 moving each plane up one bit and folding the
+ * top bit back into bits 0, 1, 3 and 4.
+ */
+BS_ATTR
+static inline void BS_F(mix_columns)(BS_V *q)
+{
+    BS_V q0, q1, q2, q3, q4, q5, q6, q7;
+    BS_V r0, r1, r2, r3, r4, r5, r6, r7;
+
+    q0 = q[0];
+    q1 = q[1];
+    q2 = q[2];
+    q3 = q[3];
+    q4 = q[4];
+    q5 = q[5];
+    q6 = q[6];
+    q7 = q[7];
+    r0 = BS_ROT16(q0);
+    r1 = BS_ROT16(q1);
+    r2 = BS_ROT16(q2);
+    r3 = BS_ROT16(q3);
+    r4 = BS_ROT16(q4);
+    r5 = BS_ROT16(q5);
+    r6 = BS_ROT16(q6);
+    r7 = BS_ROT16(q7);
+
+    q[0] = BS_XOR(BS_XOR(q7, r7), BS_XOR(r0, BS_ROT32(BS_XOR(q0, r0))));
+    q[1] = BS_XOR(BS_XOR(BS_XOR(q0, r0), BS_XOR(q7, r7)),
+                  BS_XOR(r1, BS_ROT32(BS_XOR(q1, r1))));
+    q[2] = BS_XOR(BS_XOR(q1, r1), BS_XOR(r2, BS_ROT32(BS_XOR(q2, r2))));
+    q[3] = BS_XOR(BS_XOR(BS_XOR(q2, r2), BS_XOR(q7, r7)),
+                  BS_XOR(r3, BS_ROT32(BS_XOR(q3, r3))));
+    q[4] = BS_XOR(BS_XOR(BS_XOR(q3, r3), BS_XOR(q7, r7)),
+                  BS_XOR(r4, BS_ROT32(BS_XOR(q4, r4))));
+    q[5] = BS_XOR(BS_XOR(q4, r4), BS_XOR(r5, BS_ROT32(BS_XOR(q5, r5))));
+    q[6] = BS_XOR(BS_XOR(q5, r5), BS_XOR(r6, BS_ROT32(BS_XOR(q6, r6))));
+    q[7] = BS_XOR(BS_XOR(q6, r6), BS_XOR(r7, BS_ROT32(BS_XOR(q7, r7))));
+}
+
+/*
+ * InvMixColumns: the inverse of c(x) is c(x) (04x^2 + 05), so first
+ * replace each s(r) by 05 s(r) + 04 s(r+2) = s(r) + 4 (s(r) + s(r+2)).
+ */
+BS_ATTR
+static inline void BS_F(xtime)(BS_V *t)
+{
+    BS_V t7 = t[7];
+
+    t[7] = t[6];
+    t[6] = t[5];
+    t[5] = t[4];
+    t[4] = BS_XOR(t[3], t7);
+    t[3] = BS_XOR(t[2], t7);
+    t[2] = t[1];
+    t[1] = BS_XOR(t[0], t7);
+    t[0] = t7;
+}
+
+BS_ATTR
+static inline void BS_F(inv_mix_columns)(BS_V *q)
+{
+    BS_V t[8];
+    int i;
+
+    for (i = 0; i < 8; i++)
+        t[i] = BS_XOR(q[i], BS_ROT32(q[i]));
+    BS_F(xtime)(t);
+    BS_F(xtime)(t);
+    for (i = 0; i < 8; i++)
+        q[i] = BS_XOR(q[i], t[i]);
+    BS_F(mix_columns)(q);
+}
+
+BS_ATTR
+static inline void BS_F(add_round_key)(BS_V *q,
+                                       const unsigned long long *sk)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+        q[i] = BS_XOR(q[i], BS_SET1(sk[i]));
+}
+
+BS_ATTR
+static void BS_F(crypt)(const aes_context *ctx, int dec, const uint8 *in,
+                        uint8 *out)
+{
+    BS_V q[8];
+    int r;
+
+    BS_LOAD(q, in);
+    BS_F(ortho)(q);
+    if (!dec)
+    {
+        BS_F(add_round_key)(q, ctx->bsk[0]);
+        for (r = 1; r < ctx->nr; r++)
+        {
+            BS_F(sbox)(q);
+            BS_F(shift_rows)(q);
+            BS_F(mix_columns)(q);
+            BS_F(add_round_key)(q, ctx->bsk[r]);
+        }
+        BS_F(sbox)(q);
+        BS_F(shift_rows)(q);
+        BS_F(add_round_key)(q, ctx->bsk[ctx->nr]);
+    }
+    else
+    {
+        BS_F(add_round_key)(q, ctx->bsk[ctx->nr]);
+        for (r = ctx->nr - 1; r > 0; r--)
+        {
+            BS_F(inv_shift_rows)(q);
+            BS_F(inv_sbox)(q);
+            BS_F(add_round_key)(q, ctx->bsk[r]);
+            BS_F(inv_mix_columns)(q);
+        }
+        BS_F(inv_shift_rows)(q);
+        BS_F(inv_sbox)(q);
+        BS_F(add_round_key)(q, ctx->bsk[0]);
+    }
+    BS_F(ortho)(q);
+    BS_STORE(out, q);
+}
+
+#undef BS_ROT16
+#undef BS_MASKED
+#undef BS_SWAPN
+#undef BS_F
+#undef BS_CAT
+#undef BS_CAT2
+
+#undef BS_V
+#undef BS_BLOCKS
+#undef BS_PREFIX
+#undef BS_ATTR
+#undef BS_XOR
+#undef BS_AND
+#undef BS_OR
+#undef BS_NOT
+#undef BS_SHL
+#undef BS_SHR
+#undef BS_ROT32
+#undef BS_SET1
+#undef BS_LOAD
+#undef BS_STORE
@@ -24,6 +24,7 @@
  */
 
 #include "aes.h"
+#include <string.h>
 
 /* uncomment the following line to run the test suite */
 
@@ -421,13 +422,32 @@ void aes_gen_tables(void)
         (b)[(i) + 3] = (uint8) ((n) >>  0);       \
     }
 
-/* decryption key schedule tables */
-static int KT_init = 1;
+/*
+ * The key schedule indexes no tables with key bytes: SubWord runs the
+ * bitsliced S-box circuit (defined with the bitsliced engine below) and
+ * InvMixColumns for the decryption round keys is computed with shifts
+ * and masks, four bytes at a time.
+ */
+static uint32 aes_sub_word(uint32 w);
+
+#define ROTL8(x)  ((((x) << 8) | ((x) >> 24)) & 0xFFFFFFFF)
+
+/* multiply each of the four bytes of x by 2 in GF(2^8) */
+#define XTIME4(x) ((((x) & 0x7F7F7F7F) << 1) ^ ((((x) >> 7) & 0x01010101) * 0x1B))
 
-static uint32 KT0[256];
-static uint32 KT1[256];
-static uint32 KT2[256];
-static uint32 KT3[256];
+static uint32 aes_inv_mix_column(uint32 w)
+{
+    uint32 w2 = XTIME4(w);
+    uint32 w4 = XTIME4(w2);
+    uint32 w8 = XTIME4(w4);
+    uint32 w9 = w8 ^ w;
+
+    /* byte i: 0E.a[i] ^ 0B.a[i+1] ^ 0D.a[i+2] ^ 09.a[i+3] */
+    return((w8 ^ w4 ^ w2) ^
+           ROTL8(w9 ^ w2) ^
+           ROTL8(ROTL8(w9 ^ w4)) ^
+           ROTL8(ROTL8(ROTL8(w9))));
+}
 
 /* AES key scheduling routine */
 int aes_set_key(aes_context *ctx, uint8 *key, int nbits)
@@ -471,11 +491,7 @@ int aes_set_key(aes_context *ctx, uint8 *key, int nbits)
 
         for (i = 0; i < 10; i++, RK += 4)
         {
-            RK[4]  = RK[0] ^ RCON[i] ^
-                     (FSb[(uint8) (RK[3] >> 16)] << 24) ^
-                     (FSb[(uint8) (RK[3] >>  8)] << 16) ^
-                     (FSb[(uint8) (RK[3])] <<  8) ^
-                     (FSb[(uint8) (RK[3] >> 24)]);
+            RK[4]  = RK[0] ^ RCON[i] ^ aes_sub_word(ROTL8(RK[3]));
 
             RK[5]  = RK[1] ^ RK[4];
             RK[6]  = RK[2] ^ RK[5];
@@ -487,11 +503,7 @@ int aes_set_key(aes_context *ctx, uint8 *key, int nbits)
 
         for (i = 0; i < 8; i++, RK += 6)
         {
-            RK[6]  = RK[0] ^ RCON[i] ^
-                     (FSb[(uint8) (RK[5] >> 16)] << 24) ^
-                     (FSb[(uint8) (RK[5] >>  8)] << 16) ^
-                     (FSb[(uint8) (RK[5])] <<  8) ^
-                     (FSb[(uint8) (RK[5] >> 24)]);
+            RK[6]  = RK[0] ^ RCON[i] ^ aes_sub_word(ROTL8(RK[5]));
 
             RK[7]  = RK[1] ^ RK[6];
             RK[8]  = RK[2] ^ RK[7];
@@ -505,21 +517,13 @@ int aes_set_key(aes_context *ctx, uint8 *key, int nbits)
 
         for (i = 0; i < 7; i++, RK += 8)
         {
-            RK[8]  = RK[0] ^ RCON[i] ^
-                     (FSb[(uint8) (RK[7] >> 16)] << 24) ^
-                     (FSb[(uint8) (RK[7] >>  8)] << 16) ^
-                     (FSb[(uint8) (RK[7])] <<  8) ^
-                     (FSb[(uint8) (RK[7] >> 24)]);
+            RK[8]  = RK[0] ^ RCON[i] ^ aes_sub_word(ROTL8(RK[7]));
 
             RK[9]  = RK[1] ^ RK[8];
             RK[10] = RK[2] ^ RK[9];
             RK[11] = RK[3] ^ RK[10];
 
-            RK[12] = RK[4] ^
-                     (FSb[(uint8) (RK[11] >> 24)] << 24) ^
-                     (FSb[(uint8) (RK[11] >> 16)] << 16) ^
-                     (FSb[(uint8) (RK[11] >>  8)] <<  8) ^
-                     (FSb[(uint8) (RK[11])]);
+            RK[12] = RK[4] ^ aes_sub_word(RK[11]);
 
             RK[13] = RK[5] ^ RK[12];
             RK[14] = RK[6] ^ RK[13];
@@ -530,19 +534,6 @@ int aes_set_key(aes_context *ctx, uint8 *key, int nbits)
 
     /* setup decryption round keys */
 
-    if (KT_init)
-    {
-        for (i = 0; i < 256; i++)
-        {
-            KT0[i] = RT0[FSb[i]];
-            KT1[i] = RT1[FSb[i]];
-            KT2[i] = RT2[FSb[i]];
-            KT3[i] = RT3[FSb[i]];
-        }
-
-        KT_init = 0;
-    }
-
     SK = ctx->drk;
 
     *SK++ = *RK++;
@@ -554,29 +545,10 @@ int aes_set_key(aes_context *ctx, uint8 *key, int nbits)
     {
         RK -= 8;
 
-        *SK++ = KT0[(uint8) (*RK >> 24)] ^
-                KT1[(uint8) (*RK >> 16)] ^
-                KT2[(uint8) (*RK >>  8)] ^
-                KT3[(uint8) (*RK)];
-        RK++;
-
-        *SK++ = KT0[(uint8) (*RK >> 24)] ^
-                KT1[(uint8) (*RK >> 16)] ^
-                KT2[(uint8) (*RK >>  8)] ^
-                KT3[(uint8) (*RK)];
-        RK++;
-
-        *SK++ = KT0[(uint8) (*RK >> 24)] ^
-                KT1[(uint8) (*RK >> 16)] ^
-                KT2[(uint8) (*RK >>  8)] ^
-                KT3[(uint8) (*RK)];
-        RK++;
-
-        *SK++ = KT0[(uint8) (*RK >> 24)] ^
-                KT1[(uint8) (*RK >> 16)] ^
-                KT2[(uint8) (*RK >>  8)] ^
-                KT3[(uint8) (*RK)];
-        RK++;
+        *SK++ = aes_inv_mix_column(*RK++);
+        *SK++ = aes_inv_mix_column(*RK++);
+        *SK++ = aes_inv_mix_column(*RK++);
+        *SK++ = aes_inv_mix_column(*RK++);
     }
 
     RK -= 8;
@@ -586,11 +558,39 @@ int aes_set_key(aes_context *ctx, uint8 *key, int nbits)
     *SK++ = *RK++;
     *SK++ = *RK++;
 
+    /* byte-order copies of the round keys for AES-NI */
+    for (i = 0; i < 4 * (ctx->nr + 1); i++)
+    {
+        PUT_UINT32(ctx->erk[i], ctx->brk[0], 4 * i);
+        PUT_UINT32(ctx->drk[i], ctx->brk[1], 4 * i);
+    }
+
+    /*
+     * bitsliced copies for the bitsliced engine: bit b of byte k of
+     * round key r goes to bits 16 * (k % 4) + 4 * (k / 4) .. + 3 of
+     * bsk[r][b], once for each of the four blocks in a 64-bit lane;
+     * computed without branches on the key
+     */
+    memset(ctx->bsk, 0, sizeof(ctx->bsk));
+    for (i = 0; i <= ctx->nr; i++)
+    {
+        int k, b;
+        for (k = 0; k < 16; k++)
+        {
+            for (b = 0; b < 8; b++)
+            {
+                unsigned long long bit = (ctx->brk[0][16 * i + k] >> b) & 1;
+                ctx->bsk[i][b] |= (bit * 0xF) << (16 * (k & 3) + 4 * (k >> 2));
+            }
+        }
+    }
+
     return(0);
 }
 
-/* AES 128-bit block encryption routine */
-void aes_encrypt(aes_context *ctx, uint8 input[16], uint8 output[16])
+/* AES 128-bit block encryption routine - table version */
+static void aes_encrypt_table(aes_context *ctx, const uint8 input[16],
+                              uint8 output[16])
 {
     uint32 *RK, X0, X1, X2, X3, Y0, Y1, Y2, Y3;
 
@@ -681,8 +681,9 @@ void aes_encrypt(aes_context *ctx, uint8 input[16], uint8 output[16])
     PUT_UINT32(X3, output, 12);
 }
 
-/* AES 128-bit block decryption routine */
-void aes_decrypt(aes_context *ctx, uint8 input[16], uint8 output[16])
+/* AES 128-bit block decryption routine - table version */
+static void aes_decrypt_table(aes_context *ctx, const uint8 input[16],
+                              uint8 output[16])
 {
     uint32 *RK, X0, X1, X2, X3, Y0, Y1, Y2, Y3;
 
@@ -774,6 +775,765 @@ void aes_decrypt(aes_context *ctx, uint8 input[16], uint8 output[16])
     PUT_UINT32(X3, output, 12);
 }
 
+/*
+ * AES-NI engine
+ *
+ * The x86 AES instructions do a whole round per instruction, in
+ * constant time.  aesenc has a latency of several cycles but can
+ * start a new round every cycle, so the multi-block modes keep
+ * AESNI_WAYS independent blocks in flight.  AES-NI uses the
+ * "equivalent inverse cipher" for decryption, which is exactly what
+ * the drk schedule built by aes_set_key() holds; brk[] has both
+ * schedules in byte order.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#define AES_HAVE_AESNI
+#include <immintrin.h>
+
+#define AESNI_TARGET __attribute__((target("aes,sse2")))
+#define AESNI_WAYS   8
+
+static int aes_have_aesni(void)
+{
+    __builtin_cpu_init();
+    return(__builtin_cpu_supports("aes"));
+}
+
+AESNI_TARGET
+static inline void aesni_load_keys(const aes_context *ctx, int dec,
+                                   __m128i rk[15])
+{
+    int r;
+
+    /* all 15 slots, whatever the key size, so none is uninitialised */
+    for (r = 0; r < 15; r++)
+        rk[r] = _mm_loadu_si128((const __m128i *)(ctx->brk[dec] + 16 * r));
+}
+
+/* encrypt blocks b[0..n-1] in parallel */
+AESNI_TARGET
+static inline void aesni_enc_blocks(__m128i *b, int n,
+                                    const __m128i *rk, int nr)
+{
+    int r, j;
+
+    for (j = 0; j < n; j++)
+        b[j] = _mm_xor_si128(b[j], rk[0]);
+    for (r = 1; r < nr; r++)
+        for (j = 0; j < n; j++)
+            b[j] = _mm_aesenc_si128(b[j], rk[r]);
+    for (j = 0; j < n; j++)
+        b[j] = _mm_aesenclast_si128(b[j], rk[nr]);
+}
+
+/* decrypt blocks b[0..n-1] in parallel */
+AESNI_TARGET
+static inline void aesni_dec_blocks(__m128i *b, int n,
+                                    const __m128i *rk, int nr)
+{
+    int r, j;
+
+    for (j = 0; j < n; j++)
+        b[j] = _mm_xor_si128(b[j], rk[0]);
+    for (r = 1; r < nr; r++)
+        for (j = 0; j < n; j++)
+            b[j] = _mm_aesdec_si128(b[j], rk[r]);
+    for (j = 0; j < n; j++)
+        b[j] = _mm_aesdeclast_si128(b[j], rk[nr]);
+}
+
+AESNI_TARGET
+static void aesni_ecb(aes_context *ctx, int dec, const uint8 *input,
+                      uint8 *output, size_t nblocks)
+{
+    __m128i rk[15], b[AESNI_WAYS], x;
+    const __m128i *in = (const __m128i *)input;
+    __m128i *out = (__m128i *)output;
+    int j;
+
+    aesni_load_keys(ctx, dec, rk);
+    for ( ; nblocks >= AESNI_WAYS; nblocks -= AESNI_WAYS)
+    {
+        for (j = 0; j < AESNI_WAYS; j++)
+            b[j] = _mm_loadu_si128(in++);
+        if (dec)
+            aesni_dec_blocks(b, AESNI_WAYS, rk, ctx->nr);
+        else
+            aesni_enc_blocks(b, AESNI_WAYS, rk, ctx->nr);
+        for (j = 0; j < AESNI_WAYS; j++)
+            _mm_storeu_si128(out++, b[j]);
+    }
+    for ( ; nblocks > 0; nblocks--)
+    {
+        x = _mm_loadu_si128(in++);
+        if (dec)
+            aesni_dec_blocks(&x, 1, rk, ctx->nr);
+        else
+            aesni_enc_blocks(&x, 1, rk, ctx->nr);
+        _mm_storeu_si128(out++, x);
+    }
+}
+
+AESNI_TARGET
+static void aesni_cbc_encrypt(aes_context *ctx, uint8 iv[16],
+                              const uint8 *input, uint8 *output,
+                              size_t nblocks)
+{
+    __m128i rk[15], b;
+    const __m128i *in = (const __m128i *)input;
+    __m128i *out = (__m128i *)output;
+
+    aesni_load_keys(ctx, 0, rk);
+    b = _mm_loadu_si128((const __m128i *)iv);
+    for ( ; nblocks > 0; nblocks--)
+    {
+        b = _mm_xor_si128(b, _mm_loadu_si128(in++));
+        aesni_enc_blocks(&b, 1, rk, ctx->nr);
+        _mm_storeu_si128(out++, b);
+    }
+    _mm_storeu_si128((__m128i *)iv, b);
+}
+
+AESNI_TARGET
+static void aesni_cbc_decrypt(aes_context *ctx, uint8 iv[16],
+                              const uint8 *input, uint8 *output,
+                              size_t nblocks)
+{
+    __m128i rk[15], b[AESNI_WAYS], c[AESNI_WAYS], prev, x;
+    const __m128i *in = (const __m128i *)input;
+    __m128i *out = (__m128i *)output;
+    int j;
+
+    aesni_load_keys(ctx, 1, rk);
+    prev = _mm_loadu_si128((const __m128i *)iv);
+    for ( ; nblocks >= AESNI_WAYS; nblocks -= AESNI_WAYS)
+    {
+        for (j = 0; j < AESNI_WAYS; j++)
+            b[j] = c[j] = _mm_loadu_si128(in++);
+        aesni_dec_blocks(b, AESNI_WAYS, rk, ctx->nr);
+        /* all of c[] is loaded before any output is stored */
+        _mm_storeu_si128(out++, _mm_xor_si128(b[0], prev));
+        for (j = 1; j < AESNI_WAYS; j++)
+            _mm_storeu_si128(out++, _mm_xor_si128(b[j], c[j - 1]));
+        prev = c[AESNI_WAYS - 1];
+    }
+    for ( ; nblocks > 0; nblocks--)
+    {
+        x = c[0] = _mm_loadu_si128(in++);
+        aesni_dec_blocks(&x, 1, rk, ctx->nr);
+        _mm_storeu_si128(out++, _mm_xor_si128(x, prev));
+        prev = c[0];
+    }
+    _mm_storeu_si128((__m128i *)iv, prev);
+}
+
+AESNI_TARGET
+static void aesni_ctr_crypt(aes_context *ctx, uint8 counter[16],
+                            const uint8 *input, uint8 *output,
+                            size_t length)
+{
+    __m128i rk[15], b[AESNI_WAYS];
+    unsigned long long hi = 0, lo = 0;
+    int i, j, n;
+
+    aesni_load_keys(ctx, 0, rk);
+    for (i = 0; i < 8; i++)
+    {
+        hi = (hi << 8) | counter[i];
+        lo = (lo << 8) | counter[i + 8];
+    }
+    while (length > 0)
+    {
+        n = (length < 16 * AESNI_WAYS) ? (int)((length + 15) / 16) :
+                                         AESNI_WAYS;
+        for (j = 0; j < n; j++)
+        {
+            b[j] = _mm_set_epi64x((long long)__builtin_bswap64(lo),
+                                  (long long)__builtin_bswap64(hi));
+            if (++lo == 0)
+                hi++;
+        }
+        if (n == AESNI_WAYS)
+            aesni_enc_blocks(b, AESNI_WAYS, rk, ctx->nr);
+        else
+            aesni_enc_blocks(b, n, rk, ctx->nr);
+        for (j = 0; j < n && length >= 16; j++)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *)input);
+            _mm_storeu_si128((__m128i *)output, _mm_xor_si128(x, b[j]));
+            input += 16;
+            output += 16;
+            length -= 16;
+        }
+        if (j < n)
+        {
+            /* partial last block */
+            uint8 ks[16];
+            _mm_storeu_si128((__m128i *)ks, b[j]);
+            for (i = 0; i < (int)length; i++)
+                output[i] = input[i] ^ ks[i];
+            length = 0;
+        }
+    }
+    for (i = 7; i >= 0; i--)
+    {
+        counter[i] = (uint8) hi;
+        counter[i + 8] = (uint8) lo;
+        hi >>= 8;
+        lo >>= 8;
+    }
+}
+
+#endif /* x86 with GCC */
+
+/*
+ * Bitsliced engine
+ *
+ * A constant-time fallback for hosts without AES-NI: no table
+ * lookups and no branches on keys or data, so nothing leaks through
+ * the cache or the branch predictor.  aes-bitslice.h is instantiated
+ * for 64-bit integers (4 blocks at a time, portable), SSE2 (8 blocks)
+ * and AVX2 (16 blocks); the widest kernel the host supports is used.
+ * Every kernel uses the bitsliced round keys bsk built by aes_set_key(),
+ * for decryption too, as the bitsliced inverse cipher needs no
+ * separate schedule.  Short groups are padded, so a single block costs
+ * as much as a full group, and CBC encryption, being serial, is slow.
+ */
+
+#define BS_MAXBLOCKS 16
+
+typedef void bs_kernel(const aes_context *ctx, int dec, const uint8 *in,
+                       uint8 *out);
+
+/* 64-bit lanes in plain C: q[4 * p + b] from block b, columns p, p + 2 */
+static void bs64_load(unsigned long long *q, const uint8 *in)
+{
+    int p, b, k;
+
+    for (p = 0; p < 2; p++)
+    {
+        for (b = 0; b < 4; b++)
+        {
+            unsigned long long w = 0;
+            for (k = 0; k < 8; k++)
+                w |= (unsigned long long)
+                     in[16 * b + 4 * (2 * (k & 1) + p) + (k >> 1)] << (8 * k);
+            q[4 * p + b] = w;
+        }
+    }
+}
+
+static void bs64_store(uint8 *out, const unsigned long long *q)
+{
+    int p, b, k;
+
+    for (p = 0; p < 2; p++)
+    {
+        for (b = 0; b < 4; b++)
+        {
+            for (k = 0; k < 8; k++)
+                out[16 * b + 4 * (2 * (k & 1) + p) + (k >> 1)] =
+                    (uint8)(q[4 * p + b] >> (8 * k));
+        }
+    }
+}
+
+#define BS_V            unsigned long long
+#define BS_BLOCKS       4
+#define BS_PREFIX       bs64_
+#define BS_ATTR
+#define BS_XOR(a, b)    ((a) ^ (b))
+#define BS_AND(a, b)    ((a) & (b))
+#define BS_OR(a, b)     ((a) | (b))
+#define BS_NOT(a)       (~(a))
+#define BS_SHL(x, n)    ((x) << (n))
+#define BS_SHR(x, n)    ((x) >> (n))
+#define BS_ROT32(x)     (((x) << 32) | ((x) >> 32))
+#define BS_SET1(u)      ((unsigned long long)(u))
+#define BS_LOAD(q, in)  bs64_load(q, in)
+#define BS_STORE(out, q) bs64_store(out, q)
+#include "aes-bitslice.h"
+
+/* SubWord for the key schedule: the four bytes of w go through bs64_sbox() */
+static uint32 aes_sub_word(uint32 w)
+{
+    unsigned long long q[8];
+    uint32 r = 0;
+    int b;
+
+    for (b = 0; b < 8; b++)
+        q[b] = (w >> b) & 0x01010101;
+    bs64_sbox(q);
+    for (b = 0; b < 8; b++)
+        r |= (uint32)(q[b] & 0x01010101) << b;
+    return(r);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#define AES_HAVE_BS_SIMD
+#include <immintrin.h>
+
+#define BS_SSE2_TARGET __attribute__((target("sse2")))
+#define BS_AVX2_TARGET __attribute__((target("avx2")))
+
+/*
+ * SSE2: unpacking each block with itself shifted by 8 bytes gives
+ * columns 0 and 2 interleaved in the low half and columns 1 and 3 in
+ * the high half; blocks 0-3 then go to lane 0 and blocks 4-7 to lane 1.
+ */
+BS_SSE2_TARGET
+static inline void bs_sse2_load(__m128i *q, const uint8 *in)
+{
+    __m128i u[8], x;
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        x = _mm_loadu_si128((const __m128i *)(in + 16 * i));
+        u[i] = _mm_unpacklo_epi8(x, _mm_srli_si128(x, 8));
+    }
+    for (i = 0; i < 4; i++)
+    {
+        q[i] = _mm_unpacklo_epi64(u[i], u[i + 4]);
+        q[i + 4] = _mm_unpackhi_epi64(u[i], u[i + 4]);
+    }
+}
+
+BS_SSE2_TARGET
+static inline void bs_sse2_store(uint8 *out, const __m128i *q)
+{
+    __m128i u[8], lo = _mm_set1_epi16(0x00FF);
+    int i;
+
+    for (i = 0; i < 4; i++)
+    {
+        u[i] = _mm_unpacklo_epi64(q[i], q[i + 4]);
+        u[i + 4] = _mm_unpackhi_epi64(q[i], q[i + 4]);
+    }
+    for (i = 0; i < 8; i++)
+        _mm_storeu_si128((__m128i *)(out + 16 * i),
+                         _mm_packus_epi16(_mm_and_si128(u[i], lo),
+                                          _mm_srli_epi16(u[i], 8)));
+}
+
+#define BS_V            __m128i
+#define BS_BLOCKS       8
+#define BS_PREFIX       bs_sse2_
+#define BS_ATTR         BS_SSE2_TARGET
+#define BS_XOR(a, b)    _mm_xor_si128(a, b)
+#define BS_AND(a, b)    _mm_and_si128(a, b)
+#define BS_OR(a, b)     _mm_or_si128(a, b)
+#define BS_NOT(a)       _mm_xor_si128(a, _mm_set1_epi32(-1))
+#define BS_SHL(x, n)    _mm_slli_epi64(x, n)
+#define BS_SHR(x, n)    _mm_srli_epi64(x, n)
+#define BS_ROT32(x)     _mm_shuffle_epi32(x, 0xB1)
+#define BS_SET1(u)      _mm_set1_epi64x((long long)(u))
+#define BS_LOAD(q, in)  bs_sse2_load(q, in)
+#define BS_STORE(out, q) bs_sse2_store(out, q)
+#include "aes-bitslice.h"
+
+/* AVX2: blocks 0-7 in the low 128 bits, blocks 8-15 in the high */
+BS_AVX2_TARGET
+static inline void bs_avx2_load(__m256i *q, const uint8 *in)
+{
+    __m128i lo[8], hi[8];
+    int i;
+
+    bs_sse2_load(lo, in);
+    bs_sse2_load(hi, in + 128);
+    for (i = 0; i < 8; i++)
+        q[i] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo[i]),
+                                       hi[i], 1);
+}
+
+BS_AVX2_TARGET
+static inline void bs_avx2_store(uint8 *out, const __m256i *q)
+{
+    __m128i lo[8], hi[8];
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        lo[i] = _mm256_castsi256_si128(q[i]);
+        hi[i] = _mm256_extracti128_si256(q[i], 1);
+    }
+    bs_sse2_store(out, lo);
+    bs_sse2_store(out + 128, hi);
+}
+
+#define BS_V            __m256i
+#define BS_BLOCKS       16
+#define BS_PREFIX       bs_avx2_
+#define BS_ATTR         BS_AVX2_TARGET
+#define BS_XOR(a, b)    _mm256_xor_si256(a, b)
+#define BS_AND(a, b)    _mm256_and_si256(a, b)
+#define BS_OR(a, b)     _mm256_or_si256(a, b)
+#define BS_NOT(a)       _mm256_xor_si256(a, _mm256_set1_epi32(-1))
+#define BS_SHL(x, n)    _mm256_slli_epi64(x, n)
+#define BS_SHR(x, n)    _mm256_srli_epi64(x, n)
+#define BS_ROT32(x)     _mm256_shuffle_epi32(x, 0xB1)
+#define BS_SET1(u)      _mm256_set1_epi64x((long long)(u))
+#define BS_LOAD(q, in)  bs_avx2_load(q, in)
+#define BS_STORE(out, q) bs_avx2_store(out, q)
+#include "aes-bitslice.h"
+
+#endif /* x86 with GCC */
+
+static bs_kernel *bs_crypt_kernel;
+static size_t bs_width;
+
+/* pick the widest kernel the host supports, on first use */
+static void bs_select(void)
+{
+    if (bs_crypt_kernel != 0)
+        return;
+    bs_crypt_kernel = bs64_crypt;
+    bs_width = 4;
+#ifdef AES_HAVE_BS_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        bs_crypt_kernel = bs_avx2_crypt;
+        bs_width = 16;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        bs_crypt_kernel = bs_sse2_crypt;
+        bs_width = 8;
+    }
+#endif
+}
+
+/* encrypt or decrypt n <= bs_width blocks, padding a short group */
+static void bs_crypt(const aes_context *ctx, int dec, const uint8 *in,
+                     uint8 *out, size_t n)
+{
+    uint8 buf[16 * BS_MAXBLOCKS];
+
+    if (n == bs_width)
+    {
+        bs_crypt_kernel(ctx, dec, in, out);
+        return;
+    }
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, in, 16 * n);
+    bs_crypt_kernel(ctx, dec, buf, buf);
+    memcpy(out, buf, 16 * n);
+}
+
+static void bs_ecb(aes_context *ctx, int dec, const uint8 *input,
+                   uint8 *output, size_t nblocks)
+{
+    size_t n;
+
+    bs_select();
+    for ( ; nblocks > 0; nblocks -= n, input += 16 * n, output += 16 * n)
+    {
+        n = (nblocks < bs_width) ? nblocks : bs_width;
+        bs_crypt(ctx, dec, input, output, n);
+    }
+}
+
+static void bs_cbc_encrypt(aes_context *ctx, uint8 iv[16],
+                           const uint8 *input, uint8 *output, size_t nblocks)
+{
+    int i;
+
+    bs_select();
+    for ( ; nblocks > 0; nblocks--, input += 16, output += 16)
+    {
+        for (i = 0; i < 16; i++)
+            iv[i] ^= input[i];
+        bs_crypt(ctx, 0, iv, iv, 1);
+        memcpy(output, iv, 16);
+    }
+}
+
+static void bs_cbc_decrypt(aes_context *ctx, uint8 iv[16],
+                           const uint8 *input, uint8 *output, size_t nblocks)
+{
+    uint8 c[16 * (BS_MAXBLOCKS + 1)];
+    size_t i, n;
+
+    bs_select();
+    for ( ; nblocks > 0; nblocks -= n, input += 16 * n, output += 16 * n)
+    {
+        n = (nblocks < bs_width) ? nblocks : bs_width;
+        /* c holds the previous ciphertext block, then this group's */
+        memcpy(c, iv, 16);
+        memcpy(c + 16, input, 16 * n);
+        bs_crypt(ctx, 1, input, output, n);
+        for (i = 0; i < 16 * n; i++)
+            output[i] ^= c[i];
+        memcpy(iv, c + 16 * n, 16);
+    }
+}
+
+static void bs_ctr_crypt(aes_context *ctx, uint8 counter[16],
+                         const uint8 *input, uint8 *output, size_t length)
+{
+    uint8 ks[16 * BS_MAXBLOCKS];
+    size_t i, j, n, len;
+
+    bs_select();
+    while (length > 0)
+    {
+        n = (length + 15) / 16;
+        if (n > bs_width)
+            n = bs_width;
+        for (j = 0; j < n; j++)
+        {
+            memcpy(ks + 16 * j, counter, 16);
+            for (i = 16; i-- > 0 && ++counter[i] == 0; )
+                ;
+        }
+        bs_crypt(ctx, 0, ks, ks, n);
+        len = (length < 16 * n) ? length : 16 * n;
+        for (i = 0; i < len; i++)
+            output[i] = input[i] ^ ks[i];
+        input += len;
+        output += len;
+        length -= len;
+    }
+}
+
+/*
+ * Engine selection
+ */
+
+static int aes_engine = AES_ENGINE_AUTO;
+
+static int aes_engine_supported(int engine)
+{
+    switch (engine)
+    {
+    case AES_ENGINE_AUTO:
+    case AES_ENGINE_TABLE:
+    case AES_ENGINE_BITSLICE:
+        return(1);
+#ifdef AES_HAVE_AESNI
+    case AES_ENGINE_AESNI:
+        return(aes_have_aesni());
+#endif
+    default:
+        return(0);
+    }
+}
+
+/*
+ * the engine to use now, resolving AES_ENGINE_AUTO on first use;
+ * without AES-NI that is the bitsliced engine rather than the faster
+ * table engine, so that the default is constant-time everywhere
+ */
+static int aes_current_engine(void)
+{
+    if (aes_engine == AES_ENGINE_AUTO)
+        aes_engine = aes_engine_supported(AES_ENGINE_AESNI) ?
+                     AES_ENGINE_AESNI : AES_ENGINE_BITSLICE;
+    return(aes_engine);
+}
+
+/* select the engine for all contexts; returns 1 if it is unsupported */
+int aes_set_engine(int engine)
+{
+    if (!aes_engine_supported(engine))
+        return(1);
+    aes_engine = engine;
+    return(0);
+}
+
+int aes_get_engine(void)
+{
+    return(aes_current_engine());
+}
+
+const char *aes_engine_name(int engine)
+{
+    switch (engine)
+    {
+    case AES_ENGINE_AUTO:     return("auto");
+    case AES_ENGINE_TABLE:    return("table");
+    case AES_ENGINE_BITSLICE: return("bitslice");
+    case AES_ENGINE_AESNI:    return("aes-ni");
+    default:                  return("unknown");
+    }
+}
+
+/*
+ * Single-block and multi-block interfaces
+ */
+
+void aes_encrypt(aes_context *ctx, uint8 input[16], uint8 output[16])
+{
+#ifdef AES_HAVE_AESNI
+    if (aes_current_engine() == AES_ENGINE_AESNI)
+    {
+        aesni_ecb(ctx, 0, input, output, 1);
+        return;
+    }
+#endif
+    if (aes_current_engine() == AES_ENGINE_BITSLICE)
+    {
+        bs_ecb(ctx, 0, input, output, 1);
+        return;
+    }
+    aes_encrypt_table(ctx, input, output);
+}
+
+void aes_decrypt(aes_context *ctx, uint8 input[16], uint8 output[16])
+{
+#ifdef AES_HAVE_AESNI
+    if (aes_current_engine() == AES_ENGINE_AESNI)
+    {
+        aesni_ecb(ctx, 1, input, output, 1);
+        return;
+    }
+#endif
+    if (aes_current_engine() == AES_ENGINE_BITSLICE)
+    {
+        bs_ecb(ctx, 1, input, output, 1);
+        return;
+    }
+    aes_decrypt_table(ctx, input, output);
+}
+
+/* ECB: encrypt nblocks 16-byte blocks independently */
+void aes_ecb_encrypt(aes_context *ctx, const uint8 *input, uint8 *output,
+                     size_t nblocks)
+{
+#ifdef AES_HAVE_AESNI
+    if (aes_current_engine() == AES_ENGINE_AESNI)
+    {
+        aesni_ecb(ctx, 0, input, output, nblocks);
+        return;
+    }
+#endif
+    if (aes_current_engine() == AES_ENGINE_BITSLICE)
+    {
+        bs_ecb(ctx, 0, input, output, nblocks);
+        return;
+    }
+    for ( ; nblocks > 0; nblocks--, input += 16, output += 16)
+        aes_encrypt_table(ctx, input, output);
+}
+
+/* ECB: decrypt nblocks 16-byte blocks independently */
+void aes_ecb_decrypt(aes_context *ctx, const uint8 *input, uint8 *output,
+                     size_t nblocks)
+{
+#ifdef AES_HAVE_AESNI
+    if (aes_current_engine() == AES_ENGINE_AESNI)
+    {
+        aesni_ecb(ctx, 1, input, output, nblocks);
+        return;
+    }
+#endif
+    if (aes_current_engine() == AES_ENGINE_BITSLICE)
+    {
+        bs_ecb(ctx, 1, input, output, nblocks);
+        return;
+    }
+    for ( ; nblocks > 0; nblocks--, input += 16, output += 16)
+        aes_decrypt_table(ctx, input, output);
+}
+
+/* CBC encryption; iv is updated so that calls can be chained */
+void aes_cbc_encrypt(aes_context *ctx, uint8 iv[16], const uint8 *input,
+                     uint8 *output, size_t nblocks)
+{
+    int i;
+
+#ifdef AES_HAVE_AESNI
+    if (aes_current_engine() == AES_ENGINE_AESNI)
+    {
+        aesni_cbc_encrypt(ctx, iv, input, output, nblocks);
+        return;
+    }
+#endif
+    if (aes_current_engine() == AES_ENGINE_BITSLICE)
+    {
+        bs_cbc_encrypt(ctx, iv, input, output, nblocks);
+        return;
+    }
+    for ( ; nblocks > 0; nblocks--, input += 16, output += 16)
+    {
+        for (i = 0; i < 16; i++)
+            iv[i] ^= input[i];
+        aes_encrypt_table(ctx, iv, iv);
+        memcpy(output, iv, 16);
+    }
+}
+
+/* CBC decryption; iv is updated so that calls can be chained */
+void aes_cbc_decrypt(aes_context *ctx, uint8 iv[16], const uint8 *input,
+                     uint8 *output, size_t nblocks)
+{
+    uint8 block[16], next[16];
+    int i;
+
+#ifdef AES_HAVE_AESNI
+    if (aes_current_engine() == AES_ENGINE_AESNI)
+    {
+        aesni_cbc_decrypt(ctx, iv, input, output, nblocks);
+        return;
+    }
+#endif
+    if (aes_current_engine() == AES_ENGINE_BITSLICE)
+    {
+        bs_cbc_decrypt(ctx, iv, input, output, nblocks);
+        return;
+    }
+    for ( ; nblocks > 0; nblocks--, input += 16, output += 16)
+    {
+        memcpy(next, input, 16);
+        aes_decrypt_table(ctx, input, block);
+        for (i = 0; i < 16; i++)
+            output[i] = block[i] ^ iv[i];
+        memcpy(iv, next, 16);
+    }
+}
+
+/*
+ * CTR: XOR length bytes with the keystream E(counter), E(counter + 1),
+ * ..., treating the counter as a 128-bit big-endian integer.  The
+ * counter is advanced past every block used, including a partial
+ * last block, so a chained call starts on a fresh block.
+ */
+void aes_ctr_crypt(aes_context *ctx, uint8 counter[16], const uint8 *input,
+                   uint8 *output, size_t length)
+{
+    uint8 ks[16];
+    size_t i, n;
+
+#ifdef AES_HAVE_AESNI
+    if (aes_current_engine() == AES_ENGINE_AESNI)
+    {
+        aesni_ctr_crypt(ctx, counter, input, output, length);
+        return;
+    }
+#endif
+    if (aes_current_engine() == AES_ENGINE_BITSLICE)
+    {
+        bs_ctr_crypt(ctx, counter, input, output, length);
+        return;
+    }
+    while (length > 0)
+    {
+        aes_encrypt_table(ctx, counter, ks);
+        for (i = 16; i-- > 0 && ++counter[i] == 0; )
+            ;
+        n = (length < 16) ? length : 16;
+        for (i = 0; i < n; i++)
+            output[i] = input[i] ^ ks[i];
+        input += n;
+        output += n;
+        length -= n;
+    }
+}
+
 #ifdef TEST
 
 #include <string.h>
@@ -804,7 +1564,7 @@ static unsigned char AES_dec_test[3][16] =
       0x84, 0x60, 0x4D, 0x60, 0x27, 0x1B, 0xC5, 0x9A }
 };
 
-int main(void )
+static int monte_carlo(void)
 {
     int m, n, i, j;
     aes_context ctx;
@@ -872,9 +1632,239 @@ int main(void )
         }
     }
 
+    return(0);
+}
+
+
+/*
+ * NIST SP 800-38A test vectors for AES-128 (F.1.1, F.2.2 and F.5.1)
+ */
+
+static unsigned char SP800_key[16] =
+{
+    0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+    0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C
+};
+
+static unsigned char SP800_plain[64] =
+{
+    0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96,
+    0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A,
+    0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C,
+    0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51,
+    0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11,
+    0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF,
+    0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17,
+    0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10
+};
+
+static unsigned char SP800_ecb[64] =
+{
+    0x3A, 0xD7, 0x7B, 0xB4, 0x0D, 0x7A, 0x36, 0x60,
+    0xA8, 0x9E, 0xCA, 0xF3, 0x24, 0x66, 0xEF, 0x97,
+    0xF5, 0xD3, 0xD5, 0x85, 0x03, 0xB9, 0x69, 0x9D,
+    0xE7, 0x85, 0x89, 0x5A, 0x96, 0xFD, 0xBA, 0xAF,
+    0x43, 0xB1, 0xCD, 0x7F, 0x59, 0x8E, 0xCE, 0x23,
+    0x88, 0x1B, 0x00, 0xE3, 0xED, 0x03, 0x06, 0x88,
+    0x7B, 0x0C, 0x78, 0x5E, 0x27, 0xE8, 0xAD, 0x3F,
+    0x82, 0x23, 0x20, 0x71, 0x04, 0x72, 0x5D, 0xD4
+};
+
+static unsigned char SP800_cbc_iv[16] =
+{
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F
+};
+
+static unsigned char SP800_cbc[64] =
+{
+    0x76, 0x49, 0xAB, 0xAC, 0x81, 0x19, 0xB2, 0x46,
+    0xCE, 0xE9, 0x8E, 0x9B, 0x12, 0xE9, 0x19, 0x7D,
+    0x50, 0x86, 0xCB, 0x9B, 0x50, 0x72, 0x19, 0xEE,
+    0x95, 0xDB, 0x11, 0x3A, 0x91, 0x76, 0x78, 0xB2,
+    0x73, 0xBE, 0xD6, 0xB8, 0xE3, 0xC1, 0x74, 0x3B,
+    0x71, 0x16, 0xE6, 0x9E, 0x22, 0x22, 0x95, 0x16,
+    0x3F, 0xF1, 0xCA, 0xA1, 0x68, 0x1F, 0xAC, 0x09,
+    0x12, 0x0E, 0xCA, 0x30, 0x75, 0x86, 0xE1, 0xA7
+};
+
+static unsigned char SP800_ctr_iv[16] =
+{
+    0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7,
+    0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF
+};
+
+static unsigned char SP800_ctr[64] =
+{
+    0x87, 0x4D, 0x61, 0x91, 0xB6, 0x20, 0xE3, 0x26,
+    0x1B, 0xEF, 0x68, 0x64, 0x99, 0x0D, 0xB6, 0xCE,
+    0x98, 0x06, 0xF6, 0x6B, 0x79, 0x70, 0xFD, 0xFF,
+    0x86, 0x17, 0x18, 0x7B, 0xB9, 0xFF, 0xFD, 0xFF,
+    0x5A, 0xE4, 0xDF, 0x3E, 0xDB, 0xD5, 0xD3, 0x5E,
+    0x5B, 0x4F, 0x09, 0x02, 0x0D, 0xB0, 0x3E, 0xAB,
+    0x1E, 0x03, 0x1D, 0xDA, 0x2F, 0xBE, 0x03, 0xD1,
+    0x79, 0x21, 0x70, 0xA0, 0xF3, 0x00, 0x9C, 0xEE
+};
+
+static int check(const char *name, const unsigned char *got,
+                 const unsigned char *want, size_t len)
+{
+    int ok = (memcmp(got, want, len) == 0);
+    printf(" %-22s %s\n", name, ok ? "passed." : "failed!");
+    return(ok ? 0 : 1);
+}
+
+static int mode_tests(void)
+{
+    aes_context ctx;
+    unsigned char buf[64], iv[16];
+    int fail = 0;
+
+    printf("\n NIST SP 800-38A mode tests (AES-128)\n\n");
+
+    aes_set_key(&ctx, SP800_key, 128);
+
+    aes_ecb_encrypt(&ctx, SP800_plain, buf, 4);
+    fail += check("ECB encryption:", buf, SP800_ecb, 64);
+    aes_ecb_decrypt(&ctx, buf, buf, 4);
+    fail += check("ECB decryption:", buf, SP800_plain, 64);
+
+    memcpy(iv, SP800_cbc_iv, 16);
+    aes_cbc_encrypt(&ctx, iv, SP800_plain, buf, 4);
+    fail += check("CBC encryption:", buf, SP800_cbc, 64);
+    memcpy(iv, SP800_cbc_iv, 16);
+    aes_cbc_decrypt(&ctx, iv, buf, buf, 4);
+    fail += check("CBC decryption:", buf, SP800_plain, 64);
+
+    memcpy(iv, SP800_ctr_iv, 16);
+    aes_ctr_crypt(&ctx, iv, SP800_plain, buf, 64);
+    fail += check("CTR encryption:", buf, SP800_ctr, 64);
+    memcpy(iv, SP800_ctr_iv, 16);
+    aes_ctr_crypt(&ctx, iv, buf, buf, 64);
+    fail += check("CTR decryption:", buf, SP800_plain, 64);
+
+    return(fail);
+}
+
+/*
+ * Compare every mode on every supported engine with the table engine,
+ * for lengths that exercise the multi-block loops and their tails,
+ * including a CTR counter that carries out of its low 64 bits.
+ */
+static int cross_check(int engine)
+{
+    enum { MAXBLOCKS = 37 };
+    aes_context ctx;
+    unsigned char key[32], in[16 * MAXBLOCKS];
+    unsigned char want[16 * MAXBLOCKS], got[16 * MAXBLOCKS];
+    unsigned char iv1[16], iv2[16];
+    int nbits, i, fail = 0;
+    size_t n, len;
+
+    for (i = 0; i < (int)sizeof(in); i++)
+        in[i] = (unsigned char)(i * 73 + 11);
+    for (i = 0; i < (int)sizeof(key); i++)
+        key[i] = (unsigned char)(i * 29 + 5);
+
+    for (nbits = 128; nbits <= 256; nbits += 64)
+    {
+        aes_set_key(&ctx, key, nbits);
+        for (n = 0; n <= MAXBLOCKS; n++)
+        {
+            aes_set_engine(AES_ENGINE_TABLE);
+            aes_ecb_encrypt(&ctx, in, want, n);
+            aes_set_engine(engine);
+            aes_ecb_encrypt(&ctx, in, got, n);
+            fail |= memcmp(want, got, 16 * n);
+            aes_ecb_decrypt(&ctx, got, got, n);
+            fail |= memcmp(in, got, 16 * n);
+
+            memset(iv1, 0xA5, 16);
+            aes_set_engine(AES_ENGINE_TABLE);
+            aes_cbc_encrypt(&ctx, iv1, in, want, n);
+            memset(iv2, 0xA5, 16);
+            aes_set_engine(engine);
+            aes_cbc_encrypt(&ctx, iv2, in, got, n);
+            fail |= memcmp(want, got, 16 * n) | memcmp(iv1, iv2, 16);
+            memset(iv2, 0xA5, 16);
+            aes_cbc_decrypt(&ctx, iv2, got, got, n);
+            fail |= memcmp(in, got, 16 * n) | memcmp(iv1, iv2, 16);
+        }
+        for (len = 0; len <= sizeof(in); len += 7)
+        {
+            memset(iv1, 0xFF, 16);
+            iv1[0] = 0;
+            iv1[7] = 0;
+            memcpy(iv2, iv1, 16);
+            aes_set_engine(AES_ENGINE_TABLE);
+            aes_ctr_crypt(&ctx, iv1, in, want, len);
+            aes_set_engine(engine);
+            aes_ctr_crypt(&ctx, iv2, in, got, len);
+            fail |= memcmp(want, got, len) | memcmp(iv1, iv2, 16);
+        }
+    }
+    aes_set_engine(AES_ENGINE_AUTO);
+    printf(" %-22s %s\n", "Engine cross-check:", fail ? "failed!" : "passed.");
+    return(fail ? 1 : 0);
+}
+
+/* cross-check the narrower bitsliced kernels too */
+static int bitslice_kernels(void)
+{
+    static const struct { const char *name; bs_kernel *fn; size_t width; }
+    kernels[] =
+    {
+        { "64-bit", bs64_crypt, 4 },
+#ifdef AES_HAVE_BS_SIMD
+        { "SSE2", bs_sse2_crypt, 8 },
+#endif
+    };
+    bs_kernel *save_fn;
+    size_t save_width, i;
+    int fail = 0;
+
+    bs_select();
+    save_fn = bs_crypt_kernel;
+    save_width = bs_width;
+    for (i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++)
+    {
+        if (kernels[i].fn == save_fn)
+            continue;
+        printf("\n Engine bitslice, %s kernel\n", kernels[i].name);
+        bs_crypt_kernel = kernels[i].fn;
+        bs_width = kernels[i].width;
+        fail += mode_tests();
+        fail += cross_check(AES_ENGINE_BITSLICE);
+    }
+    bs_crypt_kernel = save_fn;
+    bs_width = save_width;
+    return(fail);
+}
+
+int main(void)
+{
+    int engine, fail = 0;
+
+    for (engine = AES_ENGINE_TABLE; engine <= AES_ENGINE_AESNI; engine++)
+    {
+        if (aes_set_engine(engine) != 0)
+        {
+            printf("\n Engine %s: not supported\n", aes_engine_name(engine));
+            continue;
+        }
+        printf("\n Engine %s\n", aes_engine_name(engine));
+        fail += monte_carlo();
+        fail += mode_tests();
+        if (engine != AES_ENGINE_TABLE)
+            fail += cross_check(engine);
+        if (engine == AES_ENGINE_BITSLICE)
+            fail += bitslice_kernels();
+    }
+    aes_set_engine(AES_ENGINE_AUTO);
+
     printf("\n");
 
-    return(0);
+    return(fail ? 1 : 0);
 }
 
 #endif
@@ -14,11 +14,24 @@ Source: http://www.cs.rochester.edu/u/brown/Crypto/src/AES.c
 #define uint32 unsigned long int
 #endif
 
+#include <stddef.h>
+
+/* block cipher engines - see aes_set_engine() */
+enum
+{
+    AES_ENGINE_AUTO,        /* best engine the host supports */
+    AES_ENGINE_TABLE,       /* portable T-table code */
+    AES_ENGINE_BITSLICE,    /* constant-time bitsliced code (SSE2/AVX2) */
+    AES_ENGINE_AESNI        /* x86 AES-NI instructions */
+};
+
 typedef struct
 {
     uint32 erk[64];     /* encryption round keys */
     uint32 drk[64];     /* decryption round keys */
     int nr;             /* number of rounds */
+    uint8 brk[2][240];  /* erk and drk as bytes, for AES-NI */
+    unsigned long long bsk[15][8];  /* erk bitsliced, for bitslice */
 } aes_context;
 
 int  aes_set_key(aes_context *ctx, uint8 *key, int nbits);
@@ -26,4 +39,21 @@ void aes_encrypt(aes_context *ctx, uint8 input[16], uint8 output[16]);
 void aes_decrypt(aes_context *ctx, uint8 input[16], uint8 output[16]);
 void aes_gen_tables(void);
 
+/* engine selection: aes_set_engine() returns 1 if not supported */
+int  aes_set_engine(int engine);
+int  aes_get_engine(void);
+const char *aes_engine_name(int engine);
+
+/* multi-block modes; input and output may be the same buffer */
+void aes_ecb_encrypt(aes_context *ctx, const uint8 *input, uint8 *output,
+                     size_t nblocks);
+void aes_ecb_decrypt(aes_context *ctx, const uint8 *input, uint8 *output,
+                     size_t nblocks);
+void aes_cbc_encrypt(aes_context *ctx, uint8 iv[16], const uint8 *input,
+                     uint8 *output, size_t nblocks);
+void aes_cbc_decrypt(aes_context *ctx, uint8 iv[16], const uint8 *input,
+                     uint8 *output, size_t nblocks);
+void aes_ctr_crypt(aes_context *ctx, uint8 counter[16], const uint8 *input,
+                   uint8 *output, size_t length);
+
 #endif /* aes.h */
@@ -47,43 +47,44 @@ int hmac(SHAversion whichSha, const unsigned char *text, int text_len,
 }
 
 /*
- *  hmacReset
+ *  hmacSchedule
  *
  *  Description:
- *      This function will initialize the hmacContext in preparation
- *      for computing a new HMAC message digest.
+ *      This helper function absorbs the padded key into a pair of
+ *      hash contexts: inner after K XOR ipad, outer after K XOR opad.
+ *      These midstates are all an HMAC needs to remember of the key.
  *
  *  Parameters:
- *      context: [in/out]
- *          The context to reset.
  *      whichSha: [in]
  *          One of SHA1, SHA224, SHA256, SHA384, SHA512
  *      key: [in]
  *          The secret shared key.
  *      key_len: [in]
  *          The length of the secret shared key.
+ *      inner, outer: [out]
+ *          The contexts to initialise.
  *
  *  Returns:
  *      sha Error Code.
  *
  */
-int hmacReset(HMACContext *ctx, enum SHAversion whichSha,
-    const unsigned char *key, int key_len)
+static int hmacSchedule(enum SHAversion whichSha,
+    const unsigned char *key, int key_len,
+    USHAContext *inner, USHAContext *outer)
 {
   int i, blocksize, hashsize;
 
   /* inner padding - key XORd with ipad */
   unsigned char k_ipad[USHA_Max_Message_Block_Size];
 
+  /* outer padding - key XORd with opad */
+  unsigned char k_opad[USHA_Max_Message_Block_Size];
+
   /* temporary buffer when keylen > blocksize */
   unsigned char tempkey[USHAMaxHashSize];
 
-  if (!ctx) return shaNull;
-
-  blocksize = ctx->blockSize = USHABlockSize(whichSha);
-  hashsize = ctx->hashSize = USHAHashSize(whichSha);
-
-  ctx->whichSha = whichSha;
+  blocksize = USHABlockSize(whichSha);
+  hashsize = USHAHashSize(whichSha);
 
   /*
    * If key is longer than the hash blocksize,
@@ -115,19 +116,163 @@ int hmacReset(HMACContext *ctx, enum SHAversion whichSha,
   /* store key into the pads, XOR'd with ipad and opad values */
   for (i = 0; i < key_len; i++) {
     k_ipad[i] = key[i] ^ 0x36;
-    ctx->k_opad[i] = key[i] ^ 0x5c;
+    k_opad[i] = key[i] ^ 0x5c;
   }
   /* remaining pad bytes are '\0' XOR'd with ipad and opad values */
   for ( ; i < blocksize; i++) {
     k_ipad[i] = 0x36;
-    ctx->k_opad[i] = 0x5c;
+    k_opad[i] = 0x5c;
   }
 
-  /* perform inner hash */
-  /* init context for 1st pass */
-  return USHAReset(&ctx->shaContext, whichSha) ||
-         /* and start with inner pad */
-         USHAInput(&ctx->shaContext, k_ipad, blocksize);
+  /* start the inner hash with the inner pad */
+  return USHAReset(inner, whichSha) ||
+         USHAInput(inner, k_ipad, blocksize) ||
+         /* and the outer hash with the outer pad */
+         USHAReset(outer, whichSha) ||
+         USHAInput(outer, k_opad, blocksize);
+}
+
+/*
+ *  hmacReset
+ *
+ *  Description:
+ *      This function will initialize the hmacContext in preparation
+ *      for computing a new HMAC message digest.
+ *
+ *  Parameters:
+ *      context: [in/out]
+ *          The context to reset.
+ *      whichSha: [in]
+ *          One of SHA1, SHA224, SHA256, SHA384, SHA512
+ *      key: [in]
+ *          The secret shared key.
+ *      key_len: [in]
+ *          The length of the secret shared key.
+ *
+ *  Returns:
+ *      sha Error Code.
+ *
+ */
+int hmacReset(HMACContext *ctx, enum SHAversion whichSha,
+    const unsigned char *key, int key_len)
+{
+  if (!ctx) return shaNull;
+
+  ctx->whichSha = whichSha;
+  ctx->blockSize = USHABlockSize(whichSha);
+  ctx->hashSize = USHAHashSize(whichSha);
+
+  return hmacSchedule(whichSha, key, key_len,
+                      &ctx->shaContext, &ctx->outerContext);
+}
+
+/*
+ *  hmacPrecompute
+ *
+ *  Description:
+ *      This function will hash the padded key once, so that any
+ *      number of messages can then be authenticated with it by
+ *      hmacResetKey() or hmacBatch() without rehashing the key.
+ *      The HMACKey holds key-derived secrets and should be
+ *      protected (and wiped) like the key itself.
+ *
+ *  Parameters:
+ *      hkey: [out]
+ *          The key schedule to fill in.
+ *      whichSha: [in]
+ *          One of SHA1, SHA224, SHA256, SHA384, SHA512
+ *      key: [in]
+ *          The secret shared key.
+ *      key_len: [in]
+ *          The length of the secret shared key.
+ *
+ *  Returns:
+ *      sha Error Code.
+ *
+ */
+int hmacPrecompute(HMACKey *hkey, enum SHAversion whichSha,
+    const unsigned char *key, int key_len)
+{
+  if (!hkey) return shaNull;
+
+  hkey->whichSha = whichSha;
+  hkey->blockSize = USHABlockSize(whichSha);
+  hkey->hashSize = USHAHashSize(whichSha);
+
+  return hmacSchedule(whichSha, key, key_len,
+                      &hkey->innerContext, &hkey->outerContext);
+}
+
+/*
+ *  hmacResetKey
+ *
+ *  Description:
+ *      This function will initialize the hmacContext for a new HMAC
+ *      message digest by copying the midstates saved by
+ *      hmacPrecompute(), instead of hashing the key again.
+ *
+ *  Parameters:
+ *      context: [in/out]
+ *          The context to reset.
+ *      hkey: [in]
+ *          A key schedule from hmacPrecompute().
+ *
+ *  Returns:
+ *      sha Error Code.
+ *
+ */
+int hmacResetKey(HMACContext *ctx, const HMACKey *hkey)
+{
+  if (!ctx || !hkey) return shaNull;
+
+  ctx->whichSha = hkey->whichSha;
+  ctx->blockSize = hkey->blockSize;
+  ctx->hashSize = hkey->hashSize;
+  ctx->shaContext = hkey->innerContext;
+  ctx->outerContext = hkey->outerContext;
+  return shaSuccess;
+}
+
+/*
+ *  hmacBatch
+ *
+ *  Description:
+ *      This function will compute the HMAC of each of n messages
+ *      under one precomputed key.
+ *
+ *  Parameters:
+ *      hkey: [in]
+ *          A key schedule from hmacPrecompute().
+ *      n: [in]
+ *          The number of messages.
+ *      texts: [in]
+ *          texts[i] points to message i.
+ *      text_lens: [in]
+ *          text_lens[i] is the length of message i.
+ *      digests: [out]
+ *          digests[i] receives the HMAC of message i.
+ *
+ *  Returns:
+ *      sha Error Code; the first error stops the batch.
+ *
+ */
+int hmacBatch(const HMACKey *hkey, int n,
+    const unsigned char *const texts[], const int text_lens[],
+    uint8_t digests[][USHAMaxHashSize])
+{
+  HMACContext ctx;
+  int i, err = shaSuccess;
+
+  if (!hkey || (n > 0 && (!texts || !text_lens || !digests)))
+    return shaNull;
+  if (n < 0)
+    return shaBadParam;
+
+  for (i = 0; i < n && err == shaSuccess; i++)
+    err = hmacResetKey(&ctx, hkey) ||
+          hmacInput(&ctx, texts[i], text_lens[i]) ||
+          hmacResult(&ctx, digests[i]);
+  return err;
 }
 
 /*
@@ -207,22 +352,21 @@ int hmacFinalBits(HMACContext *ctx,
  *   sha Error Code.
  *
  */
-int hmacResult(HMACContext *ctx, uint8_t *digest)
+int hmacResult(HMACContext *ctx, uint8_t digest[USHAMaxHashSize])
 {
+  int err;
+
   if (!ctx) return shaNull;
 
   /* finish up 1st pass */
   /* (Use digest here as a temporary buffer.) */
-  return USHAResult(&ctx->shaContext, digest) ||
-
-         /* perform outer SHA */
-         /* init context for 2nd pass */
-         USHAReset(&ctx->shaContext, ctx->whichSha) ||
+  err = USHAResult(&ctx->shaContext, digest);
+  if (err != shaSuccess) return err;
 
-         /* start with outer pad */
-         USHAInput(&ctx->shaContext, ctx->k_opad, ctx->blockSize) ||
+  /* perform outer SHA, starting from the saved outer pad midstate */
+  ctx->shaContext = ctx->outerContext;
 
-         /* then results of 1st hash */
+  return /* then results of 1st hash */
          USHAInput(&ctx->shaContext, digest, ctx->hashSize) ||
 
          /* finish up 2nd pass */
@@ -0,0 +1,382 @@
+/****************************** sha-ni.c ******************************/
+/*
+ * Description:
+ *   This file implements the compression backends for SHA-1 and
+ *   SHA-224/256 that use the x86 SHA extensions (SHA-NI), and the
+ *   run-time selection between them and the portable C backends in
+ *   sha1.c and sha224-256.c.
+ *
+ *   SHA1ProcessBlocks() and SHA224_256ProcessBlocks() compress any
+ *   number of consecutive blocks per call, so SHA1Input() and
+ *   SHA256Input() hand whole blocks straight from the caller's
+ *   buffer to the backend without copying them into Message_Block.
+ *
+ *   The backend is chosen on first use: SHA-NI if CPUID reports the
+ *   SHA, SSSE3 and SSE4.1 extensions, otherwise portable.
+ *   SHASetBackend() overrides the choice; shatest-ietf uses it to
+ *   run the standard tests against each backend.  The dispatch
+ *   pointers are atomic, so threads that start hashing at the same
+ *   time may each resolve them without a data race: they all store
+ *   the same functions.
+ *
+ * Portability Issues:
+ *   The SHA-NI code needs GCC or Clang on x86/x86-64 (it uses
+ *   per-function target attributes and <cpuid.h>); elsewhere only
+ *   the portable backend is available.
+ */
+
+#include "sha.h"
+#include "sha-private.h"
+#include <stdatomic.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA_NI_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif /* __GNUC__ && x86 */
+
+typedef void (*SHABlocksFunc)(uint32_t *H, const uint8_t *blocks,
+    unsigned int nblocks);
+
+static void SHA1BlocksInit(uint32_t *H, const uint8_t *blocks,
+    unsigned int nblocks);
+static void SHA224_256BlocksInit(uint32_t *H, const uint8_t *blocks,
+    unsigned int nblocks);
+
+static SHABackend shaBackend = shaBackendAuto;
+static _Atomic(SHABlocksFunc) sha1Blocks = SHA1BlocksInit;
+static _Atomic(SHABlocksFunc) sha256Blocks = SHA224_256BlocksInit;
+
+#ifdef SHA_NI_X86
+
+/*
+ * SHA1_NI_ROUNDS4
+ *
+ *   Four rounds of SHA-1, group g (0..19), using the message
+ *   schedule words in M[] and the E values in Ecur/Enext.  With a
+ *   constant g, the compiler drops the schedule steps that do not
+ *   apply to that group.
+ */
+#define SHA1_NI_ROUNDS4(g, Ecur, Enext)                                \
+  do {                                                                 \
+    if ((g) < 4)                                                       \
+      M[(g) & 3] = _mm_shuffle_epi8(_mm_loadu_si128(                   \
+        (const __m128i *)(blocks + 16 * ((g) & 3))), MASK);            \
+    if ((g) == 0)                                                      \
+      Ecur = _mm_add_epi32(Ecur, M[0]);                                \
+    else                                                               \
+      Ecur = _mm_sha1nexte_epu32(Ecur, M[(g) & 3]);                    \
+    Enext = ABCD;                                                      \
+    if ((g) >= 3 && (g) <= 18)                                         \
+      M[((g) + 1) & 3] = _mm_sha1msg2_epu32(M[((g) + 1) & 3],          \
+                                            M[(g) & 3]);               \
+    ABCD = _mm_sha1rnds4_epu32(ABCD, Ecur, (g) / 5);                   \
+    if ((g) >= 1 && (g) <= 16)                                         \
+      M[((g) - 1) & 3] = _mm_sha1msg1_epu32(M[((g) - 1) & 3],          \
+                                            M[(g) & 3]);               \
+    if ((g) >= 2 && (g) <= 17)                                         \
+      M[((g) - 2) & 3] = _mm_xor_si128(M[((g) - 2) & 3], M[(g) & 3]);  \
+  } while (0)
+
+/*
+ * SHA1BlocksSHANI
+ *
+ * Description:
+ *   SHA-NI compression backend for SHA-1.
+ *
+ * Parameters:
+ *   H: [in/out]
+ *     The intermediate hash to update
+ *   blocks: [in]
+ *     The message blocks
+ *   nblocks: [in]
+ *     The number of blocks
+ */
+__attribute__((target("sha,sse4.1")))
+static void SHA1BlocksSHANI(uint32_t *H, const uint8_t *blocks,
+    unsigned int nblocks)
+{
+  const __m128i MASK =
+    _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+  __m128i ABCD, ABCD_SAVE, E0, E0_SAVE, E1;
+  __m128i M[4];
+
+  ABCD = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)H), 0x1B);
+  E0 = _mm_set_epi32((int)H[4], 0, 0, 0);
+
+  for ( ; nblocks > 0; nblocks--, blocks += SHA1_Message_Block_Size) {
+    ABCD_SAVE = ABCD;
+    E0_SAVE = E0;
+
+    SHA1_NI_ROUNDS4( 0, E0, E1);
+    SHA1_NI_ROUNDS4( 1, E1, E0);
+    SHA1_NI_ROUNDS4( 2, E0, E1);
+    SHA1_NI_ROUNDS4( 3, E1, E0);
+    SHA1_NI_ROUNDS4( 4, E0, E1);
+    SHA1_NI_ROUNDS4( 5, E1, E0);
+    SHA1_NI_ROUNDS4( 6, E0, E1);
+    SHA1_NI_ROUNDS4( 7, E1, E0);
+    SHA1_NI_ROUNDS4( 8, E0, E1);
+    SHA1_NI_ROUNDS4( 9, E1, E0);
+    SHA1_NI_ROUNDS4(10, E0, E1);
+    SHA1_NI_ROUNDS4(11, E1, E0);
+    SHA1_NI_ROUNDS4(12, E0, E1);
+    SHA1_NI_ROUNDS4(13, E1, E0);
+    SHA1_NI_ROUNDS4(14, E0, E1);
+    SHA1_NI_ROUNDS4(15, E1, E0);
+    SHA1_NI_ROUNDS4(16, E0, E1);
+    SHA1_NI_ROUNDS4(17, E1, E0);
+    SHA1_NI_ROUNDS4(18, E0, E1);
+    SHA1_NI_ROUNDS4(19, E1, E0);
+
+    E0 = _mm_sha1nexte_epu32(E0, E0_SAVE);
+    ABCD = _mm_add_epi32(ABCD, ABCD_SAVE);
+  }
+
+  _mm_storeu_si128((__m128i *)H, _mm_shuffle_epi32(ABCD, 0x1B));
+  H[4] = (uint32_t)_mm_extract_epi32(E0, 3);
+}
+
+/*
+ * SHA256_NI_ROUNDS4
+ *
+ *   Four rounds of SHA-256, group g (0..15), using the message
+ *   schedule words in M[] and the state in STATE0 (ABEF) and
+ *   STATE1 (CDGH).
+ */
+#define SHA256_NI_ROUNDS4(g)                                           \
+  do {                                                                 \
+    if ((g) < 4)                                                       \
+      M[(g) & 3] = _mm_shuffle_epi8(_mm_loadu_si128(                   \
+        (const __m128i *)(blocks + 16 * ((g) & 3))), MASK);            \
+    MSG = _mm_add_epi32(M[(g) & 3],                                    \
+      _mm_loadu_si128((const __m128i *)&SHA256_K[4 * (g)]));           \
+    STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);               \
+    if ((g) >= 3 && (g) <= 14) {                                       \
+      TMP = _mm_alignr_epi8(M[(g) & 3], M[((g) - 1) & 3], 4);          \
+      M[((g) + 1) & 3] = _mm_add_epi32(M[((g) + 1) & 3], TMP);         \
+      M[((g) + 1) & 3] = _mm_sha256msg2_epu32(M[((g) + 1) & 3],        \
+                                              M[(g) & 3]);             \
+    }                                                                  \
+    MSG = _mm_shuffle_epi32(MSG, 0x0E);                                \
+    STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);               \
+    if ((g) >= 1 && (g) <= 12)                                         \
+      M[((g) - 1) & 3] = _mm_sha256msg1_epu32(M[((g) - 1) & 3],        \
+                                              M[(g) & 3]);             \
+  } while (0)
+
+/*
+ * SHA224_256BlocksSHANI
+ *
+ * Description:
+ *   SHA-NI compression backend for SHA-224 and SHA-256.
+ *
+ * Parameters:
+ *   H: [in/out]
+ *     The intermediate hash to update
+ *   blocks: [in]
+ *     The message blocks
+ *   nblocks: [in]
+ *     The number of blocks
+ */
+__attribute__((target("sha,sse4.1")))
+static void SHA224_256BlocksSHANI(uint32_t *H, const uint8_t *blocks,
+    unsigned int nblocks)
+{
+  const __m128i MASK =
+    _mm_set_epi64x(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+  __m128i STATE0, STATE1, ABEF_SAVE, CDGH_SAVE;
+  __m128i MSG, TMP;
+  __m128i M[4];
+
+  /* Rearrange ABCD EFGH into the ABEF CDGH order the unit uses */
+  TMP = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&H[0]), 0xB1);
+  STATE1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&H[4]),
+                             0x1B);
+  STATE0 = _mm_alignr_epi8(TMP, STATE1, 8);
+  STATE1 = _mm_blend_epi16(STATE1, TMP, 0xF0);
+
+  for ( ; nblocks > 0; nblocks--, blocks += SHA256_Message_Block_Size) {
+    ABEF_SAVE = STATE0;
+    CDGH_SAVE = STATE1;
+
+    SHA256_NI_ROUNDS4( 0);
+    SHA256_NI_ROUNDS4( 1);
+    SHA256_NI_ROUNDS4( 2);
+    SHA256_NI_ROUNDS4( 3);
+    SHA256_NI_ROUNDS4( 4);
+    SHA256_NI_ROUNDS4( 5);
+    SHA256_NI_ROUNDS4( 6);
+    SHA256_NI_ROUNDS4( 7);
+    SHA256_NI_ROUNDS4( 8);
+    SHA256_NI_ROUNDS4( 9);
+    SHA256_NI_ROUNDS4(10);
+    SHA256_NI_ROUNDS4(11);
+    SHA256_NI_ROUNDS4(12);
+    SHA256_NI_ROUNDS4(13);
+    SHA256_NI_ROUNDS4(14);
+    SHA256_NI_ROUNDS4(15);
+
+    STATE0 = _mm_add_epi32(STATE0, ABEF_SAVE);
+    STATE1 = _mm_add_epi32(STATE1, CDGH_SAVE);
+  }
+
+  TMP = _mm_shuffle_epi32(STATE0, 0x1B);
+  STATE1 = _mm_shuffle_epi32(STATE1, 0xB1);
+  STATE0 = _mm_blend_epi16(TMP, STATE1, 0xF0);
+  STATE1 = _mm_alignr_epi8(STATE1, TMP, 8);
+  _mm_storeu_si128((__m128i *)&H[0], STATE0);
+  _mm_storeu_si128((__m128i *)&H[4], STATE1);
+}
+
+#endif /* SHA_NI_X86 */
+
+/*
+ * SHAHaveSHANI
+ *
+ * Description:
+ *   Report whether the host has the SHA, SSSE3 and SSE4.1
+ *   extensions the SHA-NI backends need.
+ */
+static int SHAHaveSHANI(void)
+{
+#ifdef SHA_NI_X86
+  unsigned int eax, ebx, ecx, edx;
+
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) ||
+      !(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1))
+    return 0;
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    return 0;
+  return (ebx & bit_SHA) != 0;
+#else
+  return 0;
+#endif /* SHA_NI_X86 */
+}
+
+/*
+ * SHAResolveBackend
+ *
+ * Description:
+ *   Point the dispatch functions at the selected backend.
+ */
+static void SHAResolveBackend(void)
+{
+  SHABlocksFunc blocks1 = SHA1BlocksPortable;
+  SHABlocksFunc blocks256 = SHA224_256BlocksPortable;
+
+#ifdef SHA_NI_X86
+  if (SHAGetBackend() == shaBackendSHANI) {
+    blocks1 = SHA1BlocksSHANI;
+    blocks256 = SHA224_256BlocksSHANI;
+  }
+#endif /* SHA_NI_X86 */
+  atomic_store_explicit(&sha1Blocks, blocks1, memory_order_relaxed);
+  atomic_store_explicit(&sha256Blocks, blocks256, memory_order_relaxed);
+}
+
+/*
+ * SHA1BlocksInit, SHA224_256BlocksInit
+ *
+ * Description:
+ *   Initial targets of the dispatch pointers: choose a backend on
+ *   first use, then pass the call on.
+ */
+static void SHA1BlocksInit(uint32_t *H, const uint8_t *blocks,
+    unsigned int nblocks)
+{
+  SHAResolveBackend();
+  SHA1ProcessBlocks(H, blocks, nblocks);
+}
+
+static void SHA224_256BlocksInit(uint32_t *H, const uint8_t *blocks,
+    unsigned int nblocks)
+{
+  SHAResolveBackend();
+  SHA224_256ProcessBlocks(H, blocks, nblocks);
+}
+
+/*
+ * SHA1ProcessBlocks
+ *
+ * Description:
+ *   Compress nblocks consecutive SHA-1 blocks with the selected
+ *   backend.
+ */
+void SHA1ProcessBlocks(uint32_t *H, const uint8_t *blocks,
+    unsigned int nblocks)
+{
+  atomic_load_explicit(&sha1Blocks, memory_order_relaxed)(H, blocks, nblocks);
+}
+
+/*
+ * SHA224_256ProcessBlocks
+ *
+ * Description:
+ *   Compress nblocks consecutive SHA-224/256 blocks with the
+ *   selected backend.
+ */
+void SHA224_256ProcessBlocks(uint32_t *H, const uint8_t *blocks,
+    unsigned int nblocks)
+{
+  atomic_load_explicit(&sha256Blocks, memory_order_relaxed)(H, blocks,
+                                                             nblocks);
+}
+
+/*
+ * SHASetBackend
+ *
+ * Description:
+ *   Select the compression backend for SHA-1, SHA-224 and SHA-256.
+ *   This is a process-wide setting; change it only while no hash
+ *   is being computed.
+ *
+ * Returns:
+ *   shaBadParam if the host cannot run the backend, else shaSuccess.
+ */
+int SHASetBackend(SHABackend backend)
+{
+  switch (backend) {
+    case shaBackendAuto:
+    case shaBackendPortable:
+      break;
+    case shaBackendSHANI:
+      if (SHAHaveSHANI())
+        break;
+      return shaBadParam;
+    default:
+      return shaBadParam;
+  }
+  shaBackend = backend;
+  SHAResolveBackend();
+  return shaSuccess;
+}
+
+/*
+ * SHAGetBackend
+ *
+ * Description:
+ *   Return the backend in use, with shaBackendAuto resolved.
+ */
+SHABackend SHAGetBackend(void)
+{
+  if (shaBackend != shaBackendAuto)
+    return shaBackend;
+  return SHAHaveSHANI() ? shaBackendSHANI : shaBackendPortable;
+}
+
+/*
+ * SHABackendName
+ *
+ * Description:
+ *   Return a printable name for a backend.
+ */
+const char *SHABackendName(SHABackend backend)
+{
+  switch (backend) {
+    case shaBackendAuto:     return "auto";
+    case shaBackendPortable: return "portable";
+    case shaBackendSHANI:    return "sha-ni";
+    default:                 return "unknown";
+  }
+}
@@ -26,5 +26,28 @@
 
 #define SHA_Parity(x, y, z)  ((x) ^ (y) ^ (z))
 
+/*
+ * SHA-224/256 round constants (FIPS-180-2, section 4.2.2), shared
+ * between sha224-256.c and the multi-buffer code in sha256-batch.c.
+ */
+extern const uint32_t SHA256_K[64];
+
+/*
+ * Compression backends.  Each processes nblocks consecutive
+ * message blocks, updating the intermediate hash H in place.
+ * SHA1ProcessBlocks() and SHA224_256ProcessBlocks() dispatch to
+ * the backend chosen by SHASetBackend() (see sha-ni.c); the
+ * portable backends are in sha1.c and sha224-256.c.
+ */
+extern void SHA1ProcessBlocks(uint32_t *H, const uint8_t *blocks,
+                              unsigned int nblocks);
+extern void SHA1BlocksPortable(uint32_t *H, const uint8_t *blocks,
+                               unsigned int nblocks);
+extern void SHA224_256ProcessBlocks(uint32_t *H, const uint8_t *blocks,
+                                    unsigned int nblocks);
+extern void SHA224_256BlocksPortable(uint32_t *H,
+                                     const uint8_t *blocks,
+                                     unsigned int nblocks);
+
 #endif /* _SHA_PRIVATE__H */
 
@@ -0,0 +1,524 @@
+/*************************** sha-tree.c ***************************/
+/*
+ * Description:
+ *   This file implements parallel tree hashing on top of SHA-384 and
+ *   SHA-512, for hashing very large files on many cores.  The modes
+ *   are selected with SHATreeVersion and are deliberately distinct
+ *   from SHAversion: a tree digest is not a FIPS 180-2 digest and the
+ *   sequential USHA functions are not affected by anything here.
+ *
+ *   Tree layout, with H the underlying hash (SHA-384 or SHA-512),
+ *   C the chunk size and L the message length in bytes:
+ *
+ *     1. The message is cut into n = max(1, ceil(L / C)) chunks of
+ *        C bytes; the last chunk may be short (or empty if L is 0).
+ *     2. Leaf i is H(chunk[i] || 0x00).
+ *     3. The leaves form level 0.  Each level is reduced to the next
+ *        by replacing each adjacent pair (2j, 2j+1) with the node
+ *        H(left || right || 0x01); an odd node at the end of a level
+ *        is carried up unchanged.  This repeats until one node, the
+ *        root, remains.
+ *     4. The digest is H(root || L || C || 0x02), with L and C as
+ *        64-bit big-endian integers.
+ *
+ *   The trailing byte separates leaves, inner nodes and the final
+ *   digest; putting it at the end rather than the front keeps each
+ *   chunk block-aligned, so SHA512Input() compresses it in place.
+ *   Binding L and C into the digest means that the same data hashed
+ *   with different chunk sizes gives unrelated digests.
+ *
+ *   The leaves are hashed by a pool of POSIX threads; the caller's
+ *   thread joins in.  A regular file is mapped into memory and all
+ *   its chunks are handed to the pool at once; other input (a pipe,
+ *   say) is read a batch of chunks at a time.  The inner nodes are
+ *   cheap by comparison (one node per chunk) and are computed on the
+ *   caller's thread.
+ *
+ * Portability Issues:
+ *   Requires POSIX threads and mmap().
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "sha.h"
+
+/* Domain separation suffixes */
+#define SHATREE_LEAF  0x00
+#define SHATREE_NODE  0x01
+#define SHATREE_FINAL 0x02
+
+/* Chunks per thread read in one batch when input cannot be mapped */
+#define SHATREE_BATCH 4
+
+typedef uint8_t SHATreeDigest[USHAMaxHashSize];
+
+/* One batch of chunks to be hashed into leaves */
+typedef struct SHATreeJob {
+  SHAversion whichSha;
+  const uint8_t *data;          /* start of the first chunk */
+  size_t length;                /* bytes in this batch */
+  size_t chunksize;
+  size_t nchunks;               /* chunks in this batch */
+  size_t next;                  /* next chunk to hand out */
+  size_t done;                  /* chunks finished */
+  SHATreeDigest *leaves;        /* leaf digest for each chunk */
+  int err;                      /* first error, or shaSuccess */
+} SHATreeJob;
+
+typedef struct SHATreePool {
+  pthread_mutex_t lock;
+  pthread_cond_t work;          /* a job was posted, or shutdown */
+  pthread_cond_t idle;          /* the current job is finished */
+  pthread_t *threads;
+  unsigned int nthreads;        /* worker threads started */
+  unsigned long generation;     /* incremented for each job */
+  int shutdown;
+  SHATreeJob *job;              /* current job, or null */
+} SHATreePool;
+
+static SHAversion SHATreeSha(SHATreeVersion whichTree)
+{
+  return (whichTree == SHA384Tree) ? SHA384 : SHA512;
+}
+
+/*
+ * Hash chunk i of the job into its leaf.
+ */
+static int SHATreeLeaf(const SHATreeJob *job, size_t i)
+{
+  USHAContext sha;
+  static const uint8_t suffix = SHATREE_LEAF;
+  size_t offset = i * job->chunksize;
+  size_t n = job->length - offset;
+  int err;
+
+  if (n > job->chunksize)
+    n = job->chunksize;
+  err = USHAReset(&sha, job->whichSha);
+  if (err == shaSuccess && n > 0)
+    err = USHAInput(&sha, job->data + offset, (unsigned int)n);
+  if (err == shaSuccess)
+    err = USHAInput(&sha, &suffix, 1);
+  if (err == shaSuccess)
+    err = USHAResult(&sha, job->leaves[i]);
+  return err;
+}
+
+/*
+ * Hash chunks of the current job until none are left to hand out.
+ * Called, and returns, with pool->lock held.
+ */
+static void SHATreeRun(SHATreePool *pool)
+{
+  SHATreeJob *job = pool->job;
+
+  while (job && job->next < job->nchunks) {
+    size_t i = job->next++;
+    int err;
+    pthread_mutex_unlock(&pool->lock);
+    err = SHATreeLeaf(job, i);
+    pthread_mutex_lock(&pool->lock);
+    if (err != shaSuccess && job->err == shaSuccess)
+      job->err = err;
+    if (++job->done == job->nchunks)
+      pthread_cond_signal(&pool->idle);
+  }
+}
+
+static void *SHATreeWorker(void *arg)
+{
+  SHATreePool *pool = arg;
+  unsigned long seen = 0;
+
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (!pool->shutdown && pool->generation == seen)
+      pthread_cond_wait(&pool->work, &pool->lock);
+    if (pool->shutdown)
+      break;
+    seen = pool->generation;
+    SHATreeRun(pool);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return 0;
+}
+
+/*
+ * Start nthreads - 1 workers; the caller's thread is the last one.
+ */
+static int SHATreePoolStart(SHATreePool *pool, unsigned int nthreads)
+{
+  unsigned int i;
+
+  memset(pool, 0, sizeof(*pool));
+  if (pthread_mutex_init(&pool->lock, 0) != 0)
+    return shaResourceError;
+  pthread_cond_init(&pool->work, 0);
+  pthread_cond_init(&pool->idle, 0);
+  if (nthreads > 1 &&
+      (pool->threads = malloc((nthreads - 1) * sizeof(*pool->threads)))) {
+    for (i = 0; i < nthreads - 1; i++) {
+      if (pthread_create(&pool->threads[i], 0, SHATreeWorker, pool) != 0)
+        break;
+      pool->nthreads++;
+    }
+  }
+  /* Running with fewer threads than asked for is not an error */
+  return shaSuccess;
+}
+
+static void SHATreePoolStop(SHATreePool *pool)
+{
+  unsigned int i;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->shutdown = 1;
+  pthread_cond_broadcast(&pool->work);
+  pthread_mutex_unlock(&pool->lock);
+  for (i = 0; i < pool->nthreads; i++)
+    pthread_join(pool->threads[i], 0);
+  free(pool->threads);
+  pthread_cond_destroy(&pool->idle);
+  pthread_cond_destroy(&pool->work);
+  pthread_mutex_destroy(&pool->lock);
+}
+
+/*
+ * Hash every chunk of the job on the pool and wait for the result.
+ */
+static int SHATreePoolRun(SHATreePool *pool, SHATreeJob *job)
+{
+  pthread_mutex_lock(&pool->lock);
+  pool->job = job;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->work);
+  SHATreeRun(pool);
+  while (job->done < job->nchunks)
+    pthread_cond_wait(&pool->idle, &pool->lock);
+  pool->job = 0;
+  pthread_mutex_unlock(&pool->lock);
+  return job->err;
+}
+
+/*
+ * Hash one batch of data, which starts on a chunk boundary, into
+ * leaves; an empty batch still has one (empty) chunk.
+ */
+static int SHATreeLeaves(SHATreePool *pool, SHAversion whichSha,
+  const uint8_t *data, size_t length, size_t chunksize,
+  SHATreeDigest *leaves)
+{
+  SHATreeJob job;
+
+  memset(&job, 0, sizeof(job));
+  job.whichSha = whichSha;
+  job.data = data;
+  job.length = length;
+  job.chunksize = chunksize;
+  job.nchunks = (length == 0) ? 1 : (length - 1) / chunksize + 1;
+  job.leaves = leaves;
+  return SHATreePoolRun(pool, &job);
+}
+
+/*
+ * Reduce n leaves to the final digest, as described at the top of
+ * this file.  The leaves array is overwritten.
+ */
+static int SHATreeRoot(SHAversion whichSha, SHATreeDigest *nodes,
+  size_t n, uint64_t length, uint64_t chunksize,
+  uint8_t digest[USHAMaxHashSize])
+{
+  USHAContext sha;
+  int hashsize = USHAHashSize(whichSha);
+  uint8_t suffix, trailer[2 * 8 + 1];
+  size_t i, j;
+  int err = shaSuccess;
+
+  while (n > 1 && err == shaSuccess) {
+    suffix = SHATREE_NODE;
+    for (i = 0, j = 0; i + 1 < n && err == shaSuccess; i += 2, j++) {
+      err = USHAReset(&sha, whichSha);
+      if (err == shaSuccess)
+        err = USHAInput(&sha, nodes[i], hashsize);
+      if (err == shaSuccess)
+        err = USHAInput(&sha, nodes[i + 1], hashsize);
+      if (err == shaSuccess)
+        err = USHAInput(&sha, &suffix, 1);
+      if (err == shaSuccess)
+        err = USHAResult(&sha, nodes[j]);
+    }
+    if (n & 1)
+      memcpy(nodes[j++], nodes[n - 1], hashsize);
+    n = j;
+  }
+
+  for (i = 0; i < 8; i++) {
+    trailer[i] = (uint8_t)(length >> (56 - 8 * i));
+    trailer[8 + i] = (uint8_t)(chunksize >> (56 - 8 * i));
+  }
+  trailer[16] = SHATREE_FINAL;
+  if (err == shaSuccess)
+    err = USHAReset(&sha, whichSha);
+  if (err == shaSuccess)
+    err = USHAInput(&sha, nodes[0], hashsize);
+  if (err == shaSuccess)
+    err = USHAInput(&sha, trailer, sizeof(trailer));
+  if (err == shaSuccess)
+    err = USHAResult(&sha, digest);
+  return err;
+}
+
+/*
+ * Check the parameters common to SHATreeHash() and SHATreeHashFile(),
+ * filling in the defaults for nthreads and chunksize.
+ */
+static int SHATreeCheck(SHATreeVersion whichTree, unsigned int *nthreads,
+  size_t *chunksize, uint8_t *digest)
+{
+  if (!digest)
+    return shaNull;
+  if (whichTree != SHA384Tree && whichTree != SHA512Tree)
+    return shaBadParam;
+  if (*chunksize == 0)
+    *chunksize = SHATreeDefaultChunkSize;
+  if (*chunksize < SHATreeMinChunkSize ||
+      *chunksize > SHATreeMaxChunkSize ||
+      *chunksize % SHA512_Message_Block_Size != 0)
+    return shaBadParam;
+  if (*nthreads == 0) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    *nthreads = (ncpu > 0) ? (unsigned int)ncpu : 1;
+  }
+  return shaSuccess;
+}
+
+/*
+ * SHATreeHash
+ *
+ * Description:
+ *   This function computes the tree digest of a message held in
+ *   memory.
+ *
+ * Parameters:
+ *   whichTree: [in]
+ *     SHA384Tree or SHA512Tree
+ *   data: [in]
+ *     The message; may be null if length is 0.
+ *   length: [in]
+ *     The length of the message in bytes
+ *   nthreads: [in]
+ *     Number of threads to hash with, or 0 for one per online CPU
+ *   chunksize: [in]
+ *     Bytes per leaf, or 0 for SHATreeDefaultChunkSize; must be a
+ *     multiple of 128 from SHATreeMinChunkSize to SHATreeMaxChunkSize.
+ *   digest: [out]
+ *     Where the digest is returned; SHATreeHashSize() bytes are used.
+ *
+ * Returns:
+ *   sha Error Code.
+ */
+int SHATreeHash(SHATreeVersion whichTree, const uint8_t *data,
+  size_t length, unsigned int nthreads, size_t chunksize,
+  uint8_t digest[USHAMaxHashSize])
+{
+  SHATreePool pool;
+  SHATreeDigest *leaves;
+  size_t nchunks;
+  int err;
+
+  err = SHATreeCheck(whichTree, &nthreads, &chunksize, digest);
+  if (err != shaSuccess)
+    return err;
+  if (!data && length > 0)
+    return shaNull;
+
+  nchunks = (length == 0) ? 1 : (length - 1) / chunksize + 1;
+  if (nthreads > nchunks)
+    nthreads = (unsigned int)nchunks;
+  if (!(leaves = malloc(nchunks * sizeof(*leaves))))
+    return shaResourceError;
+  if ((err = SHATreePoolStart(&pool, nthreads)) == shaSuccess) {
+    err = SHATreeLeaves(&pool, SHATreeSha(whichTree), data, length,
+                        chunksize, leaves);
+    SHATreePoolStop(&pool);
+  }
+  if (err == shaSuccess)
+    err = SHATreeRoot(SHATreeSha(whichTree), leaves, nchunks, length,
+                      chunksize, digest);
+  free(leaves);
+  return err;
+}
+
+/*
+ * Read up to length bytes, stopping early only at end of file.
+ * Returns the number of bytes read, or -1 on error.
+ */
+static ssize_t SHATreeRead(int fd, uint8_t *buf, size_t length)
+{
+  size_t got = 0;
+
+  while (got < length) {
+    ssize_t n = read(fd, buf + got, length - got);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return -1;
+    if (n == 0)
+      break;
+    got += (size_t)n;
+  }
+  return (ssize_t)got;
+}
+
+/*
+ * Hash input that cannot be mapped, a batch of chunks at a time.
+ */
+static int SHATreeHashStream(SHATreeVersion whichTree, int fd,
+  unsigned int nthreads, size_t chunksize,
+  uint8_t digest[USHAMaxHashSize])
+{
+  SHATreePool pool;
+  SHATreeDigest *leaves = 0, *more;
+  size_t batchsize = (size_t)nthreads * SHATREE_BATCH * chunksize;
+  size_t nchunks = 0, room = 0, batchchunks;
+  uint64_t length = 0;
+  uint8_t *buf;
+  ssize_t got;
+  int err;
+
+  if (!(buf = malloc(batchsize)))
+    return shaResourceError;
+  if ((err = SHATreePoolStart(&pool, nthreads)) != shaSuccess) {
+    free(buf);
+    return err;
+  }
+
+  do {
+    if ((got = SHATreeRead(fd, buf, batchsize)) < 0) {
+      err = shaFileError;
+      break;
+    }
+    /* Only an empty message hashes an empty chunk */
+    if (got == 0 && nchunks > 0)
+      break;
+    batchchunks = (got == 0) ? 1 : ((size_t)got - 1) / chunksize + 1;
+    if (nchunks + batchchunks > room) {
+      room = 2 * room + batchchunks;
+      if (!(more = realloc(leaves, room * sizeof(*leaves)))) {
+        err = shaResourceError;
+        break;
+      }
+      leaves = more;
+    }
+    err = SHATreeLeaves(&pool, SHATreeSha(whichTree), buf, (size_t)got,
+                        chunksize, leaves + nchunks);
+    nchunks += batchchunks;
+    length += (uint64_t)got;
+  } while (err == shaSuccess && (size_t)got == batchsize);
+
+  SHATreePoolStop(&pool);
+  free(buf);
+  if (err == shaSuccess)
+    err = SHATreeRoot(SHATreeSha(whichTree), leaves, nchunks, length,
+                      chunksize, digest);
+  free(leaves);
+  return err;
+}
+
+/*
+ * SHATreeHashFile
+ *
+ * Description:
+ *   This function computes the tree digest of the file open on fd,
+ *   from its current offset to end of file.  A regular file is
+ *   mapped into memory; anything else is read in batches of
+ *   SHATREE_BATCH chunks per thread.
+ *
+ * Parameters:
+ *   whichTree: [in]
+ *     SHA384Tree or SHA512Tree
+ *   fd: [in]
+ *     An open file descriptor, readable.
+ *   nthreads, chunksize, digest:
+ *     As for SHATreeHash().
+ *
+ * Returns:
+ *   sha Error Code; shaFileError if the file could not be read.
+ */
+int SHATreeHashFile(SHATreeVersion whichTree, int fd,
+  unsigned int nthreads, size_t chunksize,
+  uint8_t digest[USHAMaxHashSize])
+{
+  struct stat st;
+  off_t offset;
+  int err;
+
+  err = SHATreeCheck(whichTree, &nthreads, &chunksize, digest);
+  if (err != shaSuccess)
+    return err;
+
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+      (offset = lseek(fd, 0, SEEK_CUR)) >= 0 && offset < st.st_size &&
+      (uintmax_t)st.st_size <= (size_t)-1) {
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+      (void)posix_madvise(map, size, POSIX_MADV_WILLNEED);
+      err = SHATreeHash(whichTree, (const uint8_t *)map + offset,
+                        size - (size_t)offset, nthreads, chunksize,
+                        digest);
+      munmap(map, size);
+      if (err == shaSuccess && lseek(fd, st.st_size, SEEK_SET) < 0)
+        err = shaFileError;
+      return err;
+    }
+  }
+  return SHATreeHashStream(whichTree, fd, nthreads, chunksize, digest);
+}
+
+/*
+ * SHATreeHashSize
+ *
+ * Description:
+ *   This function returns the size of the tree digest in bytes.
+ *
+ * Parameters:
+ *   whichTree: [in]
+ *     SHA384Tree or SHA512Tree
+ *
+ * Returns:
+ *   digest size, as for USHAHashSize().
+ */
+int SHATreeHashSize(SHATreeVersion whichTree)
+{
+  return USHAHashSize(SHATreeSha(whichTree));
+}
+
+/*
+ * SHATreeName
+ *
+ * Description:
+ *   This function returns the name of a tree hash mode, which is
+ *   labelled so that it cannot be mistaken for a FIPS 180-2 hash.
+ *
+ * Parameters:
+ *   whichTree: [in]
+ *     SHA384Tree or SHA512Tree
+ *
+ * Returns:
+ *   the name, or "unknown".
+ */
+const char *SHATreeName(SHATreeVersion whichTree)
+{
+  switch (whichTree) {
+    case SHA384Tree: return "SHA384-TREE";
+    case SHA512Tree: return "SHA512-TREE";
+    default: return "unknown";
+  }
+}
@@ -24,6 +24,7 @@
  *              SHA-512         64 byte / 512 bit
  */
 
+#include <stddef.h>
 #include <stdint.h>
 /*
  * If you do not have the ISO standard stdint.h header file, then you
@@ -46,7 +47,9 @@ enum {
     shaNull,            /* Null pointer parameter */
     shaInputTooLong,    /* input data too long */
     shaStateError,      /* called Input after FinalBits or Result */
-    shaBadParam         /* passed a bad parameter */
+    shaBadParam,        /* passed a bad parameter */
+    shaFileError,       /* error reading an input file */
+    shaResourceError    /* out of memory or cannot create threads */
 };
 #endif /* _SHA_enum_ */
 
@@ -76,6 +79,41 @@ typedef enum SHAversion {
     SHA1, SHA224, SHA256, SHA384, SHA512
 } SHAversion;
 
+/*
+ *  These constants select a tree hash mode for SHATreeHash() and
+ *  SHATreeHashFile().  They are NOT the FIPS 180-2 algorithms: the
+ *  message is cut into chunks which are hashed independently (and in
+ *  parallel) and the chunk digests are combined in a Merkle tree, as
+ *  documented in sha-tree.c.  A tree digest never equals the plain
+ *  SHA-384 or SHA-512 digest of the same data.
+ */
+typedef enum SHATreeVersion {
+    SHA384Tree, SHA512Tree
+} SHATreeVersion;
+
+enum {
+    SHATreeDefaultChunkSize = 1024 * 1024,
+    SHATreeMinChunkSize = 1024, SHATreeMaxChunkSize = 1024 * 1024 * 1024
+};
+
+/*
+ *  These constants select the engine used by SHA256BatchHash().
+ *  SHA256BatchAuto picks the widest engine the host supports.
+ */
+typedef enum SHA256BatchEngine {
+    SHA256BatchAuto, SHA256BatchScalar, SHA256BatchSSE2,
+    SHA256BatchAVX2, SHA256BatchAVX512
+} SHA256BatchEngine;
+
+/*
+ *  These constants select the compression backend used for SHA-1,
+ *  SHA-224 and SHA-256.  shaBackendAuto uses the x86 SHA extensions
+ *  when the host has them and the portable code otherwise.
+ */
+typedef enum SHABackend {
+    shaBackendAuto, shaBackendPortable, shaBackendSHANI
+} SHABackend;
+
 /*
  *  This structure will hold context information for the SHA-1
  *  hashing operation.
@@ -167,10 +205,22 @@ typedef struct HMACContext {
     int hashSize;               /* hash size of SHA being used */
     int blockSize;              /* block size of SHA being used */
     USHAContext shaContext;     /* SHA context */
-    unsigned char k_opad[USHA_Max_Message_Block_Size];
-                        /* outer padding - key XORd with opad */
+    USHAContext outerContext;   /* SHA context after the outer padding */
+                                /* (key XORd with opad) */
 } HMACContext;
 
+/*
+ *  This structure will hold a precomputed HMAC key: the SHA
+ *  contexts after absorbing the inner and outer padded key.
+ */
+typedef struct HMACKey {
+    int whichSha;               /* which SHA is being used */
+    int hashSize;               /* hash size of SHA being used */
+    int blockSize;              /* block size of SHA being used */
+    USHAContext innerContext;   /* after key XORd with ipad */
+    USHAContext outerContext;   /* after key XORd with opad */
+} HMACKey;
+
 /*
  *  Function Prototypes
  */
@@ -220,10 +270,42 @@ extern int SHA512FinalBits(SHA512Context *, const uint8_t bits,
 extern int SHA512Result(SHA512Context *,
                         uint8_t Message_Digest[SHA512HashSize]);
 
+/*
+ * Multi-buffer SHA-256: hash n independent messages, running
+ * 4, 8 or 16 of them through the compression function at once.
+ */
+extern int SHA256BatchHash(int n, const uint8_t *const msgs[],
+                           const unsigned int lens[],
+                           uint8_t digests[][SHA256HashSize]);
+extern int SHA256BatchSetEngine(SHA256BatchEngine engine);
+extern SHA256BatchEngine SHA256BatchGetEngine(void);
+extern const char *SHA256BatchEngineName(SHA256BatchEngine engine);
+
+/*
+ * Tree hashing (not FIPS 180-2 compatible): chunks of chunksize bytes
+ * (0 for the default) are hashed on nthreads threads (0 for one per
+ * online CPU).  The digest is the same for any number of threads.
+ */
+extern int SHATreeHash(SHATreeVersion whichTree, const uint8_t *data,
+                       size_t length, unsigned int nthreads,
+                       size_t chunksize,
+                       uint8_t digest[USHAMaxHashSize]);
+extern int SHATreeHashFile(SHATreeVersion whichTree, int fd,
+                           unsigned int nthreads, size_t chunksize,
+                           uint8_t digest[USHAMaxHashSize]);
+extern int SHATreeHashSize(SHATreeVersion whichTree);
+extern const char *SHATreeName(SHATreeVersion whichTree);
+
+/* Compression backend selection for SHA-1, SHA-224 and SHA-256 */
+extern int SHASetBackend(SHABackend backend);
+extern SHABackend SHAGetBackend(void);
+extern const char *SHABackendName(SHABackend backend);
+
 /* Unified SHA functions, chosen by whichSha */
 extern int USHAReset(USHAContext *, SHAversion whichSha);
 extern int USHAInput(USHAContext *,
                      const uint8_t *bytes, unsigned int bytecount);
+extern int USHAInputFile(USHAContext *, int fd);
 extern int USHAFinalBits(USHAContext *,
                          const uint8_t bits, unsigned int bitcount);
 extern int USHAResult(USHAContext *,
@@ -259,5 +341,17 @@ extern int hmacFinalBits(HMACContext *ctx, const uint8_t bits,
 extern int hmacResult(HMACContext *ctx,
                       uint8_t digest[USHAMaxHashSize]);
 
+/*
+ * HMAC with a precomputed key, for authenticating many messages
+ * under the same key without rehashing the key for each one.
+ */
+extern int hmacPrecompute(HMACKey *hkey, enum SHAversion whichSha,
+                          const unsigned char *key, int key_len);
+extern int hmacResetKey(HMACContext *ctx, const HMACKey *hkey);
+extern int hmacBatch(const HMACKey *hkey, int n,
+                     const unsigned char *const texts[],
+                     const int text_lens[],
+                     uint8_t digests[][USHAMaxHashSize]);
+
 #endif /* _SHA_H_ */
 
@@ -35,6 +35,7 @@
  *      uses SHA1FinalBits() to hash the final few bits of the input.
  */
 
+#include <string.h>
 #include "sha.h"
 #include "sha-private.h"
 
@@ -54,6 +55,22 @@ static uint32_t addTemp;
         (((context)->Length_Low += (length)) < addTemp) && \
         (++(context)->Length_High == 0) ? 1 : 0)
 
+/*
+ * add "bytes" octets to the length, for whole blocks taken
+ * directly from the caller's buffer
+ */
+static int SHA1AddBytes(SHA1Context *context, unsigned int bytes)
+{
+  uint64_t low = (uint64_t)context->Length_Low + ((uint64_t)bytes << 3);
+  uint32_t high = context->Length_High + (uint32_t)(low >> 32);
+
+  if (high < context->Length_High)
+    context->Corrupted = 1;
+  context->Length_Low = (uint32_t)low;
+  context->Length_High = high;
+  return context->Corrupted;
+}
+
 /* Local Function Prototypes */
 static void SHA1Finalize(SHA1Context *context, uint8_t Pad_Byte);
 static void SHA1PadMessage(SHA1Context *, uint8_t Pad_Byte);
@@ -119,6 +136,8 @@ int SHA1Reset(SHA1Context *context)
 int SHA1Input(SHA1Context *context,
     const uint8_t *message_array, unsigned length)
 {
+  unsigned int n;
+
   if (!length)
     return shaSuccess;
 
@@ -134,15 +153,34 @@ int SHA1Input(SHA1Context *context,
 
      return context->Corrupted;
 
-  while (length-- && !context->Corrupted) {
-    context->Message_Block[context->Message_Block_Index++] =
-      (*message_array & 0xFF);
-
-    if (!SHA1AddLength(context, 8) &&
+  while (length && !context->Corrupted) {
+    /* whole blocks are compressed straight from the caller's buffer */
+    if ((context->Message_Block_Index == 0) &&
+        (length >= SHA1_Message_Block_Size)) {
+      unsigned int nblocks = length / SHA1_Message_Block_Size;
+      unsigned int nbytes = nblocks * SHA1_Message_Block_Size;
+      if (SHA1AddBytes(context, nbytes))
+        break;
+      SHA1ProcessBlocks(context->Intermediate_Hash, message_array,
+                        nblocks);
+      message_array += nbytes;
+      length -= nbytes;
+      continue;
+    }
+
+    /* otherwise buffer as much of the current block as we can */
+    n = SHA1_Message_Block_Size - context->Message_Block_Index;
+    if (n > length)
+      n = length;
+    memcpy(&context->Message_Block[context->Message_Block_Index],
+           message_array, n);
+    context->Message_Block_Index += n;
+    message_array += n;
+    length -= n;
+
+    if (!SHA1AddLength(context, 8 * n) &&
       (context->Message_Block_Index == SHA1_Message_Block_Size))
       SHA1ProcessMessageBlock(context);
-
-    message_array++;
   }
 
   return shaSuccess;
@@ -356,6 +394,38 @@ static void SHA1PadMessage(SHA1Context *context, uint8_t Pad_Byte)
  *   names used in the publication.
  */
 static void SHA1ProcessMessageBlock(SHA1Context *context)
+{
+  SHA1ProcessBlocks(context->Intermediate_Hash,
+                    context->Message_Block, 1);
+  context->Message_Block_Index = 0;
+}
+
+/*
+ * SHA1BlocksPortable
+ *
+ * Description:
+ *   This function is the portable compression backend.  It will
+ *   process nblocks consecutive 512-bit blocks of the message,
+ *   starting at blocks.
+ *
+ * Parameters:
+ *   Intermediate_Hash: [in/out]
+ *     The intermediate hash to update
+ *   blocks: [in]
+ *     The message blocks
+ *   nblocks: [in]
+ *     The number of blocks
+ *
+ * Returns:
+ *   Nothing.
+ *
+ * Comments:
+ *   Many of the variable names in this code, especially the
+ *   single character names, were used because those were the
+ *   names used in the publication.
+ */
+void SHA1BlocksPortable(uint32_t *Intermediate_Hash,
+    const uint8_t *blocks, unsigned int nblocks)
 {
   /* Constants defined in FIPS-180-2, section 4.2.1 */
   const uint32_t K[4] = {
@@ -366,68 +436,67 @@ static void SHA1ProcessMessageBlock(SHA1Context *context)
   uint32_t   W[80];           /* Word sequence */
   uint32_t   A, B, C, D, E;   /* Word buffers */
 
-  /*
-   * Initialize the first 16 words in the array W
-   */
-  for (t = 0; t < 16; t++) {
-    W[t]  = ((uint32_t)context->Message_Block[t * 4]) << 24;
-    W[t] |= ((uint32_t)context->Message_Block[t * 4 + 1]) << 16;
-    W[t] |= ((uint32_t)context->Message_Block[t * 4 + 2]) << 8;
-    W[t] |= ((uint32_t)context->Message_Block[t * 4 + 3]);
-  }
-
-  for (t = 16; t < 80; t++)
-    W[t] = SHA1_ROTL(1, W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16]);
-
-  A = context->Intermediate_Hash[0];
-  B = context->Intermediate_Hash[1];
-  C = context->Intermediate_Hash[2];
-  D = context->Intermediate_Hash[3];
-  E = context->Intermediate_Hash[4];
-
-  for (t = 0; t < 20; t++) {
-    temp = SHA1_ROTL(5,A) + SHA_Ch(B, C, D) + E + W[t] + K[0];
-    E = D;
-    D = C;
-    C = SHA1_ROTL(30,B);
-    B = A;
-    A = temp;
+  for ( ; nblocks > 0; nblocks--, blocks += SHA1_Message_Block_Size) {
+    /*
+     * Initialize the first 16 words in the array W
+     */
+    for (t = 0; t < 16; t++) {
+      W[t]  = ((uint32_t)blocks[t * 4]) << 24;
+      W[t] |= ((uint32_t)blocks[t * 4 + 1]) << 16;
+      W[t] |= ((uint32_t)blocks[t * 4 + 2]) << 8;
+      W[t] |= ((uint32_t)blocks[t * 4 + 3]);
+    }
+
+    for (t = 16; t < 80; t++)
+      W[t] = SHA1_ROTL(1, W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16]);
+
+    A = Intermediate_Hash[0];
+    B = Intermediate_Hash[1];
+    C = Intermediate_Hash[2];
+    D = Intermediate_Hash[3];
+    E = Intermediate_Hash[4];
+
+    for (t = 0; t < 20; t++) {
+      temp = SHA1_ROTL(5,A) + SHA_Ch(B, C, D) + E + W[t] + K[0];
+      E = D;
+      D = C;
+      C = SHA1_ROTL(30,B);
+      B = A;
+      A = temp;
+    }
+
+    for (t = 20; t < 40; t++) {
+      temp = SHA1_ROTL(5,A) + SHA_Parity(B, C, D) + E + W[t] + K[1];
+      E = D;
+      D = C;
+      C = SHA1_ROTL(30,B);
+      B = A;
+      A = temp;
+    }
+
+    for (t = 40; t < 60; t++) {
+      temp = SHA1_ROTL(5,A) + SHA_Maj(B, C, D) + E + W[t] + K[2];
+      E = D;
+      D = C;
+      C = SHA1_ROTL(30,B);
+      B = A;
+      A = temp;
+    }
+
+    for (t = 60; t < 80; t++) {
+      temp = SHA1_ROTL(5,A) + SHA_Parity(B, C, D) + E + W[t] + K[3];
+      E = D;
+      D = C;
+      C = SHA1_ROTL(30,B);
+      B = A;
+      A = temp;
+    }
+
+    Intermediate_Hash[0] += A;
+    Intermediate_Hash[1] += B;
+    Intermediate_Hash[2] += C;
+    Intermediate_Hash[3] += D;
+    Intermediate_Hash[4] += E;
   }
-
-  for (t = 20; t < 40; t++) {
-    temp = SHA1_ROTL(5,A) + SHA_Parity(B, C, D) + E + W[t] + K[1];
-    E = D;
-    D = C;
-    C = SHA1_ROTL(30,B);
-    B = A;
-    A = temp;
-  }
-
-  for (t = 40; t < 60; t++) {
-    temp = SHA1_ROTL(5,A) + SHA_Maj(B, C, D) + E + W[t] + K[2];
-    E = D;
-    D = C;
-    C = SHA1_ROTL(30,B);
-    B = A;
-    A = temp;
-  }
-
-  for (t = 60; t < 80; t++) {
-    temp = SHA1_ROTL(5,A) + SHA_Parity(B, C, D) + E + W[t] + K[3];
-    E = D;
-    D = C;
-    C = SHA1_ROTL(30,B);
-    B = A;
-    A = temp;
-  }
-
-  context->Intermediate_Hash[0] += A;
-  context->Intermediate_Hash[1] += B;
-  context->Intermediate_Hash[2] += C;
-
-  context->Intermediate_Hash[3] += D;
-  context->Intermediate_Hash[4] += E;
-
-  context->Message_Block_Index = 0;
 }
 
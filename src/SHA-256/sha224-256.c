@@ -36,6 +36,7 @@
  *   final few bits of the input.
  */
 
+#include <string.h>
 #include "sha.h"
 #include "sha-private.h"
 
@@ -65,6 +66,22 @@ static uint32_t addTemp;
     (((context)->Length_Low += (length)) < addTemp) &&     \
     (++(context)->Length_High == 0) ? 1 : 0)
 
+/*
+ * add "bytes" octets to the length, for whole blocks taken
+ * directly from the caller's buffer
+ */
+static int SHA224_256AddBytes(SHA256Context *context, unsigned int bytes)
+{
+  uint64_t low = (uint64_t)context->Length_Low + ((uint64_t)bytes << 3);
+  uint32_t high = context->Length_High + (uint32_t)(low >> 32);
+
+  if (high < context->Length_High)
+    context->Corrupted = 1;
+  context->Length_Low = (uint32_t)low;
+  context->Length_High = high;
+  return context->Corrupted;
+}
+
 /* Local Function Prototypes */
 static void SHA224_256Finalize(SHA256Context *context,
   uint8_t Pad_Byte);
@@ -87,6 +104,23 @@ static uint32_t SHA256_H0[SHA256HashSize/4] = {
   0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
 };
 
+/* Constants defined in FIPS-180-2, section 4.2.2 */
+const uint32_t SHA256_K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b,
+  0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01,
+  0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7,
+  0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+  0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152,
+  0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+  0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+  0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819,
+  0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08,
+  0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f,
+  0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
 /*
  * SHA224Reset
  *
@@ -224,6 +258,8 @@ int SHA256Reset(SHA256Context *context)
 int SHA256Input(SHA256Context *context, const uint8_t *message_array,
     unsigned int length)
 {
+  unsigned int n;
+
   if (!length)
     return shaSuccess;
 
@@ -239,15 +275,34 @@ int SHA256Input(SHA256Context *context, const uint8_t *message_array,
   if (context->Corrupted)
      return context->Corrupted;
 
-  while (length-- && !context->Corrupted) {
-    context->Message_Block[context->Message_Block_Index++] =
-            (*message_array & 0xFF);
-
-    if (!SHA224_256AddLength(context, 8) &&
+  while (length && !context->Corrupted) {
+    /* whole blocks are compressed straight from the caller's buffer */
+    if ((context->Message_Block_Index == 0) &&
+        (length >= SHA256_Message_Block_Size)) {
+      unsigned int nblocks = length / SHA256_Message_Block_Size;
+      unsigned int nbytes = nblocks * SHA256_Message_Block_Size;
+      if (SHA224_256AddBytes(context, nbytes))
+        break;
+      SHA224_256ProcessBlocks(context->Intermediate_Hash, message_array,
+                              nblocks);
+      message_array += nbytes;
+      length -= nbytes;
+      continue;
+    }
+
+    /* otherwise buffer as much of the current block as we can */
+    n = SHA256_Message_Block_Size - context->Message_Block_Index;
+    if (n > length)
+      n = length;
+    memcpy(&context->Message_Block[context->Message_Block_Index],
+           message_array, n);
+    context->Message_Block_Index += n;
+    message_array += n;
+    length -= n;
+
+    if (!SHA224_256AddLength(context, 8 * n) &&
       (context->Message_Block_Index == SHA256_Message_Block_Size))
       SHA224_256ProcessMessageBlock(context);
-
-    message_array++;
   }
 
   return shaSuccess;
@@ -329,7 +384,8 @@ int SHA256FinalBits(SHA256Context *context,
  * Returns:
  *   sha Error Code.
  */
-int SHA256Result(SHA256Context *context, uint8_t Message_Digest[])
+int SHA256Result(SHA256Context *context,
+    uint8_t Message_Digest[SHA256HashSize])
 {
 
   return SHA224_256ResultN(context, Message_Digest, SHA256HashSize);
@@ -448,72 +504,88 @@ static void SHA224_256PadMessage(SHA256Context *context,
  */
 static void SHA224_256ProcessMessageBlock(SHA256Context *context)
 {
-  /* Constants defined in FIPS-180-2, section 4.2.2 */
-  static const uint32_t K[64] = {
-      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b,
-      0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01,
-      0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7,
-      0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
-      0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152,
-      0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
-      0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
-      0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-      0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819,
-      0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08,
-      0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f,
-      0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
-      0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-  };
+  SHA224_256ProcessBlocks(context->Intermediate_Hash,
+                          context->Message_Block, 1);
+  context->Message_Block_Index = 0;
+}
+
+/*
+ * SHA224_256BlocksPortable
+ *
+ * Description:
+ *   This function is the portable compression backend.  It will
+ *   process nblocks consecutive 512-bit blocks of the message,
+ *   starting at blocks.
+ *
+ * Parameters:
+ *   Intermediate_Hash: [in/out]
+ *     The intermediate hash to update
+ *   blocks: [in]
+ *     The message blocks
+ *   nblocks: [in]
+ *     The number of blocks
+ *
+ * Returns:
+ *   Nothing.
+ *
+ * Comments:
+ *   Many of the variable names in this code, especially the
+ *   single character names, were used because those were the
+ *   names used in the publication.
+ */
+void SHA224_256BlocksPortable(uint32_t *Intermediate_Hash,
+    const uint8_t *blocks, unsigned int nblocks)
+{
   int        t, t4;                   /* Loop counter */
   uint32_t   temp1, temp2;            /* Temporary word value */
   uint32_t   W[64];                   /* Word sequence */
   uint32_t   A, B, C, D, E, F, G, H;  /* Word buffers */
 
-  /*
-   * Initialize the first 16 words in the array W
-   */
-  for (t = t4 = 0; t < 16; t++, t4 += 4)
-    W[t] = (((uint32_t)context->Message_Block[t4]) << 24) |
-           (((uint32_t)context->Message_Block[t4 + 1]) << 16) |
-           (((uint32_t)context->Message_Block[t4 + 2]) << 8) |
-           (((uint32_t)context->Message_Block[t4 + 3]));
-
-  for (t = 16; t < 64; t++)
-    W[t] = SHA256_sigma1(W[t-2]) + W[t-7] +
-        SHA256_sigma0(W[t-15]) + W[t-16];
-
-  A = context->Intermediate_Hash[0];
-  B = context->Intermediate_Hash[1];
-  C = context->Intermediate_Hash[2];
-  D = context->Intermediate_Hash[3];
-  E = context->Intermediate_Hash[4];
-  F = context->Intermediate_Hash[5];
-  G = context->Intermediate_Hash[6];
-  H = context->Intermediate_Hash[7];
-
-  for (t = 0; t < 64; t++) {
-    temp1 = H + SHA256_SIGMA1(E) + SHA_Ch(E,F,G) + K[t] + W[t];
-    temp2 = SHA256_SIGMA0(A) + SHA_Maj(A,B,C);
-    H = G;
-    G = F;
-    F = E;
-    E = D + temp1;
-    D = C;
-    C = B;
-    B = A;
-    A = temp1 + temp2;
+  for ( ; nblocks > 0; nblocks--, blocks += SHA256_Message_Block_Size) {
+    /*
+     * Initialize the first 16 words in the array W
+     */
+    for (t = t4 = 0; t < 16; t++, t4 += 4)
+      W[t] = (((uint32_t)blocks[t4]) << 24) |
+             (((uint32_t)blocks[t4 + 1]) << 16) |
+             (((uint32_t)blocks[t4 + 2]) << 8) |
+             (((uint32_t)blocks[t4 + 3]));
+
+    for (t = 16; t < 64; t++)
+      W[t] = SHA256_sigma1(W[t-2]) + W[t-7] +
+          SHA256_sigma0(W[t-15]) + W[t-16];
+
+    A = Intermediate_Hash[0];
+    B = Intermediate_Hash[1];
+    C = Intermediate_Hash[2];
+    D = Intermediate_Hash[3];
+    E = Intermediate_Hash[4];
+    F = Intermediate_Hash[5];
+    G = Intermediate_Hash[6];
+    H = Intermediate_Hash[7];
+
+    for (t = 0; t < 64; t++) {
+      temp1 = H + SHA256_SIGMA1(E) + SHA_Ch(E,F,G) + SHA256_K[t] + W[t];
+      temp2 = SHA256_SIGMA0(A) + SHA_Maj(A,B,C);
+      H = G;
+      G = F;
+      F = E;
+      E = D + temp1;
+      D = C;
+      C = B;
+      B = A;
+      A = temp1 + temp2;
+    }
+
+    Intermediate_Hash[0] += A;
+    Intermediate_Hash[1] += B;
+    Intermediate_Hash[2] += C;
+    Intermediate_Hash[3] += D;
+    Intermediate_Hash[4] += E;
+    Intermediate_Hash[5] += F;
+    Intermediate_Hash[6] += G;
+    Intermediate_Hash[7] += H;
   }
-
-  context->Intermediate_Hash[0] += A;
-  context->Intermediate_Hash[1] += B;
-  context->Intermediate_Hash[2] += C;
-  context->Intermediate_Hash[3] += D;
-  context->Intermediate_Hash[4] += E;
-  context->Intermediate_Hash[5] += F;
-  context->Intermediate_Hash[6] += G;
-  context->Intermediate_Hash[7] += H;
-
-  context->Message_Block_Index = 0;
 }
 
 /*
@@ -0,0 +1,369 @@
+/************************** sha256-batch.c **************************/
+/*
+ * Description:
+ *   This file implements a multi-buffer interface to SHA-256.
+ *   Rather than hashing one message at a time, SHA256BatchHash()
+ *   runs several independent messages through the compression
+ *   function at once, one message per 32-bit lane of a vector
+ *   register: 4 lanes with SSE2, 8 with AVX2 and 16 with AVX-512F.
+ *   The widest engine the host supports is chosen at run time; the
+ *   scalar engine uses SHA256Reset/SHA256Input/SHA256Result and is
+ *   always available.  All engines produce the same digests.
+ *
+ *   Each lane works through its message one block at a time.  Whole
+ *   blocks are read directly from the caller's buffer; the last
+ *   partial block plus the padding and length (one or two blocks)
+ *   is assembled in a small per-lane buffer.  When a lane finishes
+ *   its message, the digest is written out and the lane is given
+ *   the next message, so messages of different lengths keep all
+ *   lanes busy until the batch runs dry.
+ *
+ * Portability Issues:
+ *   The vector engines need GCC or Clang on x86/x86-64 (they use
+ *   per-function target attributes and __builtin_cpu_supports());
+ *   elsewhere only the scalar engine is compiled.
+ */
+
+#include <string.h>
+#include "sha.h"
+#include "sha-private.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA256_BATCH_X86
+#include <immintrin.h>
+#endif /* __GNUC__ && x86 */
+
+#ifdef __GNUC__
+#define SHA256_ALIGNED  __attribute__((aligned(64)))
+#else
+#define SHA256_ALIGNED
+#endif /* __GNUC__ */
+
+enum { SHA256_MAX_LANES = 16 };
+
+typedef void (*SHA256LanesFunc)(uint32_t *state,
+    const uint8_t *const *blocks);
+
+/* Per-lane progress through one message */
+typedef struct SHA256Lane {
+  const uint8_t *msg;     /* Start of message */
+  unsigned int full;      /* Whole blocks read directly from msg */
+  unsigned int nblocks;   /* Total blocks, including padding */
+  unsigned int next;      /* Next block to compress */
+  int which;              /* Index of message, or -1 if idle */
+  uint8_t tail[2 * SHA256_Message_Block_Size]; /* Last block(s) */
+} SHA256Lane;
+
+static SHA256BatchEngine batchEngine = SHA256BatchAuto;
+
+#ifdef SHA256_BATCH_X86
+
+#define SHA256_LANES      4
+#define SHA256_LANES_FN   SHA256Lanes_SSE2
+#define SHA256_LANES_ATTR __attribute__((target("sse2")))
+#define V                 __m128i
+#define V_LOAD(p)         _mm_load_si128((const __m128i *)(p))
+#define V_STORE(p,v)      _mm_store_si128((__m128i *)(p), (v))
+#define V_SET1(x)         _mm_set1_epi32((int)(x))
+#define V_ADD(a,b)        _mm_add_epi32((a), (b))
+#define V_XOR(a,b)        _mm_xor_si128((a), (b))
+#define V_AND(a,b)        _mm_and_si128((a), (b))
+#define V_OR(a,b)         _mm_or_si128((a), (b))
+#define V_ANDNOT(a,b)     _mm_andnot_si128((a), (b))
+#define V_SHR(x,n)        _mm_srli_epi32((x), (n))
+#define V_ROTR(x,n)       \
+  _mm_or_si128(_mm_srli_epi32((x), (n)), _mm_slli_epi32((x), 32-(n)))
+#include "sha256-lanes.h"
+
+#define SHA256_LANES      8
+#define SHA256_LANES_FN   SHA256Lanes_AVX2
+#define SHA256_LANES_ATTR __attribute__((target("avx2")))
+#define V                 __m256i
+#define V_LOAD(p)         _mm256_load_si256((const __m256i *)(p))
+#define V_STORE(p,v)      _mm256_store_si256((__m256i *)(p), (v))
+#define V_SET1(x)         _mm256_set1_epi32((int)(x))
+#define V_ADD(a,b)        _mm256_add_epi32((a), (b))
+#define V_XOR(a,b)        _mm256_xor_si256((a), (b))
+#define V_AND(a,b)        _mm256_and_si256((a), (b))
+#define V_OR(a,b)         _mm256_or_si256((a), (b))
+#define V_ANDNOT(a,b)     _mm256_andnot_si256((a), (b))
+#define V_SHR(x,n)        _mm256_srli_epi32((x), (n))
+#define V_ROTR(x,n)       _mm256_or_si256(_mm256_srli_epi32((x), (n)), \
+                                          _mm256_slli_epi32((x), 32-(n)))
+#include "sha256-lanes.h"
+
+#define SHA256_LANES      16
+#define SHA256_LANES_FN   SHA256Lanes_AVX512
+#define SHA256_LANES_ATTR __attribute__((target("avx512f")))
+#define V                 __m512i
+#define V_LOAD(p)         _mm512_load_si512((const void *)(p))
+#define V_STORE(p,v)      _mm512_store_si512((void *)(p), (v))
+#define V_SET1(x)         _mm512_set1_epi32((int)(x))
+#define V_ADD(a,b)        _mm512_add_epi32((a), (b))
+#define V_XOR(a,b)        _mm512_xor_si512((a), (b))
+#define V_AND(a,b)        _mm512_and_si512((a), (b))
+#define V_OR(a,b)         _mm512_or_si512((a), (b))
+#define V_ANDNOT(a,b)     _mm512_andnot_si512((a), (b))
+#define V_SHR(x,n)        _mm512_srli_epi32((x), (n))
+#define V_ROTR(x,n)       _mm512_ror_epi32((x), (n))
+#include "sha256-lanes.h"
+
+#endif /* SHA256_BATCH_X86 */
+
+/*
+ * SHA256BatchSupported
+ *
+ * Description:
+ *   Report whether the host can run the given engine.
+ */
+static int SHA256BatchSupported(SHA256BatchEngine engine)
+{
+  switch (engine) {
+    case SHA256BatchAuto:
+    case SHA256BatchScalar:
+      return 1;
+#ifdef SHA256_BATCH_X86
+    case SHA256BatchSSE2:
+      return __builtin_cpu_supports("sse2");
+    case SHA256BatchAVX2:
+      return __builtin_cpu_supports("avx2");
+    case SHA256BatchAVX512:
+      return __builtin_cpu_supports("avx512f");
+#endif /* SHA256_BATCH_X86 */
+    default:
+      return 0;
+  }
+}
+
+/*
+ * SHA256BatchSetEngine
+ *
+ * Description:
+ *   Select the engine used by SHA256BatchHash().  The default,
+ *   SHA256BatchAuto, uses the widest engine the host supports.
+ *   This is a process-wide setting; set it before hashing starts.
+ *
+ * Returns:
+ *   shaBadParam if the host cannot run the engine, else shaSuccess.
+ */
+int SHA256BatchSetEngine(SHA256BatchEngine engine)
+{
+  if (!SHA256BatchSupported(engine))
+    return shaBadParam;
+  batchEngine = engine;
+  return shaSuccess;
+}
+
+/*
+ * SHA256BatchGetEngine
+ *
+ * Description:
+ *   Return the engine SHA256BatchHash() will use, with
+ *   SHA256BatchAuto resolved to a specific engine.
+ */
+SHA256BatchEngine SHA256BatchGetEngine(void)
+{
+  if (batchEngine != SHA256BatchAuto)
+    return batchEngine;
+  if (SHA256BatchSupported(SHA256BatchAVX512))
+    return SHA256BatchAVX512;
+  if (SHA256BatchSupported(SHA256BatchAVX2))
+    return SHA256BatchAVX2;
+  if (SHA256BatchSupported(SHA256BatchSSE2))
+    return SHA256BatchSSE2;
+  return SHA256BatchScalar;
+}
+
+/*
+ * SHA256BatchEngineName
+ *
+ * Description:
+ *   Return a printable name for an engine.
+ */
+const char *SHA256BatchEngineName(SHA256BatchEngine engine)
+{
+  switch (engine) {
+    case SHA256BatchAuto:   return "auto";
+    case SHA256BatchScalar: return "scalar";
+    case SHA256BatchSSE2:   return "sse2";
+    case SHA256BatchAVX2:   return "avx2";
+    case SHA256BatchAVX512: return "avx512";
+    default:                return "unknown";
+  }
+}
+
+/*
+ * SHA256BatchScalarHash
+ *
+ * Description:
+ *   Hash the messages one at a time with the standard interface.
+ */
+static int SHA256BatchScalarHash(int n, const uint8_t *const msgs[],
+    const unsigned int lens[], uint8_t digests[][SHA256HashSize])
+{
+  SHA256Context ctx;
+  int i, err;
+
+  for (i = 0; i < n; i++) {
+    err = SHA256Reset(&ctx);
+    if (err == shaSuccess)
+      err = SHA256Input(&ctx, msgs[i], lens[i]);
+    if (err == shaSuccess)
+      err = SHA256Result(&ctx, digests[i]);
+    if (err != shaSuccess)
+      return err;
+  }
+  return shaSuccess;
+}
+
+/*
+ * SHA256LaneStart
+ *
+ * Description:
+ *   Load message 'which' into lane j: reset the lane's column of
+ *   the state and build the padded final block(s).
+ */
+static void SHA256LaneStart(SHA256Lane *lane, uint32_t *state,
+    int lanes, int j, const SHA256Context *init, int which,
+    const uint8_t *msg, unsigned int len)
+{
+  unsigned int rem = len % SHA256_Message_Block_Size;
+  uint64_t bits = (uint64_t)len * 8;
+  uint8_t *last;
+  int i;
+
+  for (i = 0; i < 8; i++)
+    state[i * lanes + j] = init->Intermediate_Hash[i];
+
+  lane->msg = msg;
+  lane->which = which;
+  lane->next = 0;
+  lane->full = len / SHA256_Message_Block_Size;
+  lane->nblocks = lane->full +
+    ((rem < SHA256_Message_Block_Size - 8) ? 1 : 2);
+
+  memset(lane->tail, 0, sizeof(lane->tail));
+  if (rem > 0)
+    memcpy(lane->tail, msg + len - rem, rem);
+  lane->tail[rem] = 0x80;
+  last = lane->tail + (lane->nblocks - lane->full) *
+         SHA256_Message_Block_Size;
+  for (i = 1; i <= 8; i++, bits >>= 8)
+    last[-i] = (uint8_t)bits;
+}
+
+/*
+ * SHA256BatchLanes
+ *
+ * Description:
+ *   Drive a multi-lane compression function over all n messages,
+ *   refilling each lane as soon as its message is finished.
+ */
+static int SHA256BatchLanes(int n, const uint8_t *const msgs[],
+    const unsigned int lens[], uint8_t digests[][SHA256HashSize],
+    int lanes, SHA256LanesFunc compress)
+{
+  static const uint8_t idle[SHA256_Message_Block_Size];
+  SHA256_ALIGNED uint32_t state[8 * SHA256_MAX_LANES];
+  SHA256Lane lane[SHA256_MAX_LANES];
+  const uint8_t *blocks[SHA256_MAX_LANES];
+  SHA256Context init;
+  int i, j, next = 0, active = 0;
+
+  SHA256Reset(&init);
+  for (j = 0; j < lanes; j++) {
+    lane[j].which = -1;
+    if (next < n) {
+      SHA256LaneStart(&lane[j], state, lanes, j, &init, next,
+                      msgs[next], lens[next]);
+      next++;
+      active++;
+    }
+  }
+
+  while (active > 0) {
+    for (j = 0; j < lanes; j++) {
+      SHA256Lane *l = &lane[j];
+      if (l->which < 0)
+        blocks[j] = idle;
+      else if (l->next < l->full)
+        blocks[j] = l->msg + l->next * SHA256_Message_Block_Size;
+      else
+        blocks[j] = l->tail +
+                    (l->next - l->full) * SHA256_Message_Block_Size;
+    }
+
+    compress(state, blocks);
+
+    for (j = 0; j < lanes; j++) {
+      SHA256Lane *l = &lane[j];
+      if (l->which < 0 || ++l->next < l->nblocks)
+        continue;
+      for (i = 0; i < SHA256HashSize; ++i)
+        digests[l->which][i] = (uint8_t)
+          (state[(i >> 2) * lanes + j] >> 8 * (3 - (i & 0x03)));
+      if (next < n) {
+        SHA256LaneStart(l, state, lanes, j, &init, next,
+                        msgs[next], lens[next]);
+        next++;
+      } else {
+        l->which = -1;
+        active--;
+      }
+    }
+  }
+
+  return shaSuccess;
+}
+
+/*
+ * SHA256BatchHash
+ *
+ * Description:
+ *   This function computes the SHA-256 digest of each of n
+ *   independent messages.
+ *
+ * Parameters:
+ *   n: [in]
+ *     The number of messages.
+ *   msgs: [in]
+ *     msgs[i] points at message i (may be null if lens[i] is 0).
+ *   lens: [in]
+ *     lens[i] is the length of message i in bytes.
+ *   digests: [out]
+ *     digests[i] receives the digest of message i.
+ *
+ * Returns:
+ *   sha Error Code.
+ */
+int SHA256BatchHash(int n, const uint8_t *const msgs[],
+    const unsigned int lens[], uint8_t digests[][SHA256HashSize])
+{
+  int i;
+
+  if (n < 0)
+    return shaBadParam;
+  if (n == 0)
+    return shaSuccess;
+  if (!msgs || !lens || !digests)
+    return shaNull;
+  for (i = 0; i < n; i++)
+    if (!msgs[i] && lens[i] != 0)
+      return shaNull;
+
+  switch (SHA256BatchGetEngine()) {
+#ifdef SHA256_BATCH_X86
+    case SHA256BatchSSE2:
+      return SHA256BatchLanes(n, msgs, lens, digests, 4,
+                              SHA256Lanes_SSE2);
+    case SHA256BatchAVX2:
+      return SHA256BatchLanes(n, msgs, lens, digests, 8,
+                              SHA256Lanes_AVX2);
+    case SHA256BatchAVX512:
+      return SHA256BatchLanes(n, msgs, lens, digests, 16,
+                              SHA256Lanes_AVX512);
+#endif /* SHA256_BATCH_X86 */
+    default:
+      return SHA256BatchScalarHash(n, msgs, lens, digests);
+  }
+}
@@ -0,0 +1,121 @@
+/************************** sha256-lanes.h **************************/
+/*
+ * Description:
+ *   Template for a SHA-256 compression function that processes one
+ *   64-byte block from each of SHA256_LANES independent messages.
+ *   Each 32-bit word of the state lives in one vector register with
+ *   one lane per message, so the 64 rounds are executed once for
+ *   all the lanes.
+ *
+ *   This file is included by sha256-batch.c once per instruction
+ *   set.  Before including it, define:
+ *     SHA256_LANES      number of 32-bit lanes in a vector
+ *     SHA256_LANES_FN   name of the function to generate
+ *     SHA256_LANES_ATTR function attribute (e.g. a target() spec)
+ *     V                 vector type
+ *     V_LOAD(p)         aligned load of SHA256_LANES words
+ *     V_STORE(p,v)      aligned store of SHA256_LANES words
+ *     V_SET1(x)         broadcast a 32-bit constant
+ *     V_ADD(a,b)        lane-wise 32-bit addition
+ *     V_XOR(a,b), V_AND(a,b), V_OR(a,b)
+ *     V_ANDNOT(a,b)     (~a) & b
+ *     V_SHR(x,n)        logical right shift by constant
+ *     V_ROTR(x,n)       rotate right by constant
+ *   All of these are undefined again at the end of the file.
+ *
+ * Parameters of the generated function:
+ *   state: [in/out]
+ *     state[i * SHA256_LANES + j] is word i of the intermediate hash
+ *     for lane j; it must be suitably aligned for V_LOAD.
+ *   blocks: [in]
+ *     blocks[j] points at the 64-byte block for lane j.
+ */
+
+#define V_SIGMA0(x) V_XOR(V_XOR(V_ROTR(x, 2), V_ROTR(x,13)), V_ROTR(x,22))
+#define V_SIGMA1(x) V_XOR(V_XOR(V_ROTR(x, 6), V_ROTR(x,11)), V_ROTR(x,25))
+#define V_sigma0(x) V_XOR(V_XOR(V_ROTR(x, 7), V_ROTR(x,18)), V_SHR(x, 3))
+#define V_sigma1(x) V_XOR(V_XOR(V_ROTR(x,17), V_ROTR(x,19)), V_SHR(x,10))
+#define V_Ch(x,y,z)  V_XOR(V_AND(x, y), V_ANDNOT(x, z))
+#define V_Maj(x,y,z) V_OR(V_AND(x, y), V_AND(z, V_OR(x, y)))
+#define V_ROW(i)     (state + (i) * SHA256_LANES)
+
+SHA256_LANES_ATTR
+static void SHA256_LANES_FN(uint32_t *state,
+    const uint8_t *const *blocks)
+{
+  SHA256_ALIGNED uint32_t w[SHA256_LANES];
+  V W[16];
+  V A, B, C, D, E, F, G, H, temp1, temp2;
+  int t, j;
+
+  /*
+   * Transpose the first 16 big-endian words of each block into
+   * one vector per word.
+   */
+  for (t = 0; t < 16; t++) {
+    for (j = 0; j < SHA256_LANES; j++) {
+      const uint8_t *p = blocks[j] + 4 * t;
+      w[j] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+             ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+    }
+    W[t] = V_LOAD(w);
+  }
+
+  A = V_LOAD(V_ROW(0));
+  B = V_LOAD(V_ROW(1));
+  C = V_LOAD(V_ROW(2));
+  D = V_LOAD(V_ROW(3));
+  E = V_LOAD(V_ROW(4));
+  F = V_LOAD(V_ROW(5));
+  G = V_LOAD(V_ROW(6));
+  H = V_LOAD(V_ROW(7));
+
+  for (t = 0; t < 64; t++) {
+    if (t >= 16)
+      W[t & 15] = V_ADD(V_ADD(V_sigma1(W[(t-2) & 15]), W[(t-7) & 15]),
+                        V_ADD(V_sigma0(W[(t-15) & 15]), W[t & 15]));
+    temp1 = V_ADD(V_ADD(V_ADD(H, V_SIGMA1(E)), V_Ch(E, F, G)),
+                  V_ADD(V_SET1(SHA256_K[t]), W[t & 15]));
+    temp2 = V_ADD(V_SIGMA0(A), V_Maj(A, B, C));
+    H = G;
+    G = F;
+    F = E;
+    E = V_ADD(D, temp1);
+    D = C;
+    C = B;
+    B = A;
+    A = V_ADD(temp1, temp2);
+  }
+
+  V_STORE(V_ROW(0), V_ADD(A, V_LOAD(V_ROW(0))));
+  V_STORE(V_ROW(1), V_ADD(B, V_LOAD(V_ROW(1))));
+  V_STORE(V_ROW(2), V_ADD(C, V_LOAD(V_ROW(2))));
+  V_STORE(V_ROW(3), V_ADD(D, V_LOAD(V_ROW(3))));
+  V_STORE(V_ROW(4), V_ADD(E, V_LOAD(V_ROW(4))));
+  V_STORE(V_ROW(5), V_ADD(F, V_LOAD(V_ROW(5))));
+  V_STORE(V_ROW(6), V_ADD(G, V_LOAD(V_ROW(6))));
+  V_STORE(V_ROW(7), V_ADD(H, V_LOAD(V_ROW(7))));
+}
+
+#undef V_SIGMA0
+#undef V_SIGMA1
+#undef V_sigma0
+#undef V_sigma1
+#undef V_Ch
+#undef V_Maj
+#undef V_ROW
+
+#undef SHA256_LANES
+#undef SHA256_LANES_FN
+#undef SHA256_LANES_ATTR
+#undef V
+#undef V_LOAD
+#undef V_STORE
+#undef V_SET1
+#undef V_ADD
+#undef V_XOR
+#undef V_AND
+#undef V_OR
+#undef V_ANDNOT
+#undef V_SHR
+#undef V_ROTR
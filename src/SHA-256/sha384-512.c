@@ -40,6 +40,7 @@
  *
  */
 
+#include <string.h>
 #include "sha.h"
 #include "sha-private.h"
 
@@ -252,7 +253,8 @@ static void SHA384_512Finalize(SHA512Context *context,
   uint8_t Pad_Byte);
 static void SHA384_512PadMessage(SHA512Context *context,
   uint8_t Pad_Byte);
-static void SHA384_512ProcessMessageBlock(SHA512Context *context);
+static void SHA384_512ProcessMessageBlock(SHA512Context *context,
+  const uint8_t *block);
 static int SHA384_512Reset(SHA512Context *context, uint32_t H0[]);
 static int SHA384_512ResultN( SHA512Context *context,
   uint8_t Message_Digest[], int HashSize);
@@ -303,7 +305,8 @@ static void SHA384_512Finalize(SHA512Context *context,
   uint8_t Pad_Byte);
 static void SHA384_512PadMessage(SHA512Context *context,
   uint8_t Pad_Byte);
-static void SHA384_512ProcessMessageBlock(SHA512Context *context);
+static void SHA384_512ProcessMessageBlock(SHA512Context *context,
+  const uint8_t *block);
 static int SHA384_512Reset(SHA512Context *context, uint64_t H0[]);
 static int SHA384_512ResultN(SHA512Context *context,
   uint8_t Message_Digest[], int HashSize);
@@ -467,6 +470,8 @@ int SHA512Input(SHA512Context *context,
         const uint8_t *message_array,
         unsigned int length)
 {
+  unsigned int n;
+
   if (!length)
     return shaSuccess;
 
@@ -481,15 +486,31 @@ int SHA512Input(SHA512Context *context,
   if (context->Corrupted)
      return context->Corrupted;
 
-  while (length-- && !context->Corrupted) {
-    context->Message_Block[context->Message_Block_Index++] =
-            (*message_array & 0xFF);
-
-    if (!SHA384_512AddLength(context, 8) &&
+  while (length && !context->Corrupted) {
+    /* whole blocks are compressed straight from the caller's buffer */
+    if ((context->Message_Block_Index == 0) &&
+        (length >= SHA512_Message_Block_Size)) {
+      if (SHA384_512AddLength(context, 8 * SHA512_Message_Block_Size))
+        break;
+      SHA384_512ProcessMessageBlock(context, message_array);
+      message_array += SHA512_Message_Block_Size;
+      length -= SHA512_Message_Block_Size;
+      continue;
+    }
+
+    /* otherwise buffer as much of the current block as we can */
+    n = SHA512_Message_Block_Size - context->Message_Block_Index;
+    if (n > length)
+      n = length;
+    memcpy(&context->Message_Block[context->Message_Block_Index],
+           message_array, n);
+    context->Message_Block_Index += n;
+    message_array += n;
+    length -= n;
+
+    if (!SHA384_512AddLength(context, 8 * n) &&
       (context->Message_Block_Index == SHA512_Message_Block_Size))
-      SHA384_512ProcessMessageBlock(context);
-
-    message_array++;
+      SHA384_512ProcessMessageBlock(context, context->Message_Block);
   }
 
   return shaSuccess;
@@ -656,7 +677,7 @@ static void SHA384_512PadMessage(SHA512Context *context,
     while (context->Message_Block_Index < SHA512_Message_Block_Size)
       context->Message_Block[context->Message_Block_Index++] = 0;
 
-    SHA384_512ProcessMessageBlock(context);
+    SHA384_512ProcessMessageBlock(context, context->Message_Block);
   } else
     context->Message_Block[context->Message_Block_Index++] = Pad_Byte;
 
@@ -704,7 +725,7 @@ static void SHA384_512PadMessage(SHA512Context *context,
   context->Message_Block[127] = (uint8_t)(context->Length_Low);
 #endif /* USE_32BIT_ONLY */
 
-  SHA384_512ProcessMessageBlock(context);
+  SHA384_512ProcessMessageBlock(context, context->Message_Block);
 }
 
 /*
@@ -712,11 +733,14 @@ static void SHA384_512PadMessage(SHA512Context *context,
  *
  * Description:
  *   This helper function will process the next 1024 bits of the
- *   message stored in the Message_Block array.
+ *   message, stored in the Message_Block array or, for whole
+ *   blocks passed to SHA512Input(), in the caller's buffer.
  *
  * Parameters:
  *   context: [in/out]
  *     The SHA context to update
+ *   block: [in]
+ *     The 128-byte message block
  *
  * Returns:
  *   Nothing.
@@ -727,7 +751,8 @@ static void SHA384_512PadMessage(SHA512Context *context,
  *   names used in the publication.
  *
  */
-static void SHA384_512ProcessMessageBlock(SHA512Context *context)
+static void SHA384_512ProcessMessageBlock(SHA512Context *context,
+    const uint8_t *block)
 {
   /* Constants defined in FIPS-180-2, section 4.2.3 */
 #ifdef USE_32BIT_ONLY
@@ -775,14 +800,14 @@ static void SHA384_512ProcessMessageBlock(SHA512Context *context)
 
   /* Initialize the first 16 words in the array W */
   for (t = t2 = t8 = 0; t < 16; t++, t8 += 8) {
-    W[t2++] = ((((uint32_t)context->Message_Block[t8    ])) << 24) |
-              ((((uint32_t)context->Message_Block[t8 + 1])) << 16) |
-              ((((uint32_t)context->Message_Block[t8 + 2])) << 8) |
-              ((((uint32_t)context->Message_Block[t8 + 3])));
-    W[t2++] = ((((uint32_t)context->Message_Block[t8 + 4])) << 24) |
-              ((((uint32_t)context->Message_Block[t8 + 5])) << 16) |
-              ((((uint32_t)context->Message_Block[t8 + 6])) << 8) |
-              ((((uint32_t)context->Message_Block[t8 + 7])));
+    W[t2++] = ((((uint32_t)block[t8    ])) << 24) |
+              ((((uint32_t)block[t8 + 1])) << 16) |
+              ((((uint32_t)block[t8 + 2])) << 8) |
+              ((((uint32_t)block[t8 + 3])));
+    W[t2++] = ((((uint32_t)block[t8 + 4])) << 24) |
+              ((((uint32_t)block[t8 + 5])) << 16) |
+              ((((uint32_t)block[t8 + 6])) << 8) |
+              ((((uint32_t)block[t8 + 7])));
   }
 
   for (t = 16; t < 80; t++, t2 += 2) {
@@ -892,15 +917,15 @@ static void SHA384_512ProcessMessageBlock(SHA512Context *context)
    * Initialize the first 16 words in the array W
    */
   for (t = t8 = 0; t < 16; t++, t8 += 8)
-    W[t] = ((uint64_t)(context->Message_Block[t8  ]) << 56) |
-           ((uint64_t)(context->Message_Block[t8 + 1]) << 48) |
-           ((uint64_t)(context->Message_Block[t8 + 2]) << 40) |
-           ((uint64_t)(context->Message_Block[t8 + 3]) << 32) |
-           ((uint64_t)(context->Message_Block[t8 + 4]) << 24) |
-           ((uint64_t)(context->Message_Block[t8 + 5]) << 16) |
-
-           ((uint64_t)(context->Message_Block[t8 + 6]) << 8) |
-           ((uint64_t)(context->Message_Block[t8 + 7]));
+    W[t] = ((uint64_t)(block[t8  ]) << 56) |
+           ((uint64_t)(block[t8 + 1]) << 48) |
+           ((uint64_t)(block[t8 + 2]) << 40) |
+           ((uint64_t)(block[t8 + 3]) << 32) |
+           ((uint64_t)(block[t8 + 4]) << 24) |
+           ((uint64_t)(block[t8 + 5]) << 16) |
+
+           ((uint64_t)(block[t8 + 6]) << 8) |
+           ((uint64_t)(block[t8 + 7]));
 
   for (t = 16; t < 80; t++)
     W[t] = SHA512_sigma1(W[t-2]) + W[t-7] +
@@ -0,0 +1,279 @@
+/**************************** shabench.c ****************************/
+/*
+ *  Description:
+ *    This file measures the throughput of the SHA functions through
+ *    the unified USHA interface, reporting MB/s (10^6 bytes per
+ *    second) for each algorithm and, where there is a choice, each
+ *    compression backend.  The message is either a buffer of
+ *    pseudo-random bytes handed to USHAInput() in a single call, or
+ *    a file read with USHAInputFile().  Each measurement is repeated
+ *    and the best time is reported.
+ *
+ *    With -m, it compares the HMAC paths for 64 byte, 1 KiB and
+ *    64 KiB messages instead: hmac(), which hashes the padded key
+ *    for every message, against a key precomputed by hmacPrecompute()
+ *    and used via hmacResetKey() or hmacBatch().
+ *
+ *  Usage:
+ *    shabench [-m] [-s MiB] [-r repeats] [-f file]
+ *
+ *  Portability Issues:
+ *    Uses POSIX getopt(), open() and clock_gettime().
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include "sha.h"
+
+static const struct {
+  const char *name;
+  SHAversion whichSha;
+  int hasBackends;              /* uses SHASetBackend() selection */
+} hashes[] = {
+  { "SHA1",   SHA1,   1 },
+  { "SHA224", SHA224, 1 },
+  { "SHA256", SHA256, 1 },
+  { "SHA384", SHA384, 0 },
+  { "SHA512", SHA512, 0 },
+};
+
+static const SHABackend backends[] = {
+  shaBackendPortable, shaBackendSHANI
+};
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Hash the buffer (or, if fd >= 0, the file) once and return the
+ * elapsed time in seconds, or a negative value on error.
+ */
+static double timehash(SHAversion whichSha, const uint8_t *buf,
+  unsigned int len, int fd)
+{
+  USHAContext sha;
+  uint8_t digest[USHAMaxHashSize];
+  double t0 = now();
+  int err = USHAReset(&sha, whichSha);
+
+  if (err == shaSuccess) {
+    if (fd >= 0) {
+      if (lseek(fd, 0, SEEK_SET) < 0)
+        return -1.0;
+      err = USHAInputFile(&sha, fd);
+    } else {
+      err = USHAInput(&sha, buf, len);
+    }
+  }
+  if (err == shaSuccess)
+    err = USHAResult(&sha, digest);
+  return (err == shaSuccess) ? now() - t0 : -1.0;
+}
+
+/* Messages per hmacBatch() call in the HMAC benchmark */
+#define HMAC_BATCH 64
+
+enum { HMAC_PLAIN, HMAC_PRECOMPUTED, HMAC_BATCHED, HMAC_METHODS };
+
+/*
+ * MAC nmsgs messages of len bytes from buf under one key, using the
+ * given method, and return the elapsed time in seconds, or a
+ * negative value on error.
+ */
+static double timehmac(int method, SHAversion whichSha,
+  const uint8_t *buf, int len, long nmsgs)
+{
+  static const unsigned char key[] = "a 32-byte key for the benchmark";
+  const unsigned char *texts[HMAC_BATCH];
+  int lens[HMAC_BATCH];
+  uint8_t digests[HMAC_BATCH][USHAMaxHashSize];
+  HMACContext ctx;
+  HMACKey hkey;
+  double t0 = now();
+  long i;
+  int err = shaSuccess, j;
+
+  if (method != HMAC_PLAIN)
+    err = hmacPrecompute(&hkey, whichSha, key, sizeof(key) - 1);
+  for (j = 0; j < HMAC_BATCH; j++) {
+    texts[j] = buf;
+    lens[j] = len;
+  }
+  for (i = 0; i < nmsgs && err == shaSuccess; ) {
+    switch (method) {
+      case HMAC_PLAIN:
+        err = hmac(whichSha, buf, len, key, sizeof(key) - 1, digests[0]);
+        i++;
+        break;
+      case HMAC_PRECOMPUTED:
+        err = hmacResetKey(&ctx, &hkey) ||
+              hmacInput(&ctx, buf, len) ||
+              hmacResult(&ctx, digests[0]);
+        i++;
+        break;
+      default:
+        j = (nmsgs - i < HMAC_BATCH) ? (int)(nmsgs - i) : HMAC_BATCH;
+        err = hmacBatch(&hkey, j, texts, lens, digests);
+        i += j;
+        break;
+    }
+  }
+  return (err == shaSuccess) ? now() - t0 : -1.0;
+}
+
+/*
+ * Report MB/s for each HMAC method and message size, and the
+ * speedup of the precomputed key over hmac().
+ */
+static int hmacbench(const char *argv0, unsigned long mib, int repeats)
+{
+  static const int sizes[] = { 64, 1024, 64 * 1024 };
+  static const char *const methods[HMAC_METHODS] = {
+    "hmac()", "precomputed", "batch"
+  };
+  double bytes = (double)(mib << 20);
+  uint8_t *buf;
+  size_t i, s;
+  int m, r;
+
+  if (!(buf = malloc(sizes[sizeof(sizes) / sizeof(sizes[0]) - 1]))) {
+    fprintf(stderr, "%s: out of memory\n", argv0);
+    return 1;
+  }
+  memset(buf, 'x', sizes[sizeof(sizes) / sizeof(sizes[0]) - 1]);
+
+  printf("%-8s %6s %12s %12s %12s %8s\n", "Hash", "Bytes",
+         methods[0], methods[1], methods[2], "Speedup");
+  for (i = 0; i < sizeof(hashes) / sizeof(hashes[0]); i++) {
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+      long nmsgs = (long)(bytes / sizes[s]);
+      double mbps[HMAC_METHODS];
+      for (m = 0; m < HMAC_METHODS; m++) {
+        double best = 0.0, t;
+        for (r = 0; r < repeats; r++) {
+          t = timehmac(m, hashes[i].whichSha, buf, sizes[s], nmsgs);
+          if (t < 0) {
+            fprintf(stderr, "%s: HMAC %s failed\n", argv0,
+                    hashes[i].name);
+            free(buf);
+            return 1;
+          }
+          if (r == 0 || t < best)
+            best = t;
+        }
+        mbps[m] = best > 0 ? bytes / best / 1e6 : 0.0;
+      }
+      printf("%-8s %6d %12.1f %12.1f %12.1f %7.2fx\n", hashes[i].name,
+             sizes[s], mbps[HMAC_PLAIN], mbps[HMAC_PRECOMPUTED],
+             mbps[HMAC_BATCHED],
+             mbps[HMAC_PLAIN] > 0 ? mbps[HMAC_PRECOMPUTED] /
+                                    mbps[HMAC_PLAIN] : 0.0);
+    }
+  }
+  free(buf);
+  return 0;
+}
+
+static void usage(const char *argv0)
+{
+  fprintf(stderr, "Usage: %s [-m] [-s MiB] [-r repeats] [-f file]\n"
+    "-m\tbenchmark HMAC with and without a precomputed key\n"
+    "-s\tsize of the in-memory message in MiB (default 64;\n"
+    "\tdefault 16 with -m, where it is the total per measurement)\n"
+    "-r\ttimes to repeat each measurement (default 3)\n"
+    "-f\thash this file with USHAInputFile() instead\n", argv0);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long mib = 0;
+  int repeats = 3;
+  int hmacmode = 0;
+  const char *file = 0;
+  double bytes;
+  uint8_t *buf = 0;
+  unsigned int len = 0;
+  int fd = -1;
+  int opt;
+  size_t i, b;
+
+  while ((opt = getopt(argc, argv, "f:mr:s:")) != -1)
+    switch (opt) {
+      case 'f': file = optarg; break;
+      case 'm': hmacmode = 1; break;
+      case 'r': repeats = atoi(optarg); break;
+      case 's': mib = strtoul(optarg, 0, 0); break;
+      default: usage(argv[0]);
+    }
+  if (mib == 0)
+    mib = hmacmode ? 16 : 64;
+  if (optind != argc || repeats <= 0 || mib >= 4096 ||
+      (hmacmode && file))
+    usage(argv[0]);
+  if (hmacmode)
+    return hmacbench(argv[0], mib, repeats);
+
+  if (file) {
+    off_t end;
+    if ((fd = open(file, O_RDONLY)) < 0 ||
+        (end = lseek(fd, 0, SEEK_END)) < 0) {
+      fprintf(stderr, "%s: cannot open file '%s'\n", argv[0], file);
+      return 1;
+    }
+    bytes = (double)end;
+  } else {
+    uint32_t x = 0x12345678;
+    len = (unsigned int)(mib << 20);
+    if (!(buf = malloc(len))) {
+      fprintf(stderr, "%s: out of memory\n", argv[0]);
+      return 1;
+    }
+    for (i = 0; i < len; i++) {
+      x = x * 1103515245 + 12345;
+      buf[i] = (uint8_t)(x >> 24);
+    }
+    bytes = (double)len;
+  }
+
+  printf("%-8s %-10s %10s\n", "Hash", "Backend", "MB/s");
+  for (i = 0; i < sizeof(hashes) / sizeof(hashes[0]); i++) {
+    size_t nb = hashes[i].hasBackends ?
+                sizeof(backends) / sizeof(backends[0]) : 1;
+    for (b = 0; b < nb; b++) {
+      double best = 0.0, t;
+      int r;
+      if (hashes[i].hasBackends &&
+          SHASetBackend(backends[b]) != shaSuccess)
+        continue;
+      for (r = 0; r < repeats; r++) {
+        if ((t = timehash(hashes[i].whichSha, buf, len, fd)) < 0) {
+          fprintf(stderr, "%s: %s failed\n", argv[0], hashes[i].name);
+          return 1;
+        }
+        if (r == 0 || t < best)
+          best = t;
+      }
+      printf("%-8s %-10s %10.1f\n", hashes[i].name,
+             hashes[i].hasBackends ? SHABackendName(backends[b]) : "-",
+             best > 0 ? bytes / best / 1e6 : 0.0);
+    }
+  }
+  SHASetBackend(shaBackendAuto);
+
+  free(buf);
+  if (fd >= 0)
+    close(fd);
+  return 0;
+}
@@ -28,11 +28,13 @@
  *
  */
 
+#define _POSIX_C_SOURCE 200809L
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <unistd.h>
 #include "sha.h"
 
 static int xgetopt(int argc, char **argv, const char *optstring);
@@ -669,9 +671,9 @@ void usage(const char *argv0)
 {
   fprintf(stderr,
     "Usage:\n"
-    "Common options: [-h hash] [-w|-x] [-H]\n"
+    "Common options: [-h hash] [-c backend] [-w|-x] [-H]\n"
     "Standard tests:\n"
-      "\t%s [-m] [-l loopcount] [-t test#] [-e]\n"
+      "\t%s [-m] [-l loopcount] [-t test#] [-e] [-M] [-T]\n"
       "\t\t[-r randomseed] [-R randomloop-count] "
         "[-p] [-P|-X]\n"
     "Hash a string:\n"
@@ -683,11 +685,15 @@ void usage(const char *argv0)
     "Additional bits to add in: [-B bitcount -b bits]\n"
     "-h\thash to test: "
       "0|SHA1, 1|SHA224, 2|SHA256, 3|SHA384, 4|SHA512\n"
+    "-c\tcompression backend: auto, portable or sha-ni\n"
+      "\t(default: standard tests run with each, others use auto)\n"
     "-m\tperform hmac test\n"
     "-k\tkey for hmac test\n"
     "-t\ttest case to run, 1-10\n"
     "-l\thow many times to run the test\n"
     "-e\ttest error returns\n"
+    "-M\ttest multi-buffer SHA-256 with each batch engine\n"
+    "-T\ttest the SHA384/SHA512 tree hash modes\n"
     "-p\tdo not print results\n"
     "-P\tdo not print PASSED/FAILED\n"
     "-X\tprint FAILED, but not PASSED\n"
@@ -883,7 +889,14 @@ int hashfile(int hashno, const char *hashfilename, int bits,
         }
       }
     }
-  else
+  else if (!keyarray) {
+    err = USHAInputFile(&sha, fileno(hashfp));
+    if (err != shaSuccess) {
+      fprintf(stderr, "hashfile(): shaInput Error %d.\n", err);
+      if (hashfp != stdin) fclose(hashfp);
+      return err;
+    }
+  } else
     while ((nread = fread(buf, 1, sizeof(buf), hashfp)) > 0) {
       err = keyarray ? hmacInput(&hmac, buf, nread) :
                        USHAInput(&sha, buf, nread);
@@ -973,6 +986,270 @@ void randomtest(int hashno, const char *seed, int hashsize,
   }
 }
 
+/*
+ * Exercise the multi-buffer SHA-256 interface with each engine the
+ * host supports.  The batch holds every byte-aligned SHA-256
+ * standard test, checked against its known result, interleaved with
+ * messages of assorted lengths, checked against SHA256Input() and
+ * SHA256Result(), so that the lanes finish at different times.
+ */
+#define BATCHRANDOM 61
+static
+void batchtest(int printResults, int printPassFail)
+{
+  const uint8_t *msgs[TESTCOUNT + BATCHRANDOM];
+  unsigned int lens[TESTCOUNT + BATCHRANDOM];
+  const char *results[TESTCOUNT + BATCHRANDOM];
+  uint8_t expect[BATCHRANDOM][SHA256HashSize];
+  uint8_t digests[TESTCOUNT + BATCHRANDOM][SHA256HashSize];
+  uint8_t *bufs[TESTCOUNT];
+  uint8_t randbuf[BATCHRANDOM * 7];
+  SHA256Context ctx;
+  int i, n = 0, nbufs = 0, r = 0, engine, ret;
+  long k;
+
+  for (i = 0; i < (int)sizeof(randbuf); i++)
+    randbuf[i] = (uint8_t)(i * 131 + 7);
+
+  for (i = 0; i < TESTCOUNT; i++) {
+    const char *t = hashes[SHA256].tests[i].testarray;
+    int len = hashes[SHA256].tests[i].length;
+    long repeat = hashes[SHA256].tests[i].repeatcount;
+    if (hashes[SHA256].tests[i].numberExtrabits != 0)
+      continue;
+    if ((bufs[nbufs] = malloc(len * repeat + 1)) == 0) {
+      fprintf(stderr, "batchtest(): out of memory\n");
+      exit(1);
+    }
+    for (k = 0; k < repeat; k++)
+      memcpy(bufs[nbufs] + k * len, t, len);
+    msgs[n] = bufs[nbufs++];
+    lens[n] = len * repeat;
+    results[n++] = hashes[SHA256].tests[i].resultarray;
+
+    /* a few messages of other lengths between each test */
+    for ( ; r < BATCHRANDOM * (i + 1) / TESTCOUNT; r++) {
+      msgs[n] = randbuf + r;
+      lens[n] = (r * 37) % (sizeof(randbuf) - r);
+      SHA256Reset(&ctx);
+      SHA256Input(&ctx, msgs[n], lens[n]);
+      SHA256Result(&ctx, expect[r]);
+      results[n++] = 0;
+    }
+  }
+
+  for (engine = SHA256BatchScalar; engine <= SHA256BatchAVX512;
+       engine++) {
+    const char *name = SHA256BatchEngineName(engine);
+    if (SHA256BatchSetEngine(engine) != shaSuccess) {
+      if (printResults == PRINTTEXT)
+        printf("SHA256 batch engine %s: not supported\n", name);
+      continue;
+    }
+    memset(digests, '\343', sizeof(digests));
+    ret = (SHA256BatchHash(n, msgs, lens, digests) == shaSuccess);
+    for (i = 0, r = 0; ret && i < n; i++) {
+      if (results[i])
+        ret = checkmatch(digests[i], results[i], SHA256HashSize);
+      else
+        ret = (memcmp(digests[i], expect[r++], SHA256HashSize) == 0);
+    }
+    if (printResults == PRINTTEXT)
+      printf("SHA256 batch engine %s: %d messages\n", name, n);
+    if ((printPassFail == PRINTPASSFAIL) || !ret)
+      printf("SHA256 batch test %s: %s\n", name,
+        ret ? "PASSED" : "FAILED");
+  }
+  SHA256BatchSetEngine(SHA256BatchAuto);
+
+  for (i = 0; i < nbufs; i++)
+    free(bufs[i]);
+}
+
+/*
+ * Pick the HMAC test field for hashno, falling back to the entries
+ * shared by several hashes, as the standard HMAC tests do.
+ */
+#define HMACFIELD(testno, field, hashno) \
+  (hmachashes[testno].field[hashno] ? hmachashes[testno].field[hashno] : \
+   hmachashes[testno].field[1] ? hmachashes[testno].field[1] : \
+   hmachashes[testno].field[0])
+
+/*
+ * Exercise the precomputed HMAC key interface: each HMAC standard
+ * test is run through hmacResetKey(), and all of them for one key
+ * through hmacBatch(), with the data repeated to give the batch
+ * several messages.  Both must give the known results.
+ */
+#define HMACBATCH 3
+static
+void hmackeytest(int hashnolow, int hashnohigh, int printResults,
+  int printPassFail)
+{
+  const unsigned char *texts[HMACBATCH];
+  int lens[HMACBATCH];
+  uint8_t digests[HMACBATCH][USHAMaxHashSize];
+  uint8_t digest[USHAMaxHashSize];
+  HMACContext ctx;
+  HMACKey hkey;
+  int hashno, testno, i, ret;
+
+  for (hashno = hashnolow; hashno <= hashnohigh; ++hashno) {
+    ret = 1;
+    for (testno = 0; ret && testno < HMACTESTCOUNT; ++testno) {
+      const char *result = hmachashes[testno].resultarray[hashno];
+      int resultlen = hmachashes[testno].resultlength[hashno];
+      const unsigned char *text =
+        (const unsigned char *)HMACFIELD(testno, dataarray, hashno);
+      int textlen = HMACFIELD(testno, datalength, hashno);
+
+      memset(&hkey, '\343', sizeof(hkey));
+      memset(&ctx, '\343', sizeof(ctx));
+      ret = hmacPrecompute(&hkey, hashes[hashno].whichSha,
+              (const unsigned char *)HMACFIELD(testno, keyarray, hashno),
+              HMACFIELD(testno, keylength, hashno)) == shaSuccess &&
+            hmacResetKey(&ctx, &hkey) == shaSuccess &&
+            hmacInput(&ctx, text, textlen) == shaSuccess &&
+            hmacResult(&ctx, digest) == shaSuccess &&
+            checkmatch(digest, result, resultlen);
+
+      for (i = 0; i < HMACBATCH; i++) {
+        texts[i] = text;
+        lens[i] = textlen;
+      }
+      memset(digests, '\343', sizeof(digests));
+      ret = ret &&
+            hmacBatch(&hkey, HMACBATCH, texts, lens, digests) == shaSuccess;
+      for (i = 0; ret && i < HMACBATCH; i++)
+        ret = checkmatch(digests[i], result, resultlen);
+    }
+    if (printResults == PRINTTEXT)
+      printf("%s precomputed key: %d tests\n", hashes[hashno].name,
+        HMACTESTCOUNT);
+    if ((printPassFail == PRINTPASSFAIL) || !ret)
+      printf("%s hmac precomputed key test: %s\n", hashes[hashno].name,
+        ret ? "PASSED" : "FAILED");
+  }
+}
+
+/*
+ * Compute a tree digest the slow way, straight from the layout
+ * documented in sha-tree.c, with nothing shared with that code.
+ */
+static
+void treereference(SHAversion whichSha, const uint8_t *data,
+  size_t length, size_t chunksize, uint8_t digest[USHAMaxHashSize])
+{
+  uint8_t nodes[64][USHAMaxHashSize], trailer[17];
+  uint8_t suffix;
+  USHAContext sha;
+  int hashsize = USHAHashSize(whichSha);
+  size_t n = (length == 0) ? 1 : (length + chunksize - 1) / chunksize;
+  size_t i, j;
+
+  for (i = 0; i < n; i++) {
+    size_t len = (i == n - 1) ? length - i * chunksize : chunksize;
+    suffix = 0x00;
+    USHAReset(&sha, whichSha);
+    USHAInput(&sha, data + i * chunksize, (unsigned int)len);
+    USHAInput(&sha, &suffix, 1);
+    USHAResult(&sha, nodes[i]);
+  }
+  for ( ; n > 1; n = j) {
+    suffix = 0x01;
+    for (i = 0, j = 0; i < n; i += 2, j++) {
+      if (i + 1 == n) {
+        memcpy(nodes[j], nodes[i], hashsize);
+        continue;
+      }
+      USHAReset(&sha, whichSha);
+      USHAInput(&sha, nodes[i], hashsize);
+      USHAInput(&sha, nodes[i + 1], hashsize);
+      USHAInput(&sha, &suffix, 1);
+      USHAResult(&sha, nodes[j]);
+    }
+  }
+  for (i = 0; i < 8; i++) {
+    trailer[i] = (uint8_t)((uint64_t)length >> (56 - 8 * i));
+    trailer[8 + i] = (uint8_t)((uint64_t)chunksize >> (56 - 8 * i));
+  }
+  trailer[16] = 0x02;
+  USHAReset(&sha, whichSha);
+  USHAInput(&sha, nodes[0], hashsize);
+  USHAInput(&sha, trailer, sizeof(trailer));
+  USHAResult(&sha, digest);
+}
+
+/*
+ * Exercise the tree hash modes: for several message lengths around
+ * chunk boundaries and several thread counts, the digest from memory,
+ * from a file and from a pipe must all match the reference.
+ */
+static
+void treetest(int printResults, int printPassFail)
+{
+  static const size_t lengths[] = {
+    0, 1, 1023, 1024, 1025, 2048, 3 * 1024 + 5, 7 * 1024,
+    13 * 1024 + 100, 32 * 1024
+  };
+  static const unsigned int threads[] = { 1, 2, 3, 8 };
+  const size_t chunksize = SHATreeMinChunkSize;
+  uint8_t data[32 * 1024];
+  uint8_t expect[USHAMaxHashSize], digest[USHAMaxHashSize];
+  int whichTree, ret, fds[2];
+  size_t i, t;
+
+  for (i = 0; i < sizeof(data); i++)
+    data[i] = (uint8_t)(i * 251 + (i >> 8));
+
+  for (whichTree = SHA384Tree; whichTree <= SHA512Tree; whichTree++) {
+    SHAversion whichSha = (whichTree == SHA384Tree) ? SHA384 : SHA512;
+    int hashsize = SHATreeHashSize(whichTree);
+    ret = 1;
+    for (i = 0; ret && i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+      treereference(whichSha, data, lengths[i], chunksize, expect);
+      for (t = 0; ret && t < sizeof(threads) / sizeof(threads[0]); t++) {
+        FILE *fp = tmpfile();
+        memset(digest, '\343', sizeof(digest));
+        ret = SHATreeHash(whichTree, data, lengths[i], threads[t],
+                          chunksize, digest) == shaSuccess &&
+              memcmp(digest, expect, hashsize) == 0;
+
+        /* a regular file, which is mapped */
+        ret = ret && fp &&
+              fwrite(data, 1, lengths[i], fp) == lengths[i] &&
+              fflush(fp) == 0 && fseek(fp, 0, SEEK_SET) == 0 &&
+              SHATreeHashFile(whichTree, fileno(fp), threads[t],
+                              chunksize, digest) == shaSuccess &&
+              memcmp(digest, expect, hashsize) == 0;
+        if (fp)
+          fclose(fp);
+
+        /* a pipe, which is read in batches */
+        if (ret && pipe(fds) == 0) {
+          ret = write(fds[1], data, lengths[i]) == (ssize_t)lengths[i];
+          close(fds[1]);
+          ret = ret &&
+                SHATreeHashFile(whichTree, fds[0], threads[t],
+                                chunksize, digest) == shaSuccess &&
+                memcmp(digest, expect, hashsize) == 0;
+          close(fds[0]);
+        } else {
+          ret = 0;
+        }
+      }
+    }
+    if (printResults == PRINTTEXT)
+      printf("%s: %d lengths, %d thread counts\n",
+        SHATreeName(whichTree),
+        (int)(sizeof(lengths) / sizeof(lengths[0])),
+        (int)(sizeof(threads) / sizeof(threads[0])));
+    if ((printPassFail == PRINTPASSFAIL) || !ret)
+      printf("%s tree test: %s\n", SHATreeName(whichTree),
+        ret ? "PASSED" : "FAILED");
+  }
+}
+
 /*
  * Look up a hash name.
  */
@@ -995,6 +1272,25 @@ int findhash(const char *argv0, const char *opt)
   return 0;
 }
 
+/*
+ * Look up a compression backend name.
+ */
+static
+int findbackend(const char *argv0, const char *opt)
+{
+  int i;
+
+  if (!opt)
+    return shaBackendAuto;
+  for (i = shaBackendAuto; i <= shaBackendSHANI; i++)
+    if (scasecmp(opt, SHABackendName(i)) == 0)
+      return i;
+
+  fprintf(stderr, "%s: Unknown backend name: '%s'\n", argv0, opt);
+  usage(argv0);
+  return 0;
+}
+
 /*
  * Run some tests that should invoke errors.
  */
@@ -1091,6 +1387,8 @@ int main(int argc, char **argv)
   int printResults = PRINTTEXT;
   int printPassFail = 1;
   int checkErrors = 0;
+  int checkBatch = 0;
+  int checkTree = 0;
   char *hashstr = 0;
   int hashlen = 0;
   const char *resultstr = 0;
@@ -1103,12 +1401,15 @@ int main(int argc, char **argv)
   const char *hashFilename = 0;
   int extrabits = 0, numberExtrabits = 0;
   int strIsHex = 0;
+  const char *backendName = 0;
+  int backend, backendlow, backendhigh;
 
-  while ((i = xgetopt(argc, argv, "b:B:ef:F:h:Hk:l:mpPr:R:s:S:t:wxX"))
+  while ((i = xgetopt(argc, argv, "b:B:c:ef:F:h:Hk:l:mMpPr:R:s:S:t:TwxX"))
          != -1)
     switch (i) {
       case 'b': extrabits = strtol(xoptarg, 0, 0); break;
       case 'B': numberExtrabits = atoi(xoptarg); break;
+      case 'c': backendName = xoptarg; break;
       case 'e': checkErrors = 1; break;
       case 'f': hashfilename = xoptarg; break;
       case 'F': hashFilename = xoptarg; break;
@@ -1118,6 +1419,7 @@ int main(int argc, char **argv)
       case 'k': hmacKey = xoptarg; hmaclen = strlen(xoptarg); break;
       case 'l': loopnohigh = atoi(xoptarg); break;
       case 'm': runHmacTests = 1; break;
+      case 'M': checkBatch = 1; break;
       case 'P': printPassFail = 0; break;
       case 'p': printResults = PRINTNONE; break;
       case 'R': randomcount = atoi(xoptarg); break;
@@ -1126,6 +1428,7 @@ int main(int argc, char **argv)
       case 's': hashstr = xoptarg; hashlen = strlen(hashstr); break;
       case 'S': resultstr = xoptarg; break;
       case 't': testnolow = ntestnohigh = atoi(xoptarg) - 1; break;
+      case 'T': checkTree = 1; break;
       case 'w': printResults = PRINTRAW; break;
       case 'x': printResults = PRINTHEX; break;
       case 'X': printPassFail = 2; break;
@@ -1150,98 +1453,134 @@ int main(int argc, char **argv)
     usage(argv[0]);
 
   /*
-   *  Perform SHA/HMAC tests
+   *  Perform SHA/HMAC tests.  The standard tests run once with each
+   *  compression backend; anything else uses the chosen backend.
    */
-  for (hashno = hashnolow; hashno <= hashnohigh; ++hashno) {
-    if (printResults == PRINTTEXT)
-      printf("Hash %s\n", hashes[hashno].name);
-    err = shaSuccess;
-
-    for (loopno = 1; (loopno <= loopnohigh) && (err == shaSuccess);
-         ++loopno) {
-      if (hashstr)
-        err = hash(0, loopno, hashno, hashstr, hashlen, 1,
-          numberExtrabits, extrabits, (const unsigned char *)hmacKey,
-          hmaclen, resultstr, hashes[hashno].hashsize, printResults,
-          printPassFail);
-
-      else if (randomseedstr)
-        randomtest(hashno, randomseedstr, hashes[hashno].hashsize, 0,
-          randomcount, printResults, printPassFail);
-
-      else if (hashfilename)
-        err = hashfile(hashno, hashfilename, extrabits,
-
-                       numberExtrabits, 0,
-                       (const unsigned char *)hmacKey, hmaclen,
-                       resultstr, hashes[hashno].hashsize,
-                       printResults, printPassFail);
-
-      else if (hashFilename)
-        err = hashfile(hashno, hashFilename, extrabits,
-                       numberExtrabits, 1,
-                       (const unsigned char *)hmacKey, hmaclen,
-                       resultstr, hashes[hashno].hashsize,
-                       printResults, printPassFail);
-
-      else /* standard tests */ {
-        for (testno = testnolow;
-             (testno <= testnohigh) && (err == shaSuccess); ++testno) {
-          if (runHmacTests) {
-            err = hash(testno, loopno, hashno,
-                       hmachashes[testno].dataarray[hashno] ?
-                       hmachashes[testno].dataarray[hashno] :
-                       hmachashes[testno].dataarray[1] ?
-                       hmachashes[testno].dataarray[1] :
-                       hmachashes[testno].dataarray[0],
-                       hmachashes[testno].datalength[hashno] ?
-                       hmachashes[testno].datalength[hashno] :
-                       hmachashes[testno].datalength[1] ?
-                       hmachashes[testno].datalength[1] :
-                       hmachashes[testno].datalength[0],
-                       1, 0, 0,
-                       (const unsigned char *)(
-                        hmachashes[testno].keyarray[hashno] ?
-                        hmachashes[testno].keyarray[hashno] :
-                        hmachashes[testno].keyarray[1] ?
-                        hmachashes[testno].keyarray[1] :
-                        hmachashes[testno].keyarray[0]),
-                       hmachashes[testno].keylength[hashno] ?
-                       hmachashes[testno].keylength[hashno] :
-                       hmachashes[testno].keylength[1] ?
-                       hmachashes[testno].keylength[1] :
-                       hmachashes[testno].keylength[0],
-                       hmachashes[testno].resultarray[hashno],
-                       hmachashes[testno].resultlength[hashno],
-                       printResults, printPassFail);
-          } else {
-            err = hash(testno, loopno, hashno,
-                       hashes[hashno].tests[testno].testarray,
-                       hashes[hashno].tests[testno].length,
-                       hashes[hashno].tests[testno].repeatcount,
-                       hashes[hashno].tests[testno].numberExtrabits,
-
-                       hashes[hashno].tests[testno].extrabits, 0, 0,
-                       hashes[hashno].tests[testno].resultarray,
-                       hashes[hashno].hashsize,
-                       printResults, printPassFail);
+  if (!backendName && !hashstr && !randomseedstr && !hashfilename &&
+      !hashFilename) {
+    backendlow = shaBackendPortable;
+    backendhigh = shaBackendSHANI;
+  } else {
+    backendlow = backendhigh = findbackend(argv[0], backendName);
+  }
+
+  for (backend = backendlow; backend <= backendhigh; ++backend) {
+    if (SHASetBackend(backend) != shaSuccess) {
+      if (printResults == PRINTTEXT)
+        printf("Backend %s not supported\n", SHABackendName(backend));
+      continue;
+    }
+    if ((backendlow != backendhigh) && ((printResults == PRINTTEXT) ||
+        (printPassFail == PRINTPASSFAIL)))
+      printf("Backend %s\n", SHABackendName(backend));
+
+    for (hashno = hashnolow; hashno <= hashnohigh; ++hashno) {
+      if (printResults == PRINTTEXT)
+        printf("Hash %s\n", hashes[hashno].name);
+      err = shaSuccess;
+
+      for (loopno = 1; (loopno <= loopnohigh) && (err == shaSuccess);
+           ++loopno) {
+        if (hashstr)
+          err = hash(0, loopno, hashno, hashstr, hashlen, 1,
+            numberExtrabits, extrabits, (const unsigned char *)hmacKey,
+            hmaclen, resultstr, hashes[hashno].hashsize, printResults,
+            printPassFail);
+
+        else if (randomseedstr)
+          randomtest(hashno, randomseedstr, hashes[hashno].hashsize, 0,
+            randomcount, printResults, printPassFail);
+
+        else if (hashfilename)
+          err = hashfile(hashno, hashfilename, extrabits,
+
+                         numberExtrabits, 0,
+                         (const unsigned char *)hmacKey, hmaclen,
+                         resultstr, hashes[hashno].hashsize,
+                         printResults, printPassFail);
+
+        else if (hashFilename)
+          err = hashfile(hashno, hashFilename, extrabits,
+                         numberExtrabits, 1,
+                         (const unsigned char *)hmacKey, hmaclen,
+                         resultstr, hashes[hashno].hashsize,
+                         printResults, printPassFail);
+
+        else /* standard tests */ {
+          for (testno = testnolow;
+               (testno <= testnohigh) && (err == shaSuccess); ++testno) {
+            if (runHmacTests) {
+              err = hash(testno, loopno, hashno,
+                         hmachashes[testno].dataarray[hashno] ?
+                         hmachashes[testno].dataarray[hashno] :
+                         hmachashes[testno].dataarray[1] ?
+                         hmachashes[testno].dataarray[1] :
+                         hmachashes[testno].dataarray[0],
+                         hmachashes[testno].datalength[hashno] ?
+                         hmachashes[testno].datalength[hashno] :
+                         hmachashes[testno].datalength[1] ?
+                         hmachashes[testno].datalength[1] :
+                         hmachashes[testno].datalength[0],
+                         1, 0, 0,
+                         (const unsigned char *)(
+                          hmachashes[testno].keyarray[hashno] ?
+                          hmachashes[testno].keyarray[hashno] :
+                          hmachashes[testno].keyarray[1] ?
+                          hmachashes[testno].keyarray[1] :
+                          hmachashes[testno].keyarray[0]),
+                         hmachashes[testno].keylength[hashno] ?
+                         hmachashes[testno].keylength[hashno] :
+                         hmachashes[testno].keylength[1] ?
+                         hmachashes[testno].keylength[1] :
+                         hmachashes[testno].keylength[0],
+                         hmachashes[testno].resultarray[hashno],
+                         hmachashes[testno].resultlength[hashno],
+                         printResults, printPassFail);
+            } else {
+              err = hash(testno, loopno, hashno,
+                         hashes[hashno].tests[testno].testarray,
+                         hashes[hashno].tests[testno].length,
+                         hashes[hashno].tests[testno].repeatcount,
+                         hashes[hashno].tests[testno].numberExtrabits,
+
+                         hashes[hashno].tests[testno].extrabits, 0, 0,
+                         hashes[hashno].tests[testno].resultarray,
+                         hashes[hashno].hashsize,
+                         printResults, printPassFail);
+            }
           }
-        }
 
-        if (!runHmacTests) {
-          randomtest(hashno, hashes[hashno].randomtest,
-            hashes[hashno].hashsize, hashes[hashno].randomresults,
-            RANDOMCOUNT, printResults, printPassFail);
+          if (!runHmacTests) {
+            randomtest(hashno, hashes[hashno].randomtest,
+              hashes[hashno].hashsize, hashes[hashno].randomresults,
+              RANDOMCOUNT, printResults, printPassFail);
+          }
         }
       }
     }
   }
+  SHASetBackend(shaBackendAuto);
+
+  /* Test the precomputed HMAC key interface */
+  if (runHmacTests && !hashstr && !hashfilename && !hashFilename) {
+    hmackeytest(hashnolow, hashnohigh, printResults, printPassFail);
+  }
 
   /* Test some error returns */
   if (checkErrors) {
     testErrors(hashnolow, hashnohigh, printResults, printPassFail);
   }
 
+  /* Test the multi-buffer SHA-256 interface */
+  if (checkBatch) {
+    batchtest(printResults, printPassFail);
+  }
+
+  /* Test the tree hash modes */
+  if (checkTree) {
+    treetest(printResults, printPassFail);
+  }
+
   return 0;
 }
 
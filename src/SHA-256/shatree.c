@@ -0,0 +1,116 @@
+/* Parallel SHA-384/SHA-512 tree hash of files */
+
+/*
+** Print the SHA512-TREE (or SHA384-TREE) digest of each named file,
+** or standard input, hashing chunks of the file on all the cores.
+** The digests are labelled with the mode because they are NOT the
+** same as the output of sha512sum; see sha-tree.c for the layout.
+** The digest does not depend on the number of threads, but it does
+** depend on the chunk size.
+*/
+
+#include "posixver.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "filter.h"
+#include "jlss.h"
+#include "sha.h"
+#include "stderr.h"
+
+enum { MAX_THREADS = 1024 };
+
+static SHATreeVersion tree = SHA512Tree;
+static unsigned int nthreads = 0;
+static size_t chunksize = 0;
+
+static int shatree(FILE *ifp, const char *fn)
+{
+    uint8_t digest[USHAMaxHashSize];
+    int size = SHATreeHashSize(tree);
+    int err = SHATreeHashFile(tree, fileno(ifp), nthreads, chunksize, digest);
+
+    if (err != shaSuccess)
+    {
+        err_remark("failed to hash %s (SHA error %d)\n", fn, err);
+        return -1;
+    }
+    printf("%s (%s) = ", SHATreeName(tree), (ifp == stdin) ? "-" : fn);
+    for (int i = 0; i < size; i++)
+        printf("%02x", digest[i]);
+    putchar('\n');
+    return 0;
+}
+
+/* Chunk size in bytes, with an optional K, M or G suffix */
+static size_t scan_size(const char *arg)
+{
+    char *end;
+    errno = 0;
+    size_t size = strtosize_scaled(arg, &end, 0, true);
+    if (end == arg || *end != '\0' || errno != 0 || size < SHATreeMinChunkSize ||
+        size > SHATreeMaxChunkSize || size % SHA512_Message_Block_Size != 0)
+        err_error("invalid chunk size '%s' (a multiple of 128 from 1K to 1G)\n", arg);
+    return size;
+}
+
+/* Number of threads, 1 to MAX_THREADS */
+static unsigned int scan_threads(const char *arg)
+{
+    char *end;
+    errno = 0;
+    long n = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || errno != 0 || n < 1 || n > MAX_THREADS)
+        err_error("invalid number of threads '%s' (1..%d)\n", arg, MAX_THREADS);
+    return (unsigned int)n;
+}
+
+static const char usestr[] = "[-hV][-a 384|512][-c chunk][-j threads] [file ...]";
+static const char optstr[] = "a:c:hj:V";
+static const char hlpstr[] =
+    "  -a 384|512  Underlying hash (default 512)\n"
+    "  -c chunk    Chunk size, e.g. 4M (default 1M); changes the digest\n"
+    "  -h          Print this help and exit\n"
+    "  -j threads  Number of threads (default: one per online CPU)\n"
+    "  -V          Print version information and exit\n"
+    ;
+
+int main(int argc, char **argv)
+{
+    err_setarg0(argv[0]);
+    int opt;
+
+    while ((opt = getopt(argc, argv, optstr)) != -1)
+    {
+        switch (opt)
+        {
+        case 'a':
+            if (strcmp(optarg, "384") == 0)
+                tree = SHA384Tree;
+            else if (strcmp(optarg, "512") == 0)
+                tree = SHA512Tree;
+            else
+                err_error("unknown hash '%s' (use 384 or 512)\n", optarg);
+            break;
+        case 'c':
+            chunksize = scan_size(optarg);
+            break;
+        case 'j':
+            nthreads = scan_threads(optarg);
+            break;
+        case 'h':
+            err_help(usestr, hlpstr);
+            /*NOTREACHED*/
+        case 'V':
+            err_version("SHATREE", "1.0");
+            /*NOTREACHED*/
+        default:
+            err_usage(usestr);
+            /*NOTREACHED*/
+        }
+    }
+
+    return(filter_stdout(argc, argv, optind, shatree) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -5,7 +5,20 @@
  *     This file implements a unified interface to the SHA algorithms.
  */
 
+#define _POSIX_C_SOURCE 200809L
 #include "sha.h"
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Largest piece of a mapped file passed to USHAInput() in one call;
+ * a multiple of every block size that fits in an unsigned int.
+ */
+#define USHA_FILE_CHUNK   (1U << 30)
+/* Size of the read() buffer used when a file cannot be mapped */
+#define USHA_READ_BUFSIZE (64 * 1024)
 
 /*
  *  USHAReset
@@ -88,6 +101,78 @@ int USHAInput(USHAContext *ctx,
   }
 }
 
+/*
+ *  USHAInputFile
+ *
+ *  Description:
+ *      This function reads the file open on fd, from its current
+ *      offset to end of file, as the next portion of the message.
+ *      A regular file is mapped into memory and hashed in place, so
+ *      whole blocks are compressed without being copied; anything
+ *      that cannot be mapped (pipes, terminals, empty files or a
+ *      failed mmap()) is read in large block-aligned pieces instead.
+ *      On success the file offset is left at end of file.
+ *
+ *  Parameters:
+ *      context: [in/out]
+ *          The SHA context to update
+ *      fd: [in]
+ *          An open file descriptor, readable.
+ *
+ *  Returns:
+ *      sha Error Code; shaFileError if the file could not be read.
+ *
+ */
+int USHAInputFile(USHAContext *ctx, int fd)
+{
+  struct stat st;
+  off_t offset;
+  int err = shaSuccess;
+
+  if (!ctx)
+    return shaNull;
+
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+      (offset = lseek(fd, 0, SEEK_CUR)) >= 0 && offset < st.st_size &&
+      (uintmax_t)st.st_size <= (size_t)-1) {
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+      const uint8_t *p = (const uint8_t *)map + offset;
+      size_t left = size - (size_t)offset;
+      (void)posix_madvise(map, size, POSIX_MADV_SEQUENTIAL);
+      while (left > 0 && err == shaSuccess) {
+        unsigned int n = (left > USHA_FILE_CHUNK) ? USHA_FILE_CHUNK :
+                                                    (unsigned int)left;
+        err = USHAInput(ctx, p, n);
+        p += n;
+        left -= n;
+      }
+      munmap(map, size);
+      if (err == shaSuccess && lseek(fd, st.st_size, SEEK_SET) < 0)
+        err = shaFileError;
+      return err;
+    }
+  }
+
+  /* Fall back to reading the file */
+  {
+    uint8_t buf[USHA_READ_BUFSIZE];
+    ssize_t nread;
+    while (err == shaSuccess) {
+      nread = read(fd, buf, sizeof(buf));
+      if (nread < 0 && errno == EINTR)
+        continue;
+      if (nread < 0)
+        return shaFileError;
+      if (nread == 0)
+        break;
+      err = USHAInput(ctx, buf, (unsigned int)nread);
+    }
+  }
+  return err;
+}
+
 /*
  * USHAFinalBits
  *
@@ -0,0 +1,929 @@
+/*
+@(#)File:           bench.c
+@(#)Purpose:        Benchmark harness: named cases, statistics, reports
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#if defined(__linux__)
+#define _GNU_SOURCE     /* syscall() for perf_event_open() */
+#endif /* __linux__ */
+
+#include "posixver.h"
+#include "bench.h"
+#include "emalloc.h"
+#include "timer.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define BENCH_HAVE_PERF
+#endif /* __linux__ */
+
+/*
+** Each case is run warm-up times untimed, then timed until at least
+** min_runs runs have been made and the median absolute deviation of
+** the run times is within tolerance of the median, or max_runs runs
+** have been made, or the case has used time_limit seconds.  The
+** median and MAD are robust against the occasional run that is
+** interrupted, which is why they are used rather than the mean and
+** standard deviation.
+*/
+
+/*
+** The counters are opened in groups, and the counters in a group are
+** counted over the same interval.  The first group has the general
+** events, and the cache events have a group of their own, so that if
+** the kernel cannot schedule them both at once (with the NMI watchdog
+** holding a counter, say), it takes turns between them.  Each group
+** reads the time it was enabled and the time it was running: a group
+** that never ran has no values for that run, and the values of one that
+** ran part of the time are scaled up by enabled/running.
+*/
+enum { BENCH_NUM_COUNTERS = 6 };
+enum { BENCH_NUM_GROUPS = 2 };
+
+#if defined(BENCH_HAVE_PERF)
+#define BENCH_HW_CACHE(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+#endif /* BENCH_HAVE_PERF */
+
+static const struct
+{
+    const char *name;
+    int group;
+    unsigned int type;
+    unsigned long long config;
+} counters[BENCH_NUM_COUNTERS] =
+{
+#if defined(BENCH_HAVE_PERF)
+    { "cycles",        0, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES       },
+    { "instructions",  0, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS     },
+    { "cache_misses",  0, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES     },
+    { "branch_misses", 0, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES    },
+    { "l1d_misses",    1, PERF_TYPE_HW_CACHE, BENCH_HW_CACHE(PERF_COUNT_HW_CACHE_L1D) },
+    { "llc_misses",    1, PERF_TYPE_HW_CACHE, BENCH_HW_CACHE(PERF_COUNT_HW_CACHE_LL)  },
+#else
+    { "cycles",        0, 0, 0 },
+    { "instructions",  0, 0, 0 },
+    { "cache_misses",  0, 0, 0 },
+    { "branch_misses", 0, 0, 0 },
+    { "l1d_misses",    1, 0, 0 },
+    { "llc_misses",    1, 0, 0 },
+#endif /* BENCH_HAVE_PERF */
+};
+
+typedef struct BenchMetric
+{
+    char   *name;
+    double  value;
+} BenchMetric;
+
+typedef struct BenchEntry
+{
+    BenchCase   bcase;
+    int         nmetrics;
+    BenchMetric metrics[BENCH_MAX_METRICS];
+} BenchEntry;
+
+struct Bench
+{
+    char       *suite;
+    FILE       *fp;
+    BenchFormat format;
+    int         warmup;
+    int         min_runs;
+    int         max_runs;
+    double      tolerance;
+    double      time_limit;
+    int         use_counters;
+    int         per_item;           /* Report counters per item */
+    size_t      ncases;
+    size_t      maxcases;
+    BenchEntry *cases;
+    BenchEntry *current;            /* Case being run, for bench_metric() */
+    size_t      nrun;               /* Cases run so far */
+    int         nreported;          /* Cases reported so far */
+    int         started;            /* Report started */
+    int         perf_fd[BENCH_NUM_COUNTERS];    /* -1 if not available */
+    int         perf_index[BENCH_NUM_COUNTERS]; /* Position in group read */
+    int         perf_open;          /* Number of counters open */
+    int         perf_leader[BENCH_NUM_GROUPS];  /* -1 if group not open */
+    int         perf_members[BENCH_NUM_GROUPS]; /* Counters open in group */
+};
+
+typedef struct BenchResult
+{
+    int     runs;
+    int     failures;
+    double  min_ns;
+    double  median_ns;
+    double  p99_ns;
+    double  mean_ns;
+    int     have_counter[BENCH_NUM_COUNTERS];
+    double  counter[BENCH_NUM_COUNTERS];    /* Median per run */
+} BenchResult;
+
+/* Copy of str, or null if str is null */
+static char *copy_str(const char *str)
+{
+    if (str == 0)
+        return(0);
+    size_t len = strlen(str) + 1;
+    return(memcpy(MALLOC(len), str, len));
+}
+
+Bench *bench_create(const char *suite)
+{
+    Bench *bench = MALLOC(sizeof(*bench));
+    bench->suite = copy_str(suite);
+    bench->fp = stdout;
+    bench->format = BENCH_TEXT;
+    bench->warmup = 2;
+    bench->min_runs = 10;
+    bench->max_runs = 1000;
+    bench->tolerance = 0.02;
+    bench->time_limit = 2.0;
+    bench->use_counters = 1;
+    bench->per_item = 0;
+    bench->ncases = 0;
+    bench->maxcases = 0;
+    bench->cases = 0;
+    bench->current = 0;
+    bench->nrun = 0;
+    bench->nreported = 0;
+    bench->started = 0;
+    for (int i = 0; i < BENCH_NUM_COUNTERS; i++)
+    {
+        bench->perf_fd[i] = -1;
+        bench->perf_index[i] = -1;
+    }
+    for (int g = 0; g < BENCH_NUM_GROUPS; g++)
+    {
+        bench->perf_leader[g] = -1;
+        bench->perf_members[g] = 0;
+    }
+    bench->perf_open = 0;
+    return(bench);
+}
+
+void bench_destroy(Bench *bench)
+{
+    if (bench == 0)
+        return;
+    bench_finish(bench);
+    for (size_t i = 0; i < bench->ncases; i++)
+    {
+        BenchEntry *e = &bench->cases[i];
+        FREE((char *)e->bcase.name);
+        FREE((char *)e->bcase.param);
+        FREE((char *)e->bcase.unit);
+        for (int j = 0; j < e->nmetrics; j++)
+            FREE(e->metrics[j].name);
+    }
+    FREE(bench->cases);
+    FREE(bench->suite);
+    FREE(bench);
+}
+
+void bench_set_output(Bench *bench, FILE *fp)
+{
+    bench->fp = fp;
+}
+
+void bench_set_format(Bench *bench, BenchFormat format)
+{
+    bench->format = format;
+}
+
+/* Set the format from its name: text, csv or json; -1 if unknown */
+int bench_set_format_name(Bench *bench, const char *name)
+{
+    if (strcmp(name, "text") == 0)
+        bench->format = BENCH_TEXT;
+    else if (strcmp(name, "csv") == 0)
+        bench->format = BENCH_CSV;
+    else if (strcmp(name, "json") == 0)
+        bench->format = BENCH_JSON;
+    else
+        return(-1);
+    return(0);
+}
+
+void bench_set_warmup(Bench *bench, int runs)
+{
+    bench->warmup = (runs < 0) ? 0 : runs;
+}
+
+void bench_set_runs(Bench *bench, int min_runs, int max_runs)
+{
+    if (min_runs < 1)
+        min_runs = 1;
+    if (max_runs < min_runs)
+        max_runs = min_runs;
+    bench->min_runs = min_runs;
+    bench->max_runs = max_runs;
+}
+
+void bench_set_tolerance(Bench *bench, double tolerance)
+{
+    bench->tolerance = tolerance;
+}
+
+void bench_set_time_limit(Bench *bench, double seconds)
+{
+    bench->time_limit = seconds;
+}
+
+void bench_set_counters(Bench *bench, int enable)
+{
+    bench->use_counters = enable;
+}
+
+void bench_set_per_item(Bench *bench, int enable)
+{
+    bench->per_item = enable;
+}
+
+
+void bench_add(Bench *bench, const BenchCase *bcase)
+{
+    assert(bcase->name != 0 && bcase->run != 0);
+    if (bench->ncases >= bench->maxcases)
+    {
+        bench->maxcases = 2 * bench->maxcases + 16;
+        bench->cases = REALLOC(bench->cases,
+                               bench->maxcases * sizeof(bench->cases[0]));
+    }
+    BenchEntry *e = &bench->cases[bench->ncases++];
+    e->bcase = *bcase;
+    e->bcase.name = copy_str(bcase->name);
+    e->bcase.param = copy_str(bcase->param);
+    e->bcase.unit = copy_str(bcase->unit);
+    e->nmetrics = 0;
+}
+
+/* Record (or replace) a named value for the case being run */
+void bench_metric(Bench *bench, const char *name, double value)
+{
+    BenchEntry *e = bench->current;
+    if (e == 0)
+        return;
+    for (int i = 0; i < e->nmetrics; i++)
+    {
+        if (strcmp(e->metrics[i].name, name) == 0)
+        {
+            e->metrics[i].value = value;
+            return;
+        }
+    }
+    if (e->nmetrics < BENCH_MAX_METRICS)
+    {
+        e->metrics[e->nmetrics].name = copy_str(name);
+        e->metrics[e->nmetrics].value = value;
+        e->nmetrics++;
+    }
+}
+
+/* -- Hardware counters */
+
+#if defined(BENCH_HAVE_PERF)
+
+static int perf_open(unsigned int type, unsigned long long config, int group_fd)
+{
+    struct perf_event_attr pe;
+
+    memset(&pe, 0, sizeof(pe));
+    pe.type = type;
+    pe.size = sizeof(pe);
+    pe.config = config;
+    pe.disabled = (group_fd == -1);
+    pe.exclude_kernel = 1;
+    pe.exclude_hv = 1;
+    pe.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return((int)syscall(__NR_perf_event_open, &pe, 0, -1, group_fd, 0));
+}
+
+static void perf_start(Bench *bench)
+{
+    for (int g = 0; g < BENCH_NUM_GROUPS; g++)
+    {
+        if (bench->perf_leader[g] >= 0)
+            ioctl(bench->perf_leader[g], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    }
+    for (int g = 0; g < BENCH_NUM_GROUPS; g++)
+    {
+        if (bench->perf_leader[g] >= 0)
+            ioctl(bench->perf_leader[g], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+/*
+** Stop the counters and read them into values[], setting have[i] for
+** each counter whose group was scheduled; returns the number set.
+*/
+static int perf_stop(Bench *bench, double values[BENCH_NUM_COUNTERS],
+                     int have[BENCH_NUM_COUNTERS])
+{
+    /* nr, time_enabled, time_running, values[nr] */
+    unsigned long long buf[BENCH_NUM_GROUPS][3 + BENCH_NUM_COUNTERS];
+    double scale[BENCH_NUM_GROUPS];
+    int nhave = 0;
+
+    for (int g = 0; g < BENCH_NUM_GROUPS; g++)
+    {
+        if (bench->perf_leader[g] >= 0)
+            ioctl(bench->perf_leader[g], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+    for (int g = 0; g < BENCH_NUM_GROUPS; g++)
+    {
+        scale[g] = 0.0;
+        if (bench->perf_leader[g] < 0)
+            continue;
+        if (read(bench->perf_leader[g], buf[g], sizeof(buf[g])) < (ssize_t)(3 * sizeof(buf[g][0])) ||
+            buf[g][0] != (unsigned long long)bench->perf_members[g] || buf[g][2] == 0)
+            continue;
+        scale[g] = (double)buf[g][1] / buf[g][2];
+    }
+    for (int i = 0; i < BENCH_NUM_COUNTERS; i++)
+    {
+        int g = counters[i].group;
+        have[i] = (bench->perf_index[i] >= 0 && scale[g] > 0.0);
+        if (have[i])
+        {
+            values[i] = buf[g][3 + bench->perf_index[i]] * scale[g];
+            nhave++;
+        }
+    }
+    return(nhave);
+}
+
+/* Open as many counters as possible, in their groups */
+static void perf_init(Bench *bench)
+{
+    for (int i = 0; i < BENCH_NUM_COUNTERS; i++)
+    {
+        int g = counters[i].group;
+        int fd = perf_open(counters[i].type, counters[i].config, bench->perf_leader[g]);
+        if (fd < 0)
+        {
+            if (i == 0)
+                return;     /* No cycle counter: not permitted here */
+            continue;
+        }
+        if (bench->perf_leader[g] == -1)
+            bench->perf_leader[g] = fd;
+        bench->perf_fd[i] = fd;
+        bench->perf_index[i] = bench->perf_members[g]++;
+        bench->perf_open++;
+    }
+    /* The first enable can take milliseconds; get it out of the way */
+    double values[BENCH_NUM_COUNTERS];
+    int have[BENCH_NUM_COUNTERS];
+    perf_start(bench);
+    perf_stop(bench, values, have);
+}
+
+static void perf_fini(Bench *bench)
+{
+    for (int i = BENCH_NUM_COUNTERS; i-- > 0; )
+    {
+        if (bench->perf_fd[i] >= 0)
+            close(bench->perf_fd[i]);
+        bench->perf_fd[i] = -1;
+        bench->perf_index[i] = -1;
+    }
+    for (int g = 0; g < BENCH_NUM_GROUPS; g++)
+    {
+        bench->perf_leader[g] = -1;
+        bench->perf_members[g] = 0;
+    }
+    bench->perf_open = 0;
+}
+
+#else
+
+static void perf_init(Bench *bench) { (void)bench; }
+static void perf_fini(Bench *bench) { (void)bench; }
+static void perf_start(Bench *bench) { (void)bench; }
+static int  perf_stop(Bench *bench, double values[BENCH_NUM_COUNTERS],
+                      int have[BENCH_NUM_COUNTERS])
+{
+    (void)bench;
+    (void)values;
+    for (int i = 0; i < BENCH_NUM_COUNTERS; i++)
+        have[i] = 0;
+    return(0);
+}
+
+#endif /* BENCH_HAVE_PERF */
+
+/* -- Statistics */
+
+static int cmp_double(const void *v1, const void *v2)
+{
+    double d1 = *(const double *)v1;
+    double d2 = *(const double *)v2;
+    return((d1 > d2) - (d1 < d2));
+}
+
+/* Median of sorted data */
+static double median(const double *sorted, int n)
+{
+    if (n % 2 == 1)
+        return(sorted[n / 2]);
+    return((sorted[n / 2 - 1] + sorted[n / 2]) / 2.0);
+}
+
+/* Percentile (nearest rank) of sorted data */
+static double percentile(const double *sorted, int n, int pct)
+{
+    int rank = (pct * n + 99) / 100;
+    if (rank < 1)
+        rank = 1;
+    return(sorted[rank - 1]);
+}
+
+/* Are the n samples stable: MAD within tolerance of the median? */
+static int is_stable(const double *samples, int n, double tolerance,
+                     double *work)
+{
+    memcpy(work, samples, n * sizeof(double));
+    qsort(work, n, sizeof(double), cmp_double);
+    double med = median(work, n);
+    for (int i = 0; i < n; i++)
+        work[i] = (samples[i] < med) ? med - samples[i] : samples[i] - med;
+    qsort(work, n, sizeof(double), cmp_double);
+    return(median(work, n) <= tolerance * med);
+}
+
+/*
+** One run of a case: setup, then the timed run with the counters
+** enabled.  Returns the time in nanoseconds; sets have[i] if counter i
+** was read into values[i].
+*/
+static double measure(Bench *bench, const BenchCase *bc,
+                      double values[BENCH_NUM_COUNTERS], int have[BENCH_NUM_COUNTERS])
+{
+    Clock clk;
+
+    clk_init(&clk);
+    if (bc->setup)
+        (*bc->setup)(bc->ctx);
+    perf_start(bench);
+    clk_start(&clk);
+    (*bc->run)(bc->ctx);
+    clk_stop(&clk);
+    perf_stop(bench, values, have);
+    return((double)clk_elapsed_nsec(&clk));
+}
+
+static void run_case(Bench *bench, BenchEntry *e, BenchResult *res)
+{
+    const BenchCase *bc = &e->bcase;
+    int max = bench->max_runs;
+    double *samples = MALLOC(max * sizeof(double));
+    double *work = MALLOC(max * sizeof(double));
+    double *ctrs[BENCH_NUM_COUNTERS];
+    double values[BENCH_NUM_COUNTERS] = { 0 };
+    int nctrs[BENCH_NUM_COUNTERS] = { 0 };
+    int have[BENCH_NUM_COUNTERS];
+    Clock total;
+
+    for (int i = 0; i < BENCH_NUM_COUNTERS; i++)
+        ctrs[i] = MALLOC(max * sizeof(double));
+
+    bench->current = e;
+    memset(res, 0, sizeof(*res));
+
+    /* Warm-up runs go through the same path, to warm it up too */
+    for (int i = 0; i < bench->warmup; i++)
+        measure(bench, bc, values, have);
+
+    clk_init(&total);
+    clk_start(&total);
+    int n = 0;
+    while (n < max)
+    {
+        samples[n++] = measure(bench, bc, values, have);
+        for (int i = 0; i < BENCH_NUM_COUNTERS; i++)
+        {
+            if (have[i])
+                ctrs[i][nctrs[i]++] = values[i];
+        }
+        if (bc->check && (*bc->check)(bc->ctx) != 0)
+            res->failures++;
+        if (n >= bench->min_runs &&
+            is_stable(samples, n, bench->tolerance, work))
+            break;
+        clk_stop(&total);
+        if (clk_elapsed_nsec(&total) >= bench->time_limit * 1.0E9)
+            break;
+    }
+    bench->current = 0;
+
+    double sum = 0.0;
+    for (int i = 0; i < n; i++)
+        sum += samples[i];
+    memcpy(work, samples, n * sizeof(double));
+    qsort(work, n, sizeof(double), cmp_double);
+    res->runs = n;
+    res->min_ns = work[0];
+    res->median_ns = median(work, n);
+    res->p99_ns = percentile(work, n, 99);
+    res->mean_ns = sum / n;
+
+    for (int i = 0; i < BENCH_NUM_COUNTERS; i++)
+    {
+        if (nctrs[i] > 0)
+        {
+            qsort(ctrs[i], nctrs[i], sizeof(double), cmp_double);
+            res->have_counter[i] = 1;
+            res->counter[i] = median(ctrs[i], nctrs[i]);
+        }
+        FREE(ctrs[i]);
+    }
+    FREE(work);
+    FREE(samples);
+}
+
+/* -- Reports */
+
+static double throughput(const BenchCase *bc, const BenchResult *res)
+{
+    if (bc->items <= 0.0 || res->median_ns <= 0.0)
+        return(0.0);
+    return(bc->items / (res->median_ns * 1.0E-9));
+}
+
+/* Format a rate with an SI prefix: 123.4M */
+static char *si_format(double value, char *buffer, size_t buflen)
+{
+    static const char prefix[] = " kMGTP";
+    int i = 0;
+    while (value >= 1000.0 && prefix[i + 1] != '\0')
+    {
+        value /= 1000.0;
+        i++;
+    }
+    snprintf(buffer, buflen, "%.1f%c", value, prefix[i]);
+    return(buffer);
+}
+
+/* Counter name for the reports: cycles, or cycles_per_item */
+static const char *counter_name(const Bench *bench, int i, char *buffer, size_t buflen)
+{
+    if (!bench->per_item)
+        return(counters[i].name);
+    snprintf(buffer, buflen, "%s_per_item", counters[i].name);
+    return(buffer);
+}
+
+/* Median counter value per run, or per item if so configured */
+static double counter_value(const Bench *bench, const BenchCase *bc,
+                            const BenchResult *res, int i)
+{
+    if (bench->per_item && bc->items > 0.0)
+        return(res->counter[i] / bc->items);
+    return(res->counter[i]);
+}
+
+/* Counts per run are whole numbers; counts per item are not */
+static void print_counter(const Bench *bench, FILE *fp, int width, double value)
+{
+    if (bench->per_item)
+        fprintf(fp, "%*.4f", width, value);
+    else
+        fprintf(fp, "%*.0f", width, value);
+}
+
+static void print_text(Bench *bench, const BenchEntry *e, const BenchResult *res)
+{
+    FILE *fp = bench->fp;
+    const BenchCase *bc = &e->bcase;
+    int width = bench->per_item ? 22 : 14;
+    char buffer[32];
+
+    if (bench->nreported == 0)
+    {
+        fprintf(fp, "%-16s %-36s %5s %12s %12s %12s %18s %4s",
+                "Case", "Param", "Runs", "Min(us)", "Median(us)", "P99(us)",
+                "Throughput", "");
+        for (int i = 0; i < BENCH_NUM_COUNTERS; i++)
+        {
+            if (bench->perf_index[i] >= 0)
+                fprintf(fp, " %*s", width, counter_name(bench, i, buffer, sizeof(buffer)));
+        }
+        fputc('\n', fp);
+    }
+    fprintf(fp, "%-16s %-36s %5d %12.3f %12.3f %12.3f",
+            bc->name, bc->param ? bc->param : "", res->runs,
+            res->min_ns / 1.0E3, res->median_ns / 1.0E3, res->p99_ns / 1.0E3);
+    if (bc->items > 0.0)
+    {
+        char rate[48];
+        snprintf(rate, sizeof(rate), "%s %s/s",
+                 si_format(throughput(bc, res), buffer, sizeof(buffer)),
+                 bc->unit ? bc->unit : "items");
+        fprintf(fp, " %18s", rate);
+    }
+    else
+        fprintf(fp, " %18s", "-");
+    fprintf(fp, " %4s", res->failures ? "FAIL" : "ok");
+    for (int i = 0; i < BENCH_NUM_COUNTERS; i++)
+    {
+        if (bench->perf_index[i] >= 0)
+        {
+            putc(' ', fp);
+            if (res->have_counter[i])
+                print_counter(bench, fp, width, counter_value(bench, bc, res, i));
+            else
+                fprintf(fp, "%*s", width, "-");     /* Never scheduled */
+        }
+    }
+    for (int i = 0; i < e->nmetrics; i++)
+        fprintf(fp, " %s=%.15g", e->metrics[i].name, e->metrics[i].value);
+    fputc('\n', fp);
+}
+
+/* Write a CSV field, quoted if necessary */
+static void csv_string(FILE *fp, const char *str)
+{
+    if (str == 0)
+        return;
+    if (strpbrk(str, ",\"\n") == 0)
+    {
+        fputs(str, fp);
+        return;
+    }
+    putc('"', fp);
+    for ( ; *str != '\0'; str++)
+    {
+        if (*str == '"')
+            putc('"', fp);
+        putc(*str, fp);
+    }
+    putc('"', fp);
+}
+
+static void print_csv(Bench *bench, const BenchEntry *e, const BenchResult *res)
+{
+    FILE *fp = bench->fp;
+    const BenchCase *bc = &e->bcase;
+
+    if (bench->nreported == 0)
+    {
+        fputs("suite,case,param,runs,failures,min_ns,median_ns,p99_ns,mean_ns,"
+              "items,unit,items_per_sec", fp);
+        char buffer[32];
+        for (int i = 0; i < BENCH_NUM_COUNTERS; i++)
+            fprintf(fp, ",%s", counter_name(bench, i, buffer, sizeof(buffer)));
+        fputs(",metrics\n", fp);
+    }
+    csv_string(fp, bench->suite);
+    putc(',', fp);
+    csv_string(fp, bc->name);
+    putc(',', fp);
+    csv_string(fp, bc->param);
+    fprintf(fp, ",%d,%d,%.0f,%.0f,%.0f,%.1f,%.15g,", res->runs, res->failures,
+            res->min_ns, res->median_ns, res->p99_ns, res->mean_ns, bc->items);
+    csv_string(fp, bc->unit);
+    fprintf(fp, ",%.6g", throughput(bc, res));
+    for (int i = 0; i < BENCH_NUM_COUNTERS; i++)
+    {
+        putc(',', fp);
+        if (res->have_counter[i])
+            print_counter(bench, fp, 0, counter_value(bench, bc, res, i));
+    }
+    putc(',', fp);
+    if (e->nmetrics > 0)
+    {
+        char buffer[256];
+        size_t len = 0;
+        for (int i = 0; i < e->nmetrics && len < sizeof(buffer); i++)
+            len += snprintf(buffer + len, sizeof(buffer) - len, "%s%s=%.15g",
+                            (i > 0) ? ";" : "", e->metrics[i].name,
+                            e->metrics[i].value);
+        csv_string(fp, buffer);
+    }
+    putc('\n', fp);
+}
+
+/* Write a JSON string, with escapes */
+static void json_string(FILE *fp, const char *str)
+{
+    putc('"', fp);
+    for ( ; str != 0 && *str != '\0'; str++)
+    {
+        unsigned char c = *str;
+        if (c == '"' || c == '\\')
+            fprintf(fp, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(fp, "\\u%04x", c);
+        else
+            putc(c, fp);
+    }
+    putc('"', fp);
+}
+
+static void print_json(Bench *bench, const BenchEntry *e, const BenchResult *res)
+{
+    FILE *fp = bench->fp;
+    const BenchCase *bc = &e->bcase;
+
+    if (bench->nreported == 0)
+    {
+        fputs("{\n  \"suite\": ", fp);
+        json_string(fp, bench->suite);
+        fputs(",\n  \"cases\": [\n", fp);
+    }
+    else
+        fputs(",\n", fp);
+    fputs("    { \"case\": ", fp);
+    json_string(fp, bc->name);
+    fputs(", \"param\": ", fp);
+    json_string(fp, bc->param);
+    fprintf(fp, ", \"runs\": %d, \"failures\": %d,\n", res->runs, res->failures);
+    fprintf(fp, "      \"min_ns\": %.0f, \"median_ns\": %.0f, \"p99_ns\": %.0f,"
+            " \"mean_ns\": %.1f,\n", res->min_ns, res->median_ns, res->p99_ns,
+            res->mean_ns);
+    fprintf(fp, "      \"items\": %.15g, \"unit\": ", bc->items);
+    json_string(fp, bc->unit);
+    fprintf(fp, ", \"items_per_sec\": %.6g", throughput(bc, res));
+    fputs(",\n      \"counters\": {", fp);
+    const char *sep = " ";
+    char buffer[32];
+    for (int i = 0; i < BENCH_NUM_COUNTERS; i++)
+    {
+        if (res->have_counter[i])
+        {
+            fprintf(fp, "%s\"%s\": ", sep, counter_name(bench, i, buffer, sizeof(buffer)));
+            print_counter(bench, fp, 0, counter_value(bench, bc, res, i));
+            sep = ", ";
+        }
+    }
+    fputs(" }, \"metrics\": {", fp);
+    sep = " ";
+    for (int i = 0; i < e->nmetrics; i++)
+    {
+        fputs(sep, fp);
+        json_string(fp, e->metrics[i].name);
+        fprintf(fp, ": %.15g", e->metrics[i].value);
+        sep = ", ";
+    }
+    fputs(" } }", fp);
+}
+
+static void print_result(Bench *bench, const BenchEntry *e, const BenchResult *res)
+{
+    switch (bench->format)
+    {
+    case BENCH_TEXT:
+        print_text(bench, e, res);
+        break;
+    case BENCH_CSV:
+        print_csv(bench, e, res);
+        break;
+    case BENCH_JSON:
+        print_json(bench, e, res);
+        break;
+    }
+    bench->nreported++;
+    fflush(bench->fp);
+}
+
+/*
+** Run and report the cases added since the last call; return the
+** number of them that failed.  The data used by those cases can be
+** released once bench_run() returns, so a program with many large
+** cases can add and run them a few at a time.
+*/
+int bench_run(Bench *bench)
+{
+    int nfailed = 0;
+
+    if (!bench->started)
+    {
+        bench->started = 1;
+        if (bench->use_counters)
+            perf_init(bench);
+        if (bench->format == BENCH_TEXT)
+            fprintf(bench->fp, "Suite: %s%s\n", bench->suite,
+                    (bench->use_counters && bench->perf_open == 0) ?
+                    " (hardware counters not available)" : "");
+    }
+
+    for ( ; bench->nrun < bench->ncases; bench->nrun++)
+    {
+        BenchResult res;
+        BenchEntry *e = &bench->cases[bench->nrun];
+        run_case(bench, e, &res);
+        print_result(bench, e, &res);
+        if (res.failures > 0)
+            nfailed++;
+    }
+    return(nfailed);
+}
+
+/* Complete the report; bench_destroy() calls this if need be */
+void bench_finish(Bench *bench)
+{
+    if (!bench->started)
+        return;
+    if (bench->format == BENCH_JSON)
+    {
+        if (bench->nreported == 0)
+        {
+            fputs("{\n  \"suite\": ", bench->fp);
+            json_string(bench->fp, bench->suite);
+            fputs(",\n  \"cases\": [", bench->fp);
+        }
+        fputs("\n  ]\n}\n", bench->fp);
+    }
+    fflush(bench->fp);
+    perf_fini(bench);
+    bench->started = 0;
+}
+
+#ifdef TEST
+
+#include "stderr.h"
+#include <unistd.h>
+
+typedef struct SumCtx
+{
+    size_t  n;
+    int    *data;
+    long    sum;
+} SumCtx;
+
+static void sum_setup(void *ctx)
+{
+    SumCtx *s = ctx;
+    s->sum = 0;
+}
+
+static void sum_run(void *ctx)
+{
+    SumCtx *s = ctx;
+    long sum = 0;
+    for (size_t i = 0; i < s->n; i++)
+        sum += s->data[i];
+    s->sum = sum;
+}
+
+static int sum_check(void *ctx)
+{
+    SumCtx *s = ctx;
+    long n = s->n;
+    return(s->sum != n * (n - 1) / 2);
+}
+
+static const char usestr[] = "[-h][-f text|csv|json]";
+
+int main(int argc, char **argv)
+{
+    static const size_t sizes[] = { 1000, 100000, 1000000 };
+    enum { NUM_SIZES = sizeof(sizes) / sizeof(sizes[0]) };
+    SumCtx ctx[NUM_SIZES];
+    Bench *bench = bench_create("bench-test");
+    int opt;
+
+    err_setarg0(argv[0]);
+    while ((opt = getopt(argc, argv, "f:h")) != -1)
+    {
+        if (opt == 'f' && bench_set_format_name(bench, optarg) == 0)
+            continue;
+        err_usage(usestr);
+    }
+
+    for (int i = 0; i < NUM_SIZES; i++)
+    {
+        char param[32];
+        ctx[i].n = sizes[i];
+        ctx[i].data = MALLOC(sizes[i] * sizeof(int));
+        for (size_t j = 0; j < sizes[i]; j++)
+            ctx[i].data[j] = (int)j;
+        snprintf(param, sizeof(param), "n=%zu", sizes[i]);
+        BenchCase bc = { "sum", param, sum_setup, sum_run, sum_check,
+                         &ctx[i], (double)sizes[i], "ints" };
+        bench_add(bench, &bc);
+    }
+
+    int rc = bench_run(bench);
+    bench_destroy(bench);
+    for (int i = 0; i < NUM_SIZES; i++)
+        FREE(ctx[i].data);
+    return(rc == 0 ? 0 : 1);
+}
+
+#endif /* TEST */
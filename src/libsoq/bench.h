@@ -0,0 +1,85 @@
+/*
+@(#)File:           bench.h
+@(#)Purpose:        Benchmark harness: named cases, statistics, reports
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#ifndef BENCH_H_INCLUDED
+#define BENCH_H_INCLUDED
+
+#include <stdio.h>
+
+/*
+** A benchmark suite is a list of named cases.  bench_run() times each
+** case repeatedly, after some warm-up runs, until the spread of the
+** run times is small enough (or a run or time limit is reached), and
+** reports the minimum, median and 99th percentile run time, and the
+** throughput (items per second at the median time), as text, CSV or
+** JSON.  Where the host allows it (Linux perf_event_open()), hardware
+** counters (cycles, instructions, cache misses, branch misses, and L1
+** data cache and last-level cache read misses) are read for every run
+** and their medians are reported too: per run, or, after
+** bench_set_per_item(), divided by the number of items in the case, so
+** cases of different sizes can be compared.  A counter that the kernel
+** never scheduled is reported as "-" in text, and left empty in CSV and
+** out of JSON, rather than as zero.
+**
+** The setup function, if any, is called before every run, and the
+** check function, if any, after every run; neither is timed.  The
+** check function returns 0 if the run produced the right answer; a
+** case with any failed checks is reported as failed.  It can also
+** record up to BENCH_MAX_METRICS named values for the case (e.g. the
+** number of comparisons made by a sort) with bench_metric().
+**
+** bench_run() runs the cases added since it was last called, so the
+** data for a batch of cases need only live until it returns.
+** bench_finish() completes the report (closing the JSON document);
+** bench_destroy() calls it if it has not been called.
+*/
+
+typedef struct Bench Bench;
+
+typedef enum BenchFormat
+{
+    BENCH_TEXT,             /* Aligned columns for people */
+    BENCH_CSV,              /* One header line, one line per case */
+    BENCH_JSON              /* One object with an array of cases */
+} BenchFormat;
+
+enum { BENCH_MAX_METRICS = 4 };
+
+typedef struct BenchCase
+{
+    const char *name;               /* Case name (copied) */
+    const char *param;              /* Parameters, e.g. "n=1000" (copied; may be 0) */
+    void      (*setup)(void *ctx);  /* Untimed, before each run (may be 0) */
+    void      (*run)(void *ctx);    /* Timed */
+    int       (*check)(void *ctx);  /* Untimed, after each run (may be 0) */
+    void       *ctx;                /* Passed to setup, run and check */
+    double      items;              /* Items processed per run (0 for none) */
+    const char *unit;               /* Name of the items, e.g. "elements" */
+} BenchCase;
+
+extern Bench *bench_create(const char *suite);
+extern void   bench_destroy(Bench *bench);
+
+/* Configuration; the defaults suit runs of microseconds to milliseconds */
+extern void   bench_set_output(Bench *bench, FILE *fp);          /* stdout */
+extern void   bench_set_format(Bench *bench, BenchFormat format); /* text */
+extern int    bench_set_format_name(Bench *bench, const char *name);
+extern void   bench_set_warmup(Bench *bench, int runs);          /* 2 */
+extern void   bench_set_runs(Bench *bench, int min_runs, int max_runs); /* 10, 1000 */
+extern void   bench_set_tolerance(Bench *bench, double tolerance); /* 0.02 */
+extern void   bench_set_time_limit(Bench *bench, double seconds); /* 2.0 */
+extern void   bench_set_counters(Bench *bench, int enable);      /* 1 */
+extern void   bench_set_per_item(Bench *bench, int enable);      /* 0 */
+
+extern void   bench_add(Bench *bench, const BenchCase *bcase);
+extern void   bench_metric(Bench *bench, const char *name, double value);
+extern int    bench_run(Bench *bench);      /* Cases added since last run */
+extern void   bench_finish(Bench *bench);   /* End of report */
+
+#endif /* BENCH_H_INCLUDED */
@@ -7,6 +7,7 @@
 #define HAVE_FUNLOCKFILE
 #define HAVE_MEMMEM
 #define HAVE_NANOSLEEP
+#define HAVE_PTHREAD_H
 #define HAVE_STRNDUP
 #define HAVE_STRNLEN
 #define HAVE_UNISTD_H
@@ -91,5 +91,10 @@ extern int strtoi(const char *str, char **endptr, int base);
 extern unsigned int strtoui(const char *str, char **endptr, int base);
 /* strtosize() - analogue to strtol() for size_t */
 extern size_t strtosize(const char *data, char **endptr, int base);
+/* strtosize_scaled() - strtosize() with an optional K, M, G or T suffix */
+/* for units of 1000 (binary false) or 1024 (binary true) up to the power */
+/* 1 to 4; sets errno to ERANGE and returns SIZE_MAX if the value overflows */
+/* size_t, and rejects a negative number (*endptr == data) */
+extern size_t strtosize_scaled(const char *data, char **endptr, int base, bool binary);
 
 #endif /* JLSS_H */
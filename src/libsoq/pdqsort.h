@@ -0,0 +1,398 @@
+/*
+@(#)File:           pdqsort.h
+@(#)Purpose:        Pattern-defeating quicksort, specialised per type by macro
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#ifndef JLSS_ID_PDQSORT_H
+#define JLSS_ID_PDQSORT_H
+
+#include <stdbool.h>    /* bool */
+#include <stddef.h>     /* size_t */
+
+/*
+** PDQSORT_DEFINE(name, type, less, branchless) defines
+**
+**     static inline void name(type *data, size_t n);
+**
+** which sorts data[0..n-1] in place (not stably) so that less(a, b) is
+** false for every a that follows b.  The less argument is a function or
+** macro given two lvalues of the element type; for example:
+**
+**     #define INT_LESS(a, b) ((a) < (b))
+**     PDQSORT_DEFINE(pdq_sort_int, int, INT_LESS, true)
+**
+** The arguments may have side effects (such as *--last), so a macro must
+** evaluate each of them exactly once; use an inline function otherwise.
+**
+** The algorithm is Orson Peters' pattern-defeating quicksort, an
+** introsort that stays O(n log n) in the worst case and is O(n) on many
+** common patterns:
+**  - insertion sort for partitions of fewer than 24 elements;
+**  - median of 3, or Tukey's ninther above 128 elements, for the pivot;
+**  - when a partition needs no swaps and is reasonably balanced, a
+**    partial insertion sort (giving up after 8 moves) finishes off
+**    already sorted runs, so sorted and reversed input take linear time;
+**  - when the pivot is equal to the element before the partition (so
+**    nothing in the partition is smaller), elements equal to the pivot
+**    are put aside in one pass, so many duplicates take linear time;
+**  - a badly unbalanced partition swaps a few elements to break up the
+**    pattern that caused it, and after log2(n) bad partitions the rest
+**    of that partition is heap sorted.
+** With branchless true, partitioning uses Edelkamp and Weiss's block
+** partition (BlockQuicksort): comparison results for a block of 64
+** elements from each end are recorded as offsets without branching,
+** then the misplaced elements are swapped in a cyclic permutation.
+** That is faster when the comparison is cheap and its result hard to
+** predict (integers, floats, small keys); use false when comparing is
+** expensive, as with strings, where the ordinary Hoare partition wins.
+*/
+
+enum { PDQSORT_INSERTION = 24 };
+enum { PDQSORT_NINTHER = 128 };
+enum { PDQSORT_PARTIAL_LIMIT = 8 };
+enum { PDQSORT_BLOCK = 64 };
+
+#define PDQSORT_SWAP(type, a, b) \
+    do { type pdq_t_ = *(a); *(a) = *(b); *(b) = pdq_t_; } while (0)
+
+#define PDQSORT_DEFINE(name, type, less, branchless) \
+\
+static inline void name##_isort(type *begin, type *end, bool leftmost) \
+{ \
+    if (begin == end) \
+        return; \
+    for (type *cur = begin + 1; cur != end; cur++) \
+    { \
+        type *sift = cur; \
+        type *sift_1 = cur - 1; \
+        if (less(*sift, *sift_1)) \
+        { \
+            type tmp = *sift; \
+            /* Unless leftmost, begin[-1] stops the loop */ \
+            do \
+            { \
+                *sift-- = *sift_1; \
+            } while ((!leftmost || sift != begin) && less(tmp, *--sift_1)); \
+            *sift = tmp; \
+        } \
+    } \
+} \
+\
+/* Insertion sort that gives up after a few moves */ \
+static inline bool name##_isort_partial(type *begin, type *end) \
+{ \
+    size_t limit = 0; \
+    if (begin == end) \
+        return true; \
+    for (type *cur = begin + 1; cur != end; cur++) \
+    { \
+        type *sift = cur; \
+        type *sift_1 = cur - 1; \
+        if (less(*sift, *sift_1)) \
+        { \
+            type tmp = *sift; \
+            do \
+            { \
+                *sift-- = *sift_1; \
+            } while (sift != begin && less(tmp, *--sift_1)); \
+            *sift = tmp; \
+            limit += cur - sift; \
+        } \
+        if (limit > PDQSORT_PARTIAL_LIMIT) \
+            return false; \
+    } \
+    return true; \
+} \
+\
+static inline void name##_sort2(type *a, type *b) \
+{ \
+    if (less(*b, *a)) \
+        PDQSORT_SWAP(type, a, b); \
+} \
+\
+static inline void name##_sort3(type *a, type *b, type *c) \
+{ \
+    name##_sort2(a, b); \
+    name##_sort2(b, c); \
+    name##_sort2(a, b); \
+} \
+\
+static inline void name##_siftdown(type *data, size_t i, size_t n) \
+{ \
+    type tmp = data[i]; \
+    size_t c; \
+    while ((c = 2 * i + 1) < n) \
+    { \
+        if (c + 1 < n && less(data[c], data[c + 1])) \
+            c++; \
+        if (!less(tmp, data[c])) \
+            break; \
+        data[i] = data[c]; \
+        i = c; \
+    } \
+    data[i] = tmp; \
+} \
+\
+static inline void name##_heapsort(type *begin, type *end) \
+{ \
+    size_t n = end - begin; \
+    for (size_t i = n / 2; i-- > 0; ) \
+        name##_siftdown(begin, i, n); \
+    while (n > 1) \
+    { \
+        n--; \
+        PDQSORT_SWAP(type, &begin[0], &begin[n]); \
+        name##_siftdown(begin, 0, n); \
+    } \
+} \
+\
+/* Elements equal to the pivot *begin go left; return the pivot position */ \
+static inline type *name##_part_left(type *begin, type *end) \
+{ \
+    type pivot = *begin; \
+    type *first = begin; \
+    type *last = end; \
+    while (less(pivot, *--last)) \
+        ; \
+    if (last + 1 == end) \
+    { \
+        while (first < last && !less(pivot, *++first)) \
+            ; \
+    } \
+    else \
+    { \
+        while (!less(pivot, *++first)) \
+            ; \
+    } \
+    while (first < last) \
+    { \
+        PDQSORT_SWAP(type, first, last); \
+        while (less(pivot, *--last)) \
+            ; \
+        while (!less(pivot, *++first)) \
+            ; \
+    } \
+    *begin = *last; \
+    *last = pivot; \
+    return last; \
+} \
+\
+/* \
+** Elements equal to the pivot *begin go right; return the pivot \
+** position, and whether no element had to move. \
+*/ \
+static inline type *name##_part_right(type *begin, type *end, bool *already) \
+{ \
+    type pivot = *begin; \
+    type *first = begin; \
+    type *last = end; \
+    /* The median-of-3 guarantees an element >= pivot to stop this */ \
+    while (less(*++first, pivot)) \
+        ; \
+    if (first - 1 == begin) \
+    { \
+        while (first < last && !less(*--last, pivot)) \
+            ; \
+    } \
+    else \
+    { \
+        while (!less(*--last, pivot)) \
+            ; \
+    } \
+    *already = (first >= last); \
+    if (!(branchless)) \
+    { \
+        while (first < last) \
+        { \
+            PDQSORT_SWAP(type, first, last); \
+            while (less(*++first, pivot)) \
+                ; \
+            while (!less(*--last, pivot)) \
+                ; \
+        } \
+    } \
+    else if (first < last) \
+    { \
+        unsigned char offsets_l[PDQSORT_BLOCK]; \
+        unsigned char offsets_r[PDQSORT_BLOCK]; \
+        size_t num_l = 0, num_r = 0, start_l = 0, start_r = 0; \
+        PDQSORT_SWAP(type, first, last); \
+        first++; \
+        type *base_l = first; \
+        type *base_r = last; \
+        while (first < last) \
+        { \
+            /* Refill whichever offset block is empty, from its end */ \
+            size_t unknown = last - first; \
+            size_t split_l = (num_l != 0) ? 0 : (num_r == 0) ? unknown / 2 : unknown; \
+            size_t split_r = (num_r != 0) ? 0 : unknown - split_l; \
+            if (split_l > PDQSORT_BLOCK) \
+                split_l = PDQSORT_BLOCK; \
+            if (split_r > PDQSORT_BLOCK) \
+                split_r = PDQSORT_BLOCK; \
+            for (size_t i = 0; i < split_l; i++) \
+            { \
+                offsets_l[num_l] = (unsigned char)i; \
+                num_l += !less(*first, pivot); \
+                first++; \
+            } \
+            for (size_t i = 0; i < split_r; ) \
+            { \
+                offsets_r[num_r] = (unsigned char)++i; \
+                num_r += less(*--last, pivot); \
+            } \
+            /* Swap pairs of misplaced elements as one cycle */ \
+            size_t num = (num_l < num_r) ? num_l : num_r; \
+            unsigned char *offl = offsets_l + start_l; \
+            unsigned char *offr = offsets_r + start_r; \
+            if (num_l == num_r) \
+            { \
+                /* Plain swaps keep descending input linear */ \
+                for (size_t i = 0; i < num; i++) \
+                    PDQSORT_SWAP(type, base_l + offl[i], base_r - offr[i]); \
+            } \
+            else if (num > 0) \
+            { \
+                type *l = base_l + offl[0]; \
+                type *r = base_r - offr[0]; \
+                type tmp = *l; \
+                *l = *r; \
+                for (size_t i = 1; i < num; i++) \
+                { \
+                    l = base_l + offl[i]; \
+                    *r = *l; \
+                    r = base_r - offr[i]; \
+                    *l = *r; \
+                } \
+                *r = tmp; \
+            } \
+            num_l -= num; \
+            num_r -= num; \
+            start_l += num; \
+            start_r += num; \
+            if (num_l == 0) \
+            { \
+                start_l = 0; \
+                base_l = first; \
+            } \
+            if (num_r == 0) \
+            { \
+                start_r = 0; \
+                base_r = last; \
+            } \
+        } \
+        /* One block may still hold misplaced elements */ \
+        if (num_l > 0) \
+        { \
+            unsigned char *offl = offsets_l + start_l; \
+            while (num_l-- > 0) \
+            { \
+                --last; \
+                PDQSORT_SWAP(type, base_l + offl[num_l], last); \
+            } \
+            first = last; \
+        } \
+        if (num_r > 0) \
+        { \
+            unsigned char *offr = offsets_r + start_r; \
+            while (num_r-- > 0) \
+            { \
+                PDQSORT_SWAP(type, base_r - offr[num_r], first); \
+                first++; \
+            } \
+        } \
+    } \
+    type *pivot_pos = first - 1; \
+    *begin = *pivot_pos; \
+    *pivot_pos = pivot; \
+    return pivot_pos; \
+} \
+\
+static inline void name##_loop(type *begin, type *end, int bad_allowed, bool leftmost) \
+{ \
+    for (;;) \
+    { \
+        size_t size = end - begin; \
+        if (size < PDQSORT_INSERTION) \
+        { \
+            name##_isort(begin, end, leftmost); \
+            return; \
+        } \
+        size_t s2 = size / 2; \
+        if (size > PDQSORT_NINTHER) \
+        { \
+            name##_sort3(begin, begin + s2, end - 1); \
+            name##_sort3(begin + 1, begin + (s2 - 1), end - 2); \
+            name##_sort3(begin + 2, begin + (s2 + 1), end - 3); \
+            name##_sort3(begin + (s2 - 1), begin + s2, begin + (s2 + 1)); \
+            PDQSORT_SWAP(type, begin, begin + s2); \
+        } \
+        else \
+            name##_sort3(begin + s2, begin, end - 1); \
+        /* Nothing here is below begin[-1]; if the pivot equals it, skip the run of equal elements */ \
+        if (!leftmost && !less(*(begin - 1), *begin)) \
+        { \
+            begin = name##_part_left(begin, end) + 1; \
+            continue; \
+        } \
+        bool already; \
+        type *pivot_pos = name##_part_right(begin, end, &already); \
+        size_t l_size = pivot_pos - begin; \
+        size_t r_size = end - (pivot_pos + 1); \
+        if (l_size < size / 8 || r_size < size / 8) \
+        { \
+            if (--bad_allowed == 0) \
+            { \
+                name##_heapsort(begin, end); \
+                return; \
+            } \
+            if (l_size >= PDQSORT_INSERTION) \
+            { \
+                PDQSORT_SWAP(type, begin, begin + l_size / 4); \
+                PDQSORT_SWAP(type, pivot_pos - 1, pivot_pos - l_size / 4); \
+                if (l_size > PDQSORT_NINTHER) \
+                { \
+                    PDQSORT_SWAP(type, begin + 1, begin + (l_size / 4 + 1)); \
+                    PDQSORT_SWAP(type, begin + 2, begin + (l_size / 4 + 2)); \
+                    PDQSORT_SWAP(type, pivot_pos - 2, pivot_pos - (l_size / 4 + 1)); \
+                    PDQSORT_SWAP(type, pivot_pos - 3, pivot_pos - (l_size / 4 + 2)); \
+                } \
+            } \
+            if (r_size >= PDQSORT_INSERTION) \
+            { \
+                PDQSORT_SWAP(type, pivot_pos + 1, pivot_pos + (1 + r_size / 4)); \
+                PDQSORT_SWAP(type, end - 1, end - r_size / 4); \
+                if (r_size > PDQSORT_NINTHER) \
+                { \
+                    PDQSORT_SWAP(type, pivot_pos + 2, pivot_pos + (2 + r_size / 4)); \
+                    PDQSORT_SWAP(type, pivot_pos + 3, pivot_pos + (3 + r_size / 4)); \
+                    PDQSORT_SWAP(type, end - 2, end - (1 + r_size / 4)); \
+                    PDQSORT_SWAP(type, end - 3, end - (2 + r_size / 4)); \
+                } \
+            } \
+        } \
+        else if (already && name##_isort_partial(begin, pivot_pos) && \
+                 name##_isort_partial(pivot_pos + 1, end)) \
+            return; \
+        /* Recurse on the left; iterate on the right */ \
+        name##_loop(begin, pivot_pos, bad_allowed, leftmost); \
+        begin = pivot_pos + 1; \
+        leftmost = false; \
+    } \
+} \
+\
+static inline void name(type *data, size_t n) \
+{ \
+    int log2n = 0; \
+    if (n < 2) \
+        return; \
+    for (size_t m = n; m > 1; m >>= 1) \
+        log2n++; \
+    name##_loop(data, data + n, log2n, true); \
+}
+
+#endif /* JLSS_ID_PDQSORT_H */
@@ -0,0 +1,412 @@
+/*
+@(#)File:           radixsort.c
+@(#)Purpose:        LSD radix sorts for integers, floats and key+payload pairs; MSD for strings
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+/*
+** Grown from the 4-bit-digit demonstration in so-1947-1071/radixsort.c.
+**
+** Each numeric sort maps its element to an unsigned key whose natural
+** order is the required order (the key_xxx() functions), and then:
+** -- counts every digit of every key in one pass over the data, giving
+**    one histogram per digit position;
+** -- for each digit position whose histogram does not hold all n keys
+**    in a single bin, converts the histogram to bin offsets and
+**    scatters the data from the source to the other buffer;
+** -- copies the data back if it ended up in the scratch buffer.
+** Digits are 8 bits for arrays of fewer than RADIX_WIDE elements (so
+** the histograms stay small), and 11 bits otherwise (so a 32-bit key
+** needs at most three passes and a 64-bit key at most six).
+*/
+
+#include "posixver.h"
+#include "radixsort.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { RADIX_SMALL = 48 };          /* Use insertion sort below this */
+enum { RADIX_WIDE = 1 << 16 };      /* Use 11-bit digits from this */
+enum { RADIX_MAXBITS = 11 };
+enum { STR_SMALL = 24 };            /* Insertion sort strings below this */
+
+static inline uint32_t key_u32(uint32_t x) { return x; }
+static inline uint32_t key_i32(int32_t x) { return (uint32_t)x ^ UINT32_C(0x80000000); }
+static inline uint64_t key_u64(uint64_t x) { return x; }
+static inline uint64_t key_i64(int64_t x) { return (uint64_t)x ^ UINT64_C(0x8000000000000000); }
+static inline uint32_t key_kv32(RadixPair32 x) { return x.key; }
+static inline uint64_t key_kv64(RadixPair64 x) { return x.key; }
+
+static inline uint32_t key_flt(float x)
+{
+    uint32_t u;
+    memcpy(&u, &x, sizeof(u));
+    /* Without a branch: all ones for negative values, sign bit otherwise */
+    return u ^ ((uint32_t)-(int32_t)(u >> 31) | UINT32_C(0x80000000));
+}
+
+static inline uint64_t key_dbl(double x)
+{
+    uint64_t u;
+    memcpy(&u, &x, sizeof(u));
+    return u ^ ((uint64_t)-(int64_t)(u >> 63) | UINT64_C(0x8000000000000000));
+}
+
+/*
+** RADIX_SORT(name, Type, Key, key) defines
+**     bool name(Type *data, size_t n)
+** sorting data by key(element), an unsigned integer of type Key.
+*/
+#define RADIX_SORT(name, Type, Key, key)                                    \
+static void name##_insertion(Type *data, size_t n)                          \
+{                                                                           \
+    for (size_t i = 1; i < n; i++)                                          \
+    {                                                                       \
+        Type x = data[i];                                                   \
+        Key k = key(x);                                                     \
+        size_t j = i;                                                       \
+        while (j > 0 && key(data[j-1]) > k)                                 \
+        {                                                                   \
+            data[j] = data[j-1];                                            \
+            j--;                                                            \
+        }                                                                   \
+        data[j] = x;                                                        \
+    }                                                                       \
+}                                                                           \
+                                                                            \
+bool name(Type *data, size_t n)                                             \
+{                                                                           \
+    enum { KEYBITS = sizeof(Key) * CHAR_BIT };                              \
+    if (n < RADIX_SMALL)                                                    \
+    {                                                                       \
+        name##_insertion(data, n);                                          \
+        return true;                                                        \
+    }                                                                       \
+    const int bits = (n < RADIX_WIDE) ? 8 : RADIX_MAXBITS;                  \
+    const int npass = (KEYBITS + bits - 1) / bits;                          \
+    const size_t nbins = (size_t)1 << bits;                                 \
+    const Key mask = (Key)(nbins - 1);                                      \
+    Type *buffer = malloc(n * sizeof(Type));                                \
+    size_t *hist = calloc((size_t)npass << bits, sizeof(size_t));           \
+    if (buffer == 0 || hist == 0)                                           \
+    {                                                                       \
+        free(buffer);                                                       \
+        free(hist);                                                         \
+        return false;                                                       \
+    }                                                                       \
+                                                                            \
+    /* One pass to count every digit */                                     \
+    for (size_t i = 0; i < n; i++)                                          \
+    {                                                                       \
+        Key k = key(data[i]);                                               \
+        for (int p = 0; p < npass; p++)                                     \
+            hist[((size_t)p << bits) + ((k >> (p * bits)) & mask)]++;       \
+    }                                                                       \
+                                                                            \
+    Type *src = data;                                                       \
+    Type *dst = buffer;                                                     \
+    const Key first = key(data[0]);                                         \
+    for (int p = 0; p < npass; p++)                                         \
+    {                                                                       \
+        size_t *count = &hist[(size_t)p << bits];                           \
+        int shift = p * bits;                                               \
+        if (count[(first >> shift) & mask] == n)                            \
+            continue;           /* Every key has the same digit */          \
+        size_t offset = 0;                                                  \
+        for (size_t b = 0; b < nbins; b++)                                  \
+        {                                                                   \
+            size_t c = count[b];                                            \
+            count[b] = offset;                                              \
+            offset += c;                                                    \
+        }                                                                   \
+        for (size_t i = 0; i < n; i++)                                      \
+        {                                                                   \
+            Type x = src[i];                                                \
+            dst[count[(key(x) >> shift) & mask]++] = x;                     \
+        }                                                                   \
+        Type *t = src;                                                      \
+        src = dst;                                                          \
+        dst = t;                                                            \
+    }                                                                       \
+    if (src != data)                                                        \
+        memcpy(data, src, n * sizeof(Type));                                \
+    free(hist);                                                             \
+    free(buffer);                                                           \
+    return true;                                                            \
+}
+
+RADIX_SORT(radix_sort_u32,  uint32_t,    uint32_t, key_u32)
+RADIX_SORT(radix_sort_i32,  int32_t,     uint32_t, key_i32)
+RADIX_SORT(radix_sort_u64,  uint64_t,    uint64_t, key_u64)
+RADIX_SORT(radix_sort_i64,  int64_t,     uint64_t, key_i64)
+RADIX_SORT(radix_sort_flt,  float,       uint32_t, key_flt)
+RADIX_SORT(radix_sort_dbl,  double,      uint64_t, key_dbl)
+RADIX_SORT(radix_sort_kv32, RadixPair32, uint32_t, key_kv32)
+RADIX_SORT(radix_sort_kv64, RadixPair64, uint64_t, key_kv64)
+
+/*
+** MSD radix sort of strings (after McIlroy, Bostic and McIlroy,
+** "Engineering Radix Sort", with Kärkkäinen and Rantala's cached
+** characters).  The character at the current depth of each string is
+** read once into the byte array, then the pointers are distributed
+** into the scratch array and copied back.  Strings that end at this
+** depth (bin 0) are equal and finished.  Each other bin is sorted at
+** the next depth; the largest bin is handled by the loop rather than
+** by recursion, so the recursion depth is at most log2(n), and a
+** depth where every string has the same character costs one counting
+** pass and no distribution.
+*/
+
+static void str_insertion(char **data, size_t n, size_t depth)
+{
+    for (size_t i = 1; i < n; i++)
+    {
+        char *x = data[i];
+        size_t j = i;
+        while (j > 0 && strcmp(data[j-1] + depth, x + depth) > 0)
+        {
+            data[j] = data[j-1];
+            j--;
+        }
+        data[j] = x;
+    }
+}
+
+static void str_msd(char **data, char **buffer, unsigned char *chars,
+                    size_t n, size_t depth)
+{
+    while (n >= STR_SMALL)
+    {
+        size_t count[UCHAR_MAX + 1] = { 0 };
+        size_t start[UCHAR_MAX + 1];
+
+        for (size_t i = 0; i < n; i++)
+        {
+            chars[i] = (unsigned char)data[i][depth];
+            count[chars[i]]++;
+        }
+        if (count[chars[0]] == n)
+        {
+            /* Every string has the same character here */
+            if (chars[0] == '\0')
+                return;
+            depth++;
+            continue;
+        }
+
+        size_t offset = 0;
+        size_t big = 1;
+        for (size_t b = 0; b <= UCHAR_MAX; b++)
+        {
+            start[b] = offset;
+            offset += count[b];
+            if (b > 0 && count[b] > count[big])
+                big = b;
+        }
+        for (size_t i = 0; i < n; i++)
+            buffer[start[chars[i]]++] = data[i];
+        memcpy(data, buffer, n * sizeof(char *));
+
+        /* start[b] is now the end of bin b */
+        for (size_t b = 1; b <= UCHAR_MAX; b++)
+        {
+            if (b != big && count[b] > 1)
+                str_msd(data + start[b] - count[b], buffer, chars, count[b], depth + 1);
+        }
+        data += start[big] - count[big];
+        n = count[big];
+        depth++;
+    }
+    str_insertion(data, n, depth);
+}
+
+bool radix_sort_str(char **data, size_t n)
+{
+    if (n < STR_SMALL)
+    {
+        str_insertion(data, n, 0);
+        return true;
+    }
+    char **buffer = malloc(n * sizeof(char *));
+    unsigned char *chars = malloc(n);
+    if (buffer == 0 || chars == 0)
+    {
+        free(buffer);
+        free(chars);
+        return false;
+    }
+    str_msd(data, buffer, chars, n, 0);
+    free(chars);
+    free(buffer);
+    return true;
+}
+
+#ifdef TEST
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "timer.h"
+#include "xorshift.h"
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rng(void)
+{
+    return xorshift64star(&rng_state);
+}
+
+#define CMP_FUNC(name, Type)                                                \
+static int name(const void *p1, const void *p2)                             \
+{                                                                           \
+    Type v1 = *(const Type *)p1;                                            \
+    Type v2 = *(const Type *)p2;                                            \
+    return (v1 > v2) - (v1 < v2);                                           \
+}
+
+CMP_FUNC(cmp_u32, uint32_t)
+CMP_FUNC(cmp_i32, int32_t)
+CMP_FUNC(cmp_u64, uint64_t)
+CMP_FUNC(cmp_i64, int64_t)
+CMP_FUNC(cmp_flt, float)
+CMP_FUNC(cmp_dbl, double)
+
+static int cmp_str(const void *p1, const void *p2)
+{
+    return strcmp(*(char * const *)p1, *(char * const *)p2);
+}
+
+static int failures = 0;
+
+static void report(const char *name, size_t n, int ok, double t_radix, double t_qsort)
+{
+    if (!ok)
+        failures++;
+    printf("%-8s n=%-8zu %s  radix %9.3f ms  qsort %9.3f ms\n",
+           name, n, ok ? "OK  " : "FAIL", t_radix, t_qsort);
+}
+
+static double elapsed_ms(Clock *clk)
+{
+    return clk_elapsed_nsec(clk) / 1.0E6;
+}
+
+/*
+** Sort a copy of the data with the radix sort and another with qsort()
+** and compare the results byte for byte (the numeric data contains no
+** NaNs and no negative zeros, so the orders must agree exactly).
+*/
+#define TEST_FUNC(name, Type, radix, cmp, fill)                             \
+static void name(size_t n)                                                  \
+{                                                                           \
+    Type *a = malloc(n * sizeof(Type) + 1);                                 \
+    Type *b = malloc(n * sizeof(Type) + 1);                                 \
+    Clock clk;                                                              \
+    for (size_t i = 0; i < n; i++)                                          \
+        a[i] = fill;                                                        \
+    memcpy(b, a, n * sizeof(Type));                                         \
+    clk_init(&clk);                                                         \
+    clk_start(&clk);                                                        \
+    int ok = radix(a, n);                                                   \
+    clk_stop(&clk);                                                         \
+    double t1 = elapsed_ms(&clk);                                           \
+    clk_start(&clk);                                                        \
+    qsort(b, n, sizeof(Type), cmp);                                         \
+    clk_stop(&clk);                                                         \
+    ok = ok && memcmp(a, b, n * sizeof(Type)) == 0;                         \
+    report(#Type, n, ok, t1, elapsed_ms(&clk));                             \
+    free(a);                                                                \
+    free(b);                                                                \
+}
+
+TEST_FUNC(test_u32, uint32_t, radix_sort_u32, cmp_u32, (uint32_t)rng())
+TEST_FUNC(test_i32, int32_t,  radix_sort_i32, cmp_i32, (int32_t)rng())
+TEST_FUNC(test_u64, uint64_t, radix_sort_u64, cmp_u64, rng())
+TEST_FUNC(test_i64, int64_t,  radix_sort_i64, cmp_i64, (int64_t)rng())
+TEST_FUNC(test_flt, float,    radix_sort_flt, cmp_flt, ((int32_t)rng() | 1) / 65536.0F)
+TEST_FUNC(test_dbl, double,   radix_sort_dbl, cmp_dbl, ((int64_t)rng() | 1) / 4096.0)
+TEST_FUNC(test_small, uint32_t, radix_sort_u32, cmp_u32, (uint32_t)(rng() % 1000))
+
+/* Stability: pairs with equal keys keep their original order */
+static void test_kv(size_t n)
+{
+    RadixPair32 *a = malloc(n * sizeof(*a) + 1);
+    RadixPair64 *b = malloc(n * sizeof(*b) + 1);
+    int ok = 1;
+    for (size_t i = 0; i < n; i++)
+    {
+        a[i] = (RadixPair32){ (uint32_t)(rng() % 100), (uint32_t)i };
+        b[i] = (RadixPair64){ rng() % 100 << 40, i };
+    }
+    ok = radix_sort_kv32(a, n) && radix_sort_kv64(b, n);
+    for (size_t i = 1; ok && i < n; i++)
+    {
+        if (a[i-1].key > a[i].key || (a[i-1].key == a[i].key && a[i-1].value > a[i].value))
+            ok = 0;
+        if (b[i-1].key > b[i].key || (b[i-1].key == b[i].key && b[i-1].value > b[i].value))
+            ok = 0;
+    }
+    report("pairs", n, ok, 0.0, 0.0);
+    free(a);
+    free(b);
+}
+
+/* Strings with long common prefixes and duplicates */
+static void test_str(size_t n)
+{
+    char **a = malloc(n * sizeof(char *) + 1);
+    char **b = malloc(n * sizeof(char *) + 1);
+    Clock clk;
+    for (size_t i = 0; i < n; i++)
+    {
+        char buffer[64];
+        uint64_t r = rng();
+        snprintf(buffer, sizeof(buffer), "%s%" PRIu64,
+                 (r & 1) ? "common/prefix/" : "", (r >> 1) % (n + 1));
+        a[i] = malloc(strlen(buffer) + 1);
+        strcpy(a[i], buffer);
+    }
+    memcpy(b, a, n * sizeof(char *));
+    clk_init(&clk);
+    clk_start(&clk);
+    int ok = radix_sort_str(a, n);
+    clk_stop(&clk);
+    double t1 = elapsed_ms(&clk);
+    clk_start(&clk);
+    qsort(b, n, sizeof(char *), cmp_str);
+    clk_stop(&clk);
+    for (size_t i = 0; ok && i < n; i++)
+        ok = strcmp(a[i], b[i]) == 0;
+    report("string", n, ok, t1, elapsed_ms(&clk));
+    for (size_t i = 0; i < n; i++)
+        free(a[i]);
+    free(a);
+    free(b);
+}
+
+int main(void)
+{
+    static const size_t sizes[] = { 0, 1, 2, 47, 48, 1000, 65535, 65536, 1000000 };
+    enum { NUM_SIZES = sizeof(sizes) / sizeof(sizes[0]) };
+
+    for (int i = 0; i < NUM_SIZES; i++)
+    {
+        size_t n = sizes[i];
+        test_u32(n);
+        test_i32(n);
+        test_u64(n);
+        test_i64(n);
+        test_flt(n);
+        test_dbl(n);
+        test_small(n);
+        test_kv(n);
+        test_str(n);
+    }
+    printf("%s\n", failures == 0 ? "== PASS ==" : "== FAIL ==");
+    return(failures != 0);
+}
+
+#endif /* TEST */
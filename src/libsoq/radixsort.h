@@ -0,0 +1,68 @@
+/*
+@(#)File:           radixsort.h
+@(#)Purpose:        LSD radix sorts for integers, floats and key+payload pairs; MSD for strings
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#ifndef JLSS_ID_RADIXSORT_H
+#define JLSS_ID_RADIXSORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>    /* bool */
+#include <stddef.h>     /* size_t */
+#include <stdint.h>     /* uint32_t etc */
+
+/*
+** The numeric sorts are stable least-significant-digit radix sorts.
+** They use 8-bit digits for small arrays and 11-bit digits for large
+** ones, count all the digits in a single pass over the data, and skip
+** any pass in which every key has the same digit (so, for example,
+** sorting small non-negative numbers takes only one or two passes).
+** Signed integers are sorted by flipping the sign bit; floating point
+** numbers by flipping the sign bit of positive values and all the bits
+** of negative values, which gives -NaN < -Inf < ... < -0.0 < +0.0 < ...
+** < +Inf < +NaN.  The pair sorts order by key and keep pairs with equal
+** keys in their original order.
+**
+** radix_sort_str() is a most-significant-digit radix sort of strings
+** into strcmp() order.  It sorts the pointers, not the strings.
+**
+** All the sorts need scratch space of the same size as the array (plus
+** a byte per string for radix_sort_str()); they return false, leaving
+** the data unsorted, if they cannot allocate it.  Small arrays are
+** sorted by insertion sort without any allocation.
+*/
+
+typedef struct RadixPair32
+{
+    uint32_t    key;
+    uint32_t    value;
+} RadixPair32;
+
+typedef struct RadixPair64
+{
+    uint64_t    key;
+    uint64_t    value;
+} RadixPair64;
+
+extern bool radix_sort_u32(uint32_t *data, size_t n);
+extern bool radix_sort_i32(int32_t *data, size_t n);
+extern bool radix_sort_u64(uint64_t *data, size_t n);
+extern bool radix_sort_i64(int64_t *data, size_t n);
+extern bool radix_sort_flt(float *data, size_t n);
+extern bool radix_sort_dbl(double *data, size_t n);
+extern bool radix_sort_kv32(RadixPair32 *data, size_t n);
+extern bool radix_sort_kv64(RadixPair64 *data, size_t n);
+extern bool radix_sort_str(char **data, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JLSS_ID_RADIXSORT_H */
@@ -0,0 +1,726 @@
+/*
+@(#)File:           sortnet.c
+@(#)Purpose:        Vectorised sorting networks and merge kernels for small arrays
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+/*
+** The scalar networks elsewhere (so-4929-0953/sortnet3-89.c and
+** so-3442-6337/batcher-sort.c) do one compare-exchange at a time.  Here
+** a vector register holds W elements (8 for AVX2, 4 for SSE4.1), and one
+** min and one max sort W pairs at once.
+**
+** The network is Batcher's bitonic sort in the form that needs no
+** descending comparators: to merge two sorted blocks of size k/2 into
+** one of size k, element i is first compared with element i ^ (k-1)
+** (the first block against the second block reversed), and then with
+** i ^ j for j = k/4, ..., 1.  With elements numbered r*W + lane:
+**  - for k <= W, every comparison is inside a register: permute the
+**    register to bring the partners together, take min and max, and
+**    blend them so the lower lane of each pair gets the min (sort_reg
+**    and clean_reg below);
+**  - for j >= W, register r is compared whole with register r ^ (j/W);
+**  - the i ^ (k-1) step for k > W compares register r with register
+**    r ^ (k/W - 1) reversed.
+** Merging two sorted registers is the last stage on its own: min and
+** max of one register and the other reversed, then clean_reg on each.
+**
+** Each instruction set gets its own copy of the code, compiled with a
+** target attribute so that the library itself needs no -mavx2 or
+** -msse4.1; the one to use is chosen from what the CPU reports.
+*/
+
+#include "posixver.h"
+#include "sortnet.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SORTNET_X86
+#include <immintrin.h>
+#endif
+
+static void insertion_i32(int32_t *data, size_t n)
+{
+    for (size_t i = 1; i < n; i++)
+    {
+        int32_t x = data[i];
+        size_t j = i;
+        while (j > 0 && data[j-1] > x)
+        {
+            data[j] = data[j-1];
+            j--;
+        }
+        data[j] = x;
+    }
+}
+
+static void insertion_flt(float *data, size_t n)
+{
+    for (size_t i = 1; i < n; i++)
+    {
+        float x = data[i];
+        size_t j = i;
+        while (j > 0 && data[j-1] > x)
+        {
+            data[j] = data[j-1];
+            j--;
+        }
+        data[j] = x;
+    }
+}
+
+/* Merge up to three sorted lists (the first has nt elements) */
+#define MERGE3(name, Type)                                                  \
+static void name(const Type *t, size_t nt, const Type *a, size_t na,       \
+                 const Type *b, size_t nb, Type *out)                       \
+{                                                                           \
+    while (nt + na + nb > 0)                                                \
+    {                                                                       \
+        if (nt > 0 && (na == 0 || *t <= *a) && (nb == 0 || *t <= *b))      \
+            *out++ = *t++, nt--;                                            \
+        else if (na > 0 && (nb == 0 || *a <= *b))                           \
+            *out++ = *a++, na--;                                            \
+        else                                                                \
+            *out++ = *b++, nb--;                                            \
+    }                                                                       \
+}
+
+MERGE3(merge3_i32, int32_t)
+MERGE3(merge3_flt, float)
+
+#ifdef SORTNET_X86
+
+#define AVX2 __attribute__((target("avx2")))
+#define SSE4 __attribute__((target("sse4.1")))
+
+/* Compare lanes with partners given by perm; lanes in mask take the max */
+#define STEP(v, perm, mask, min, max, blend) \
+    do { __typeof__(v) p_ = perm; v = blend(min(v, p_), max(v, p_), mask); } while (0)
+
+/* AVX2, 8 x int32_t */
+static inline AVX2 __m256i avx2_i32_rev(__m256i v)
+{
+    return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+#define AVX2_I32_STEP(v, perm, mask) \
+    STEP(v, perm, mask, _mm256_min_epi32, _mm256_max_epi32, _mm256_blend_epi32)
+static inline AVX2 __m256i avx2_i32_clean_reg(__m256i v)
+{
+    AVX2_I32_STEP(v, _mm256_permute4x64_epi64(v, _MM_SHUFFLE(1, 0, 3, 2)), 0xF0);
+    AVX2_I32_STEP(v, _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)), 0xCC);
+    AVX2_I32_STEP(v, _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)), 0xAA);
+    return v;
+}
+static inline AVX2 __m256i avx2_i32_sort_reg(__m256i v)
+{
+    AVX2_I32_STEP(v, _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)), 0xAA);
+    AVX2_I32_STEP(v, _mm256_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3)), 0xCC);
+    AVX2_I32_STEP(v, _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)), 0xAA);
+    AVX2_I32_STEP(v, avx2_i32_rev(v), 0xF0);
+    AVX2_I32_STEP(v, _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)), 0xCC);
+    AVX2_I32_STEP(v, _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)), 0xAA);
+    return v;
+}
+static inline AVX2 __m256i avx2_i32_min(__m256i a, __m256i b) { return _mm256_min_epi32(a, b); }
+static inline AVX2 __m256i avx2_i32_max(__m256i a, __m256i b) { return _mm256_max_epi32(a, b); }
+static inline AVX2 __m256i avx2_i32_load(const int32_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+static inline AVX2 void avx2_i32_store(int32_t *p, __m256i v) { _mm256_storeu_si256((__m256i *)p, v); }
+static inline AVX2 __m256i avx2_i32_fill(void) { return _mm256_set1_epi32(INT32_MAX); }
+static inline AVX2 __m256i avx2_mask(size_t rest)
+{
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32((int)rest), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+/*
+** A masked load avoids the store-forwarding stall of loading a vector
+** from a buffer just written piecemeal; masked stores are slow on some
+** CPUs, so the tail is stored through a buffer.
+*/
+static inline AVX2 __m256i avx2_i32_load_part(const int32_t *p, size_t rest)
+{
+    __m256i m = avx2_mask(rest);
+    return _mm256_blendv_epi8(avx2_i32_fill(), _mm256_maskload_epi32((const int *)p, m), m);
+}
+static inline AVX2 void avx2_i32_store_part(int32_t *p, __m256i v, size_t rest)
+{
+    int32_t part[8];
+    avx2_i32_store(part, v);
+    memcpy(p, part, rest * sizeof(*p));
+}
+
+/*
+** AVX2, 8 x float.  The registers hold the floats with the bits of
+** negative values other than the sign flipped, which orders them as
+** int32_t (-0.0 just below +0.0), and they are compared with the int32_t
+** min and max.  The float min and max return their second operand when
+** the operands compare equal, so -0.0 and +0.0 could each end up as two
+** copies of the other.  The mapping is its own inverse.
+*/
+static inline AVX2 __m256 avx2_flt_key(__m256 v)
+{
+    __m256i x = _mm256_castps_si256(v);
+    return _mm256_castsi256_ps(_mm256_xor_si256(x, _mm256_srli_epi32(_mm256_srai_epi32(x, 31), 1)));
+}
+static inline AVX2 __m256 avx2_flt_min(__m256 a, __m256 b)
+{
+    return _mm256_castsi256_ps(_mm256_min_epi32(_mm256_castps_si256(a), _mm256_castps_si256(b)));
+}
+static inline AVX2 __m256 avx2_flt_max(__m256 a, __m256 b)
+{
+    return _mm256_castsi256_ps(_mm256_max_epi32(_mm256_castps_si256(a), _mm256_castps_si256(b)));
+}
+static inline AVX2 __m256 avx2_flt_rev(__m256 v)
+{
+    return _mm256_permutevar8x32_ps(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+#define AVX2_FLT_STEP(v, perm, mask) \
+    STEP(v, perm, mask, avx2_flt_min, avx2_flt_max, _mm256_blend_ps)
+static inline AVX2 __m256 avx2_flt_clean_reg(__m256 v)
+{
+    AVX2_FLT_STEP(v, _mm256_permute2f128_ps(v, v, 0x01), 0xF0);
+    AVX2_FLT_STEP(v, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)), 0xCC);
+    AVX2_FLT_STEP(v, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)), 0xAA);
+    return v;
+}
+static inline AVX2 __m256 avx2_flt_sort_reg(__m256 v)
+{
+    AVX2_FLT_STEP(v, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)), 0xAA);
+    AVX2_FLT_STEP(v, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3)), 0xCC);
+    AVX2_FLT_STEP(v, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)), 0xAA);
+    AVX2_FLT_STEP(v, avx2_flt_rev(v), 0xF0);
+    AVX2_FLT_STEP(v, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)), 0xCC);
+    AVX2_FLT_STEP(v, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)), 0xAA);
+    return v;
+}
+static inline AVX2 __m256 avx2_flt_load(const float *p) { return avx2_flt_key(_mm256_loadu_ps(p)); }
+static inline AVX2 void avx2_flt_store(float *p, __m256 v) { _mm256_storeu_ps(p, avx2_flt_key(v)); }
+static inline AVX2 __m256 avx2_flt_fill(void) { return _mm256_castsi256_ps(_mm256_set1_epi32(INT32_MAX)); }
+static inline AVX2 __m256 avx2_flt_load_part(const float *p, size_t rest)
+{
+    __m256i m = avx2_mask(rest);
+    return _mm256_blendv_ps(avx2_flt_fill(), avx2_flt_key(_mm256_maskload_ps(p, m)), _mm256_castsi256_ps(m));
+}
+static inline AVX2 void avx2_flt_store_part(float *p, __m256 v, size_t rest)
+{
+    float part[8];
+    avx2_flt_store(part, v);
+    memcpy(p, part, rest * sizeof(*p));
+}
+
+/* SSE4.1, 4 x int32_t; _mm_blend_epi16 masks count 16-bit lanes */
+static inline SSE4 __m128i sse4_i32_rev(__m128i v)
+{
+    return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+#define SSE4_I32_STEP(v, perm, mask) \
+    STEP(v, perm, mask, _mm_min_epi32, _mm_max_epi32, _mm_blend_epi16)
+static inline SSE4 __m128i sse4_i32_clean_reg(__m128i v)
+{
+    SSE4_I32_STEP(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)), 0xF0);
+    SSE4_I32_STEP(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)), 0xCC);
+    return v;
+}
+static inline SSE4 __m128i sse4_i32_sort_reg(__m128i v)
+{
+    SSE4_I32_STEP(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)), 0xCC);
+    SSE4_I32_STEP(v, sse4_i32_rev(v), 0xF0);
+    SSE4_I32_STEP(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)), 0xCC);
+    return v;
+}
+static inline SSE4 __m128i sse4_i32_min(__m128i a, __m128i b) { return _mm_min_epi32(a, b); }
+static inline SSE4 __m128i sse4_i32_max(__m128i a, __m128i b) { return _mm_max_epi32(a, b); }
+static inline SSE4 __m128i sse4_i32_load(const int32_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+static inline SSE4 void sse4_i32_store(int32_t *p, __m128i v) { _mm_storeu_si128((__m128i *)p, v); }
+static inline SSE4 __m128i sse4_i32_fill(void) { return _mm_set1_epi32(INT32_MAX); }
+static inline SSE4 __m128i sse4_i32_load_part(const int32_t *p, size_t rest)
+{
+    int32_t part[4] = { INT32_MAX, INT32_MAX, INT32_MAX, INT32_MAX };
+    memcpy(part, p, rest * sizeof(*p));
+    return sse4_i32_load(part);
+}
+static inline SSE4 void sse4_i32_store_part(int32_t *p, __m128i v, size_t rest)
+{
+    int32_t part[4];
+    sse4_i32_store(part, v);
+    memcpy(p, part, rest * sizeof(*p));
+}
+
+/* SSE4.1, 4 x float, held and compared as for AVX2 */
+static inline SSE4 __m128 sse4_flt_key(__m128 v)
+{
+    __m128i x = _mm_castps_si128(v);
+    return _mm_castsi128_ps(_mm_xor_si128(x, _mm_srli_epi32(_mm_srai_epi32(x, 31), 1)));
+}
+static inline SSE4 __m128 sse4_flt_min(__m128 a, __m128 b)
+{
+    return _mm_castsi128_ps(_mm_min_epi32(_mm_castps_si128(a), _mm_castps_si128(b)));
+}
+static inline SSE4 __m128 sse4_flt_max(__m128 a, __m128 b)
+{
+    return _mm_castsi128_ps(_mm_max_epi32(_mm_castps_si128(a), _mm_castps_si128(b)));
+}
+static inline SSE4 __m128 sse4_flt_rev(__m128 v)
+{
+    return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+#define SSE4_FLT_STEP(v, perm, mask) \
+    STEP(v, perm, mask, sse4_flt_min, sse4_flt_max, _mm_blend_ps)
+static inline SSE4 __m128 sse4_flt_clean_reg(__m128 v)
+{
+    SSE4_FLT_STEP(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)), 0xC);
+    SSE4_FLT_STEP(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)), 0xA);
+    return v;
+}
+static inline SSE4 __m128 sse4_flt_sort_reg(__m128 v)
+{
+    SSE4_FLT_STEP(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)), 0xA);
+    SSE4_FLT_STEP(v, sse4_flt_rev(v), 0xC);
+    SSE4_FLT_STEP(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)), 0xA);
+    return v;
+}
+static inline SSE4 __m128 sse4_flt_load(const float *p) { return sse4_flt_key(_mm_loadu_ps(p)); }
+static inline SSE4 void sse4_flt_store(float *p, __m128 v) { _mm_storeu_ps(p, sse4_flt_key(v)); }
+static inline SSE4 __m128 sse4_flt_fill(void) { return _mm_castsi128_ps(_mm_set1_epi32(INT32_MAX)); }
+static inline SSE4 __m128 sse4_flt_load_part(const float *p, size_t rest)
+{
+    float part[4] = { INFINITY, INFINITY, INFINITY, INFINITY };
+    memcpy(part, p, rest * sizeof(*p));
+    return sse4_flt_load(part);
+}
+static inline SSE4 void sse4_flt_store_part(float *p, __m128 v, size_t rest)
+{
+    float part[4];
+    sse4_flt_store(part, v);
+    memcpy(p, part, rest * sizeof(*p));
+}
+
+/*
+** SORTNET_KERNELS(pfx, Type, V, W, ATTR) defines, from the primitives
+** pfx_xxx() above,
+**     void pfx_sort(Type *data, size_t n)      n <= SORTNET_MAX
+**     void pfx_merge(a, na, b, nb, out)
+*/
+#define SORTNET_KERNELS(pfx, Type, V, W, ATTR, merge3)                      \
+static inline ATTR void pfx##_network(V *v, int R)                          \
+{                                                                           \
+    for (int r = 0; r < R; r++)                                             \
+        v[r] = pfx##_sort_reg(v[r]);                                        \
+    for (int kr = 2; kr <= R; kr *= 2)                                      \
+    {                                                                       \
+        for (int r = 0; r < R; r++)                                         \
+        {                                                                   \
+            int p = r ^ (kr - 1);                                           \
+            if (p > r)                                                      \
+            {                                                               \
+                V b = pfx##_rev(v[p]);                                      \
+                V lo = pfx##_min(v[r], b);                                  \
+                v[p] = pfx##_rev(pfx##_max(v[r], b));                       \
+                v[r] = lo;                                                  \
+            }                                                               \
+        }                                                                   \
+        for (int jr = kr / 4; jr >= 1; jr /= 2)                             \
+        {                                                                   \
+            for (int r = 0; r < R; r++)                                     \
+            {                                                               \
+                int p = r ^ jr;                                             \
+                if (p > r)                                                  \
+                {                                                           \
+                    V lo = pfx##_min(v[r], v[p]);                           \
+                    v[p] = pfx##_max(v[r], v[p]);                           \
+                    v[r] = lo;                                              \
+                }                                                           \
+            }                                                               \
+        }                                                                   \
+        for (int r = 0; r < R; r++)                                         \
+            v[r] = pfx##_clean_reg(v[r]);                                   \
+    }                                                                       \
+}                                                                           \
+                                                                            \
+static ATTR void pfx##_sort(Type *data, size_t n)                           \
+{                                                                           \
+    V v[SORTNET_MAX / W];                                                   \
+    size_t full = n / W;                                                    \
+    size_t rest = n % W;                                                    \
+    size_t used = full + (rest != 0);                                       \
+    size_t R = 1;                                                           \
+    while (R < used)                                                        \
+        R *= 2;                                                             \
+    for (size_t r = 0; r < full; r++)                                       \
+        v[r] = pfx##_load(data + r * W);                                    \
+    if (rest != 0)                                                          \
+        v[full] = pfx##_load_part(data + full * W, rest);                   \
+    for (size_t r = used; r < R; r++)                                       \
+        v[r] = pfx##_fill();                                                \
+    /* Constant register counts, so each case is unrolled */               \
+    switch (R)                                                              \
+    {                                                                       \
+    case 1:  pfx##_network(v, 1);  break;                                   \
+    case 2:  pfx##_network(v, 2);  break;                                   \
+    case 4:  pfx##_network(v, 4);  break;                                   \
+    case 8:  pfx##_network(v, 8);  break;                                   \
+    default: pfx##_network(v, SORTNET_MAX / W); break;                      \
+    }                                                                       \
+    for (size_t r = 0; r < full; r++)                                       \
+        pfx##_store(data + r * W, v[r]);                                    \
+    if (rest != 0)                                                          \
+        pfx##_store_part(data + full * W, v[full], rest);                   \
+}                                                                           \
+                                                                            \
+static inline ATTR void pfx##_merge_regs(V *a, V *b)                        \
+{                                                                           \
+    V rb = pfx##_rev(*b);                                                   \
+    V lo = pfx##_min(*a, rb);                                               \
+    V hi = pfx##_max(*a, rb);                                               \
+    *a = pfx##_clean_reg(lo);                                               \
+    *b = pfx##_clean_reg(hi);                                               \
+}                                                                           \
+                                                                            \
+/* vb always holds the W largest elements seen that are not yet output */ \
+static ATTR void pfx##_merge(const Type *a, size_t na, const Type *b,      \
+                             size_t nb, Type *out)                          \
+{                                                                           \
+    Type tail[W];                                                           \
+    if (na < W || nb < W)                                                   \
+    {                                                                       \
+        merge3(a, 0, a, na, b, nb, out);                                    \
+        return;                                                             \
+    }                                                                       \
+    V va = pfx##_load(a);                                                   \
+    V vb = pfx##_load(b);                                                   \
+    a += W, na -= W;                                                        \
+    b += W, nb -= W;                                                        \
+    pfx##_merge_regs(&va, &vb);                                             \
+    pfx##_store(out, va);                                                   \
+    out += W;                                                               \
+    while (na >= W && nb >= W)                                              \
+    {                                                                       \
+        if (*a <= *b)                                                       \
+        {                                                                   \
+            va = pfx##_load(a);                                             \
+            a += W, na -= W;                                                \
+        }                                                                   \
+        else                                                                \
+        {                                                                   \
+            va = pfx##_load(b);                                             \
+            b += W, nb -= W;                                                \
+        }                                                                   \
+        pfx##_merge_regs(&va, &vb);                                         \
+        pfx##_store(out, va);                                               \
+        out += W;                                                           \
+    }                                                                       \
+    pfx##_store(tail, vb);                                                  \
+    merge3(tail, W, a, na, b, nb, out);                                     \
+}
+
+SORTNET_KERNELS(avx2_i32, int32_t, __m256i, 8, AVX2, merge3_i32)
+SORTNET_KERNELS(avx2_flt, float,   __m256,  8, AVX2, merge3_flt)
+SORTNET_KERNELS(sse4_i32, int32_t, __m128i, 4, SSE4, merge3_i32)
+SORTNET_KERNELS(sse4_flt, float,   __m128,  4, SSE4, merge3_flt)
+
+static inline int have_avx2(void) { return __builtin_cpu_supports("avx2"); }
+static inline int have_sse4(void) { return __builtin_cpu_supports("sse4.1"); }
+
+#else
+
+static inline int have_avx2(void) { return 0; }
+static inline int have_sse4(void) { return 0; }
+#define avx2_i32_sort(d, n)     insertion_i32(d, n)
+#define avx2_flt_sort(d, n)     insertion_flt(d, n)
+#define sse4_i32_sort(d, n)     insertion_i32(d, n)
+#define sse4_flt_sort(d, n)     insertion_flt(d, n)
+#define avx2_i32_merge(a, na, b, nb, o) merge3_i32(0, 0, a, na, b, nb, o)
+#define avx2_flt_merge(a, na, b, nb, o) merge3_flt(0, 0, a, na, b, nb, o)
+#define sse4_i32_merge(a, na, b, nb, o) merge3_i32(0, 0, a, na, b, nb, o)
+#define sse4_flt_merge(a, na, b, nb, o) merge3_flt(0, 0, a, na, b, nb, o)
+
+#endif /* SORTNET_X86 */
+
+bool sortnet_i32(int32_t *data, size_t n)
+{
+    if (n > SORTNET_MAX)
+        return false;
+    if (n < 2)
+        return true;
+    if (have_avx2())
+        avx2_i32_sort(data, n);
+    else if (have_sse4())
+        sse4_i32_sort(data, n);
+    else
+        insertion_i32(data, n);
+    return true;
+}
+
+bool sortnet_flt(float *data, size_t n)
+{
+    if (n > SORTNET_MAX)
+        return false;
+    if (n < 2)
+        return true;
+    if (have_avx2())
+        avx2_flt_sort(data, n);
+    else if (have_sse4())
+        sse4_flt_sort(data, n);
+    else
+        insertion_flt(data, n);
+    return true;
+}
+
+void sortnet_merge_i32(const int32_t *a, size_t na, const int32_t *b, size_t nb, int32_t *out)
+{
+    if (have_avx2())
+        avx2_i32_merge(a, na, b, nb, out);
+    else if (have_sse4())
+        sse4_i32_merge(a, na, b, nb, out);
+    else
+        merge3_i32(0, 0, a, na, b, nb, out);
+}
+
+void sortnet_merge_flt(const float *a, size_t na, const float *b, size_t nb, float *out)
+{
+    if (have_avx2())
+        avx2_flt_merge(a, na, b, nb, out);
+    else if (have_sse4())
+        sse4_flt_merge(a, na, b, nb, out);
+    else
+        merge3_flt(0, 0, a, na, b, nb, out);
+}
+
+const char *sortnet_isa(void)
+{
+    if (have_avx2())
+        return "avx2";
+    if (have_sse4())
+        return "sse4.1";
+    return "scalar";
+}
+
+#ifdef TEST
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "timer.h"
+#include "xorshift.h"
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rng(void)
+{
+    return xorshift64star(&rng_state);
+}
+
+static int cmp_i32(const void *p1, const void *p2)
+{
+    int32_t v1 = *(const int32_t *)p1;
+    int32_t v2 = *(const int32_t *)p2;
+    return (v1 > v2) - (v1 < v2);
+}
+
+static int cmp_flt(const void *p1, const void *p2)
+{
+    float v1 = *(const float *)p1;
+    float v2 = *(const float *)p2;
+    return (v1 > v2) - (v1 < v2);
+}
+
+static int failures = 0;
+
+typedef void (*SortI32)(int32_t *data, size_t n);
+typedef void (*SortFlt)(float *data, size_t n);
+typedef void (*MergeI32)(const int32_t *a, size_t na, const int32_t *b, size_t nb, int32_t *out);
+typedef void (*MergeFlt)(const float *a, size_t na, const float *b, size_t nb, float *out);
+
+/* Every size from 0 to SORTNET_MAX, random data and data with ties */
+static void test_sort(const char *isa, SortI32 sort_i32, SortFlt sort_flt)
+{
+    int bad = 0;
+    for (size_t n = 0; n <= SORTNET_MAX; n++)
+    {
+        for (int trial = 0; trial < 200; trial++)
+        {
+            int32_t a[SORTNET_MAX] = { 0 }, b[SORTNET_MAX];
+            float x[SORTNET_MAX] = { 0 }, y[SORTNET_MAX];
+            uint64_t mod = (trial % 2) ? 5 : UINT64_MAX;
+            for (size_t i = 0; i < n; i++)
+            {
+                uint64_t r = rng();
+                a[i] = (trial % 4 == 3) ? INT32_MAX - (int32_t)(r % 3) : (int32_t)(r % mod);
+                x[i] = (float)(int32_t)(r % mod) / 1024.0F;
+            }
+            memcpy(b, a, sizeof(a));
+            memcpy(y, x, sizeof(x));
+            (*sort_i32)(a, n);
+            (*sort_flt)(x, n);
+            qsort(b, n, sizeof(b[0]), cmp_i32);
+            qsort(y, n, sizeof(y[0]), cmp_flt);
+            if (memcmp(a, b, n * sizeof(a[0])) != 0 || memcmp(x, y, n * sizeof(x[0])) != 0)
+                bad++;
+        }
+    }
+    printf("%-7s sort  n=0..%d  %s\n", isa, SORTNET_MAX, bad ? "FAIL" : "OK");
+    failures += (bad != 0);
+}
+
+static void test_merge(const char *isa, MergeI32 merge)
+{
+    enum { MAXLEN = 300 };
+    int bad = 0;
+    for (int trial = 0; trial < 2000; trial++)
+    {
+        int32_t a[MAXLEN], b[MAXLEN], out[2 * MAXLEN], ref[2 * MAXLEN];
+        size_t na = rng() % MAXLEN;
+        size_t nb = (trial % 3 == 0) ? rng() % 10 : rng() % MAXLEN;
+        uint64_t mod = (trial % 2) ? 50 : 1000000;
+        for (size_t i = 0; i < na; i++)
+            a[i] = (int32_t)(rng() % mod);
+        for (size_t i = 0; i < nb; i++)
+            b[i] = (int32_t)(rng() % mod);
+        qsort(a, na, sizeof(a[0]), cmp_i32);
+        qsort(b, nb, sizeof(b[0]), cmp_i32);
+        memcpy(ref, a, na * sizeof(a[0]));
+        memcpy(ref + na, b, nb * sizeof(b[0]));
+        qsort(ref, na + nb, sizeof(ref[0]), cmp_i32);
+        (*merge)(a, na, b, nb, out);
+        if (memcmp(out, ref, (na + nb) * sizeof(out[0])) != 0)
+            bad++;
+    }
+    printf("%-7s merge            %s\n", isa, bad ? "FAIL" : "OK");
+    failures += (bad != 0);
+}
+
+/* Random -1, -0.0, +0.0 and 1: the output must be sorted, and keep every signed zero */
+static size_t signed_zeros(float *x, size_t n)
+{
+    static const float values[4] = { -1.0F, -0.0F, +0.0F, 1.0F };
+    size_t nneg = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        x[i] = values[rng() % 4];
+        nneg += (x[i] == 0.0F && signbit(x[i]));
+    }
+    return nneg;
+}
+
+static bool check_zeros(const float *x, size_t n, size_t nneg)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i > 0 && x[i-1] > x[i])
+            return false;
+        nneg -= (x[i] == 0.0F && signbit(x[i]));
+    }
+    return nneg == 0;
+}
+
+static void test_zeros(const char *isa, SortFlt sort, MergeFlt merge)
+{
+    enum { MAXLEN = 100 };
+    int bad = 0;
+    for (int trial = 0; trial < 1000; trial++)
+    {
+        float a[MAXLEN], b[MAXLEN], out[2 * MAXLEN];
+        size_t n = rng() % (SORTNET_MAX + 1);
+        size_t nneg = signed_zeros(a, n);
+        (*sort)(a, n);
+        if (!check_zeros(a, n, nneg))
+            bad++;
+        size_t na = rng() % MAXLEN;
+        size_t nb = rng() % MAXLEN;
+        nneg = signed_zeros(a, na) + signed_zeros(b, nb);
+        qsort(a, na, sizeof(a[0]), cmp_flt);
+        qsort(b, nb, sizeof(b[0]), cmp_flt);
+        (*merge)(a, na, b, nb, out);
+        if (!check_zeros(out, na + nb, nneg))
+            bad++;
+    }
+    printf("%-7s zeros            %s\n", isa, bad ? "FAIL" : "OK");
+    failures += (bad != 0);
+}
+
+static void merge_scalar_flt(const float *a, size_t na, const float *b, size_t nb, float *out)
+{
+    merge3_flt(0, 0, a, na, b, nb, out);
+}
+
+static void merge_scalar(const int32_t *a, size_t na, const int32_t *b, size_t nb, int32_t *out)
+{
+    merge3_i32(0, 0, a, na, b, nb, out);
+}
+
+/* Sorts per second on many small random arrays, laid end to end */
+static double rate(SortI32 sort, size_t n)
+{
+    enum { NSETS = 4096 };
+    static int32_t work[NSETS * SORTNET_MAX];
+    Clock clk;
+    double best = 0.0;
+    clk_init(&clk);
+    /* New data each time, so the branch predictor cannot learn it */
+    for (int rep = 0; rep < 20; rep++)
+    {
+        for (size_t i = 0; i < NSETS * n; i++)
+            work[i] = (int32_t)rng();
+        clk_start(&clk);
+        for (size_t s = 0; s < NSETS; s++)
+            (*sort)(work + s * n, n);
+        clk_stop(&clk);
+        double r = NSETS / (clk_elapsed_nsec(&clk) / 1.0E9);
+        if (r > best)
+            best = r;
+    }
+    return best;
+}
+
+int main(void)
+{
+    static const size_t sizes[] = { 4, 8, 12, 16, 24, 32, 48, 64 };
+    enum { NUM_SIZES = sizeof(sizes) / sizeof(sizes[0]) };
+
+    printf("CPU instruction set: %s\n", sortnet_isa());
+    test_sort("scalar", insertion_i32, insertion_flt);
+    test_merge("scalar", merge_scalar);
+    test_zeros("scalar", insertion_flt, merge_scalar_flt);
+#ifdef SORTNET_X86
+    if (have_sse4())
+    {
+        test_sort("sse4.1", sse4_i32_sort, sse4_flt_sort);
+        test_merge("sse4.1", sse4_i32_merge);
+        test_zeros("sse4.1", sse4_flt_sort, sse4_flt_merge);
+    }
+    if (have_avx2())
+    {
+        test_sort("avx2", avx2_i32_sort, avx2_flt_sort);
+        test_merge("avx2", avx2_i32_merge);
+        test_zeros("avx2", avx2_flt_sort, avx2_flt_merge);
+    }
+#endif /* SORTNET_X86 */
+
+    printf("\nMillions of int32_t sorts per second\n");
+    printf("%4s %10s", "n", "insertion");
+#ifdef SORTNET_X86
+    if (have_sse4())
+        printf(" %10s", "sse4.1");
+    if (have_avx2())
+        printf(" %10s", "avx2");
+#endif /* SORTNET_X86 */
+    putchar('\n');
+    for (int i = 0; i < NUM_SIZES; i++)
+    {
+        size_t n = sizes[i];
+        printf("%4zu %10.2f", n, rate(insertion_i32, n) / 1.0E6);
+#ifdef SORTNET_X86
+        if (have_sse4())
+            printf(" %10.2f", rate(sse4_i32_sort, n) / 1.0E6);
+        if (have_avx2())
+            printf(" %10.2f", rate(avx2_i32_sort, n) / 1.0E6);
+#endif /* SORTNET_X86 */
+        putchar('\n');
+    }
+
+    printf("%s\n", failures == 0 ? "== PASS ==" : "== FAIL ==");
+    return(failures != 0);
+}
+
+#endif /* TEST */
@@ -0,0 +1,56 @@
+/*
+@(#)File:           sortnet.h
+@(#)Purpose:        Vectorised sorting networks and merge kernels for small arrays
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#ifndef JLSS_ID_SORTNET_H
+#define JLSS_ID_SORTNET_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>    /* bool */
+#include <stddef.h>     /* size_t */
+#include <stdint.h>     /* int32_t */
+
+/*
+** sortnet_i32() and sortnet_flt() sort up to SORTNET_MAX elements with
+** a bitonic sorting network built from vector min/max operations: AVX2
+** (8 lanes) or SSE4.1 (4 lanes), chosen at run time from what the CPU
+** supports, or insertion sort on other machines.  They return false,
+** without touching the data, if n > SORTNET_MAX.  The data is padded to
+** a power-of-two number of registers with INT32_MAX or +Inf, so the cost
+** steps up at 8, 16, 32 and 64 elements (with AVX2).
+**
+** sortnet_merge_i32() and sortnet_merge_flt() merge the sorted arrays
+** a[0..na-1] and b[0..nb-1] into out[0..na+nb-1] (which must not
+** overlap either input) by repeatedly merging a register of each with a
+** bitonic merge network.  They are meant for the merge step of a merge
+** sort whose base case is sortnet_xxx().
+**
+** The float versions must not be given NaNs.  They return a permutation
+** of their input: -0.0 and +0.0 are both kept, though equal values may
+** be in either order.
+**
+** sortnet_isa() reports which instruction set is in use: "avx2",
+** "sse4.1" or "scalar".
+*/
+
+enum { SORTNET_MAX = 64 };
+
+extern bool sortnet_i32(int32_t *data, size_t n);
+extern bool sortnet_flt(float *data, size_t n);
+extern void sortnet_merge_i32(const int32_t *a, size_t na, const int32_t *b, size_t nb, int32_t *out);
+extern void sortnet_merge_flt(const float *a, size_t na, const float *b, size_t nb, float *out);
+extern const char *sortnet_isa(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JLSS_ID_SORTNET_H */
@@ -2,7 +2,7 @@
 @(#)File:           stderr.c
 @(#)Purpose:        Error reporting routines
 @(#)Author:         J Leffler
-@(#)Copyright:      (C) JLSS 1988-2017
+@(#)Copyright:      (C) JLSS 1988-2017,2026
 @(#)Derivation:     stderr.c 10.19 2017/07/10 04:54:26
 */
 
@@ -19,6 +19,7 @@
 ** HAVE_GETTIMEOFDAY
 ** HAVE_SYSLOG_H
 ** HAVE_SYSLOG
+** HAVE_PTHREAD_H     - with C11 atomics, enables asynchronous output
 */
 
 #include "posixver.h"
@@ -42,6 +43,19 @@ extern int getpid(void);
 #endif
 enum { MAX_MSGLEN = ERR_MAXMSGLEN };
 
+#if defined(HAVE_PTHREAD_H) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
+#define USE_STDERR_ASYNC
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/uio.h>
+#endif /* HAVE_PTHREAD_H && C11 atomics */
+
+#if __STDC_VERSION__ >= 201112L
+#define ERR_THREAD_LOCAL _Thread_local
+#else
+#define ERR_THREAD_LOCAL /* If only */
+#endif /* __STDC_VERSION__ */
+
 /* Find sub-second timing mechanism */
 #if defined(HAVE_CLOCK_GETTIME)
 /* Uses <time.h> */
@@ -72,6 +86,7 @@ const char jlss_id_stderr_c_with_filedesc[] =
 
 static const char def_format[] = "%Y-%m-%d %H:%M:%S";
 static const char *tm_format = def_format;
+static unsigned tm_generation = 1;  /* Bumped by err_settimeformat() */
 static char arg0[ERR_MAXLEN_ARGV0+1] = "**undefined**";
 
 /* Permitted default error flags */
@@ -139,6 +154,7 @@ const char *err_settimeformat(const char *new_fmt)
         tm_format = def_format;
     else
         tm_format = new_fmt;
+    tm_generation++;    /* The format may be new even if the pointer is not */
     return old_fmt;
 }
 
@@ -346,13 +362,40 @@ static Time now(void)
     return clk;
 }
 
+/*
+** Each thread caches the whole-second part of the time stamp, so
+** localtime_r() and strftime() are called at most once a second (or
+** after each call to err_settimeformat(), which may reuse the buffer
+** holding the old format, so the cache is keyed on a generation count
+** rather than the format pointer).
+*/
+typedef struct TimeCache
+{
+    time_t      tv_sec;
+    unsigned    generation;
+    size_t      length;
+    char        buffer[32];
+} TimeCache;
+
+static ERR_THREAD_LOCAL TimeCache tm_cache;
+
 /* Format a time string for now (using ISO8601 format) */
 /* Allow for future settable time format with tm_format */
 static char *err_time(int flags, char *buffer, size_t buflen)
 {
     Time clk = now();
-    struct tm *tp = localtime(&clk.tv_sec);
-    size_t nb = strftime(buffer, buflen, tm_format, tp);
+    TimeCache *tc = &tm_cache;
+    if (tc->generation != tm_generation || tc->tv_sec != clk.tv_sec)
+    {
+        struct tm tm;
+        localtime_r(&clk.tv_sec, &tm);
+        tc->length = strftime(tc->buffer, sizeof(tc->buffer), tm_format, &tm);
+        tc->tv_sec = clk.tv_sec;
+        tc->generation = tm_generation;
+    }
+    size_t nb = (tc->length < buflen) ? tc->length : buflen - 1;
+    memcpy(buffer, tc->buffer, nb);
+    buffer[nb] = '\0';
     if (flags & (ERR_NANO | ERR_MICRO | ERR_MILLI))
     {
         char subsec[12];
@@ -477,11 +520,320 @@ static void (err_filedes)(int fd, int flags, int errnum, const char *format, va_
 }
 #endif /* USE_STDERR_FILEDESC */
 
+#if defined(USE_STDERR_ASYNC)
+/*
+** Asynchronous output.
+** A message is formatted in the calling thread's own buffer and copied
+** into a slot of a bounded lock-free multi-producer queue (after Dmitry
+** Vyukov's bounded queue): the producer claims a position with a
+** compare-and-swap, copies the message, and publishes the slot by
+** storing its sequence number.  The consumer -- the flusher thread, or
+** a thread draining the queue synchronously -- gathers consecutive
+** published slots and writes them with a single writev().  Consumers
+** are serialized by a mutex that producers never touch; producers only
+** take the wake-up mutex when the flusher is asleep.
+*/
+#ifndef ERR_ASYNCSLOTS
+#define ERR_ASYNCSLOTS 256      /* Must be a power of 2 */
+#endif
+enum { ASYNC_SLOTS = ERR_ASYNCSLOTS };
+enum { ASYNC_IOVMAX = 64 };
+
+typedef struct ErrSlot
+{
+    atomic_size_t   seq;            /* pos: free; pos+1: published */
+    size_t          length;
+    char            message[MAX_MSGLEN];
+} ErrSlot;
+
+typedef struct ErrQueue
+{
+    ErrSlot        *slots;
+    atomic_size_t   head;           /* Next position to claim */
+    atomic_size_t   tail;           /* Next position to write */
+    int             fd;
+    atomic_int      active;
+    atomic_int      asleep;         /* Flusher is waiting for messages */
+    atomic_int      waiters;        /* Producers waiting for space */
+    atomic_int      stop;
+    pthread_mutex_t drain;          /* Serializes consumers */
+    pthread_mutex_t lock;           /* Guards wakeup and space */
+    pthread_cond_t  wakeup;
+    pthread_cond_t  space;
+    pthread_t       flusher;
+} ErrQueue;
+
+static ErrQueue queue =
+{
+    .drain  = PTHREAD_MUTEX_INITIALIZER,
+    .lock   = PTHREAD_MUTEX_INITIALIZER,
+    .wakeup = PTHREAD_COND_INITIALIZER,
+    .space  = PTHREAD_COND_INITIALIZER,
+};
+
+static void async_wakeup(void)
+{
+    pthread_mutex_lock(&queue.lock);
+    pthread_cond_signal(&queue.wakeup);
+    pthread_mutex_unlock(&queue.lock);
+}
+
+/* Is the slot at the tail of the queue published? */
+static int async_ready(void)
+{
+    size_t pos = atomic_load(&queue.tail);
+    return(atomic_load(&queue.slots[pos & (ASYNC_SLOTS - 1)].seq) == pos + 1);
+}
+
+/* Write all of iov[0..n-1], allowing for short writes */
+static void async_writev(int fd, struct iovec *iov, int n)
+{
+    while (n > 0)
+    {
+        ssize_t nbytes = writev(fd, iov, n);
+        if (nbytes < 0 && errno == EINTR)
+            continue;
+        if (nbytes <= 0)
+            break;
+        while (n > 0 && (size_t)nbytes >= iov->iov_len)
+        {
+            nbytes -= (ssize_t)iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + nbytes;
+            iov->iov_len -= (size_t)nbytes;
+        }
+    }
+}
+
+/* Write published messages in order; caller holds queue.drain */
+static size_t async_consume(void)
+{
+    size_t total = 0;
+
+    for (;;)
+    {
+        struct iovec iov[ASYNC_IOVMAX];
+        size_t pos = atomic_load_explicit(&queue.tail, memory_order_relaxed);
+        int n;
+
+        for (n = 0; n < ASYNC_IOVMAX; n++)
+        {
+            ErrSlot *slot = &queue.slots[(pos + n) & (ASYNC_SLOTS - 1)];
+            if (atomic_load(&slot->seq) != pos + n + 1)
+                break;
+            iov[n].iov_base = slot->message;
+            iov[n].iov_len = slot->length;
+        }
+        if (n == 0)
+            break;
+        async_writev(queue.fd, iov, n);
+        for (int i = 0; i < n; i++)
+            atomic_store(&queue.slots[(pos + i) & (ASYNC_SLOTS - 1)].seq,
+                         pos + i + ASYNC_SLOTS);
+        atomic_store_explicit(&queue.tail, pos + n, memory_order_relaxed);
+        total += (size_t)n;
+    }
+    if (total > 0 && atomic_load(&queue.waiters) > 0)
+    {
+        pthread_mutex_lock(&queue.lock);
+        pthread_cond_broadcast(&queue.space);
+        pthread_mutex_unlock(&queue.lock);
+    }
+    return(total);
+}
+
+static void *async_flusher(void *arg)
+{
+    (void)arg;
+    while (!atomic_load(&queue.stop))
+    {
+        pthread_mutex_lock(&queue.drain);
+        size_t n = async_consume();
+        pthread_mutex_unlock(&queue.drain);
+        if (n == 0)
+        {
+            /* Producers check asleep after publishing, so no wake-up is lost */
+            pthread_mutex_lock(&queue.lock);
+            atomic_store(&queue.asleep, 1);
+            if (!async_ready() && !atomic_load(&queue.stop))
+                pthread_cond_wait(&queue.wakeup, &queue.lock);
+            atomic_store(&queue.asleep, 0);
+            pthread_mutex_unlock(&queue.lock);
+        }
+    }
+    return(0);
+}
+
+/*
+** The queue is full: the slot still holds a message from the previous
+** lap.  Wake the flusher and sleep until it has made space.
+*/
+static void async_wait(ErrSlot *slot, size_t pos)
+{
+    pthread_mutex_lock(&queue.lock);
+    atomic_fetch_add(&queue.waiters, 1);
+    if (atomic_load(&slot->seq) < pos)
+    {
+        pthread_cond_signal(&queue.wakeup);
+        pthread_cond_wait(&queue.space, &queue.lock);
+    }
+    atomic_fetch_sub(&queue.waiters, 1);
+    pthread_mutex_unlock(&queue.lock);
+}
+
+/* Queue a message, waiting for the flusher if the queue is full */
+static void async_push(const char *message, size_t length)
+{
+    size_t pos = atomic_load_explicit(&queue.head, memory_order_relaxed);
+    ErrSlot *slot;
+
+    for (;;)
+    {
+        slot = &queue.slots[pos & (ASYNC_SLOTS - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq == pos)
+        {
+            if (atomic_compare_exchange_weak_explicit(&queue.head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        }
+        else
+        {
+            if (seq < pos)
+                async_wait(slot, pos);
+            pos = atomic_load_explicit(&queue.head, memory_order_relaxed);
+        }
+    }
+    memcpy(slot->message, message, length);
+    slot->length = length;
+    atomic_store(&slot->seq, pos + 1);
+    /* One producer wakes a sleeping flusher; the rest need not */
+    if (atomic_load(&queue.asleep) && atomic_exchange(&queue.asleep, 0))
+        async_wakeup();
+}
+
+static void err_async(int flags, int errnum, const char *format, va_list args)
+{
+    char buffer[MAX_MSGLEN];
+    size_t msglen = err_fmtmsg(buffer, sizeof(buffer), flags, errnum, format, args);
+    async_push(buffer, msglen);
+}
+
+/*
+** Start asynchronous output to the current error destination (the file
+** descriptor if one is set, else the file descriptor of the error
+** stream).  Returns 0 on success and -1 on failure.
+*/
+int (err_async_start)(void)
+{
+    static int registered = 0;
+
+    if (atomic_load(&queue.active))
+        return(0);
+    /* Never freed: a late producer may still be looking at the slots */
+    if (queue.slots == 0 && (queue.slots = malloc(ASYNC_SLOTS * sizeof(ErrSlot))) == 0)
+        return(-1);
+    for (size_t i = 0; i < ASYNC_SLOTS; i++)
+        atomic_init(&queue.slots[i].seq, i);
+    atomic_store(&queue.head, 0);
+    atomic_store(&queue.tail, 0);
+    atomic_store(&queue.stop, 0);
+#if defined(USE_STDERR_FILEDESC)
+    if (err_fd >= 0)
+        queue.fd = err_fd;
+    else
+#endif /* USE_STDERR_FILEDESC */
+    {
+        if (errout == 0)
+            errout = stderr;
+        fflush(errout);
+        queue.fd = fileno(errout);
+    }
+    if (pthread_create(&queue.flusher, 0, async_flusher, 0) != 0)
+        return(-1);
+    if (!registered)
+    {
+        atexit(err_async_stop);
+        registered = 1;
+    }
+    atomic_store(&queue.active, 1);
+    return(0);
+}
+
+/* Write the queued messages now, in the calling thread */
+void (err_async_flush)(void)
+{
+    if (atomic_load(&queue.active))
+    {
+        pthread_mutex_lock(&queue.drain);
+        async_consume();
+        pthread_mutex_unlock(&queue.drain);
+    }
+}
+
+/* Stop the flusher thread, writing any queued messages */
+void (err_async_stop)(void)
+{
+    if (atomic_exchange(&queue.active, 0))
+    {
+        pthread_mutex_lock(&queue.lock);
+        atomic_store(&queue.stop, 1);
+        pthread_cond_signal(&queue.wakeup);
+        pthread_mutex_unlock(&queue.lock);
+        pthread_join(queue.flusher, 0);
+        pthread_mutex_lock(&queue.drain);
+        async_consume();
+        pthread_mutex_unlock(&queue.drain);
+    }
+}
+
+#else
+
+int (err_async_start)(void)
+{
+    return(-1);
+}
+
+void (err_async_flush)(void)
+{
+}
+
+void (err_async_stop)(void)
+{
+}
+
+#endif /* USE_STDERR_ASYNC */
+
 /* Most fundamental (and flexible) error message printing routine - always returns */
 static void (err_vrf_print)(FILE *fp, int flags, const char *format, va_list args)
 {
     int errnum = errno;     /* Capture errno before it is damaged! */
 
+#if defined(USE_STDERR_ASYNC)
+    /*
+    ** Messages that return go to the queue, without flushing stdio;
+    ** anything else first writes the queued messages, so messages that
+    ** exit or abort are written last, and synchronously.
+    */
+    if (atomic_load_explicit(&queue.active, memory_order_relaxed))
+    {
+#if defined(USE_STDERR_SYSLOG)
+        if (errlog == 0)
+#endif /* USE_STDERR_SYSLOG */
+        if (fp == errout && (flags & (ERR_ABORT|ERR_EXIT)) == 0)
+        {
+            err_async(flags, errnum, format, args);
+            return;
+        }
+        err_async_flush();
+    }
+#endif /* USE_STDERR_ASYNC */
+
     if ((flags & ERR_NOFLUSH) == 0)
         fflush(0);
 
@@ -2,7 +2,7 @@
 @(#)File:           stderr.h
 @(#)Purpose:        Header file for standard error functions
 @(#)Author:         J Leffler
-@(#)Copyright:      (C) JLSS 1989-2017
+@(#)Copyright:      (C) JLSS 1989-2017,2026
 @(#)Derivation:     stderr.h 10.12 2017/04/08 03:43:34
 */
 
@@ -139,6 +139,20 @@ extern const char *err_gettimeformat(void);
 #if defined(USE_STDERR_FILEDESC)
 extern int  err_use_fd(int fd);             /* Use file descriptor */
 #endif /* USE_STDERR_FILEDESC */
+/*
+** Asynchronous output: after err_async_start(), messages that return
+** (err_remark(), err_sysrem(), etc) are queued without locking and
+** written in batches by a background thread; messages that exit or
+** abort write the queue first and are then written synchronously.
+** err_async_start() returns -1 if threads are not supported or the
+** thread cannot be started.  Messages are not ordered with respect to
+** stdio output.  The error destination should not be changed while
+** asynchronous output is active.  err_async_stop() is called at exit.
+*/
+extern int  err_async_start(void);
+extern void err_async_flush(void);  /* Write queued messages now */
+extern void err_async_stop(void);
+
 #if defined(USE_STDERR_SYSLOG)
 /* In case of doubt, use zero for both logopts and facility */
 extern int  err_use_syslog(int logopts, int facility);  /* Configure/use syslog() */
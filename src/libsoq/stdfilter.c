@@ -0,0 +1,118 @@
+/*
+@(#)File:           stdfilter.c
+@(#)Purpose:        Standard File Filter - output to standard output
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#include "filter.h"
+#include "stderr.h"
+#include <string.h>
+
+static char  dash[] = "-";
+static char *no_args[] = { dash, 0 };
+static const char em_invoptnum[] = "invalid (negative) option number";
+
+/*
+    Purpose:    Standard File Filter
+
+    Arguments
+    ---------
+    argc            In: Number of arguments
+    argv            In: Argument list of program
+    optnum          In: Offset in list to start at
+    function        In: Function to process file
+
+    Comments
+    --------
+    1.  For every non-flag option in the argument list, or standard input
+        if there are no non-flag arguments, run 'function' on file.
+    2.  If a file name is '-', use standard input.
+    3.  The optnum argument should normally be the value of optind as
+        supplied by getopt(3).  But it should be the index of the first
+        non-flag argument.
+    4.  Processing continues after a file cannot be opened or the
+        function reports failure; the return value is 0 if every file
+        was processed successfully and -1 otherwise.
+    5.  Output is written to standard output by 'function'; an I/O
+        error on either stream is reported via filter_io_check().
+
+*/
+
+int filter_stdout(int argc, char **argv, int optnum, StdoutFilter function)
+{
+    int   i;
+    int   rc = 0;
+    FILE *fp;
+
+    if (optnum < 0)
+        err_abort(em_invoptnum);
+    else if (optnum >= argc)
+    {
+        argc = 1;
+        argv = no_args;
+        optnum = 0;
+    }
+    filter_setnumfiles(argc - optnum);
+
+    for (i = optnum; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-") == 0)
+        {
+            const char name[] = "(standard input)";
+            if ((*function)(stdin, name) != 0)
+                rc = -1;
+            if (filter_io_check(stdin, name, stdout) != 0)
+                rc = -1;
+        }
+        else if ((fp = fopen(argv[i], "r")) != NULL)
+        {
+            if ((*function)(fp, argv[i]) != 0)
+                rc = -1;
+            if (filter_io_check(fp, argv[i], stdout) != 0)
+                rc = -1;
+            fclose(fp);
+        }
+        else
+        {
+            err_sysrem("failed to open file %s\n", argv[i]);
+            rc = -1;
+        }
+    }
+    return(rc);
+}
+
+#ifdef TEST
+
+/*
+** Test program
+** -- copies named files to standard output, prefixed by the file name
+**    when there is more than one file
+*/
+
+#include <stdlib.h>
+
+static int cat(FILE *ifp, const char *ifn)
+{
+    char   buffer[BUFSIZ];
+    size_t n;
+
+    if (filter_numfiles() > 1)
+        printf("%s:\n", ifn);
+    while ((n = fread(buffer, sizeof(char), sizeof(buffer), ifp)) > 0)
+    {
+        if (fwrite(buffer, sizeof(char), n, stdout) != n)
+            return(-1);
+    }
+    return(0);
+}
+
+int main(int argc, char **argv)
+{
+    err_setarg0(argv[0]);
+    return(filter_stdout(argc, argv, 1, cat) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+#endif /* TEST */
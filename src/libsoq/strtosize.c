@@ -10,6 +10,7 @@
 
 #include "posixver.h"
 #include "jlss.h"
+#include <ctype.h>
 #include <errno.h>
 #include <inttypes.h>
 #include <limits.h>
@@ -32,6 +33,57 @@ size_t strtosize(const char *data, char **endptr, int base)
     return (size_t)lval;
 }
 
+size_t strtosize_scaled(const char *data, char **endptr, int base, bool binary)
+{
+    const char *str = data;
+    char *end;
+
+    while (isspace((unsigned char)*str))
+        str++;
+    if (*str == '-')
+    {
+        /* strtoumax() would negate the value */
+        if (endptr != 0)
+            *endptr = (char *)data;
+        return 0;
+    }
+
+    int old_errno = errno;
+    errno = 0;
+    size_t size = strtosize(data, &end, base);
+    int power = 0;
+    if (end != data)
+    {
+        switch (*end)
+        {
+        case 'k': case 'K': power = 1; break;
+        case 'm': case 'M': power = 2; break;
+        case 'g': case 'G': power = 3; break;
+        case 't': case 'T': power = 4; break;
+        }
+    }
+    if (power > 0)
+    {
+        size_t unit = binary ? 1024 : 1000;
+        end++;
+        while (power-- > 0 && errno == 0)
+        {
+            if (size > SIZE_MAX / unit)
+            {
+                errno = ERANGE;
+                size = SIZE_MAX;
+            }
+            else
+                size *= unit;
+        }
+    }
+    if (errno == 0)
+        errno = old_errno;
+    if (endptr != 0)
+        *endptr = end;
+    return size;
+}
+
 #ifdef TEST
 
 #include <assert.h>
@@ -82,11 +134,62 @@ static void p1_tester(const void *data)
         pt_pass("<<%s>>\n", test->input);
 }
 
+/* -- PHASE 2 TESTING -- */
+
+/* -- Test conversions for strtosize_scaled() -- */
+typedef struct p2_test_case
+{
+    const char   *input;      /* String */
+    bool          binary;     /* Units of 1024 */
+    ptrdiff_t     offset;     /* Offset in endptr */
+    size_t        retval;     /* Returned value */
+    int           errnum;     /* Value in errno */
+} p2_test_case;
+
+static const p2_test_case p2_tests[] =
+{
+    { "0",                false,  1, 0,                     0      },
+    { "12",               true,   2, 12,                    0      },
+    { "3k",               false,  2, 3000,                  0      },
+    { "3K",               true,   2, 3072,                  0      },
+    { "64M",              true,   3, 64 << 20,              0      },
+    { "2G",               false,  2, 2000000000,            0      },
+    { "0x10K",            true,   5, 16384,                 0      },
+    { "5X",               false,  1, 5,                     0      },
+    { "K",                false,  0, 0,                     0      },
+    { "-1K",              false,  0, 0,                     0      },
+    { "99999999999G",     false, 12, SIZE_MAX,              ERANGE },
+    { "20000000T",        true,   9, SIZE_MAX,              ERANGE },
+};
+
+static void p2_tester(const void *data)
+{
+    const p2_test_case *test = (const p2_test_case *)data;
+    char *end;
+    errno = 0;
+    size_t retval = strtosize_scaled(test->input, &end, 0, test->binary);
+    ptrdiff_t offset = end - test->input;
+    int errnum = errno;
+
+    if (retval != test->retval)
+        pt_fail("<<%s>> unexpected return value (actual %zu wanted %zu)\n",
+                 test->input, retval, test->retval);
+    else if (errnum != test->errnum)
+        pt_fail("<<%s>> - unexpected errno (actual %d instead of %d)\n",
+                test->input, errnum, test->errnum);
+    else if (offset != test->offset)
+        pt_fail("<<%s>> - unexpected offset (actual %td instead of %td)\n",
+                test->input, offset, test->offset);
+    else
+        pt_pass("<<%s>>\n", test->input);
+}
+
 /* -- Phased Test Infrastructure -- */
 
 static pt_auto_phase phases[] =
 {
     { p1_tester, PT_ARRAYINFO(p1_tests), 0, "Test conversions for strtosize()" },
+    { p2_tester, PT_ARRAYINFO(p2_tests), 0, "Test conversions for strtosize_scaled()" },
 };
 
 int main(int argc, char **argv)
@@ -2,7 +2,7 @@
 @(#)File:           timer.c
 @(#)Purpose:        Simple timing package for multiple systems
 @(#)Author:         J Leffler
-@(#)Copyright:      (C) JLSS 1993,1995-2001,2003,2005,2007-08,2011,2013,2015
+@(#)Copyright:      (C) JLSS 1993,1995-2001,2003,2005,2007-08,2011,2013,2015,2026
 @(#)Derivation:     timer.c 2.31 2015/02/21 17:32:35
 */
 
@@ -10,7 +10,8 @@
 
 /*
 ** Configuration (listed in order of preference):
-** HAVE_CLOCK_GETTIME: Use POSIX.4 (POSIX.1:1996) clock_gettime()
+** HAVE_CLOCK_GETTIME: Use POSIX.4 (POSIX.1:1996) clock_gettime(), with
+**                     CLOCK_MONOTONIC_RAW or CLOCK_MONOTONIC if available
 ** HAVE_GETTIMEOFDAY:  Use gettimeofday (BSD, SVR4, Unix-98)
 ** HAVE_TIMES:         Use times (System V - deprecated)
 ** HAVE_FTIME:         Use ftime (Antique Unix - deprecated)
@@ -24,12 +25,17 @@
 ** Note 3: support for GetTickCount removed 2001-03-09.  It might be
 ** needed on Windows 95, but on NT the clock() function is used in
 ** preference and is probably available to all Win32 platforms.
+** Note 4: the numeric interfaces (clk_elapsed_cycles(), clk_elapsed_nsec()
+** and the lap timer) use ticks -- see timer.h.  On x86, the TSC is
+** calibrated once (under pthread_once(), so threads may share it) against
+** clk_get() over about 5 ms, by clk_init(), clk_lap_init() or clk_start()
+** if nothing calibrated it before, so never within a timed region.
 */
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #else
-#define HAVE_GETTIMEOFDAY       /* Sensible default */
+#define HAVE_CLOCK_GETTIME      /* Sensible default (POSIX 2008) */
 #endif /* HAVE_CONFIG_H */
 
 /*===============================================================*/
@@ -117,14 +123,28 @@ extern const char jlss_id_timer_type[];
 
 #if defined HAVE_CLOCK_GETTIME
 
+/*
+** CLOCK_MONOTONIC_RAW (Linux) is not slewed by NTP, so intervals are
+** measured in the same units throughout a run; CLOCK_MONOTONIC does not
+** jump when the time of day is set.
+*/
+#if defined CLOCK_MONOTONIC_RAW
+#define JLSS_CLOCK_ID   CLOCK_MONOTONIC_RAW
+TIMER_TYPE("POSIX 1003.4 clock_gettime(CLOCK_MONOTONIC_RAW)");
+#elif defined CLOCK_MONOTONIC
+#define JLSS_CLOCK_ID   CLOCK_MONOTONIC
+TIMER_TYPE("POSIX 1003.4 clock_gettime(CLOCK_MONOTONIC)");
+#else
+#define JLSS_CLOCK_ID   CLOCK_REALTIME
 TIMER_TYPE("POSIX 1003.4 clock_gettime()");
+#endif /* CLOCK_MONOTONIC_RAW */
 
 static void
 clk_get(Time * t)
 {
     struct timespec mt;
 
-    clock_gettime(CLOCK_REALTIME, &mt);
+    clock_gettime(JLSS_CLOCK_ID, &mt);
     t->seconds = mt.tv_sec;
     t->nanoseconds = mt.tv_nsec;
 }
@@ -241,6 +261,90 @@ clk_get(Time *t)
 
 /* ============== End of Platform-Dependent Coding ============== */
 
+/* Nanoseconds since the reference time of clk_get() */
+static unsigned long long
+clk_get_nsec(void)
+{
+    Time t;
+
+    clk_get(&t);
+    return((unsigned long long)t.seconds * NANOSECOND + t.nanoseconds);
+}
+
+#ifdef JLSS_TIMER_TSC
+
+#include <pthread.h>
+
+enum { CALIBRATION_NSEC = 5 * (NANOSECOND / MILLISECOND) };
+
+static double tick_nsec = 0.0;      /* Nanoseconds per TSC tick */
+static pthread_once_t tick_once = PTHREAD_ONCE_INIT;
+
+/*
+** Time CALIBRATION_NSEC of clk_get() time in TSC ticks.  Each clock
+** reading is bracketed by two TSC readings, and the midpoint is used,
+** so the cost of clk_get() does not bias the result.
+*/
+static void
+tick_calibrate(void)
+{
+    unsigned long long n0, n1, c0, c1, a, b;
+
+    a = clk_ticks();
+    n0 = clk_get_nsec();
+    b = clk_ticks();
+    c0 = a + (b - a) / 2;
+    do
+    {
+        a = clk_ticks();
+        n1 = clk_get_nsec();
+        b = clk_ticks();
+    } while (n1 - n0 < CALIBRATION_NSEC);
+    c1 = a + (b - a) / 2;
+    tick_nsec = (c1 > c0) ? (double)(n1 - n0) / (c1 - c0) : 1.0;
+}
+
+/* Nanoseconds per tick, calibrating on first use */
+double
+clk_tick_nsec(void)
+{
+    pthread_once(&tick_once, tick_calibrate);
+    return(tick_nsec);
+}
+
+#else
+
+unsigned long long
+clk_ticks(void)
+{
+    return(clk_get_nsec());
+}
+
+double
+clk_tick_nsec(void)
+{
+    return(1.0);
+}
+
+#endif /* JLSS_TIMER_TSC */
+
+static unsigned long long
+ticks_to_nsec(unsigned long long ticks)
+{
+    return((unsigned long long)(ticks * clk_tick_nsec() + 0.5));
+}
+
+static unsigned long long
+ticks_to_cycles(unsigned long long ticks)
+{
+#ifdef JLSS_TIMER_TSC
+    return(ticks);
+#else
+    (void)ticks;
+    return(0);
+#endif /* JLSS_TIMER_TSC */
+}
+
 /* Calculate difference between two times */
 void
 clk_diff(Time * t1, Time * t2, long *sec, long *nsec)
@@ -275,22 +379,70 @@ clk_init(Clock * clk)
     clk->t1.nanoseconds = 0;
     clk->t2.seconds = 0;
     clk->t2.nanoseconds = 0;
+    clk->c1 = 0;
+    clk->c2 = 0;
+    (void)clk_tick_nsec();      /* Calibrate now rather than mid-run */
 }
 
-/* Start a clock (record the stop time in clk->t1) */
+/*
+** Start a clock (record the start time in clk->t1 and clk->c1).
+** The tick count is read last, and read first when stopping, so the
+** cost of clk_get() is not included in the numeric elapsed times.
+*/
 void
 clk_start(Clock * clk)
 {
+    (void)clk_tick_nsec();      /* In case clk_init() was not called */
     clk_get(&clk->t1);
+    clk->c1 = clk_ticks();
 }
 
-/* Stop a clock (record the stop time in clk->t2) */
+/* Stop a clock (record the stop time in clk->t2 and clk->c2) */
 void
 clk_stop(Clock * clk)
 {
+    clk->c2 = clk_ticks();
     clk_get(&clk->t2);
 }
 
+/* Return elapsed time in TSC ticks (0 if there is no TSC) */
+unsigned long long
+clk_elapsed_cycles(Clock * clk)
+{
+    return(ticks_to_cycles(clk->c2 - clk->c1));
+}
+
+/* Return elapsed time in nanoseconds */
+unsigned long long
+clk_elapsed_nsec(Clock * clk)
+{
+    return(ticks_to_nsec(clk->c2 - clk->c1));
+}
+
+/* Initialize a lap timer */
+void
+clk_lap_init(ClockLap * lap)
+{
+    lap->start = 0;
+    lap->ticks = 0;
+    lap->laps = 0;
+    (void)clk_tick_nsec();
+}
+
+/* Return total time of completed laps in TSC ticks (0 if no TSC) */
+unsigned long long
+clk_lap_cycles(const ClockLap * lap)
+{
+    return(ticks_to_cycles(lap->ticks));
+}
+
+/* Return total time of completed laps in nanoseconds */
+unsigned long long
+clk_lap_nsec(const ClockLap * lap)
+{
+    return(ticks_to_nsec(lap->ticks));
+}
+
 /* Return elapsed time as string in seconds and milliseconds */
 char       *
 clk_elapsed_ms(Clock * clk, char *buffer, size_t buflen)
@@ -341,9 +493,9 @@ main(void)
 {
     int         i;
     Clock       clk;
-    char        buf1[30];
-    char        buf2[30];
-    char        buf3[30];
+    char        buf1[64];
+    char        buf2[64];
+    char        buf3[64];
     char       *p1;
     char       *p2;
     char       *p3;
@@ -360,8 +512,26 @@ main(void)
         p1 = clk_elapsed_ms(&clk, buf1, sizeof(buf1));
         p2 = clk_elapsed_us(&clk, buf2, sizeof(buf2));
         p3 = clk_elapsed_ns(&clk, buf3, sizeof(buf3));
-        printf("Clock: %s = %s = %s (%zu)\n", p1, p2, p3, counter);
+        printf("Clock: %s = %s = %s = %llu ns = %llu cycles (%zu)\n",
+               p1, p2, p3, clk_elapsed_nsec(&clk), clk_elapsed_cycles(&clk),
+               counter);
+    }
+
+    /* Lap timer: time only the calls, not the loop around them */
+    ClockLap lap;
+    clk_lap_init(&lap);
+    clk_start(&clk);
+    for (size_t j = 0; j < max; j++)
+    {
+        clk_lap_start(&lap);
+        increment();
+        clk_lap_stop(&lap);
     }
+    clk_stop(&clk);
+    printf("Laps: %llu in %llu ns = %llu cycles (%.1f ns/lap); overall %llu ns\n",
+           lap.laps, clk_lap_nsec(&lap), clk_lap_cycles(&lap),
+           (double)clk_lap_nsec(&lap) / lap.laps, clk_elapsed_nsec(&clk));
+    printf("Tick: %.4f ns\n", clk_tick_nsec());
     return(0);
 }
 
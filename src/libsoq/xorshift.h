@@ -0,0 +1,57 @@
+/*
+@(#)File:           xorshift.h
+@(#)Purpose:        Marsaglia xorshift pseudo-random number generators
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#ifndef JLSS_ID_XORSHIFT_H
+#define JLSS_ID_XORSHIFT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+** Fast, repeatable and good enough for test data, but not for anything
+** that needs real randomness.  The caller owns the state, which must
+** not be zero; XORSHIFT64_SEED is Marsaglia's example seed.
+*/
+#define XORSHIFT64_SEED UINT64_C(88172645463325252)
+
+/* xorshift64 (shifts 13, 7, 17) */
+static inline uint64_t xorshift64(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/* xorshift64* (shifts 12, 25, 27), which also scrambles the low bits */
+static inline uint64_t xorshift64star(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * UINT64_C(0x2545F4914F6CDD1D);
+}
+
+/* Uniform in [0, 1) from the top 53 bits of xorshift64() */
+static inline double xorshift64_unit(uint64_t *state)
+{
+    return (xorshift64(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JLSS_ID_XORSHIFT_H */
@@ -0,0 +1,794 @@
+/*
+@(#)File:           mpat.c
+@(#)Purpose:        Multi-Pattern String Search (Aho-Corasick DFA, Teddy)
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+/*
+** Aho-Corasick: A V Aho and M J Corasick, "Efficient String Matching:
+** An Aid to Bibliographic Search", CACM 18(6), 1975.
+**
+** Teddy: the SIMD literal matcher from Intel's Hyperscan, as described
+** for the Rust aho-corasick crate:
+** https://github.com/BurntSushi/aho-corasick/tree/master/src/packed/teddy
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h> /* malloc, free, qsort */
+#include <string.h>
+#include "mpat.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MPAT_X86
+#include <immintrin.h>
+#endif
+
+enum { NUM_BUCKETS = 8 };       /* Teddy: one bit per bucket */
+enum { MAX_MASKS = 3 };         /* Teddy: leading bytes compared */
+enum { MIN_STATES = 1024 };     /* Aho-Corasick: initial space */
+
+enum { ENG_AC, ENG_TEDDY_SSSE3, ENG_TEDDY_AVX2 };
+
+/*
+** With more patterns than this (by number of bytes in the masks), the
+** nibble masks for English words pass most offsets, and the DFA is
+** faster; MP_TEDDY can still be asked for up to MP_TEDDY_MAX.
+*/
+static const size_t teddy_auto_max[MAX_MASKS + 1] = { 0, 8, 32, 32 };
+
+static mp_malloc use_malloc = malloc;
+static mp_free   use_free   = free;
+
+struct mp_control
+{
+    const unsigned char **pattern;  /* Patterns (not copied) */
+    size_t     *length;             /* Pattern lengths */
+    size_t      npatterns;
+    const unsigned char *target;    /* String to scanned */
+    size_t      tgtlen;             /* Length of scanned string */
+    int         engine;
+    /* Aho-Corasick */
+    uint8_t     column[256];        /* Byte to table column */
+    uint32_t    stride;             /* Columns */
+    uint32_t    nstates;
+    uint32_t    out_min;            /* First reporting state, times stride */
+    uint32_t   *delta;              /* Next state (times stride) */
+    uint32_t   *first;              /* First pattern ending in state, plus 1 */
+    uint32_t   *dict;               /* Next reporting state on the fail path */
+    uint32_t   *next;               /* Next pattern with the same string, plus 1 */
+    /* Teddy */
+    int         nmasks;
+    uint8_t     lo[MAX_MASKS][16];  /* Buckets by low nibble of byte i */
+    uint8_t     hi[MAX_MASKS][16];  /* Buckets by high nibble of byte i */
+    uint32_t    bucket_start[NUM_BUCKETS + 1];
+    uint32_t   *bucket;             /* Pattern numbers, by bucket */
+};
+
+static const mp_control mp_empty = { 0 };
+
+void mp_setalloc(mp_malloc mem_alloc, mp_free mem_free)
+{
+    use_malloc = mem_alloc;
+    use_free   = mem_free;
+}
+
+void mp_release(mp_control *ctrl)
+{
+    if (ctrl != 0)
+    {
+        (*use_free)(ctrl->pattern);
+        (*use_free)(ctrl->length);
+        (*use_free)(ctrl->delta);
+        (*use_free)(ctrl->first);
+        (*use_free)(ctrl->dict);
+        (*use_free)(ctrl->next);
+        (*use_free)(ctrl->bucket);
+        (*use_free)(ctrl);
+    }
+}
+
+/* The allocator hooks have no realloc() */
+static void *resize(void *old, size_t oldsize, size_t newsize)
+{
+    void *space = (*use_malloc)(newsize);
+    if (space != 0)
+    {
+        if (old != 0)
+            memcpy(space, old, oldsize);
+        memset((char *)space + oldsize, 0, newsize - oldsize);
+    }
+    (*use_free)(old);
+    return space;
+}
+
+static uint32_t *alloc_u32(size_t n)
+{
+    return resize(0, 0, (n + 1) * sizeof(uint32_t));
+}
+
+/*
+** Add the patterns to a trie held in the DFA table, where 0 (the root,
+** which is never a child) means no edge; returns false if out of space.
+*/
+static bool ac_trie(mp_control *ctrl)
+{
+    size_t maxstates = MIN_STATES;
+    uint32_t stride = ctrl->stride;
+
+    ctrl->nstates = 1;
+    ctrl->delta = alloc_u32(maxstates * stride);
+    ctrl->first = alloc_u32(maxstates);
+    ctrl->next = alloc_u32(ctrl->npatterns);
+    if (ctrl->delta == 0 || ctrl->first == 0 || ctrl->next == 0)
+        return false;
+
+    for (size_t p = 0; p < ctrl->npatterns; p++)
+    {
+        const unsigned char *x = ctrl->pattern[p];
+        size_t m = ctrl->length[p];
+        uint32_t s = 0;
+        if (m == 0)
+            continue;
+        for (size_t i = 0; i < m; i++)
+        {
+            uint32_t *edge = &ctrl->delta[(size_t)s * stride + ctrl->column[x[i]]];
+            if (*edge == 0)
+            {
+                if (ctrl->nstates >= maxstates)
+                {
+                    size_t newmax = 2 * maxstates;
+                    if ((uint64_t)newmax * stride >= UINT32_MAX)
+                        return false;
+                    ctrl->delta = resize(ctrl->delta, maxstates * stride * sizeof(uint32_t),
+                                         newmax * stride * sizeof(uint32_t));
+                    ctrl->first = resize(ctrl->first, maxstates * sizeof(uint32_t),
+                                         newmax * sizeof(uint32_t));
+                    if (ctrl->delta == 0 || ctrl->first == 0)
+                        return false;
+                    maxstates = newmax;
+                    edge = &ctrl->delta[(size_t)s * stride + ctrl->column[x[i]]];
+                }
+                *edge = ctrl->nstates++;
+            }
+            s = *edge;
+        }
+        ctrl->next[p] = ctrl->first[s];
+        ctrl->first[s] = p + 1;
+    }
+    return true;
+}
+
+/*
+** Complete the DFA in breadth-first order: a missing edge of a state
+** goes where the edge from its fail state goes, and that state has
+** already been completed.  Then renumber the states so that those that
+** report matches come last, and multiply the state numbers in the
+** table by the stride.
+*/
+static bool ac_complete(mp_control *ctrl)
+{
+    uint32_t n = ctrl->nstates;
+    uint32_t stride = ctrl->stride;
+    uint32_t *delta = ctrl->delta;
+    uint32_t *fail = alloc_u32(n);
+    uint32_t *queue = alloc_u32(n);
+    uint32_t *perm = alloc_u32(n);
+    ctrl->dict = alloc_u32(n);
+    bool ok = (fail != 0 && queue != 0 && perm != 0 && ctrl->dict != 0);
+
+    if (ok)
+    {
+        uint32_t head = 0;
+        uint32_t tail = 0;
+        queue[tail++] = 0;
+        while (head < tail)
+        {
+            uint32_t s = queue[head++];
+            uint32_t *row = &delta[(size_t)s * stride];
+            const uint32_t *frow = &delta[(size_t)fail[s] * stride];
+            for (uint32_t c = 0; c < stride; c++)
+            {
+                uint32_t t = row[c];
+                if (t != 0)
+                {
+                    uint32_t f = (s == 0) ? 0 : frow[c];
+                    fail[t] = f;
+                    ctrl->dict[t] = (ctrl->first[f] != 0) ? f : ctrl->dict[f];
+                    queue[tail++] = t;
+                }
+                else if (s != 0)
+                    row[c] = frow[c];
+            }
+        }
+
+        uint32_t quiet = 0;
+        for (uint32_t s = 0; s < n; s++)
+        {
+            if (ctrl->first[s] == 0 && ctrl->dict[s] == 0)
+                perm[s] = quiet++;
+        }
+        uint32_t loud = quiet;
+        for (uint32_t s = 0; s < n; s++)
+        {
+            if (ctrl->first[s] != 0 || ctrl->dict[s] != 0)
+                perm[s] = loud++;
+        }
+        ctrl->out_min = quiet * stride;
+
+        uint32_t *ndelta = alloc_u32((size_t)n * stride);
+        uint32_t *nfirst = alloc_u32(n);
+        uint32_t *ndict = alloc_u32(n);
+        ok = (ndelta != 0 && nfirst != 0 && ndict != 0);
+        if (ok)
+        {
+            for (uint32_t s = 0; s < n; s++)
+            {
+                uint32_t *row = &ndelta[(size_t)perm[s] * stride];
+                for (uint32_t c = 0; c < stride; c++)
+                    row[c] = perm[delta[(size_t)s * stride + c]] * stride;
+                nfirst[perm[s]] = ctrl->first[s];
+                ndict[perm[s]] = (ctrl->dict[s] != 0) ? perm[ctrl->dict[s]] : 0;
+            }
+        }
+        (*use_free)(ctrl->delta);
+        (*use_free)(ctrl->first);
+        (*use_free)(ctrl->dict);
+        ctrl->delta = ndelta;
+        ctrl->first = nfirst;
+        ctrl->dict = ndict;
+    }
+    (*use_free)(fail);
+    (*use_free)(queue);
+    (*use_free)(perm);
+    return ok;
+}
+
+static bool ac_compile(mp_control *ctrl)
+{
+    bool used[256] = { false };
+    uint32_t nused = 0;
+
+    for (size_t p = 0; p < ctrl->npatterns; p++)
+    {
+        for (size_t i = 0; i < ctrl->length[p]; i++)
+            used[ctrl->pattern[p][i]] = true;
+    }
+    for (int b = 0; b < 256; b++)
+        nused += used[b];
+    /* Column 0 is shared by the bytes in no pattern, if there are any */
+    uint32_t ncols = (nused < 256) ? 1 : 0;
+    for (int b = 0; b < 256; b++)
+        ctrl->column[b] = used[b] ? ncols++ : 0;
+    ctrl->stride = ncols;
+    return ac_trie(ctrl) && ac_complete(ctrl);
+}
+
+/* Report the patterns that end at offset i in state s (times stride) */
+static int ac_report(const mp_control *ctrl, uint32_t s, size_t i,
+                     mp_callback callback, void *context)
+{
+    uint32_t t = s / ctrl->stride;
+    for (uint32_t u = (ctrl->first[t] != 0) ? t : ctrl->dict[t]; u != 0; u = ctrl->dict[u])
+    {
+        for (uint32_t p = ctrl->first[u]; p != 0; p = ctrl->next[p - 1])
+        {
+            int rc = (*callback)(p - 1, i + 1 - ctrl->length[p - 1], context);
+            if (rc != 0)
+                return rc;
+        }
+    }
+    return 0;
+}
+
+static int ac_search(const mp_control *ctrl, mp_callback callback, void *context)
+{
+    const unsigned char *y = ctrl->target;
+    const uint32_t *delta = ctrl->delta;
+    const uint8_t *column = ctrl->column;
+    uint32_t out_min = ctrl->out_min;
+    uint32_t s = 0;
+
+    for (size_t i = 0; i < ctrl->tgtlen; i++)
+    {
+        s = delta[s + column[y[i]]];
+        if (s >= out_min)
+        {
+            int rc = ac_report(ctrl, s, i, callback, context);
+            if (rc != 0)
+                return rc;
+        }
+    }
+    return 0;
+}
+
+/* Teddy: patterns sorted on their leading bytes share buckets */
+typedef struct Prefix
+{
+    uint32_t    key;
+    uint32_t    pattern;
+} Prefix;
+
+static int cmp_prefix(const void *v1, const void *v2)
+{
+    const Prefix *p1 = v1;
+    const Prefix *p2 = v2;
+    if (p1->key != p2->key)
+        return (p1->key < p2->key) ? -1 : +1;
+    return (p1->pattern < p2->pattern) ? -1 : (p1->pattern > p2->pattern);
+}
+
+static bool teddy_compile(mp_control *ctrl)
+{
+    size_t np = 0;
+    size_t minlen = SIZE_MAX;
+
+    for (size_t p = 0; p < ctrl->npatterns; p++)
+    {
+        if (ctrl->length[p] > 0)
+        {
+            np++;
+            if (ctrl->length[p] < minlen)
+                minlen = ctrl->length[p];
+        }
+    }
+    if (np == 0 || np > MP_TEDDY_MAX)
+        return false;
+    ctrl->nmasks = (minlen < MAX_MASKS) ? (int)minlen : MAX_MASKS;
+
+    Prefix order[MP_TEDDY_MAX];
+    size_t k = 0;
+    for (size_t p = 0; p < ctrl->npatterns; p++)
+    {
+        if (ctrl->length[p] == 0)
+            continue;
+        uint32_t key = 0;
+        for (int i = 0; i < MAX_MASKS; i++)
+            key = (key << 8) | ((i < ctrl->nmasks) ? ctrl->pattern[p][i] : 0);
+        order[k].key = key;
+        order[k].pattern = p;
+        k++;
+    }
+    qsort(order, np, sizeof(order[0]), cmp_prefix);
+
+    ctrl->bucket = alloc_u32(np);
+    if (ctrl->bucket == 0)
+        return false;
+    memset(ctrl->lo, 0, sizeof(ctrl->lo));
+    memset(ctrl->hi, 0, sizeof(ctrl->hi));
+    for (int b = 0; b < NUM_BUCKETS; b++)
+    {
+        ctrl->bucket_start[b] = b * np / NUM_BUCKETS;
+        ctrl->bucket_start[b + 1] = (b + 1) * np / NUM_BUCKETS;
+        for (uint32_t i = ctrl->bucket_start[b]; i < ctrl->bucket_start[b + 1]; i++)
+        {
+            const unsigned char *x = ctrl->pattern[order[i].pattern];
+            ctrl->bucket[i] = order[i].pattern;
+            for (int j = 0; j < ctrl->nmasks; j++)
+            {
+                ctrl->lo[j][x[j] & 0x0F] |= 1 << b;
+                ctrl->hi[j][x[j] >> 4] |= 1 << b;
+            }
+        }
+    }
+    return true;
+}
+
+/* Check the patterns in the buckets that may start at offset i */
+static int teddy_verify(const mp_control *ctrl, size_t i, unsigned buckets,
+                        mp_callback callback, void *context)
+{
+    const unsigned char *y = ctrl->target;
+    while (buckets != 0)
+    {
+        int b = __builtin_ctz(buckets);
+        buckets &= buckets - 1;
+        for (uint32_t k = ctrl->bucket_start[b]; k < ctrl->bucket_start[b + 1]; k++)
+        {
+            uint32_t p = ctrl->bucket[k];
+            size_t m = ctrl->length[p];
+            const unsigned char *x = ctrl->pattern[p];
+            if (i + m <= ctrl->tgtlen && x[m - 1] == y[i + m - 1] && memcmp(y + i, x, m) == 0)
+            {
+                int rc = (*callback)(p, i, context);
+                if (rc != 0)
+                    return rc;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Teddy one position at a time, for the end of the target */
+static int teddy_tail(const mp_control *ctrl, size_t i, mp_callback callback, void *context)
+{
+    const unsigned char *y = ctrl->target;
+    size_t k = ctrl->nmasks;
+    for ( ; i + k <= ctrl->tgtlen; i++)
+    {
+        unsigned buckets = 0xFF;
+        for (size_t j = 0; j < k; j++)
+            buckets &= ctrl->lo[j][y[i + j] & 0x0F] & ctrl->hi[j][y[i + j] >> 4];
+        if (buckets != 0)
+        {
+            int rc = teddy_verify(ctrl, i, buckets, callback, context);
+            if (rc != 0)
+                return rc;
+        }
+    }
+    return 0;
+}
+
+#if defined(MPAT_X86)
+
+/*
+** For each of the leading bytes j of the patterns, the buckets of the
+** bytes at offsets i+j in the block are looked up by nibble, and the
+** lookups are ANDed; a non-zero byte in the result means a pattern in
+** those buckets may start at that offset.
+*/
+__attribute__((target("ssse3")))
+static int teddy_ssse3(const mp_control *ctrl, mp_callback callback, void *context)
+{
+    const unsigned char *y = ctrl->target;
+    size_t n = ctrl->tgtlen;
+    int k = ctrl->nmasks;
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i lo[MAX_MASKS];
+    __m128i hi[MAX_MASKS];
+    size_t i = 0;
+
+    for (int j = 0; j < k; j++)
+    {
+        lo[j] = _mm_loadu_si128((const __m128i *)ctrl->lo[j]);
+        hi[j] = _mm_loadu_si128((const __m128i *)ctrl->hi[j]);
+    }
+    for ( ; i + 16 + k - 1 <= n; i += 16)
+    {
+        __m128i res = _mm_set1_epi8(-1);
+        for (int j = 0; j < k; j++)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(y + i + j));
+            __m128i l = _mm_shuffle_epi8(lo[j], _mm_and_si128(v, nibble));
+            __m128i h = _mm_shuffle_epi8(hi[j], _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+            res = _mm_and_si128(res, _mm_and_si128(l, h));
+        }
+        unsigned mask = ~_mm_movemask_epi8(_mm_cmpeq_epi8(res, _mm_setzero_si128())) & 0xFFFF;
+        if (mask != 0)
+        {
+            uint8_t buckets[16];
+            _mm_storeu_si128((__m128i *)buckets, res);
+            while (mask != 0)
+            {
+                int q = __builtin_ctz(mask);
+                mask &= mask - 1;
+                int rc = teddy_verify(ctrl, i + q, buckets[q], callback, context);
+                if (rc != 0)
+                    return rc;
+            }
+        }
+    }
+    return teddy_tail(ctrl, i, callback, context);
+}
+
+__attribute__((target("avx2")))
+static int teddy_avx2(const mp_control *ctrl, mp_callback callback, void *context)
+{
+    const unsigned char *y = ctrl->target;
+    size_t n = ctrl->tgtlen;
+    int k = ctrl->nmasks;
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i lo[MAX_MASKS];
+    __m256i hi[MAX_MASKS];
+    size_t i = 0;
+
+    /* The shuffle works within each 16-byte lane: copy the tables to both */
+    for (int j = 0; j < k; j++)
+    {
+        lo[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)ctrl->lo[j]));
+        hi[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)ctrl->hi[j]));
+    }
+    for ( ; i + 32 + k - 1 <= n; i += 32)
+    {
+        __m256i res = _mm256_set1_epi8(-1);
+        for (int j = 0; j < k; j++)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(y + i + j));
+            __m256i l = _mm256_shuffle_epi8(lo[j], _mm256_and_si256(v, nibble));
+            __m256i h = _mm256_shuffle_epi8(hi[j], _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+            res = _mm256_and_si256(res, _mm256_and_si256(l, h));
+        }
+        uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(res, _mm256_setzero_si256()));
+        if (mask != 0)
+        {
+            uint8_t buckets[32];
+            _mm256_storeu_si256((__m256i *)buckets, res);
+            while (mask != 0)
+            {
+                int q = __builtin_ctz(mask);
+                mask &= mask - 1;
+                int rc = teddy_verify(ctrl, i + q, buckets[q], callback, context);
+                if (rc != 0)
+                    return rc;
+            }
+        }
+    }
+    return teddy_tail(ctrl, i, callback, context);
+}
+
+static int teddy_engine(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return ENG_TEDDY_AVX2;
+    if (__builtin_cpu_supports("ssse3"))
+        return ENG_TEDDY_SSSE3;
+    return ENG_AC;
+}
+
+#else
+
+static int teddy_engine(void)
+{
+    return ENG_AC;
+}
+
+#endif /* MPAT_X86 */
+
+mp_control *mp_setsearch_engine(const char * const *patterns, const size_t *lengths,
+                                size_t npatterns, MPEngine engine)
+{
+    mp_control *ctrl = (*use_malloc)(sizeof(mp_control));
+    if (ctrl == 0)
+        return 0;
+    *ctrl = mp_empty;
+    ctrl->pattern = (*use_malloc)((npatterns + 1) * sizeof(*ctrl->pattern));
+    ctrl->length = (*use_malloc)((npatterns + 1) * sizeof(*ctrl->length));
+    if (ctrl->pattern == 0 || ctrl->length == 0 || npatterns >= UINT32_MAX)
+    {
+        mp_release(ctrl);
+        return 0;
+    }
+    ctrl->npatterns = npatterns;
+    for (size_t p = 0; p < npatterns; p++)
+    {
+        ctrl->pattern[p] = (const unsigned char *)patterns[p];
+        ctrl->length[p] = (lengths != 0) ? lengths[p] : strlen(patterns[p]);
+    }
+
+    ctrl->engine = ENG_AC;
+    if (engine != MP_AHOCORASICK)
+    {
+        int teddy = teddy_engine();
+        if (teddy != ENG_AC && teddy_compile(ctrl) &&
+            (engine == MP_TEDDY || ctrl->npatterns <= teddy_auto_max[ctrl->nmasks]))
+            ctrl->engine = teddy;
+        else if (engine == MP_TEDDY)
+        {
+            mp_release(ctrl);
+            return 0;
+        }
+    }
+    if (ctrl->engine == ENG_AC && !ac_compile(ctrl))
+    {
+        mp_release(ctrl);
+        return 0;
+    }
+    return ctrl;
+}
+
+/* Initialize search for a set of patterns */
+mp_control *mp_setsearch(const char * const *patterns, const size_t *lengths, size_t npatterns)
+{
+    return mp_setsearch_engine(patterns, lengths, npatterns, MP_AUTO);
+}
+
+/* Initialize search to scan target string of length tgtlen */
+void mp_settarget(mp_control *ctrl, const char *target, size_t tgtlen)
+{
+    ctrl->target = (const unsigned char *)target;
+    ctrl->tgtlen = tgtlen;
+}
+
+int mp_search(mp_control *ctrl, mp_callback callback, void *context)
+{
+    if (ctrl->target == 0)
+        return 0;
+    switch (ctrl->engine)
+    {
+#if defined(MPAT_X86)
+    case ENG_TEDDY_SSSE3:
+        return teddy_ssse3(ctrl, callback, context);
+    case ENG_TEDDY_AVX2:
+        return teddy_avx2(ctrl, callback, context);
+#endif /* MPAT_X86 */
+    default:
+        return ac_search(ctrl, callback, context);
+    }
+}
+
+const char *mp_engine(const mp_control *ctrl)
+{
+    switch (ctrl->engine)
+    {
+    case ENG_TEDDY_SSSE3:
+        return "teddy-ssse3";
+    case ENG_TEDDY_AVX2:
+        return "teddy-avx2";
+    default:
+        return "aho-corasick";
+    }
+}
+
+size_t mp_size(const mp_control *ctrl)
+{
+    if (ctrl->engine == ENG_AC)
+        return ((size_t)ctrl->nstates * (ctrl->stride + 2) + ctrl->npatterns) * sizeof(uint32_t);
+    return sizeof(ctrl->lo) + sizeof(ctrl->hi) + ctrl->npatterns * sizeof(uint32_t);
+}
+
+#ifdef TEST
+
+#include <stdio.h>
+
+/*
+** Compare the matches of each engine with a naive search of every
+** pattern at every offset, over a random target on a small alphabet
+** (so that there are many matches, including overlapping ones), and
+** with a pattern set that uses all 256 byte values (split into sets of
+** MP_TEDDY_MAX for Teddy).  Teddy is skipped only if the host has
+** neither SSSE3 nor AVX2; any other set-up failure is an error.
+*/
+
+typedef struct Tally
+{
+    size_t      npatterns;
+    size_t      tgtlen;
+    unsigned   *hits;       /* hits[offset * npatterns + pattern] */
+    size_t      count;
+} Tally;
+
+static int tally(size_t pattern, size_t offset, void *context)
+{
+    Tally *t = context;
+    t->hits[offset * t->npatterns + pattern]++;
+    t->count++;
+    return 0;
+}
+
+static int stop_at_third(size_t pattern, size_t offset, void *context)
+{
+    size_t *count = context;
+    (void)pattern;
+    (void)offset;
+    return (++*count == 3) ? 42 : 0;
+}
+
+static int check(const char * const *patterns, const size_t *lengths, size_t np,
+                 const char *target, size_t n, MPEngine engine)
+{
+    mp_control *ctrl = mp_setsearch_engine(patterns, lengths, np, engine);
+    if (ctrl == 0)
+    {
+        if (engine == MP_TEDDY && teddy_engine() == ENG_AC)
+            return 0;                           /* No SSSE3 or AVX2 */
+        printf("%s: %zu patterns: set-up failed\n",
+               (engine == MP_TEDDY) ? "Teddy" : "Aho-Corasick", np);
+        return 1;
+    }
+    Tally t = { np, n, calloc(n * np + 1, sizeof(unsigned)), 0 };
+    if (t.hits == 0)
+    {
+        printf("out of memory\n");
+        exit(1);
+    }
+    mp_settarget(ctrl, target, n);
+    mp_search(ctrl, tally, &t);
+
+    int errors = 0;
+    size_t expect = 0;
+    for (size_t i = 0; i < n && errors < 5; i++)
+    {
+        for (size_t p = 0; p < np; p++)
+        {
+            size_t m = (lengths != 0) ? lengths[p] : strlen(patterns[p]);
+            unsigned want = (m > 0 && i + m <= n && memcmp(target + i, patterns[p], m) == 0);
+            expect += want;
+            if (t.hits[i * np + p] != want)
+            {
+                printf("%s: %zu patterns: pattern %zu <%.*s> at %zu: %u hits, expected %u\n",
+                       mp_engine(ctrl), np, p, (int)m, patterns[p], i, t.hits[i * np + p], want);
+                errors++;
+            }
+        }
+    }
+    if (errors == 0 && expect > 3)
+    {
+        size_t count = 0;
+        mp_settarget(ctrl, target, n);
+        if (mp_search(ctrl, stop_at_third, &count) != 42 || count != 3)
+        {
+            printf("%s: callback did not stop the search\n", mp_engine(ctrl));
+            errors++;
+        }
+    }
+    free(t.hits);
+    mp_release(ctrl);
+    return errors;
+}
+
+int main(void)
+{
+    enum { TGTLEN = 3000, MAXPAT = 200, PATLEN = 8 };
+    static char target[TGTLEN];
+    static char patspace[MAXPAT][PATLEN + 1];
+    const char *patterns[MAXPAT];
+    unsigned long seed = 20260101;
+    int errors = 0;
+
+    for (size_t i = 0; i < TGTLEN; i++)
+    {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        target[i] = "abcd\xE9"[(seed >> 33) % 5];
+    }
+    for (size_t np = 1; np <= MAXPAT; np += (np < 70) ? 1 : 43)
+    {
+        size_t nonempty = 0;
+        for (size_t p = 0; p < np; p++)
+        {
+            seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+            size_t m = (seed >> 33) % PATLEN;       /* Includes empty patterns */
+            if (p % 3 == 0 && p > 0)
+                m = strlen(patspace[p - 1]);       /* Duplicates and shared prefixes */
+            nonempty += (m > 0);
+            for (size_t i = 0; i < m; i++)
+            {
+                seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+                patspace[p][i] = (p % 3 == 0 && p > 0 && i < m / 2 + 1) ? patspace[p - 1][i]
+                               : "abcdez\xE9"[(seed >> 33) % 7];
+            }
+            patspace[p][m] = '\0';
+            patterns[p] = patspace[p];
+        }
+        errors += check(patterns, 0, np, target, TGTLEN, MP_AHOCORASICK);
+        /* Teddy takes 1 to MP_TEDDY_MAX patterns, not counting empty ones */
+        if (nonempty > 0 && nonempty <= MP_TEDDY_MAX)
+            errors += check(patterns, 0, np, target, TGTLEN, MP_TEDDY);
+    }
+
+    /* Patterns that between them use every byte value, including NUL */
+    static char allspace[256][2];
+    const char *allpat[256];
+    size_t alllen[256];
+    for (size_t b = 0; b < 256; b++)
+    {
+        allspace[b][0] = (char)b;
+        allspace[b][1] = (char)((b * 7 + 1) % 256);
+        allpat[b] = allspace[b];
+        alllen[b] = (b % 5 == 0) ? 1 : 2;
+    }
+    for (size_t i = 0; i < TGTLEN; i++)
+    {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        target[i] = (char)(seed >> 33);
+        if (i % 4 == 1)
+            target[i] = (char)((target[i - 1] & 0xFF) * 7 + 1);
+    }
+    errors += check(allpat, alllen, 256, target, TGTLEN, MP_AHOCORASICK);
+    mp_control *ctrl = mp_setsearch_engine(allpat, alllen, 256, MP_AHOCORASICK);
+    if (ctrl == 0 || ctrl->stride != 256 || ctrl->column[0xFF] == ctrl->column[0x00])
+    {
+        printf("Aho-Corasick: 256 byte values do not get 256 columns\n");
+        errors++;
+    }
+    mp_release(ctrl);
+    for (size_t q = 0; q < 256; q += MP_TEDDY_MAX)
+        errors += check(allpat + q, alllen + q, MP_TEDDY_MAX, target, TGTLEN, MP_TEDDY);
+    printf("%s\n", (errors == 0) ? "== PASS ==" : "** FAIL **");
+    return (errors == 0) ? 0 : 1;
+}
+
+#endif /* TEST */
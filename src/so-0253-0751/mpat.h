@@ -0,0 +1,73 @@
+/*
+@(#)File:           mpat.h
+@(#)Purpose:        Multi-Pattern String Search (Aho-Corasick DFA, Teddy)
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#if !defined(MPAT_H)
+#define MPAT_H
+
+#include <stddef.h> /* size_t */
+
+typedef struct mp_control mp_control;
+
+/*
+** Search for many patterns at once, in the style of bm.h: mp_setsearch()
+** compiles a set of patterns, mp_settarget() sets the string to be
+** scanned, and mp_search() scans it, calling the callback for every
+** match of every pattern (overlapping matches included) with the
+** index of the pattern in the set and the offset of the start of the
+** match in the target.  If the callback returns non-zero, the scan
+** stops and mp_search() returns that value; otherwise it returns 0.
+** Matches are not reported in any particular order.
+**
+** The patterns are not copied; the strings must remain valid.  If
+** lengths is a null pointer, the patterns are null-terminated strings.
+** Empty patterns never match.
+**
+** There are two engines:
+**
+** MP_AHOCORASICK compiles the patterns into a complete DFA, one row of
+** transitions per state and one column per distinct byte in the
+** patterns (other bytes share a column), so each byte of the target
+** costs one table lookup.  The states that report matches are numbered
+** last, so a compare finds them.  The table takes 4 bytes per state
+** per column, which is the price of speed for large sets.
+**
+** MP_TEDDY (up to MP_TEDDY_MAX patterns, on x86 with SSSE3 or AVX2)
+** puts the patterns in 8 buckets and uses byte shuffles on nibbles of
+** the first 1 to 3 bytes of each pattern to find, 16 or 32 positions
+** at a time, the positions where a pattern in a bucket may start;
+** memcmp() checks the patterns in the buckets found.
+**
+** MP_AUTO chooses Teddy, if available, for up to 8 patterns, or up to
+** 32 patterns if none is shorter than 2 bytes, and Aho-Corasick otherwise.
+** mp_setsearch_engine() returns a null pointer if the engine asked for
+** is not available (or on memory allocation failure, as mp_setsearch()
+** does).  mp_engine() names the engine in use.
+*/
+
+enum { MP_TEDDY_MAX = 64 };
+
+typedef enum MPEngine { MP_AUTO, MP_AHOCORASICK, MP_TEDDY } MPEngine;
+
+typedef int (*mp_callback)(size_t pattern, size_t offset, void *context);
+
+typedef void *(*mp_malloc)(size_t nbytes);
+typedef void (*mp_free)(void *data);
+
+extern mp_control *mp_setsearch(const char * const *patterns, const size_t *lengths,
+                                size_t npatterns);
+extern mp_control *mp_setsearch_engine(const char * const *patterns, const size_t *lengths,
+                                       size_t npatterns, MPEngine engine);
+extern void mp_settarget(mp_control *ctrl, const char *target, size_t tgtlen);
+extern int mp_search(mp_control *ctrl, mp_callback callback, void *context);
+extern void mp_release(mp_control *ctrl);
+extern void mp_setalloc(mp_malloc mem_alloc, mp_free mem_free);
+extern const char *mp_engine(const mp_control *ctrl);
+extern size_t mp_size(const mp_control *ctrl);  /* Bytes of compiled tables */
+
+#endif /* MPAT_H */
@@ -0,0 +1,248 @@
+/*
+@(#)File:           mptest.c
+@(#)Purpose:        Multi-pattern search (Teddy, Aho-Corasick) vs one search per word
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bm.h"
+#include "mpat.h"
+#include "pbench.h"
+#include "simd.h"
+#include "stderr.h"
+#include "timer.h"
+
+static const char usestr[] = "[-m minlen][-n count][-r runs] file words-file";
+
+/* One search per word is slow: only do it for small sets */
+enum { MAX_SINGLE = 256 };
+
+/*
+** Read the words, from either a plain list of words or the output of
+** procbible.sh ("count word").  A line starting with a number is a count
+** line, and the word is the next field; a count line with no word (as
+** for the empty word, which heads bible.words) is skipped.
+*/
+static char **read_words(const char *fname, size_t minlen, size_t *nwords)
+{
+    FILE *fp = fopen(fname, "r");
+    if (fp == 0)
+        err_syserr("failed to open file %s for reading\n", fname);
+    char **words = 0;
+    size_t count = 0;
+    size_t space = 0;
+    char line[4096];
+    while (fgets(line, sizeof(line), fp) != 0)
+    {
+        char *word = strtok(line, " \t\r\n");
+        if (word != 0 && strspn(word, "0123456789") == strlen(word))
+            word = strtok(0, " \t\r\n");
+        if (word == 0 || strlen(word) < minlen)
+            continue;
+        if (count >= space)
+        {
+            space = 2 * space + 1024;
+            words = realloc(words, space * sizeof(*words));
+            if (words == 0)
+                err_syserr("out of memory\n");
+        }
+        if ((words[count++] = strdup(word)) == 0)
+            err_syserr("out of memory\n");
+    }
+    fclose(fp);
+    *nwords = count;
+    return words;
+}
+
+static int count_match(size_t pattern, size_t offset, void *context)
+{
+    size_t *count = context;
+    (void)pattern;
+    (void)offset;
+    (*count)++;
+    return 0;
+}
+
+typedef struct Result
+{
+    const char *name;
+    size_t      count;
+    unsigned long long best;
+} Result;
+
+static void report(const Result *r, size_t length)
+{
+    printf("%-14s %10zu matches %9.3f ms %6.2f GB/s\n", r->name, r->count,
+           r->best / 1.0E6, gb_per_sec(length, r->best));
+}
+
+static Result time_multi(const char * const *words, size_t nwords, MPEngine engine,
+                         const char *source, size_t length, int runs)
+{
+    Result r = { 0, 0, 0 };
+    char clkbuff[32];
+    Clock clk;
+
+    clk_init(&clk);
+    clk_start(&clk);
+    mp_control *mp = mp_setsearch_engine(words, 0, nwords, engine);
+    clk_stop(&clk);
+    if (mp == 0)
+        return r;
+    r.name = mp_engine(mp);
+    printf("%-14s prep-time %s, tables %zu bytes\n", r.name,
+           clk_elapsed_us(&clk, clkbuff, sizeof(clkbuff)), mp_size(mp));
+    for (int i = 0; i < runs; i++)
+    {
+        r.count = 0;
+        clk_start(&clk);
+        mp_settarget(mp, source, length);
+        mp_search(mp, count_match, &r.count);
+        clk_stop(&clk);
+        set_best(&r.best, &clk);
+    }
+    mp_release(mp);
+    return r;
+}
+
+static Result time_bm(const char * const *words, size_t nwords,
+                      const char *source, size_t length, int runs)
+{
+    Result r = { "bm-per-word", 0, 0 };
+    Clock clk;
+
+    clk_init(&clk);
+    for (int i = 0; i < runs; i++)
+    {
+        r.count = 0;
+        clk_start(&clk);
+        for (size_t w = 0; w < nwords; w++)
+        {
+            bm_control *bp = bm_setsearch(words[w], strlen(words[w]));
+            if (bp == 0)
+                err_error("failed to set up search for %s\n", words[w]);
+            bm_settarget(bp, source, length);
+            while (bm_search(bp) != 0)
+                r.count++;
+            bm_release(bp);
+        }
+        clk_stop(&clk);
+        set_best(&r.best, &clk);
+    }
+    return r;
+}
+
+static Result time_simd(const char * const *words, size_t nwords,
+                        const char *source, size_t length, int runs)
+{
+    Result r = { "simd-per-word", 0, 0 };
+    Clock clk;
+
+    clk_init(&clk);
+    for (int i = 0; i < runs; i++)
+    {
+        r.count = 0;
+        clk_start(&clk);
+        for (size_t w = 0; w < nwords; w++)
+        {
+            simd_control *sp = simd_setsearch(words[w], strlen(words[w]));
+            if (sp == 0)
+                err_error("failed to set up search for %s\n", words[w]);
+            simd_settarget(sp, source, length);
+            while (simd_search(sp) != 0)
+                r.count++;
+            simd_release(sp);
+        }
+        clk_stop(&clk);
+        set_best(&r.best, &clk);
+    }
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = 0;
+    size_t minlen = 1;
+    int runs = 5;
+    int opt;
+
+    err_setarg0(argv[0]);
+    while ((opt = getopt(argc, argv, "m:n:r:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'm':
+            minlen = strtoul(optarg, 0, 0);
+            break;
+        case 'n':
+            count = strtoul(optarg, 0, 0);
+            break;
+        case 'r':
+            runs = atoi(optarg);
+            break;
+        default:
+            err_usage(usestr);
+        }
+    }
+    if (argc - optind != 2 || runs <= 0)
+        err_usage(usestr);
+
+    size_t length;
+    const char *source = memory_map(argv[optind], &length);
+    size_t total;
+    char **all = read_words(argv[optind + 1], minlen, &total);
+    if (total == 0)
+        err_error("no words in file %s\n", argv[optind + 1]);
+
+    /* Spread a subset evenly over the list (sorted by frequency) */
+    if (count == 0 || count > total)
+        count = total;
+    const char **words = malloc(count * sizeof(*words));
+    if (words == 0)
+        err_syserr("out of memory\n");
+    for (size_t i = 0; i < count; i++)
+        words[i] = all[i * total / count];
+
+    printf("Data file: %s (size %zu)\n", argv[optind], length);
+    printf("Words: %zu of %zu from %s\n", count, total, argv[optind + 1]);
+
+    Result results[4];
+    int nresults = 0;
+    results[nresults++] = time_multi(words, count, MP_AHOCORASICK, source, length, runs);
+    if (count <= MP_TEDDY_MAX)
+    {
+        results[nresults] = time_multi(words, count, MP_TEDDY, source, length, runs);
+        if (results[nresults].name != 0)
+            nresults++;
+    }
+    if (count <= MAX_SINGLE)
+    {
+        results[nresults++] = time_bm(words, count, source, length, runs);
+        results[nresults++] = time_simd(words, count, source, length, runs);
+    }
+    if (results[0].name == 0)
+        err_error("failed to compile %zu words\n", count);
+
+    for (int i = 0; i < nresults; i++)
+    {
+        report(&results[i], length);
+        if (results[i].count != results[0].count)
+            err_remark("match counts differ: %s %zu, %s %zu\n", results[0].name,
+                       results[0].count, results[i].name, results[i].count);
+    }
+
+    free(words);
+    for (size_t i = 0; i < total; i++)
+        free(all[i]);
+    free(all);
+    return(0);
+}
@@ -0,0 +1,50 @@
+/*
+@(#)File:           pbench.c
+@(#)Purpose:        Helpers shared by the string search benchmarks
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#define _XOPEN_SOURCE 700
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pbench.h"
+#include "stderr.h"
+
+void *memory_map(const char *fname, size_t *size)
+{
+    void *data;
+    struct stat sb;
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0)
+        err_syserr("failed to open file %s for reading\n", fname);
+    if (fstat(fd, &sb) != 0)
+        err_syserr("failed to stat file %s\n", fname);
+    if (!S_ISREG(sb.st_mode))
+        err_error("file %s is not a regular file (%o)\n", fname, sb.st_mode);
+    data = mmap(0, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+        err_error("failed to memory map file %s\n", fname);
+    close(fd);
+    *size = sb.st_size;
+    return(data);
+}
+
+/* Bytes per nanosecond is gigabytes per second */
+double gb_per_sec(size_t bytes, unsigned long long nsec)
+{
+    return (nsec == 0) ? 0.0 : (double)bytes / nsec;
+}
+
+void set_best(unsigned long long *best, Clock *clk)
+{
+    unsigned long long nsec = clk_elapsed_nsec(clk);
+    if (*best == 0 || nsec < *best)
+        *best = nsec;
+}
@@ -0,0 +1,25 @@
+/*
+@(#)File:           pbench.h
+@(#)Purpose:        Helpers shared by the string search benchmarks
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#if !defined(PBENCH_H)
+#define PBENCH_H
+
+#include <stddef.h> /* size_t */
+#include "timer.h"
+
+/* Map a regular file read-only, setting *size; errors are fatal */
+extern void *memory_map(const char *fname, size_t *size);
+
+/* Throughput of a scan of bytes in nsec nanoseconds (0 if no time) */
+extern double gb_per_sec(size_t bytes, unsigned long long nsec);
+
+/* Keep the shortest elapsed time of a stopped clock in *best (0 = none yet) */
+extern void set_best(unsigned long long *best, Clock *clk);
+
+#endif /* PBENCH_H */
@@ -2,7 +2,7 @@
 @(#)File:           $RCSfile: ptest.c,v $
 @(#)Version:        $Revision: 1.1 $
 @(#)Last changed:   $Date: 2011/05/23 00:25:47 $
-@(#)Purpose:        Relative speed of KMP vs BM vs strstr()
+@(#)Purpose:        Relative speed of KMP vs BM vs SIMD vs memmem() vs strstr()
 @(#)Author:         J Leffler
 @(#)Copyright:      (C) JLSS 2010
 @(#)Product:        :PRODUCT:
@@ -10,6 +10,7 @@
 
 /*TABSTOP=4*/
 
+#define _GNU_SOURCE     /* memmem() */
 #if __STDC_VERSION__ >= 199901L
 #define _XOPEN_SOURCE 600
 #else
@@ -31,6 +32,8 @@
 
 #include "bm.h"
 #include "kmp.h"
+#include "pbench.h"
+#include "simd.h"
 #include "stderr.h"
 #include "timer.h"
 
@@ -40,24 +43,6 @@ extern const char jlss_id_ptest_c[];
 const char jlss_id_ptest_c[] = "@(#)$Id: ptest.c,v 1.1 2011/05/23 00:25:47 jleffler Exp $";
 #endif /* lint */
 
-static void *memory_map(const char *fname, size_t *size)
-{
-    void *data;
-    struct stat sb;
-    int fd = open(fname, O_RDONLY);
-    if (fd < 0)
-        err_syserr("failed to open file %s for reading\n", fname);
-    if (fstat(fd, &sb) != 0)
-        err_syserr("failed to stat file %s\n", fname);
-    if (!S_ISREG(sb.st_mode))
-        err_error("file %s is not a regular file (%o)\n", fname, sb.st_mode);
-    data = mmap(0, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    if (data == MAP_FAILED)
-        err_error("failed to memory map file %s\n", fname);
-    *size = sb.st_size;
-    return(data);
-}
-
 int main(int argc, char **argv)
 {
     char *source;
@@ -91,6 +76,19 @@ int main(int argc, char **argv)
         clk_stop(&clk);
         printf("KMP prep-time: %s\n", clk_elapsed_us(&clk, clkbuff, sizeof(clkbuff)));
 
+        clk_start(&clk);
+        simd_control *sp = simd_setsearch(needle, strlen(needle));
+        clk_stop(&clk);
+        if (bp == 0 || kp == 0 || sp == 0)
+            err_error("failed to set up search for %s\n", needle);
+        printf("SIM prep-time: %s (%s)\n", clk_elapsed_us(&clk, clkbuff, sizeof(clkbuff)), simd_engine(sp));
+        unsigned long long b_best = 0;
+        unsigned long long k_best = 0;
+        unsigned long long v_best = 0;
+        unsigned long long m_best = 0;
+        unsigned long long s_best = 0;
+        size_t counts[5] = { 0, 0, 0, 0, 0 };
+
         /* Warm up source data */
         clk_start(&clk);
         str = strchr(source, 0xFF);
@@ -102,6 +100,8 @@ int main(int argc, char **argv)
             size_t s_count = 0;
             size_t b_count = 0;
             size_t k_count = 0;
+            size_t v_count = 0;
+            size_t m_count = 0;
 
             clk_start(&clk);
             kmp_settarget(kp, source, length);
@@ -118,12 +118,33 @@ int main(int argc, char **argv)
                 k_count++;
             clk_stop(&clk);
             printf("KMP%zd found %zd, search-time: %s\n", j, k_count, clk_elapsed_us(&clk, clkbuff, sizeof(clkbuff)));
+            set_best(&k_best, &clk);
 
             clk_start(&clk);
             while ((str = bm_search(bp)) != 0)
                 b_count++;
             clk_stop(&clk);
             printf("BM%zd  found %zd, search-time: %s\n", j, b_count, clk_elapsed_us(&clk, clkbuff, sizeof(clkbuff)));
+            set_best(&b_best, &clk);
+
+            clk_start(&clk);
+            simd_settarget(sp, source, length);
+            while ((str = simd_search(sp)) != 0)
+                v_count++;
+            clk_stop(&clk);
+            printf("SIM%zd found %zd, search-time: %s\n", j, v_count, clk_elapsed_us(&clk, clkbuff, sizeof(clkbuff)));
+            set_best(&v_best, &clk);
+
+            clk_start(&clk);
+            str = source;
+            while ((str = memmem(str, end - str, needle, strlen(needle))) != 0)
+            {
+                str++;
+                m_count++;
+            }
+            clk_stop(&clk);
+            printf("MEM%zd found %zd, search-time: %s\n", j, m_count, clk_elapsed_us(&clk, clkbuff, sizeof(clkbuff)));
+            set_best(&m_best, &clk);
 
             clk_start(&clk);
             str = source;
@@ -139,10 +160,30 @@ int main(int argc, char **argv)
             }
             clk_stop(&clk);
             printf("STR%zd found %zd, search-time: %s\n", j, s_count, clk_elapsed_us(&clk, clkbuff, sizeof(clkbuff)));
+            set_best(&s_best, &clk);
 
+            counts[0] = b_count;
+            counts[1] = k_count;
+            counts[2] = v_count;
+            counts[3] = m_count;
+            counts[4] = s_count;
+        }
+        for (int k = 1; k < 5; k++)
+        {
+            if (counts[k] != counts[0])
+            {
+                err_remark("match counts differ for %s: BM %zu, KMP %zu, SIM %zu, MEM %zu, STR %zu\n",
+                           needle, counts[0], counts[1], counts[2], counts[3], counts[4]);
+                break;
+            }
         }
+        /* Best of the runs */
+        printf("GB/s length %zu (%s): BM %.2f, KMP %.2f, SIM %.2f, MEM %.2f, STR %.2f\n",
+               strlen(needle), needle, gb_per_sec(length, b_best), gb_per_sec(length, k_best),
+               gb_per_sec(length, v_best), gb_per_sec(length, m_best), gb_per_sec(length, s_best));
         bm_release(bp);
         kmp_release(kp);
+        simd_release(sp);
     }
 
     return(0);
@@ -0,0 +1,558 @@
+/*
+@(#)File:           simd.c
+@(#)Purpose:        SIMD First-and-Last Byte String Search (Two-Way Fallback)
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+/*
+** The Two-Way search is adapted from the code by Christian Charras and
+** Thierry Lecroq (see bm.c):
+** http://www-igm.univ-mlv.fr/~lecroq/string/node26.html
+**
+** The first-and-last byte filter is the "generic SIMD" algorithm
+** described by Wojciech Muła:
+** http://0x80.pl/articles/simd-strfind.html
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h> /* malloc, free */
+#include <string.h>
+#include "simd.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+#undef MAX
+#define MAX(a,b)    (((a)>(b))?(a):(b))
+
+enum { VERIFY_BYTES = 8 };      /* Bytes checked one at a time */
+enum { WORK_RATIO = 4 };        /* Candidate bytes per target byte ... */
+enum { WORK_SLACK = 4096 };     /* ... plus this, before switching to Two-Way */
+
+enum { ENG_NONE, ENG_MEMCHR, ENG_SCALAR, ENG_SSE2, ENG_AVX2, ENG_TWOWAY };
+
+static simd_malloc use_malloc = malloc;
+static simd_free   use_free   = free;
+
+struct simd_control
+{
+    const unsigned char *search;    /* String to be searched for */
+    size_t      schlen;             /* Length of said string */
+    const unsigned char *target;    /* String to scanned */
+    size_t      tgtlen;             /* Length of scanned string */
+    int         filter;             /* Engine chosen for the search string */
+    int         engine;             /* Engine in use for this target */
+    size_t      posn;               /* Search resume location */
+    size_t      work;               /* Bytes compared for candidates */
+    ptrdiff_t   ell;                /* Two-Way: end of left part (may be -1) */
+    ptrdiff_t   per;                /* Two-Way: shift after a match */
+    bool        periodic;           /* Two-Way: search string has period per */
+    ptrdiff_t   memory;             /* Two-Way: prefix known to match */
+};
+
+static const simd_control simd_empty = { 0 };
+
+void simd_release(simd_control *ctrl)
+{
+    (*use_free)(ctrl);
+}
+
+void simd_setalloc(simd_malloc mem_alloc, simd_free mem_free)
+{
+    use_malloc = mem_alloc;
+    use_free   = mem_free;
+}
+
+/*
+** Maximal suffix of x[0..m-1] under the byte order (or the reverse
+** order); returns the position before the suffix, and sets *p to its
+** period.
+*/
+static ptrdiff_t max_suffix(const unsigned char *x, ptrdiff_t m, ptrdiff_t *p, bool reverse)
+{
+    ptrdiff_t ms = -1;
+    ptrdiff_t j = 0;
+    ptrdiff_t k = 1;
+
+    *p = 1;
+    while (j + k < m)
+    {
+        unsigned char a = x[j + k];
+        unsigned char b = x[ms + k];
+        if (a == b)
+        {
+            if (k != *p)
+                ++k;
+            else
+            {
+                j += *p;
+                k = 1;
+            }
+        }
+        else if ((a < b) != reverse)
+        {
+            j += k;
+            k = 1;
+            *p = j - ms;
+        }
+        else
+        {
+            ms = j;
+            j = ms + 1;
+            k = *p = 1;
+        }
+    }
+    return ms;
+}
+
+/* Critical factorization of the search string */
+static void twoway_prepare(simd_control *ctrl)
+{
+    const unsigned char *x = ctrl->search;
+    ptrdiff_t m = ctrl->schlen;
+    ptrdiff_t p;
+    ptrdiff_t q;
+    ptrdiff_t i = max_suffix(x, m, &p, false);
+    ptrdiff_t j = max_suffix(x, m, &q, true);
+
+    ctrl->ell = (i > j) ? i : j;
+    ctrl->per = (i > j) ? p : q;
+    ctrl->periodic = (memcmp(x, x + ctrl->per, ctrl->ell + 1) == 0);
+    if (!ctrl->periodic)
+        ctrl->per = MAX(ctrl->ell + 1, m - ctrl->ell - 1) + 1;
+}
+
+/* Resumable Two-Way search: position posn, with memory in periodic case */
+static const char *twoway_search(simd_control *ctrl)
+{
+    const unsigned char *x = ctrl->search;
+    const unsigned char *y = ctrl->target;
+    ptrdiff_t m = ctrl->schlen;
+    ptrdiff_t n = ctrl->tgtlen;
+    ptrdiff_t ell = ctrl->ell;
+    ptrdiff_t per = ctrl->per;
+    ptrdiff_t j = ctrl->posn;
+    ptrdiff_t memory = ctrl->memory;
+
+    while (j <= n - m)
+    {
+        /* Right part, left to right */
+        ptrdiff_t i = MAX(ell, memory) + 1;
+        while (i < m && x[i] == y[i + j])
+            ++i;
+        if (i < m)
+        {
+            j += i - ell;
+            memory = -1;
+            continue;
+        }
+        /* Left part, right to left */
+        i = ell;
+        while (i > memory && x[i] == y[i + j])
+            --i;
+        bool found = (i <= memory);
+        ptrdiff_t at = j;
+        j += per;
+        memory = ctrl->periodic ? m - per - 1 : -1;
+        if (found)
+        {
+            ctrl->posn = j;
+            ctrl->memory = memory;
+            return (const char *)y + at;
+        }
+    }
+    ctrl->posn = (n >= m) ? (size_t)(n - m + 1) : 0;
+    ctrl->memory = -1;
+    return 0;
+}
+
+static const char *switch_to_twoway(simd_control *ctrl)
+{
+    ctrl->engine = ENG_TWOWAY;
+    ctrl->memory = -1;
+    return twoway_search(ctrl);
+}
+
+/*
+** Check the candidate at p, whose first and last bytes match.  Most
+** false candidates fail in the first few bytes, which are compared one
+** at a time so the work can be counted; memcmp() does the rest.  A
+** match counts too: with many overlapping matches (a run of one byte,
+** say), the memcmp() calls would otherwise make the scan quadratic.
+*/
+static inline bool verify(simd_control *ctrl, const unsigned char *p)
+{
+    const unsigned char *x = ctrl->search;
+    size_t m = ctrl->schlen;
+    size_t k1 = (m - 1 < VERIFY_BYTES) ? m - 1 : VERIFY_BYTES;
+    size_t k = 1;
+
+    while (k < k1 && x[k] == p[k])
+        k++;
+    if (k < k1)
+    {
+        ctrl->work += k;
+        return false;
+    }
+    ctrl->work += m;
+    return memcmp(p + k, x + k, m - 1 - k) == 0;
+}
+
+static inline bool too_much_work(const simd_control *ctrl, size_t j)
+{
+    return ctrl->work > WORK_RATIO * j + WORK_SLACK;
+}
+
+static const char *memchr_search(simd_control *ctrl)
+{
+    const unsigned char *y = ctrl->target;
+    size_t j = ctrl->posn;
+
+    if (j < ctrl->tgtlen)
+    {
+        const unsigned char *p = memchr(y + j, ctrl->search[0], ctrl->tgtlen - j);
+        if (p != 0)
+        {
+            ctrl->posn = p - y + 1;
+            return (const char *)p;
+        }
+    }
+    ctrl->posn = ctrl->tgtlen;
+    return 0;
+}
+
+/* The filter one position at a time (and the tail of the SIMD scans) */
+static const char *scalar_search(simd_control *ctrl)
+{
+    const unsigned char *x = ctrl->search;
+    const unsigned char *y = ctrl->target;
+    size_t m = ctrl->schlen;
+    size_t n = ctrl->tgtlen;
+    size_t j = ctrl->posn;
+
+    if (too_much_work(ctrl, j))
+        return switch_to_twoway(ctrl);
+    while (j + m <= n)
+    {
+        const unsigned char *p = memchr(y + j, x[0], n - m + 1 - j);
+        if (p == 0)
+            break;
+        j = p - y;
+        if (p[m - 1] == x[m - 1] && verify(ctrl, p))
+        {
+            ctrl->posn = j + 1;
+            return (const char *)p;
+        }
+        ctrl->work++;
+        j++;
+        if (too_much_work(ctrl, j))
+        {
+            ctrl->posn = j;
+            return switch_to_twoway(ctrl);
+        }
+    }
+    ctrl->posn = (n >= m) ? n - m + 1 : 0;
+    return 0;
+}
+
+#if defined(SIMD_X86)
+
+/*
+** Compare the block of positions starting at j with the first byte,
+** and the block starting at j+m-1 with the last; each set bit in the
+** mask of both is a candidate.  A match returns with posn just after
+** it, so the next call starts a new block there, after checking the
+** work done for the matches.
+*/
+#define FILTER_LOOP(width, mask_expr) \
+    if (too_much_work(ctrl, j)) \
+        return switch_to_twoway(ctrl); \
+    while (j + width + m - 1 <= n) \
+    { \
+        uint32_t mask = (uint32_t)(mask_expr); \
+        while (mask != 0) \
+        { \
+            size_t at = j + __builtin_ctz(mask); \
+            if (verify(ctrl, y + at)) \
+            { \
+                ctrl->posn = at + 1; \
+                return (const char *)y + at; \
+            } \
+            mask &= mask - 1; \
+        } \
+        j += width; \
+        if (too_much_work(ctrl, j)) \
+        { \
+            ctrl->posn = j; \
+            return switch_to_twoway(ctrl); \
+        } \
+    }
+
+static const char *sse2_search(simd_control *ctrl)
+{
+    const unsigned char *x = ctrl->search;
+    const unsigned char *y = ctrl->target;
+    size_t m = ctrl->schlen;
+    size_t n = ctrl->tgtlen;
+    size_t j = ctrl->posn;
+    const __m128i first = _mm_set1_epi8((char)x[0]);
+    const __m128i last = _mm_set1_epi8((char)x[m - 1]);
+
+    FILTER_LOOP(16,
+        _mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpeq_epi8(first, _mm_loadu_si128((const __m128i *)(y + j))),
+            _mm_cmpeq_epi8(last, _mm_loadu_si128((const __m128i *)(y + j + m - 1))))))
+    ctrl->posn = j;
+    return scalar_search(ctrl);
+}
+
+__attribute__((target("avx2")))
+static const char *avx2_search(simd_control *ctrl)
+{
+    const unsigned char *x = ctrl->search;
+    const unsigned char *y = ctrl->target;
+    size_t m = ctrl->schlen;
+    size_t n = ctrl->tgtlen;
+    size_t j = ctrl->posn;
+    const __m256i first = _mm256_set1_epi8((char)x[0]);
+    const __m256i last = _mm256_set1_epi8((char)x[m - 1]);
+
+    FILTER_LOOP(32,
+        _mm256_movemask_epi8(_mm256_and_si256(
+            _mm256_cmpeq_epi8(first, _mm256_loadu_si256((const __m256i *)(y + j))),
+            _mm256_cmpeq_epi8(last, _mm256_loadu_si256((const __m256i *)(y + j + m - 1))))))
+    ctrl->posn = j;
+    return scalar_search(ctrl);
+}
+
+#undef FILTER_LOOP
+
+static int choose_filter(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return ENG_AVX2;
+    return ENG_SSE2;
+}
+
+#else
+
+static int choose_filter(void)
+{
+    return ENG_SCALAR;
+}
+
+#endif /* SIMD_X86 */
+
+/* Initialize search for string search of length schlen */
+simd_control *simd_setsearch(const char *search, size_t schlen)
+{
+    simd_control *ctrl = (*use_malloc)(sizeof(simd_control));
+    if (ctrl != 0)
+    {
+        *ctrl = simd_empty;
+        ctrl->search = (const unsigned char *)search;
+        ctrl->schlen = schlen;
+        ctrl->memory = -1;
+        if (schlen == 0)
+            ctrl->filter = ENG_NONE;
+        else if (schlen == 1)
+            ctrl->filter = ENG_MEMCHR;
+        else
+        {
+            twoway_prepare(ctrl);
+            ctrl->filter = choose_filter();
+        }
+        ctrl->engine = ctrl->filter;
+    }
+    return ctrl;
+}
+
+/* Initialize search to scan target string of length tgtlen */
+void simd_settarget(simd_control *ctrl, const char *target, size_t tgtlen)
+{
+    ctrl->target = (const unsigned char *)target;
+    ctrl->tgtlen = tgtlen;
+    ctrl->posn = 0;
+    ctrl->work = 0;
+    ctrl->memory = -1;
+    ctrl->engine = ctrl->filter;
+}
+
+const char *simd_search(simd_control *ctrl)
+{
+    if (ctrl->target == 0)
+        return 0;
+    switch (ctrl->engine)
+    {
+    case ENG_MEMCHR:
+        return memchr_search(ctrl);
+    case ENG_SCALAR:
+        return scalar_search(ctrl);
+#if defined(SIMD_X86)
+    case ENG_SSE2:
+        return sse2_search(ctrl);
+    case ENG_AVX2:
+        return avx2_search(ctrl);
+#endif /* SIMD_X86 */
+    case ENG_TWOWAY:
+        return twoway_search(ctrl);
+    }
+    return 0;
+}
+
+/* Name of the engine in use: it can change to Two-Way during a scan */
+const char *simd_engine(const simd_control *ctrl)
+{
+    static const char * const names[] =
+    {
+        [ENG_NONE] = "none",
+        [ENG_MEMCHR] = "memchr",
+        [ENG_SCALAR] = "scalar",
+        [ENG_SSE2] = "sse2",
+        [ENG_AVX2] = "avx2",
+        [ENG_TWOWAY] = "two-way",
+    };
+    return names[ctrl->engine];
+}
+
+#ifdef TEST
+
+#include <stdio.h>
+#include <time.h>
+
+/*
+** Compare every match with a naive search, for search strings cut
+** from a target built to provoke the worst cases: runs of one letter,
+** repeats of short strings, and random text over a small alphabet.
+*/
+static int check(const char *search, size_t schlen, const char *target, size_t tgtlen)
+{
+    simd_control *ctrl = simd_setsearch(search, schlen);
+    int errors = 0;
+    const char *found;
+    size_t j = 0;
+
+    if (ctrl == 0)
+    {
+        printf("simd_setsearch() failed!\n");
+        return 1;
+    }
+    simd_settarget(ctrl, target, tgtlen);
+    while ((found = simd_search(ctrl)) != 0)
+    {
+        while (j + schlen <= tgtlen && memcmp(target + j, search, schlen) != 0)
+            j++;
+        if (found != target + j)
+        {
+            printf("search <%.*s> (%zu) engine %s: found %td, expected %zu\n",
+                   (int)schlen, search, schlen, simd_engine(ctrl), found - target, j);
+            errors++;
+            break;
+        }
+        j++;
+    }
+    if (errors == 0 && schlen > 0)
+    {
+        while (j + schlen <= tgtlen && memcmp(target + j, search, schlen) != 0)
+            j++;
+        if (j + schlen <= tgtlen)
+        {
+            printf("search <%.*s> (%zu) engine %s: missed match at %zu\n",
+                   (int)schlen, search, schlen, simd_engine(ctrl), j);
+            errors++;
+        }
+    }
+    simd_release(ctrl);
+    return errors;
+}
+
+/*
+** A run of one byte matches at every offset.  Unless the work of the
+** matches switches the scan to Two-Way, the memcmp() of each match
+** makes it O(n*m): about 4 seconds for these sizes.
+*/
+static int check_dense(size_t tgtlen, size_t schlen)
+{
+    char *target = malloc(tgtlen);
+    int errors = 0;
+    size_t count = 0;
+
+    if (target == 0)
+    {
+        printf("out of memory\n");
+        return 1;
+    }
+    memset(target, 'a', tgtlen);
+    simd_control *ctrl = simd_setsearch(target, schlen);
+    if (ctrl == 0)
+    {
+        printf("simd_setsearch() failed!\n");
+        free(target);
+        return 1;
+    }
+    clock_t start = clock();
+    simd_settarget(ctrl, target, tgtlen);
+    while (simd_search(ctrl) != 0)
+        count++;
+    double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (count != tgtlen - schlen + 1 || strcmp(simd_engine(ctrl), "two-way") != 0 || secs > 1.0)
+    {
+        printf("run of %zu bytes, search length %zu: %zu matches (expected %zu), "
+               "engine %s, %.3f seconds\n", tgtlen, schlen, count, tgtlen - schlen + 1,
+               simd_engine(ctrl), secs);
+        errors++;
+    }
+    simd_release(ctrl);
+    free(target);
+    return errors;
+}
+
+int main(void)
+{
+    enum { TGTLEN = 20000 };
+    static char target[TGTLEN];
+    unsigned long seed = 20260101;
+    int errors = 0;
+
+    for (int kind = 0; kind < 4; kind++)
+    {
+        for (size_t i = 0; i < TGTLEN; i++)
+        {
+            seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+            switch (kind)
+            {
+            case 0: target[i] = "ab"[(seed >> 33) % 2]; break;
+            case 1: target[i] = ((seed >> 33) % 64 == 0) ? 'b' : 'a'; break;
+            case 2: target[i] = "abcab"[i % 5]; break;
+            case 3: target[i] = "etaoin shrdlu"[(seed >> 33) % 13]; break;
+            }
+        }
+        for (size_t schlen = 0; schlen <= 300; schlen += (schlen < 40) ? 1 : 37)
+        {
+            for (size_t start = 0; start < 3000; start += 271)
+                errors += check(target + start, schlen, target, TGTLEN);
+        }
+        /* Search strings not cut from the target */
+        errors += check("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab", 42, target, TGTLEN);
+        errors += check("abababababababababababababababababababc", 39, target, TGTLEN);
+        errors += check("zz", 2, target, TGTLEN);
+    }
+    /* Targets shorter than the search string, and the end of target */
+    errors += check("abc", 3, "ab", 2);
+    errors += check("abc", 3, "xxabc", 5);
+    errors += check("abcabc", 6, "abcabcabc", 9);
+    /* Many overlapping matches */
+    errors += check_dense(2000000, 1000);
+    errors += check_dense(2000000, 200000);
+    printf("%s\n", (errors == 0) ? "== PASS ==" : "** FAIL **");
+    return (errors == 0) ? 0 : 1;
+}
+
+#endif /* TEST */
@@ -0,0 +1,50 @@
+/*
+@(#)File:           simd.h
+@(#)Purpose:        SIMD First-and-Last Byte String Search (Two-Way Fallback)
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#if !defined(SIMD_H)
+#define SIMD_H
+
+#include <stddef.h> /* size_t */
+
+typedef struct simd_control simd_control;
+
+/*
+** The interface is the same as for bm.h and kmp.h: simd_setsearch()
+** sets up a search string, simd_settarget() starts a scan of a target
+** string, and each call to simd_search() returns the next match (or a
+** null pointer), including overlapping matches.  Neither string is
+** copied; the pointers must remain valid.
+**
+** The search compares 32 (AVX2) or 16 (SSE2) positions of the target
+** at a time with the first and last bytes of the search string, and
+** checks the rest of the string with memcmp() only where both match.
+** That is fast on text, but a long search string whose first and last
+** bytes match nearly everywhere in the target, or a periodic search
+** string in a target that repeats it with small differences, makes it
+** quadratic, and so do many overlapping matches (as in a run of one
+** byte).  So the search counts the bytes compared for candidates,
+** matches included, and once that is more than a few per byte
+** scanned, it finishes the scan with the Two-Way algorithm (Crochemore
+** and Perrin), which is linear in the worst case.  simd_engine()
+** reports which search is in use.
+**
+** An empty search string never matches.
+*/
+
+typedef void *(*simd_malloc)(size_t nbytes);
+typedef void (*simd_free)(void *data);
+
+extern simd_control *simd_setsearch(const char *search, size_t schlen);
+extern void simd_settarget(simd_control *ctrl, const char *target, size_t tgtlen);
+extern const char *simd_search(simd_control *ctrl);
+extern void simd_release(simd_control *ctrl);
+extern void simd_setalloc(simd_malloc mem_alloc, simd_free mem_free);
+extern const char *simd_engine(const simd_control *ctrl);
+
+#endif /* SIMD_H */
@@ -25,8 +25,14 @@ static void err_exit(const char *fmt, ...);
 static void merge(size_t nkids, Child *kids);
 static void wait_for_kids(size_t nkids, Child *kids);
 
-static int make_kid(Child *kid)
+/*
+** Each child must close the pipes to and from the children created
+** before it; otherwise an earlier child never sees EOF on its input
+** until the later ones exit, and with enough data everything deadlocks.
+*/
+static int make_kid(Child *kids, int n)
 {
+    Child *kid = &kids[n];
     int pipe1[2];   /* From parent to child */
     int pipe2[2];   /* From child to parent */
     if (pipe(pipe1) != 0)
@@ -47,6 +53,11 @@ static int make_kid(Child *kid)
     }
     else if (kid->pid == 0)
     {
+        for (int i = 0; i < n; i++)
+        {
+            close(fileno(kids[i].fp_to));
+            close(fileno(kids[i].fp_from));
+        }
         dup2(pipe1[P_READ], STDIN_FILENO);
         dup2(pipe2[P_WRITE], STDOUT_FILENO);
         close(pipe1[P_READ]);
@@ -67,27 +78,39 @@ static int make_kid(Child *kid)
     }
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
-    enum { NUM_KIDS = 5 };
-    Child kids[NUM_KIDS];
+    enum { NUM_KIDS = 5, MAX_KIDS = 256 };
+    int nkids = NUM_KIDS;
+    int opt;
     struct sigaction act;
 
+    while ((opt = getopt(argc, argv, "j:")) != -1)
+    {
+        if (opt != 'j' || (nkids = atoi(optarg)) < 1 || nkids > MAX_KIDS)
+            err_exit("Usage: %s [-j kids]  (1 <= kids <= %d; default %d)\n",
+                     argv[0], MAX_KIDS, NUM_KIDS);
+    }
+    if (optind != argc)
+        err_exit("Usage: %s [-j kids]\n", argv[0]);
+
+    Child kids[nkids];
+
     sigfillset(&act.sa_mask);
     act.sa_flags   = 0;
     act.sa_handler = SIG_DFL;
     sigaction(SIGCHLD, &act, 0);
 
-    for (int i = 0; i < NUM_KIDS; i++)
+    for (int i = 0; i < nkids; i++)
     {
-        if (make_kid(&kids[i]) != 0)
+        if (make_kid(kids, i) != 0)
             err_exit("Fault starting child %d\n", i);
     }
 
-    distribute(NUM_KIDS, kids);
-    merge(NUM_KIDS, kids);
+    distribute(nkids, kids);
+    merge(nkids, kids);
 
-    wait_for_kids(NUM_KIDS, kids);
+    wait_for_kids(nkids, kids);
     return(0);
 }
 
@@ -0,0 +1,45 @@
+#!/bin/bash
+#
+# Time multi-pipe-sort and thread-sort on the same data for a range of
+# -j values, and check that both produce the same output.
+#
+# Usage: sort-speed.sh [lines [j ...]]
+#        Default: 1000000 lines of random words; j = 1 2 4 8 16
+
+nlines=${1:-1000000}
+[ $# -gt 0 ] && shift
+jlist=${*:-1 2 4 8 16}
+
+tmp=${TMPDIR:-/tmp}/sort-speed.$$
+trap 'rm -f $tmp.*; exit 1' 1 2 3 13 15
+
+awk -v n="$nlines" 'BEGIN {
+    srand(20261016)
+    for (i = 0; i < n; i++)
+    {
+        s = ""
+        len = int(rand() * 20) + 1
+        for (j = 0; j < len; j++)
+            s = s sprintf("%c", 97 + int(rand() * 26))
+        print s
+    }
+}' > $tmp.data
+
+./thread-sort -j 1 < $tmp.data > $tmp.ref
+
+TIMEFORMAT="%R"
+printf "%-16s %4s %8s %8s\n" "Program" "-j" "Seconds" "Speedup"
+for prog in multi-pipe-sort thread-sort
+do
+    base=
+    for j in $jlist
+    do
+        secs=$( { time ./$prog -j $j < $tmp.data > $tmp.out; } 2>&1 )
+        cmp -s $tmp.ref $tmp.out || echo "$prog -j $j: output differs" >&2
+        [ -z "$base" ] && base=$secs
+        printf "%-16s %4d %8.3f %8.2f\n" $prog $j $secs \
+            $(awk -v b=$base -v s=$secs 'BEGIN { print (s > 0) ? b / s : 0 }')
+    done
+done
+
+rm -f $tmp.*
@@ -0,0 +1,344 @@
+/* SO 1321-3864 Multiprocessing and pipes in C - shared-memory version */
+
+/*
+** Sort standard input to standard output, like multi-pipe-sort, but
+** with threads sharing one copy of the data instead of child processes
+** that are sent every line through a pipe and send it back again.
+**
+** The input is read into one buffer and indexed by an array of Line
+** descriptors (start and length, including the newline).  Each of the
+** N threads sorts a contiguous partition of the array in place with
+** qsort().  The partitions are then merged in log2(N) rounds of pairwise
+** merges between the array and a second array of the same size; in each
+** round, the output positions are divided evenly between the threads,
+** and each thread finds where its share starts in each pair of runs by
+** binary search along the merge path (the co-rank), so every thread
+** does the same amount of work whatever the sizes of the runs.  No line
+** is copied or reformatted; only the descriptors move.
+**
+** Lines compare as strcmp() would compare them including the newline,
+** as in multi-pipe-sort; a last line without a newline gets one.
+*/
+
+#include "posixver.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "stderr.h"
+
+enum { IO_BLOCK = 1024 * 1024 };
+enum { MAX_THREADS = 256 };
+
+typedef struct Line
+{
+    const char *data;
+    size_t      length;     /* Including newline */
+} Line;
+
+/* A barrier from a mutex and a condition (pthread_barrier_t is optional) */
+typedef struct Barrier
+{
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    int             count;
+    int             waiting;
+    unsigned        cycle;
+} Barrier;
+
+typedef struct Shared
+{
+    Line       *lines;
+    Line       *other;
+    size_t      nlines;
+    int         nthreads;
+    Barrier     barrier;
+    Line       *result;     /* Array holding the sorted lines */
+} Shared;
+
+typedef struct Worker
+{
+    Shared     *shared;
+    int         index;
+    pthread_t   thread;
+} Worker;
+
+static void barrier_init(Barrier *b, int count)
+{
+    pthread_mutex_init(&b->lock, 0);
+    pthread_cond_init(&b->cond, 0);
+    b->count = count;
+    b->waiting = 0;
+    b->cycle = 0;
+}
+
+static void barrier_destroy(Barrier *b)
+{
+    pthread_mutex_destroy(&b->lock);
+    pthread_cond_destroy(&b->cond);
+}
+
+static void barrier_wait(Barrier *b)
+{
+    pthread_mutex_lock(&b->lock);
+    unsigned cycle = b->cycle;
+    if (++b->waiting == b->count)
+    {
+        b->waiting = 0;
+        b->cycle++;
+        pthread_cond_broadcast(&b->cond);
+    }
+    else
+    {
+        while (cycle == b->cycle)
+            pthread_cond_wait(&b->cond, &b->lock);
+    }
+    pthread_mutex_unlock(&b->lock);
+}
+
+static int cmp_lines(const Line *l1, const Line *l2)
+{
+    size_t n = (l1->length < l2->length) ? l1->length : l2->length;
+    int rc = memcmp(l1->data, l2->data, n);
+    if (rc == 0)
+        rc = (l1->length > l2->length) - (l1->length < l2->length);
+    return rc;
+}
+
+static int qs_compare(const void *v1, const void *v2)
+{
+    return cmp_lines(v1, v2);
+}
+
+/* Start of partition p of n items split into np parts */
+static size_t part_start(size_t n, int np, int p)
+{
+    return (size_t)((unsigned long long)n * p / np);
+}
+
+/*
+** Co-rank: the number of items i taken from a (the rest, k - i, from b)
+** in the first k items of the stable merge of a[0..na) and b[0..nb).
+*/
+static size_t co_rank(size_t k, const Line *a, size_t na, const Line *b, size_t nb)
+{
+    size_t lo = (k > nb) ? k - nb : 0;
+    size_t hi = (k < na) ? k : na;
+    while (lo < hi)
+    {
+        size_t i = lo + (hi - lo) / 2;
+        /* Too few from a if a[i] belongs before b[k-i-1] */
+        if (cmp_lines(&a[i], &b[k - i - 1]) <= 0)
+            lo = i + 1;
+        else
+            hi = i;
+    }
+    return lo;
+}
+
+/* Merge the items of a and b that land in out[k0..k1) */
+static void merge_slice(const Line *a, size_t na, const Line *b, size_t nb,
+                        Line *out, size_t k0, size_t k1)
+{
+    size_t i = co_rank(k0, a, na, b, nb);
+    size_t j = k0 - i;
+    size_t ie = co_rank(k1, a, na, b, nb);
+    size_t je = k1 - ie;
+    Line *dst = out + k0;
+
+    while (i < ie && j < je)
+    {
+        if (cmp_lines(&b[j], &a[i]) < 0)
+            *dst++ = b[j++];
+        else
+            *dst++ = a[i++];
+    }
+    while (i < ie)
+        *dst++ = a[i++];
+    while (j < je)
+        *dst++ = b[j++];
+}
+
+/*
+** Runs are partitions 0..nthreads-1, grouped in blocks of 'width'
+** partitions.  In each round, pairs of adjacent blocks are merged; this
+** thread produces output positions [lo, hi) of the whole array, which
+** may span several pairs.
+*/
+static void *worker_main(void *arg)
+{
+    Worker *w = arg;
+    Shared *sh = w->shared;
+    int np = sh->nthreads;
+    size_t n = sh->nlines;
+    Line *src = sh->lines;
+    Line *dst = sh->other;
+
+    size_t p0 = part_start(n, np, w->index);
+    size_t p1 = part_start(n, np, w->index + 1);
+    qsort(src + p0, p1 - p0, sizeof(Line), qs_compare);
+    barrier_wait(&sh->barrier);
+
+    size_t lo = part_start(n, np, w->index);
+    size_t hi = part_start(n, np, w->index + 1);
+    for (int width = 1; width < np; width *= 2)
+    {
+        for (int blk = 0; blk < np; blk += 2 * width)
+        {
+            size_t a0 = part_start(n, np, blk);
+            size_t b0 = part_start(n, np, (blk + width < np) ? blk + width : np);
+            size_t b1 = part_start(n, np, (blk + 2 * width < np) ? blk + 2 * width : np);
+            /* Output positions of this pair that fall in [lo, hi) */
+            size_t k0 = (lo > a0) ? lo : a0;
+            size_t k1 = (hi < b1) ? hi : b1;
+            if (k0 < k1)
+                merge_slice(src + a0, b0 - a0, src + b0, b1 - b0,
+                            dst + a0, k0 - a0, k1 - a0);
+        }
+        Line *t = src;
+        src = dst;
+        dst = t;
+        barrier_wait(&sh->barrier);
+    }
+    if (w->index == 0)
+        sh->result = src;
+    return 0;
+}
+
+static void parallel_sort(Line *lines, size_t nlines, int nthreads)
+{
+    Shared sh;
+    Worker workers[MAX_THREADS];
+
+    if ((size_t)nthreads > nlines / 2 + 1)
+        nthreads = (int)(nlines / 2 + 1);
+    sh.lines = lines;
+    sh.nlines = nlines;
+    sh.nthreads = nthreads;
+    sh.result = lines;
+    if ((sh.other = malloc(nlines * sizeof(Line) + 1)) == 0)
+        err_error("out of memory (%zu lines)\n", nlines);
+    barrier_init(&sh.barrier, nthreads);
+
+    for (int i = 0; i < nthreads; i++)
+    {
+        workers[i].shared = &sh;
+        workers[i].index = i;
+        if (i > 0 && pthread_create(&workers[i].thread, 0, worker_main, &workers[i]) != 0)
+            err_syserr("failed to create thread %d: ", i);
+    }
+    worker_main(&workers[0]);
+    for (int i = 1; i < nthreads; i++)
+        pthread_join(workers[i].thread, 0);
+
+    if (sh.result != lines)
+        memcpy(lines, sh.result, nlines * sizeof(Line));
+    barrier_destroy(&sh.barrier);
+    free(sh.other);
+}
+
+/* Read all of fp, adding a final newline if needed */
+static char *read_all(FILE *fp, size_t *size)
+{
+    char *buffer = 0;
+    size_t used = 0;
+    size_t alloc = 0;
+    size_t nbytes;
+
+    do
+    {
+        if (alloc - used < IO_BLOCK + 1)
+        {
+            alloc = (alloc + IO_BLOCK + 1) * 2;
+            if ((buffer = realloc(buffer, alloc)) == 0)
+                err_error("out of memory (%zu bytes)\n", alloc);
+        }
+        nbytes = fread(buffer + used, 1, IO_BLOCK, fp);
+        used += nbytes;
+    } while (nbytes > 0);
+    if (ferror(fp))
+        err_syserr("failed to read standard input: ");
+    if (used > 0 && buffer[used - 1] != '\n')
+        buffer[used++] = '\n';
+    *size = used;
+    return buffer;
+}
+
+static Line *index_lines(const char *buffer, size_t size, size_t *nlines)
+{
+    size_t count = 0;
+    for (const char *p = buffer; (p = memchr(p, '\n', buffer + size - p)) != 0; p++)
+        count++;
+    Line *lines = malloc(count * sizeof(Line) + 1);
+    if (lines == 0)
+        err_error("out of memory (%zu lines)\n", count);
+    const char *p = buffer;
+    for (size_t i = 0; i < count; i++)
+    {
+        const char *nl = memchr(p, '\n', buffer + size - p);
+        lines[i].data = p;
+        lines[i].length = (size_t)(nl - p) + 1;
+        p = nl + 1;
+    }
+    *nlines = count;
+    return lines;
+}
+
+static const char usestr[] = "[-h][-j threads]";
+static const char optstr[] = "hj:";
+static const char hlpstr[] =
+    "  -h          Print this help and exit\n"
+    "  -j threads  Number of threads (default: one per online CPU)\n"
+    ;
+
+int main(int argc, char **argv)
+{
+    long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+
+    err_setarg0(argv[0]);
+    while ((opt = getopt(argc, argv, optstr)) != -1)
+    {
+        switch (opt)
+        {
+        case 'j':
+            nthreads = atoi(optarg);
+            if (nthreads < 1 || nthreads > MAX_THREADS)
+                err_error("number of threads '%s' should be 1..%d\n", optarg, MAX_THREADS);
+            break;
+        case 'h':
+            err_help(usestr, hlpstr);
+            /*NOTREACHED*/
+        default:
+            err_usage(usestr);
+            /*NOTREACHED*/
+        }
+    }
+    if (optind != argc)
+        err_usage(usestr);
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > MAX_THREADS)
+        nthreads = MAX_THREADS;
+
+    size_t size;
+    size_t nlines;
+    char *buffer = read_all(stdin, &size);
+    Line *lines = index_lines(buffer, size, &nlines);
+
+    parallel_sort(lines, nlines, (int)nthreads);
+
+    setvbuf(stdout, 0, _IOFBF, IO_BLOCK);
+    for (size_t i = 0; i < nlines; i++)
+    {
+        if (fwrite(lines[i].data, 1, lines[i].length, stdout) != lines[i].length)
+            err_syserr("short write to standard output: ");
+    }
+    if (fflush(stdout) != 0)
+        err_syserr("failed to write standard output: ");
+
+    free(lines);
+    free(buffer);
+    return(0);
+}
@@ -0,0 +1,37 @@
+#!/bin/bash
+#
+# Time merge (binary heap, stdio) against merge2 (loser tree, block
+# reads, writev) merging k sorted files for a range of k, with the same
+# total number of lines each time, and check the outputs agree.
+# The timed runs write to /dev/null so that the disk is not measured.
+#
+# Usage: merge-speed.sh [total-lines [k ...]]
+#        Default: 4000000 lines; k = 2 4 8 ... 4096
+
+total=${1:-4000000}
+[ $# -gt 0 ] && shift
+klist=${*:-2 4 8 16 32 64 128 256 512 1024 2048 4096}
+
+tmp=${TMPDIR:-/tmp}/merge-speed.$$
+mkdir -p $tmp || exit 1
+trap 'rm -fr $tmp; exit 1' 1 2 3 13 15
+
+# Each input needs a file descriptor
+ulimit -n 8192 2>/dev/null
+
+TIMEFORMAT="%R"
+printf "%6s %10s %10s %10s %8s\n" "k" "lines/file" "merge" "merge2" "ratio"
+for k in $klist
+do
+    lines=$((total / k))
+    rm -f $tmp/data.*
+    perl ./mkdata.pl $k $lines $tmp/data > /dev/null || exit 1
+    ./merge $tmp/data.* | cmp -s - <(./merge2 $tmp/data.*) ||
+        echo "k = $k: outputs differ" >&2
+    t1=$( { time ./merge  $tmp/data.* > /dev/null; } 2>&1 )
+    t2=$( { time ./merge2 $tmp/data.* > /dev/null; } 2>&1 )
+    printf "%6d %10d %10.3f %10.3f %8.2f\n" $k $lines $t1 $t2 \
+        $(awk -v a=$t1 -v b=$t2 'BEGIN { print (b > 0) ? a / b : 0 }')
+done
+
+rm -fr $tmp
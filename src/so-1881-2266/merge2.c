@@ -0,0 +1,354 @@
+/* https://stackoverflow.com/q/18812266 Merging multiple sorted files */
+
+/*
+** A k-way merge for large k: the heap-based merge.c reworked so that
+** the cost per output line stays low with thousands of inputs.
+**
+** Selection: a tournament tree of losers.  Each internal node records
+** the input that lost the match played there; the overall winner sits
+** in node 0.  After the winner's line is written and its next line is
+** read, only the path from its leaf to the root is replayed, which is
+** one comparison per level -- about log2(k) in all, against up to
+** 2*log2(k) for a binary heap's siftdown.  Exhausted inputs lose every
+** match.  Ties go to the input named first, so the merge is stable.
+** Each input keeps the first 8 bytes of its current line as a big-endian
+** integer, so most comparisons never touch the line itself.
+**
+** Input: each file is read with read() into its own page-aligned buffer
+** (total budget -b, shared between the inputs, 16 KiB..1 MiB each), with
+** sequential-access advice to the kernel so it reads ahead.  Lines are
+** used in place; a line that straddles the end of the buffer is moved to
+** the front before the next read, and the buffer grows if one line will
+** not fit.
+**
+** Output: lines are not copied.  Each output line is an iovec pointing
+** into its input buffer, successive lines from the same input coalesce
+** into one iovec, and the lot is written with a single writev() when
+** IOV_MAX entries are pending or when an input is about to overwrite
+** its buffer.
+**
+** Lines compare in byte order including the newline, as in merge.c;
+** a final line without a newline is given one.
+*/
+
+#include "posixver.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "jlss.h"
+#include "stderr.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 16
+#endif
+
+enum { MIN_BUFFER = 16 * 1024 };
+enum { MAX_BUFFER = 1024 * 1024 };
+enum { DEF_BUDGET = 64 * 1024 * 1024 };
+
+typedef struct Source
+{
+    const char *file;
+    int         fd;
+    char       *buffer;
+    size_t      size;       /* Space allocated for buffer */
+    size_t      used;       /* Bytes of data in buffer */
+    size_t      next;       /* Offset of next unread line */
+    const char *line;       /* Current line, or null at EOF */
+    size_t      length;     /* Length of line including newline */
+    uint64_t    prefix;     /* First 8 bytes of line, big-endian */
+} Source;
+
+typedef struct Output
+{
+    int             fd;
+    int             count;
+    struct iovec    iov[IOV_MAX];
+} Output;
+
+static size_t page_size;
+
+static void flush_output(Output *out)
+{
+    struct iovec *iov = out->iov;
+    int count = out->count;
+
+    while (count > 0)
+    {
+        ssize_t nbytes = writev(out->fd, iov, count);
+        if (nbytes < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            err_syserr("failed to write standard output: ");
+        }
+        /* Skip whatever was written; resume a partly written iovec */
+        while (count > 0 && (size_t)nbytes >= iov->iov_len)
+        {
+            nbytes -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + nbytes;
+            iov->iov_len -= nbytes;
+        }
+    }
+    out->count = 0;
+}
+
+static inline void emit_line(Output *out, const char *line, size_t length)
+{
+    if (out->count > 0)
+    {
+        struct iovec *last = &out->iov[out->count - 1];
+        if ((const char *)last->iov_base + last->iov_len == line)
+        {
+            last->iov_len += length;
+            return;
+        }
+        if (out->count == IOV_MAX)
+            flush_output(out);
+    }
+    out->iov[out->count].iov_base = (void *)line;
+    out->iov[out->count].iov_len = length;
+    out->count++;
+}
+
+static char *alloc_buffer(size_t size)
+{
+    void *space;
+    if (posix_memalign(&space, page_size, size) != 0)
+        err_error("failed to allocate %zu bytes memory\n", size);
+    return space;
+}
+
+/* Keep the partial line, then read more after it; return bytes read */
+static size_t refill(Source *src, Output *out)
+{
+    /* Pending output may point into this buffer */
+    if (out->count > 0)
+        flush_output(out);
+
+    size_t keep = src->used - src->next;
+    if (keep == src->size)
+    {
+        /* One line fills the buffer: double it */
+        char *space = alloc_buffer(2 * src->size);
+        memcpy(space, src->buffer, keep);
+        free(src->buffer);
+        src->buffer = space;
+        src->size *= 2;
+    }
+    else if (keep > 0)
+        memmove(src->buffer, src->buffer + src->next, keep);
+    src->used = keep;
+    src->next = 0;
+
+    ssize_t nbytes;
+    while ((nbytes = read(src->fd, src->buffer + keep, src->size - keep)) < 0)
+    {
+        if (errno != EINTR)
+            err_syserr("failed to read file %s: ", src->file);
+    }
+    src->used += nbytes;
+    return nbytes;
+}
+
+static inline uint64_t load_prefix(const char *line, size_t length)
+{
+    unsigned char bytes[8] = { 0 };
+    memcpy(bytes, line, (length < 8) ? length : 8);
+    uint64_t prefix = 0;
+    for (int i = 0; i < 8; i++)
+        prefix = (prefix << 8) | bytes[i];
+    return prefix;
+}
+
+/* Make the next line current, or set line to null at EOF */
+static void read_line(Source *src, Output *out)
+{
+    char *eol;
+    while ((eol = memchr(src->buffer + src->next, '\n', src->used - src->next)) == 0)
+    {
+        if (refill(src, out) == 0)
+        {
+            if (src->used == src->next)
+            {
+                close(src->fd);
+                free(src->buffer);
+                src->fd = -1;
+                src->buffer = 0;
+                src->line = 0;
+                return;
+            }
+            /* Final line has no newline: supply one */
+            if (src->used == src->size)
+                refill(src, out);   /* Grows the buffer; reads nothing */
+            src->buffer[src->used++] = '\n';
+        }
+    }
+    src->line = src->buffer + src->next;
+    src->length = (size_t)(eol - src->line) + 1;
+    src->next += src->length;
+    src->prefix = load_prefix(src->line, src->length);
+}
+
+/* Does input i1 win against input i2? */
+static inline int beats(const Source *inputs, size_t i1, size_t i2)
+{
+    const Source *s1 = &inputs[i1];
+    const Source *s2 = &inputs[i2];
+    if (s1->line == 0)
+        return 0;
+    if (s2->line == 0)
+        return 1;
+    if (s1->prefix != s2->prefix)
+        return s1->prefix < s2->prefix;
+    size_t n = (s1->length < s2->length) ? s1->length : s2->length;
+    int rc = memcmp(s1->line, s2->line, n);
+    if (rc == 0)
+        rc = (s1->length > s2->length) - (s1->length < s2->length);
+    return (rc < 0 || (rc == 0 && i1 < i2));
+}
+
+/*
+** The leaves (inputs 0..k-1) are notionally nodes k..2k-1 of a complete
+** binary tree, so the parent of input i is node (i + k) / 2, and node n
+** has children 2n and 2n+1.  tree[1..k-1] hold the losers; tree[0] the
+** winner.
+*/
+static void build_tree(size_t *tree, size_t k, const Source *inputs)
+{
+    size_t *winner = malloc(2 * k * sizeof(*winner));
+    if (winner == 0)
+        err_error("failed to allocate %zu bytes memory\n", 2 * k * sizeof(*winner));
+    for (size_t i = 0; i < k; i++)
+        winner[k + i] = i;
+    for (size_t n = k - 1; n >= 1; n--)
+    {
+        size_t a = winner[2 * n];
+        size_t b = winner[2 * n + 1];
+        if (beats(inputs, b, a))
+        {
+            winner[n] = b;
+            tree[n] = a;
+        }
+        else
+        {
+            winner[n] = a;
+            tree[n] = b;
+        }
+    }
+    tree[0] = winner[1];
+    free(winner);
+}
+
+/* Input w has a new line: play it up the path to the root */
+static inline void replay(size_t *tree, size_t k, const Source *inputs, size_t w)
+{
+    for (size_t n = (w + k) / 2; n >= 1; n /= 2)
+    {
+        if (beats(inputs, tree[n], w))
+        {
+            size_t t = tree[n];
+            tree[n] = w;
+            w = t;
+        }
+    }
+    tree[0] = w;
+}
+
+static size_t scan_size(const char *arg)
+{
+    char *end;
+    errno = 0;
+    size_t size = strtosize_scaled(arg, &end, 0, true);
+    if (end == arg || *end != '\0' || errno != 0 || size == 0)
+        err_error("invalid buffer size '%s'\n", arg);
+    return size;
+}
+
+static const char usestr[] = "[-h][-b budget] file ...";
+static const char optstr[] = "b:h";
+static const char hlpstr[] =
+    "  -b budget   Total input buffer space, e.g. 256M (default 64M)\n"
+    "              Each file gets budget/files, between 16K and 1M\n"
+    "  -h          Print this help and exit\n"
+    ;
+
+int main(int argc, char **argv)
+{
+    size_t budget = DEF_BUDGET;
+    int opt;
+
+    err_setarg0(argv[0]);
+    while ((opt = getopt(argc, argv, optstr)) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            budget = scan_size(optarg);
+            break;
+        case 'h':
+            err_help(usestr, hlpstr);
+            /*NOTREACHED*/
+        default:
+            err_usage(usestr);
+            /*NOTREACHED*/
+        }
+    }
+    if (optind == argc)
+        err_usage(usestr);
+
+    page_size = sysconf(_SC_PAGESIZE);
+    size_t k = argc - optind;
+    size_t bufsize = budget / k;
+    if (bufsize < MIN_BUFFER)
+        bufsize = MIN_BUFFER;
+    if (bufsize > MAX_BUFFER)
+        bufsize = MAX_BUFFER;
+    bufsize = (bufsize + page_size - 1) & ~(page_size - 1);
+
+    Source *inputs = calloc(k, sizeof(*inputs));
+    size_t *tree = malloc(k * sizeof(*tree));
+    static Output out;
+    if (inputs == 0 || tree == 0)
+        err_error("failed to allocate memory for %zu inputs\n", k);
+    out.fd = STDOUT_FILENO;
+
+    for (size_t i = 0; i < k; i++)
+    {
+        Source *src = &inputs[i];
+        src->file = argv[optind + i];
+        if ((src->fd = open(src->file, O_RDONLY)) < 0)
+            err_syserr("failed to open file %s for reading: ", src->file);
+#if defined(POSIX_FADV_SEQUENTIAL)
+        posix_fadvise(src->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        src->buffer = alloc_buffer(bufsize);
+        src->size = bufsize;
+        read_line(src, &out);
+    }
+
+    build_tree(tree, k, inputs);
+
+    while (inputs[tree[0]].line != 0)
+    {
+        size_t w = tree[0];
+        emit_line(&out, inputs[w].line, inputs[w].length);
+        read_line(&inputs[w], &out);
+        replay(tree, k, inputs, w);
+    }
+    flush_output(&out);
+
+    free(tree);
+    free(inputs);
+    return 0;
+}
@@ -8,8 +8,8 @@ use warnings;
 die "Usage: num-files lines-per-file [basename]" unless scalar(@ARGV) == 2 || scalar(@ARGV) == 3;
 my $num_files = $ARGV[0];
 my $num_lines = $ARGV[1];
-die "Enter a number of files between 2 and 999" unless $num_files >= 2 && $num_files <= 999;
-die "Enter a number of lines between 2 and 9,999,999" unless $num_files >= 2 && $num_files <= 9_999_999;
+die "Enter a number of files between 2 and 9999" unless $num_files >= 2 && $num_files <= 9999;
+die "Enter a number of lines between 2 and 9,999,999" unless $num_lines >= 2 && $num_lines <= 9_999_999;
 
 my $base = $ARGV[2] // "datafile";
 my $digits = length($num_files . '');
@@ -0,0 +1,52 @@
+#!/bin/bash
+#
+# Check keysort2 -k against sort(1) on generated comma-separated data,
+# and time it with radix sort and with qsort (-q).  The timed runs write
+# to /dev/null, so the file system does not swamp the sort.
+#
+# Usage: keysort-test.sh [lines]
+
+lines=${1:-1000000}
+data=keysort-test.$$.data
+trap 'rm -f $data $data.1 $data.2' 0 1 2 3 13 15
+
+# id,word,decimal,small-int: words share long prefixes, so string keys
+# often tie on the 16-byte prefix and need the full comparison.
+perl -e '
+    srand(20260101);
+    my @w = ("alpha", "alphabet", "alphabetical-order-", "beta", "gamma-ray-burst-");
+    for my $i (1..$ARGV[0]) {
+        my $word = $w[int(rand(@w))] . join("", map { chr(97 + int(rand(3))) } 1..int(rand(6)));
+        printf "%d,%s,%.3f,%d\n", $i, $word, rand(2000) - 1000, int(rand(100));
+    }' "$lines" > $data
+
+export LC_ALL=C
+TIMEFORMAT="%R"
+status=0
+
+check()
+{
+    local kopts="$1" sopts="$2"
+    sort -s -t, $sopts $data > $data.1
+    for q in "" "-q"
+    do
+        cp $data $data.2
+        ./keysort2 $q -t, $kopts $data.2
+        t=$( { time ./keysort2 $q -t, $kopts < $data > /dev/null; } 2>&1 )
+        if cmp -s $data.1 $data.2
+        then result=ok
+        else result=FAIL; status=1
+        fi
+        printf "%-24s %-3s %-4s %8.3f s\n" "$kopts" "${q:---}" "$result" "$t"
+    done
+    t=$( { time sort -s -t, $sopts $data > /dev/null; } 2>&1 )
+    printf "%-24s %-8s %8.3f s\n" "sort $sopts" "" "$t"
+}
+
+echo "$lines lines"
+check "-k 3,n"          "-k3,3n"
+check "-k 4,n -k 3,nr"  "-k4,4n -k3,3nr"
+check "-k 2,s"          "-k2,2"
+check "-k 2,sr -k 4,n"  "-k2,2r -k4,4n"
+check "-k 4,n -k 2,s"   "-k4,4n -k2,2"
+exit $status
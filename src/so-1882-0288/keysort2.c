@@ -10,100 +10,416 @@
 **
 ** Similar to, and derived from, keysort1.c.  Read from named file (or
 ** standard input) and write to same file (or standard output).
+**
+** Keyed sorting: -k field[,type] names a key field (numbered from 1);
+** the type is n for numeric (anything strtod() accepts) or s for a
+** string compared byte by byte (the default), either optionally
+** followed by r to reverse the order.  Several -k options give
+** secondary keys, and so on.  Fields are separated by runs of blanks,
+** ignoring leading blanks, or by each occurrence of the -t character.
+** Without -k, the key is field 2, numeric, as before.  Lines with equal
+** keys stay in their input order.
+**
+** The keys of each line are turned, once, into a normalised key: a
+** byte string that sorts correctly with memcmp().  A number becomes 8
+** bytes: the bits of the double, with the sign bit flipped if positive
+** and all the bits flipped if negative.  A string becomes its bytes and
+** a terminating zero byte (so fields must not contain null bytes).  The
+** bytes of a reversed key are complemented.  The first 16 bytes of the
+** normalised key are stored next to the line pointer, as two 64-bit
+** big-endian words, so comparing them is two integer comparisons and
+** never touches the line.
+**
+** The records are sorted on the prefix by LSD radix sort (the libsoq
+** radix_sort_kv64(), on each word), or with qsort() if -q is given or
+** there are only a few records.  Each run of records with equal
+** prefixes whose keys go on beyond 16 bytes is then sorted the same way
+** on the next 16 bytes of their keys, and so on.  So the keys of a line
+** are parsed once, plus once for each level of ties it is involved in,
+** and the comparisons never parse anything.
 */
 
 #include "posixver.h"
-#include <errno.h>
-#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include "radixsort.h"
+#include "stderr.h"
 
-static void sort_file(const char *i_file, const char *o_file);
+enum { IO_BLOCK = 1024 * 1024 };
+enum { MAX_KEYS = 16 };
+enum { PREFIX_BYTES = 16 };
+enum { RADIX_MIN = 64 };
 
-int main(int argc, char **argv)
+typedef enum KeyType { KEY_STRING, KEY_NUMERIC } KeyType;
+
+typedef struct Key
+{
+    int     field;      /* Numbered from 1 */
+    KeyType type;
+    bool    reverse;
+} Key;
+
+typedef struct Record
+{
+    uint64_t    hi;     /* Prefix bytes 0..7, big-endian */
+    uint64_t    lo;     /* Prefix bytes 8..15, big-endian */
+    const char *line;
+    bool        exact;  /* Key ends within the prefix */
+} Record;
+
+static Key  keys[MAX_KEYS];
+static int  nkeys = 0;
+static int  separator = -1;     /* -1: runs of blanks */
+static bool use_qsort = false;
+
+static inline bool is_blank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+/* Find field f (from 1) of the newline-terminated line; null if missing */
+static const char *find_field(const char *line, int f, size_t *len)
 {
-    if (argc > 1)
+    const char *p = line;
+    if (separator < 0)
     {
-        for (int i = 1; i < argc; i++)
-            sort_file(argv[i], argv[i]);
+        for (;;)
+        {
+            while (is_blank(*p))
+                p++;
+            if (*p == '\n')
+                return 0;
+            const char *start = p;
+            while (*p != '\n' && !is_blank(*p))
+                p++;
+            if (--f == 0)
+            {
+                *len = (size_t)(p - start);
+                return start;
+            }
+        }
+    }
+    for (;;)
+    {
+        const char *start = p;
+        while (*p != '\n' && (unsigned char)*p != separator)
+            p++;
+        if (--f == 0)
+        {
+            *len = (size_t)(p - start);
+            return start;
+        }
+        if (*p == '\n')
+            return 0;
+        p++;
     }
-    else
-        sort_file("/dev/stdin", "/dev/stdout");
-    return 0;
 }
 
-typedef struct data
+static double field_value(const char *line, const Key *key)
 {
-    char *line;
-    int   key;
-} data;
+    size_t len;
+    const char *field = find_field(line, key->field, &len);
+    char buffer[64];
+    char *end;
+    if (field != 0 && len < sizeof(buffer))
+    {
+        memcpy(buffer, field, len);
+        buffer[len] = '\0';
+        double value = strtod(buffer, &end);
+        if (end != buffer && *end == '\0')
+            return (value == 0.0) ? 0.0 : value;    /* -0.0 == +0.0 */
+    }
+    err_error("Format error - no number in field %d of: %.20s...\n", key->field, line);
+}
 
-static int cmp_data(const void *v1, const void *v2)
+/* Map a double to an unsigned integer in the same order */
+static inline uint64_t map_double(double d)
 {
-    const data *d1 = v1;
-    const data *d2 = v2;
-    if (d1->key < d2->key)
-        return -1;
-    else if (d1->key > d2->key)
-        return +1;
-    else
-        return 0;
+    uint64_t b;
+    memcpy(&b, &d, sizeof(b));
+    return b ^ ((b >> 63) ? UINT64_C(0xFFFFFFFFFFFFFFFF) : UINT64_C(0x8000000000000000));
 }
 
-static void err_exit(const char *fmt, ...)
-{
-    int errnum = errno;
-    va_list args;
-    va_start(args, fmt);
-    vfprintf(stderr, fmt, args);
-    va_end(args);
-    if (errnum != 0)
-        fprintf(stderr, " (%d: %s)", errnum, strerror(errnum));
-    putc('\n', stderr);
-    exit(EXIT_FAILURE);
+static inline uint64_t load_be64(const unsigned char *bytes)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++)
+        v = (v << 8) | bytes[i];
+    return v;
 }
 
-void sort_file(const char *i_file, const char *o_file)
+/* Copy the bytes of src that fall in the window [offset, offset+16) */
+static inline void emit(unsigned char *chunk, size_t offset, size_t pos,
+                        const void *src, size_t len, bool reverse)
 {
-    char buffer[4096];
-    data *array = 0;
-    size_t array_len = 0;
-    size_t array_max = 0;
+    const unsigned char *bytes = src;
+    size_t lo = (pos > offset) ? pos : offset;
+    size_t hi = (pos + len < offset + PREFIX_BYTES) ? pos + len : offset + PREFIX_BYTES;
+    for (size_t i = lo; i < hi; i++)
+        chunk[i - offset] = reverse ? ~bytes[i - pos] : bytes[i - pos];
+}
 
-    FILE *i_fp = fopen(i_file, "r");
-    if (i_fp == 0)
-        err_exit("Failed to open file %s for reading", i_file);
+/*
+** Set the prefix of rec to bytes [offset, offset+16) of its normalised
+** key: each numeric key as 8 bytes, each string key followed by a zero
+** byte, complemented if reversed.  Record whether the key ends there.
+*/
+static void make_prefix(Record *rec, size_t offset)
+{
+    static const unsigned char terminator = '\0';
+    unsigned char chunk[PREFIX_BYTES] = { 0 };
+    size_t pos = 0;
 
-    while (fgets(buffer, sizeof(buffer), i_fp) != 0)
+    for (int k = 0; k < nkeys && pos < offset + PREFIX_BYTES; k++)
     {
-        if (array_len >= array_max)
+        const Key *key = &keys[k];
+        if (key->type == KEY_NUMERIC)
         {
-            size_t new_size = (array_max + 2) * 2;
-            void *space = realloc(array, new_size * sizeof(data));
-            if (space == 0)
-                err_exit("Out of memory (1)");
-            array = space;
-            array_max = new_size;
+            if (pos + 8 > offset)
+            {
+                uint64_t v = map_double(field_value(rec->line, key));
+                unsigned char bytes[8];
+                for (int i = 0; i < 8; i++)
+                    bytes[i] = (unsigned char)(v >> (56 - 8 * i));
+                emit(chunk, offset, pos, bytes, 8, key->reverse);
+            }
+            pos += 8;
         }
-        array[array_len].line = strdup(buffer);
-        if (array[array_len].line == 0)
-            err_exit("Out of memory (2)");
-        if (sscanf(array[array_len].line, "%*s %d", &array[array_len].key) != 1)
-            err_exit("Format error - no number in right place in: %.20s...\n",
-                     array[array_len].line);
-        //printf("%3zu:%.10d: %s", array_len, array[array_len].key,
-        //       array[array_len].line);
-        array_len++;
+        else
+        {
+            size_t len = 0;
+            const char *field = find_field(rec->line, key->field, &len);
+            emit(chunk, offset, pos, field, len, key->reverse);
+            emit(chunk, offset, pos + len, &terminator, 1, key->reverse);
+            pos += len + 1;
+        }
+    }
+    rec->hi = load_be64(chunk);
+    rec->lo = load_be64(chunk + 8);
+    rec->exact = (pos <= offset + PREFIX_BYTES);
+}
+
+/* Compare prefixes, then the input order (the lines are in one buffer) */
+static int cmp_record(const void *v1, const void *v2)
+{
+    const Record *r1 = v1;
+    const Record *r2 = v2;
+    if (r1->hi != r2->hi)
+        return (r1->hi < r2->hi) ? -1 : +1;
+    if (r1->lo != r2->lo)
+        return (r1->lo < r2->lo) ? -1 : +1;
+    return (r1->line > r2->line) - (r1->line < r2->line);
+}
+
+/* Stable LSD radix sort on the prefix: low word, then high word */
+static void radix_sort_prefixes(Record *recs, size_t n)
+{
+    RadixPair64 *pairs = malloc(n * sizeof(*pairs) + 1);
+    Record *sorted = malloc(n * sizeof(*sorted) + 1);
+    if (pairs == 0 || sorted == 0)
+        err_error("Out of memory (%zu records)\n", n);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        pairs[i].key = recs[i].lo;
+        pairs[i].value = i;
     }
+    if (!radix_sort_kv64(pairs, n))
+        err_error("Out of memory (%zu records)\n", n);
+    for (size_t i = 0; i < n; i++)
+        pairs[i].key = recs[pairs[i].value].hi;
+    if (!radix_sort_kv64(pairs, n))
+        err_error("Out of memory (%zu records)\n", n);
+    for (size_t i = 0; i < n; i++)
+        sorted[i] = recs[pairs[i].value];
+    memcpy(recs, sorted, n * sizeof(*recs));
+    free(sorted);
+    free(pairs);
+}
+
+/*
+** Sort on the prefixes, which hold key bytes from offset on, then sort
+** each run of equal prefixes on the next 16 bytes of key.  Records in
+** a run have the same key structure, so if one key ends in this chunk,
+** all of them do, and the run is truly equal.
+*/
+static void sort_records(Record *recs, size_t n, size_t offset)
+{
+    if (offset > 0)
+    {
+        for (size_t i = 0; i < n; i++)
+            make_prefix(&recs[i], offset);
+    }
+    if (use_qsort || n < RADIX_MIN)
+        qsort(recs, n, sizeof(*recs), cmp_record);
+    else
+        radix_sort_prefixes(recs, n);
+
+    size_t i = 0;
+    while (i < n)
+    {
+        size_t j = i + 1;
+        while (j < n && recs[j].hi == recs[i].hi && recs[j].lo == recs[i].lo)
+            j++;
+        if (j - i > 1 && !recs[i].exact)
+            sort_records(recs + i, j - i, offset + PREFIX_BYTES);
+        i = j;
+    }
+}
+
+/* Read all of the file, adding a final newline if needed */
+static char *read_file(FILE *fp, const char *file, size_t *size)
+{
+    char *buffer = 0;
+    size_t used = 0;
+    size_t alloc = 0;
+    size_t nbytes;
+
+    do
+    {
+        if (alloc - used < IO_BLOCK + 1)
+        {
+            alloc = (alloc + IO_BLOCK + 1) * 2;
+            if ((buffer = realloc(buffer, alloc)) == 0)
+                err_error("Out of memory (%zu bytes)\n", alloc);
+        }
+        nbytes = fread(buffer + used, 1, IO_BLOCK, fp);
+        used += nbytes;
+    } while (nbytes > 0);
+    if (ferror(fp))
+        err_syserr("Failed to read file %s: ", file);
+    if (used > 0 && buffer[used - 1] != '\n')
+        buffer[used++] = '\n';
+    *size = used;
+    return buffer;
+}
+
+static void sort_file(const char *i_file, const char *o_file)
+{
+    FILE *i_fp = fopen(i_file, "r");
+    if (i_fp == 0)
+        err_syserr("Failed to open file %s for reading: ", i_file);
+    size_t size;
+    char *buffer = read_file(i_fp, i_file, &size);
     fclose(i_fp);
 
-    qsort(array, array_len, sizeof(data), cmp_data);
+    size_t count = 0;
+    for (const char *p = buffer; (p = memchr(p, '\n', buffer + size - p)) != 0; p++)
+        count++;
+    Record *array = malloc(count * sizeof(*array) + 1);
+    if (array == 0)
+        err_error("Out of memory (%zu lines)\n", count);
+    const char *p = buffer;
+    for (size_t i = 0; i < count; i++)
+    {
+        array[i].line = p;
+        make_prefix(&array[i], 0);
+        p = (const char *)memchr(p, '\n', buffer + size - p) + 1;
+    }
+
+    sort_records(array, count, 0);
 
     FILE *o_fp = fopen(o_file, "w");
     if (o_fp == 0)
-        err_exit("Failed to open file %s for writing", o_file);
-    for (size_t i = 0; i < array_len; i++)
-        fputs(array[i].line, o_fp);
-    fclose(o_fp);
+        err_syserr("Failed to open file %s for writing: ", o_file);
+    for (size_t i = 0; i < count; i++)
+    {
+        const char *eol = memchr(array[i].line, '\n', buffer + size - array[i].line);
+        size_t len = (size_t)(eol - array[i].line) + 1;
+        if (fwrite(array[i].line, 1, len, o_fp) != len)
+            err_syserr("Failed to write file %s: ", o_file);
+    }
+    if (fclose(o_fp) != 0)
+        err_syserr("Failed to write file %s: ", o_file);
+    free(array);
+    free(buffer);
+}
+
+static void scan_key(const char *arg)
+{
+    char *end;
+    long field = strtol(arg, &end, 10);
+    if (end == arg || field < 1 || field > 1000000)
+        err_error("invalid key field in '%s'\n", arg);
+    if (nkeys >= MAX_KEYS)
+        err_error("too many keys (maximum %d)\n", MAX_KEYS);
+    Key *key = &keys[nkeys++];
+    key->field = (int)field;
+    key->type = KEY_STRING;
+    key->reverse = false;
+    if (*end == ',')
+    {
+        while (*++end != '\0')
+        {
+            if (*end == 'n')
+                key->type = KEY_NUMERIC;
+            else if (*end == 's')
+                key->type = KEY_STRING;
+            else if (*end == 'r')
+                key->reverse = true;
+            else
+                err_error("invalid key type in '%s' (use n, s, r)\n", arg);
+        }
+    }
+    else if (*end != '\0')
+        err_error("invalid key specification '%s'\n", arg);
+}
+
+static const char usestr[] = "[-hq][-t c][-k field[,type]]... [file ...]";
+static const char optstr[] = "hk:qt:";
+static const char hlpstr[] =
+    "  -h          Print this help and exit\n"
+    "  -k field[,type]\n"
+    "              Sort on field (from 1); type n (numeric) or s (string,\n"
+    "              the default), with r to reverse; repeat for more keys\n"
+    "              (default: -k 2,n)\n"
+    "  -q          Sort with qsort() instead of radix sort\n"
+    "  -t c        Fields are separated by c (default: runs of blanks)\n"
+    "Each file is sorted in place; with no files, standard input is\n"
+    "sorted to standard output.\n"
+    ;
+
+int main(int argc, char **argv)
+{
+    int opt;
+
+    err_setarg0(argv[0]);
+    while ((opt = getopt(argc, argv, optstr)) != -1)
+    {
+        switch (opt)
+        {
+        case 'h':
+            err_help(usestr, hlpstr);
+            /*NOTREACHED*/
+        case 'k':
+            scan_key(optarg);
+            break;
+        case 'q':
+            use_qsort = true;
+            break;
+        case 't':
+            if (optarg[0] == '\0' || optarg[1] != '\0' || optarg[0] == '\n')
+                err_error("invalid field separator '%s'\n", optarg);
+            separator = (unsigned char)optarg[0];
+            break;
+        default:
+            err_usage(usestr);
+            /*NOTREACHED*/
+        }
+    }
+    if (nkeys == 0)
+        scan_key("2,n");
+
+    if (optind < argc)
+    {
+        for (int i = optind; i < argc; i++)
+            sort_file(argv[i], argv[i]);
+    }
+    else
+        sort_file("/dev/stdin", "/dev/stdout");
+    return 0;
 }
@@ -0,0 +1,295 @@
+/* SO 2027-1977 - sort parallel arrays: index permutation v swapping */
+
+/*
+** Benchmark colsort() against sorting the rows by swapping every column
+** at every exchange, as quicksort_random() in so-20271977.c does for its
+** four arrays.
+**
+** The table has -c columns of doubles and -n rows.  The first -k columns
+** are the keys: column 0 has about 4 rows per distinct value, so with
+** -k 2 the second key matters, as y matters for Array4.  Column k holds
+** the original row number and column c (c > k) holds row + c, so the
+** result can be checked: the keys must be in order, rows with equal keys
+** must keep their original order, and every column of each row must
+** come from the same original row.
+**
+** Times reported: 'order' to sort the (key, row) pairs, 'permute' to
+** gather the columns, and, with -q, 'swap' for the swapping quicksort.
+*/
+
+#include "posixver.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "colsort.h"
+#include "jlss.h"
+#include "stderr.h"
+#include "timer.h"
+#include "xorshift.h"
+
+enum { MAX_KEYS = 4 };
+
+static uint64_t rng_state = XORSHIFT64_SEED;
+
+static void *xmalloc(size_t size)
+{
+    void *space = malloc(size);
+    if (space == 0)
+        err_error("out of memory (%zu bytes)\n", size);
+    return space;
+}
+
+static void load_table(double **cols, size_t ncols, size_t nkeys, size_t n)
+{
+    size_t range = (n / 4 > 0) ? n / 4 : 1;
+    for (size_t i = 0; i < n; i++)
+    {
+        cols[0][i] = (double)(size_t)(xorshift64_unit(&rng_state) * range);
+        for (size_t k = 1; k < nkeys; k++)
+            cols[k][i] = xorshift64_unit(&rng_state) * n;
+        for (size_t c = nkeys; c < ncols; c++)
+            cols[c][i] = (double)i + (c - nkeys);
+    }
+}
+
+static inline int compare_rows(double **cols, size_t nkeys, size_t i, size_t j)
+{
+    for (size_t k = 0; k < nkeys; k++)
+    {
+        if (cols[k][i] < cols[k][j])
+            return -1;
+        if (cols[k][i] > cols[k][j])
+            return +1;
+    }
+    return 0;
+}
+
+static inline void swap_rows(double **cols, size_t ncols, size_t i, size_t j)
+{
+    for (size_t c = 0; c < ncols; c++)
+    {
+        double d = cols[c][i];
+        cols[c][i] = cols[c][j];
+        cols[c][j] = d;
+    }
+}
+
+/* The partition_random() scheme of so-20271977.c, for any number of columns */
+static void swap_sort(double **cols, size_t ncols, size_t nkeys, size_t p, size_t r)
+{
+    while (p < r)
+    {
+        size_t pivot = p + xorshift64(&rng_state) % (r - p + 1);
+        swap_rows(cols, ncols, pivot, r);
+        size_t i = p;
+        for (size_t j = p; j < r; j++)
+        {
+            if (compare_rows(cols, nkeys, j, r) <= 0)
+                swap_rows(cols, ncols, j, i++);
+        }
+        swap_rows(cols, ncols, i, r);
+        /* Recurse on the smaller part, iterate on the larger */
+        if (i - p < r - i)
+        {
+            if (i > p)
+                swap_sort(cols, ncols, nkeys, p, i - 1);
+            p = i + 1;
+        }
+        else
+        {
+            swap_sort(cols, ncols, nkeys, i + 1, r);
+            if (i == 0)
+                break;
+            r = i - 1;
+        }
+    }
+}
+
+/* Returns the number of problems found */
+static size_t check_table(double **cols, double **keys, size_t ncols, size_t nkeys,
+                          size_t n, int stable)
+{
+    size_t errors = 0;
+    for (size_t i = 0; i < n && errors < 10; i++)
+    {
+        size_t row = (size_t)cols[nkeys][i];
+        for (size_t k = 0; k < nkeys; k++)
+        {
+            if (cols[k][i] != keys[k][row])
+            {
+                printf("row %zu: key %zu = %g, but original row %zu had %g\n",
+                       i, k, cols[k][i], row, keys[k][row]);
+                errors++;
+            }
+        }
+        for (size_t c = nkeys + 1; c < ncols; c++)
+        {
+            if (cols[c][i] != (double)row + (c - nkeys))
+            {
+                printf("row %zu: column %zu = %.0f, expected %.0f\n",
+                       i, c, cols[c][i], (double)row + (c - nkeys));
+                errors++;
+            }
+        }
+        if (i > 0)
+        {
+            int rc = compare_rows(cols, nkeys, i - 1, i);
+            if (rc > 0 || (stable && rc == 0 && cols[nkeys][i - 1] > cols[nkeys][i]))
+            {
+                printf("rows %zu and %zu are out of order\n", i - 1, i);
+                errors++;
+            }
+        }
+    }
+    return errors;
+}
+
+static size_t scan_size(const char *arg, const char *what)
+{
+    char *end;
+    errno = 0;
+    size_t size = strtosize_scaled(arg, &end, 0, false);
+    if (end == arg || *end != '\0' || errno != 0 || size == 0)
+        err_error("invalid %s '%s'\n", what, arg);
+    return size;
+}
+
+static double elapsed(Clock *clk)
+{
+    return clk_elapsed_nsec(clk) / 1.0E9;
+}
+
+static const char usestr[] = "[-hpq][-c columns][-j threads][-k keys][-n rows][-s seed]";
+static const char optstr[] = "c:hj:k:n:pqs:";
+static const char hlpstr[] =
+    "  -c columns  Number of columns of doubles (default 4)\n"
+    "  -h          Print this help and exit\n"
+    "  -j threads  Threads for the gather (default: one per online CPU)\n"
+    "  -k keys     Number of key columns, 1..4 (default 2)\n"
+    "  -n rows     Number of rows, e.g. 10M or 100M (default 1M)\n"
+    "  -p          Sort the (key, row) pairs with pdqsort, not radix sort\n"
+    "  -q          Also time the quicksort that swaps every column\n"
+    "  -s seed     Seed for the random data\n"
+    ;
+
+int main(int argc, char **argv)
+{
+    size_t ncols = 4;
+    size_t nkeys = 2;
+    size_t n = 1000000;
+    long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    int radix = 1;
+    int swap = 0;
+    int opt;
+
+    err_setarg0(argv[0]);
+    while ((opt = getopt(argc, argv, optstr)) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            ncols = scan_size(optarg, "number of columns");
+            break;
+        case 'h':
+            err_help(usestr, hlpstr);
+            /*NOTREACHED*/
+        case 'j':
+            nthreads = atoi(optarg);
+            if (nthreads < 1)
+                err_error("invalid number of threads '%s'\n", optarg);
+            break;
+        case 'k':
+            nkeys = atoi(optarg);
+            if (nkeys < 1 || nkeys > MAX_KEYS)
+                err_error("number of keys '%s' should be 1..%d\n", optarg, MAX_KEYS);
+            break;
+        case 'n':
+            n = scan_size(optarg, "number of rows");
+            break;
+        case 'p':
+            radix = 0;
+            break;
+        case 'q':
+            swap = 1;
+            break;
+        case 's':
+            rng_state = strtoull(optarg, 0, 0) | 1;
+            break;
+        default:
+            err_usage(usestr);
+            /*NOTREACHED*/
+        }
+    }
+    if (optind != argc)
+        err_usage(usestr);
+    if (ncols <= nkeys)
+        err_error("need more columns (%zu) than keys (%zu)\n", ncols, nkeys);
+    if (nthreads < 1)
+        nthreads = 1;
+
+    double **cols = xmalloc(ncols * sizeof(*cols));
+    for (size_t c = 0; c < ncols; c++)
+        cols[c] = xmalloc(n * sizeof(double));
+    double *keys[MAX_KEYS];
+    for (size_t k = 0; k < nkeys; k++)
+        keys[k] = xmalloc(n * sizeof(double));
+    size_t *perm = xmalloc(n * sizeof(*perm));
+    ColSortKey sort_keys[MAX_KEYS];
+    ColSortColumn *columns = xmalloc(ncols * sizeof(*columns));
+    for (size_t k = 0; k < nkeys; k++)
+        sort_keys[k] = (ColSortKey){ .data = cols[k], .type = COLSORT_DBL };
+    for (size_t c = 0; c < ncols; c++)
+        columns[c] = (ColSortColumn){ .data = cols[c], .width = sizeof(double) };
+
+    uint64_t seed = rng_state;
+    load_table(cols, ncols, nkeys, n);
+    for (size_t k = 0; k < nkeys; k++)
+        memcpy(keys[k], cols[k], n * sizeof(double));
+
+    Clock clk;
+    clk_init(&clk);
+    clk_start(&clk);
+    if (!colsort_order(sort_keys, nkeys, n, perm, radix))
+        err_error("out of memory sorting %zu keys\n", n);
+    clk_stop(&clk);
+    double t_order = elapsed(&clk);
+    clk_start(&clk);
+    if (!colsort_permute(columns, ncols, perm, n, (int)nthreads))
+        err_error("out of memory permuting %zu columns\n", ncols);
+    clk_stop(&clk);
+    double t_permute = elapsed(&clk);
+    size_t errors = check_table(cols, keys, ncols, nkeys, n, 1);
+
+    printf("rows %zu columns %zu keys %zu threads %ld sort %s\n",
+           n, ncols, nkeys, nthreads, radix ? "radix" : "pdq");
+    printf("colsort: order %8.3f  permute %8.3f  total %8.3f s\n",
+           t_order, t_permute, t_order + t_permute);
+
+    if (swap)
+    {
+        rng_state = seed;
+        load_table(cols, ncols, nkeys, n);
+        clk_start(&clk);
+        if (n > 1)
+            swap_sort(cols, ncols, nkeys, 0, n - 1);
+        clk_stop(&clk);
+        double t_swap = elapsed(&clk);
+        errors += check_table(cols, keys, ncols, nkeys, n, 0);
+        printf("swap:    total %8.3f s  (%.2fx colsort)\n",
+               t_swap, t_swap / (t_order + t_permute));
+    }
+
+    printf("%s\n", (errors == 0) ? "== PASS ==" : "** FAIL **");
+
+    free(columns);
+    free(perm);
+    for (size_t k = 0; k < nkeys; k++)
+        free(keys[k]);
+    for (size_t c = 0; c < ncols; c++)
+        free(cols[c]);
+    free(cols);
+    return (errors == 0) ? 0 : 1;
+}
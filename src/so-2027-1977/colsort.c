@@ -0,0 +1,364 @@
+/*
+@(#)File:           colsort.c
+@(#)Purpose:        Sort parallel arrays (columns) via an index permutation
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#include "posixver.h"
+#include "colsort.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pdqsort.h"
+#include "radixsort.h"
+
+enum { MAX_THREADS = 256 };
+enum { GATHER_BLOCK = 2048 };   /* Rows: 16 KiB of permutation */
+enum { PREFETCH_AHEAD = 16 };   /* Rows */
+enum { SLICE_ALIGN = 64 };
+
+#if defined(__GNUC__)
+#define PREFETCH(addr)  __builtin_prefetch(addr)
+#else
+#define PREFETCH(addr)  ((void)0)
+#endif
+
+/* Order by key, then by row, so the sort is stable */
+static inline bool pair_less(RadixPair64 a, RadixPair64 b)
+{
+    return a.key < b.key || (a.key == b.key && a.value < b.value);
+}
+
+PDQSORT_DEFINE(pdq_sort_pairs, RadixPair64, pair_less, true)
+
+/* Map float bits to unsigned integers in the same order */
+static inline uint64_t map_flt(uint32_t b)
+{
+    return b ^ ((b >> 31) ? UINT32_C(0xFFFFFFFF) : UINT32_C(0x80000000));
+}
+
+static inline uint64_t map_dbl(uint64_t b)
+{
+    return b ^ ((b >> 63) ? UINT64_C(0xFFFFFFFFFFFFFFFF) : UINT64_C(0x8000000000000000));
+}
+
+/* Set the key of each pair from the row named by its value */
+static void load_keys(const ColSortKey *key, RadixPair64 *pairs, size_t n)
+{
+    switch (key->type)
+    {
+    case COLSORT_I32:
+        {
+        const int32_t *data = key->data;
+        for (size_t i = 0; i < n; i++)
+            pairs[i].key = (uint32_t)data[pairs[i].value] ^ UINT32_C(0x80000000);
+        }
+        break;
+    case COLSORT_U32:
+        {
+        const uint32_t *data = key->data;
+        for (size_t i = 0; i < n; i++)
+            pairs[i].key = data[pairs[i].value];
+        }
+        break;
+    case COLSORT_I64:
+        {
+        const int64_t *data = key->data;
+        for (size_t i = 0; i < n; i++)
+            pairs[i].key = (uint64_t)data[pairs[i].value] ^ UINT64_C(0x8000000000000000);
+        }
+        break;
+    case COLSORT_U64:
+        {
+        const uint64_t *data = key->data;
+        for (size_t i = 0; i < n; i++)
+            pairs[i].key = data[pairs[i].value];
+        }
+        break;
+    case COLSORT_FLT:
+        {
+        const float *data = key->data;
+        for (size_t i = 0; i < n; i++)
+        {
+            uint32_t b;
+            memcpy(&b, &data[pairs[i].value], sizeof(b));
+            pairs[i].key = map_flt(b);
+        }
+        }
+        break;
+    case COLSORT_DBL:
+        {
+        const double *data = key->data;
+        for (size_t i = 0; i < n; i++)
+        {
+            uint64_t b;
+            memcpy(&b, &data[pairs[i].value], sizeof(b));
+            pairs[i].key = map_dbl(b);
+        }
+        }
+        break;
+    }
+}
+
+/*
+** Sort pairs on the first key, then each run of equal keys on the rest.
+** Within a run, the values (rows) are in ascending order on entry, and
+** both sorts keep them so.
+*/
+static bool sort_pairs(const ColSortKey *keys, size_t nkeys, RadixPair64 *pairs, size_t n, bool radix)
+{
+    load_keys(&keys[0], pairs, n);
+    if (radix)
+    {
+        if (!radix_sort_kv64(pairs, n))
+            return false;
+    }
+    else
+        pdq_sort_pairs(pairs, n);
+
+    if (nkeys > 1)
+    {
+        size_t i = 0;
+        while (i < n)
+        {
+            size_t j = i + 1;
+            while (j < n && pairs[j].key == pairs[i].key)
+                j++;
+            if (j - i > 1 && !sort_pairs(keys + 1, nkeys - 1, pairs + i, j - i, radix))
+                return false;
+            i = j;
+        }
+    }
+    return true;
+}
+
+bool colsort_order(const ColSortKey *keys, size_t nkeys, size_t n, size_t *perm, bool radix)
+{
+    if (nkeys == 0 || n == 0)
+    {
+        for (size_t i = 0; i < n; i++)
+            perm[i] = i;
+        return true;
+    }
+    RadixPair64 *pairs = malloc(n * sizeof(*pairs));
+    if (pairs == 0)
+        return false;
+    for (size_t i = 0; i < n; i++)
+        pairs[i].value = i;
+    bool ok = sort_pairs(keys, nkeys, pairs, n, radix);
+    if (ok)
+    {
+        for (size_t i = 0; i < n; i++)
+            perm[i] = pairs[i].value;
+    }
+    free(pairs);
+    return ok;
+}
+
+typedef struct Job
+{
+    const ColSortColumn *dst;
+    const ColSortColumn *src;
+    size_t          ncols;
+    const size_t   *perm;
+    size_t          lo;         /* Rows [lo, hi) */
+    size_t          hi;
+    size_t          n;
+    pthread_t       thread;
+} Job;
+
+#define GATHER_FUNCTION(name, type) \
+static void name(void *dst, const void *src, const size_t *perm, \
+                 size_t lo, size_t hi, size_t n) \
+{ \
+    type *d = dst; \
+    const type *s = src; \
+    size_t pf = (n > PREFETCH_AHEAD) ? n - PREFETCH_AHEAD : 0; \
+    if (pf > hi) \
+        pf = hi; \
+    size_t i = lo; \
+    for ( ; i < pf; i++) \
+    { \
+        PREFETCH(&s[perm[i + PREFETCH_AHEAD]]); \
+        d[i] = s[perm[i]]; \
+    } \
+    for ( ; i < hi; i++) \
+        d[i] = s[perm[i]]; \
+}
+
+GATHER_FUNCTION(gather_32, uint32_t)
+GATHER_FUNCTION(gather_64, uint64_t)
+
+static void gather_any(void *dst, const void *src, const size_t *perm,
+                       size_t lo, size_t hi, size_t width)
+{
+    char *d = dst;
+    const char *s = src;
+    for (size_t i = lo; i < hi; i++)
+        memcpy(d + i * width, s + perm[i] * width, width);
+}
+
+/* Gather every column for a block of rows, then the next block */
+static void *gather_main(void *arg)
+{
+    const Job *job = arg;
+    for (size_t b0 = job->lo; b0 < job->hi; b0 += GATHER_BLOCK)
+    {
+        size_t b1 = (job->hi - b0 > GATHER_BLOCK) ? b0 + GATHER_BLOCK : job->hi;
+        for (size_t c = 0; c < job->ncols; c++)
+        {
+            void *dst = job->dst[c].data;
+            const void *src = job->src[c].data;
+            switch (job->src[c].width)
+            {
+            case 4:
+                gather_32(dst, src, job->perm, b0, b1, job->n);
+                break;
+            case 8:
+                gather_64(dst, src, job->perm, b0, b1, job->n);
+                break;
+            default:
+                gather_any(dst, src, job->perm, b0, b1, job->src[c].width);
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+static void *copy_main(void *arg)
+{
+    const Job *job = arg;
+    for (size_t c = 0; c < job->ncols; c++)
+    {
+        size_t width = job->src[c].width;
+        memcpy((char *)job->dst[c].data + job->lo * width,
+               (const char *)job->src[c].data + job->lo * width,
+               (job->hi - job->lo) * width);
+    }
+    return 0;
+}
+
+/*
+** Split the rows, not the columns, between the threads: each thread
+** then reads its share of the permutation once however many columns
+** there are, and the load is even when there are fewer columns than
+** threads.  A thread that cannot be created runs in the caller.
+*/
+static void run_jobs(void *(*function)(void *), const ColSortColumn *dst,
+                     const ColSortColumn *src, size_t ncols,
+                     const size_t *perm, size_t n, int nthreads)
+{
+    Job jobs[MAX_THREADS];
+    bool started[MAX_THREADS];
+
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > MAX_THREADS)
+        nthreads = MAX_THREADS;
+    if ((size_t)nthreads > n / GATHER_BLOCK + 1)
+        nthreads = (int)(n / GATHER_BLOCK + 1);
+
+    for (int t = 0; t < nthreads; t++)
+    {
+        Job *job = &jobs[t];
+        job->dst = dst;
+        job->src = src;
+        job->ncols = ncols;
+        job->perm = perm;
+        job->n = n;
+        /* Block-aligned boundaries */
+        job->lo = (size_t)((unsigned long long)(n / GATHER_BLOCK) * t / nthreads) * GATHER_BLOCK;
+        job->hi = (size_t)((unsigned long long)(n / GATHER_BLOCK) * (t + 1) / nthreads) * GATHER_BLOCK;
+        if (t == nthreads - 1)
+            job->hi = n;
+        started[t] = (t > 0 && pthread_create(&job->thread, 0, function, job) == 0);
+    }
+    (*function)(&jobs[0]);
+    for (int t = 1; t < nthreads; t++)
+    {
+        if (started[t])
+            pthread_join(jobs[t].thread, 0);
+        else
+            (*function)(&jobs[t]);
+    }
+}
+
+void colsort_gather(const ColSortColumn *dst, const ColSortColumn *src, size_t ncols,
+                    const size_t *perm, size_t n, int nthreads)
+{
+    if (n > 0 && ncols > 0)
+        run_jobs(gather_main, dst, src, ncols, perm, n, nthreads);
+}
+
+static inline size_t slice_size(size_t n, size_t width)
+{
+    return (n * width + SLICE_ALIGN - 1) / SLICE_ALIGN * SLICE_ALIGN;
+}
+
+bool colsort_permute(const ColSortColumn *cols, size_t ncols, const size_t *perm,
+                     size_t n, int nthreads)
+{
+    if (n == 0 || ncols == 0)
+        return true;
+
+    size_t total = 0;
+    size_t widest = 0;
+    for (size_t c = 0; c < ncols; c++)
+    {
+        size_t size = slice_size(n, cols[c].width);
+        total += size;
+        if (size > widest)
+            widest = size;
+    }
+    size_t budget = (widest > COLSORT_SCRATCH) ? widest : COLSORT_SCRATCH;
+    if (budget > total)
+        budget = total;
+
+    char *scratch = malloc(budget);
+    ColSortColumn *tmp = malloc(ncols * sizeof(*tmp));
+    if (scratch == 0 || tmp == 0)
+    {
+        free(scratch);
+        free(tmp);
+        return false;
+    }
+
+    /* As many columns at a time as fit in the scratch space */
+    size_t c0 = 0;
+    while (c0 < ncols)
+    {
+        size_t used = 0;
+        size_t c1 = c0;
+        while (c1 < ncols && used + slice_size(n, cols[c1].width) <= budget)
+        {
+            tmp[c1 - c0].data = scratch + used;
+            tmp[c1 - c0].width = cols[c1].width;
+            used += slice_size(n, cols[c1].width);
+            c1++;
+        }
+        run_jobs(gather_main, tmp, cols + c0, c1 - c0, perm, n, nthreads);
+        run_jobs(copy_main, cols + c0, tmp, c1 - c0, perm, n, nthreads);
+        c0 = c1;
+    }
+
+    free(tmp);
+    free(scratch);
+    return true;
+}
+
+bool colsort(const ColSortKey *keys, size_t nkeys, const ColSortColumn *cols, size_t ncols,
+             size_t n, int nthreads)
+{
+    size_t *perm = malloc(n * sizeof(*perm) + 1);
+    if (perm == 0)
+        return false;
+    bool ok = colsort_order(keys, nkeys, n, perm, true) &&
+              colsort_permute(cols, ncols, perm, n, nthreads);
+    free(perm);
+    return ok;
+}
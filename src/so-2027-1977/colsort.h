@@ -0,0 +1,85 @@
+/*
+@(#)File:           colsort.h
+@(#)Purpose:        Sort parallel arrays (columns) via an index permutation
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#ifndef JLSS_ID_COLSORT_H
+#define JLSS_ID_COLSORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>    /* bool */
+#include <stddef.h>     /* size_t */
+
+/*
+** Sorting a set of parallel arrays -- a column store -- by swapping
+** every column at every exchange costs one scattered write per column
+** per swap.  These functions instead sort in two steps:
+**
+** colsort_order() computes the permutation: perm[i] is the row that
+** belongs in position i.  It sorts compact (key, row) pairs of 16 bytes
+** on the first key column, with the LSD radix sort from libsoq when
+** radix is true and with pdqsort when it is false, then sorts each run
+** of rows with equal keys on the next key column, and so on.  Rows with
+** all keys equal stay in their original order, so the sort is stable.
+** Floating point keys are ordered as radix_sort_dbl() orders them, so
+** -0.0 sorts before +0.0 and NaNs go to the ends.
+**
+** colsort_gather() applies the permutation to any number of columns:
+** dst[c][i] = src[c][perm[i]].  The rows are divided between nthreads
+** threads, and each thread works through its rows a block at a time,
+** gathering every column for the block before moving on, so the block
+** of the permutation is read from memory once and then stays in cache.
+**
+** colsort_permute() does the same in place, gathering groups of columns
+** into scratch space (at most COLSORT_SCRATCH bytes, or one column if
+** that is bigger) and copying them back.
+**
+** colsort() computes the permutation from the keys and applies it to
+** the columns in place; the key columns are usually among them.
+**
+** Column widths may be anything; widths of 4 and 8 bytes are fastest.
+** colsort_gather() cannot fail; the others return false if they cannot
+** allocate memory, in which case colsort_permute() and colsort() leave
+** the columns unchanged.  A thread that cannot be started is not an
+** error; its share of the rows is done by the calling thread instead.
+*/
+
+typedef enum ColSortType
+{
+    COLSORT_I32, COLSORT_U32, COLSORT_I64, COLSORT_U64, COLSORT_FLT, COLSORT_DBL
+} ColSortType;
+
+typedef struct ColSortKey
+{
+    const void *data;
+    ColSortType type;
+} ColSortKey;
+
+typedef struct ColSortColumn
+{
+    void       *data;
+    size_t      width;      /* Bytes per element */
+} ColSortColumn;
+
+enum { COLSORT_SCRATCH = 256 * 1024 * 1024 };
+
+extern bool colsort_order(const ColSortKey *keys, size_t nkeys, size_t n, size_t *perm, bool radix);
+extern void colsort_gather(const ColSortColumn *dst, const ColSortColumn *src, size_t ncols,
+                           const size_t *perm, size_t n, int nthreads);
+extern bool colsort_permute(const ColSortColumn *cols, size_t ncols, const size_t *perm,
+                            size_t n, int nthreads);
+extern bool colsort(const ColSortKey *keys, size_t nkeys, const ColSortColumn *cols, size_t ncols,
+                    size_t n, int nthreads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JLSS_ID_COLSORT_H */
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include "colsort.h"
 
 #define FLTFMT "%13.6f"
 
@@ -38,6 +39,7 @@ static void *xmalloc(size_t size)
 void quicksort_last(Array4 *A);
 void quicksort_random(Array4 *A);
 void selectionsort(Array4 *A);
+void colsort_array4(Array4 *A);
 
 static inline int compare(Array4 const *A, size_t p, size_t r)
 {
@@ -208,6 +210,7 @@ static void test_set_sorts(Array4 *A, char const *l_tag, char const *z_tag)
         { quicksort_last, "QS.L" },
         { quicksort_random, "QS.R" },
         { selectionsort, "SS.N" },
+        { colsort_array4, "CS.P" },
     };
     enum { NUM_SORTS = sizeof(sort) / sizeof(sort[0]) };
     for (int i = 0; i < NUM_SORTS; i++)
@@ -337,6 +340,28 @@ void selectionsort(Array4 *A)
     }
 }
 
+/* Sort by permutation: sort (key, index) pairs, then gather each array */
+void colsort_array4(Array4 *A)
+{
+    ColSortKey keys[] =
+    {
+        { A->x, COLSORT_DBL },
+        { A->y, COLSORT_DBL },
+    };
+    ColSortColumn cols[] =
+    {
+        { A->x, sizeof(A->x[0]) },
+        { A->y, sizeof(A->y[0]) },
+        { A->z, sizeof(A->z[0]) },
+        { A->w, sizeof(A->w[0]) },
+    };
+    if (!colsort(keys, 2, cols, 4, A->n, 1))
+    {
+        fprintf(stderr, "Out of memory (%zu rows)\n", A->n);
+        exit(1);
+    }
+}
+
 /*
 ** To apply this to the real code, where there are 4 arrays to be sorted
 ** in parallel, you might write:
@@ -0,0 +1,752 @@
+/* SO 2093-8023 - many ranks at once, and approximate quantiles */
+
+/*
+** qsel.cpp and mppsel.cpp find one rank per call.  Percentiles such as
+** p50, p90, p99 and p99.9 need several ranks of the same data, and a
+** separate quickselect for each one re-partitions most of the array
+** every time.
+**
+** multi_select() finds any number of ranks in one recursive pass: after
+** each partition, the ranks are split between the two sides, and only
+** sides holding a wanted rank are processed further, so the work is
+** about n * (1 + log2(number of ranks)) comparisons rather than n per
+** rank.  The pivot for a range of 600 or more elements is chosen as
+** Floyd and Rivest do: by selecting, from a sample of the range, the
+** value expected to lie just beside one of the wanted ranks (the middle
+** one), so each partition cuts the range down to a few elements around
+** that rank, and the other ranks are shared out between the sides.
+** Smaller ranges use the median of 3 (or Tukey's ninther).  It is an
+** introselect: if the recursion gets deeper than 2 log2(n) the pivot
+** is chosen by median of medians, which bounds the worst case at O(n)
+** per rank-path.  Ranges of up to 16 elements are insertion sorted.
+** When it returns, a[r] holds the value of rank r (0-based) for each
+** requested r, and the array is partitioned around each of them.
+**
+** With nthreads > 1, ranges of at least par_min elements are
+** partitioned in parallel: each thread counts the elements of its chunk
+** that are less than, equal to and greater than the pivot, then copies
+** them to their places in a scratch array, and the threads copy the
+** scratch array back.  That is three passes over the data instead of
+** one, but each is divided between the threads.  Elements equal to the
+** pivot are gathered in the middle, so ranks that land among them need
+** no more work.
+**
+** KLLSketch is a streaming quantile sketch (Karnin, Lang and Liberty,
+** 2016) for when the data cannot be kept.  Values go into a buffer at
+** level 0; when a level is full it is sorted and every other element
+** (odd or even positions, at random) is promoted to the next level with
+** twice the weight.  Capacities shrink by a factor of 2/3 per level
+** down from k at the top, so the sketch holds about 3k values whatever
+** the stream length, and the rank error of any quantile is O(1/k),
+** independent of n, with high probability.  Sketches of separate
+** streams can be merged, so threads can sketch their shares of the
+** data independently.
+**
+** The benchmark times, on lognormal 'latencies':
+**     sort        std::sort, then read off the ranks
+**     nth         std::nth_element once per rank
+**     multi       multi_select(), one thread
+**     multi-par   multi_select() with -j threads
+**     kll         KLLSketch, one value at a time, and its rank error
+** Option -t runs the correctness tests instead.
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <unistd.h>     // getopt
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+static size_t par_min = 1 << 20;
+enum { SMALL_RANGE = 16 };
+enum { NINTHER_MIN = 128 };
+enum { SAMPLE_MIN = 600 };
+
+template<class T>
+static void insertion_sort(T *a, size_t n)
+{
+    for (size_t i = 1; i < n; i++)
+    {
+        T v = a[i];
+        size_t j = i;
+        for ( ; j > 0 && v < a[j - 1]; j--)
+            a[j] = a[j - 1];
+        a[j] = v;
+    }
+}
+
+/* Order a[i], a[j], a[k] and return j, the index of the median */
+template<class T>
+static size_t sort3(T *a, size_t i, size_t j, size_t k)
+{
+    if (a[j] < a[i])
+        swap(a[i], a[j]);
+    if (a[k] < a[j])
+    {
+        swap(a[j], a[k]);
+        if (a[j] < a[i])
+            swap(a[i], a[j]);
+    }
+    return j;
+}
+
+template<class T>
+static size_t choose_pivot(T *a, size_t n)
+{
+    size_t m = n / 2;
+    if (n < NINTHER_MIN)
+        return sort3(a, 0, m, n - 1);
+    size_t s = n / 8;
+    sort3(a, 0, s, 2 * s);
+    sort3(a, m - s, m, m + s);
+    sort3(a, n - 1 - 2 * s, n - 1 - s, n - 1);
+    return sort3(a, s, m, n - 1 - s);
+}
+
+/*
+** Partition a[0..n) about a[pi]: afterwards a[0..m) <= a[m] <= a[m+1..n)
+** and m is returned.  Elements equal to the pivot stop both scans, so
+** many duplicates still split evenly.
+*/
+template<class T>
+static size_t partition(T *a, size_t n, size_t pi)
+{
+    swap(a[0], a[pi]);
+    T p = a[0];
+    size_t i = 0;
+    size_t j = n;
+    for (;;)
+    {
+        while (++i < n && a[i] < p)
+            ;
+        while (p < a[--j])
+            ;
+        if (i >= j)
+            break;
+        swap(a[i], a[j]);
+    }
+    swap(a[0], a[j]);
+    return j;
+}
+
+static int depth_limit(size_t n)
+{
+    int depth = 0;
+    while (n > 1)
+    {
+        n >>= 1;
+        depth++;
+    }
+    return 2 * depth;
+}
+
+template<class T>
+static void select_ranks(T *a, size_t lo, size_t hi, const size_t *ranks, size_t nranks, int depth);
+
+/* Median of medians of 5: moves the medians to the front; returns the pivot index */
+template<class T>
+static size_t median_of_medians(T *a, size_t n)
+{
+    if (n <= 5)
+    {
+        insertion_sort(a, n);
+        return n / 2;
+    }
+    size_t m = 0;
+    for (size_t i = 0; i + 5 <= n; i += 5)
+    {
+        insertion_sort(a + i, 5);
+        swap(a[m++], a[i + 2]);
+    }
+    size_t mid = m / 2;
+    select_ranks(a, 0, m, &mid, 1, depth_limit(m));
+    return mid;
+}
+
+/*
+** Floyd and Rivest's pivot for rank k of a[lo..hi): select rank k within
+** a sample of the elements around a[k], sized and placed so that, with
+** high probability, the pivot lands just beside the true rank k.  Then
+** the partition leaves only a short range around k, and most elements
+** go the same way, so the comparisons are well predicted.
+*/
+template<class T>
+static size_t floyd_rivest_pivot(T *a, size_t lo, size_t hi, size_t k, int depth)
+{
+    double n = (double)(hi - lo);
+    double i = (double)(k - lo);
+    double z = log(n);
+    double s = 0.5 * exp(2.0 * z / 3.0);
+    double sd = 0.5 * sqrt(z * s * (n - s) / n) * ((i < n / 2) ? -1.0 : 1.0);
+    double left = (double)k - i * s / n + sd;
+    double right = (double)k + (n - i) * s / n + sd;
+    size_t slo = (left > (double)lo) ? (size_t)left : lo;
+    size_t shi = (right < (double)hi) ? (size_t)right : hi;
+    if (slo > k)
+        slo = k;
+    if (shi <= k)
+        shi = k + 1;
+    select_ranks(a, slo, shi, &k, 1, depth);
+    return k - lo;
+}
+
+/*
+** Put the values of the ranks (sorted, absolute indexes, all within
+** [lo, hi)) in place in a[lo..hi).
+*/
+template<class T>
+static void select_ranks(T *a, size_t lo, size_t hi, const size_t *ranks, size_t nranks, int depth)
+{
+    while (nranks > 0 && hi - lo > SMALL_RANGE)
+    {
+        size_t n = hi - lo;
+        size_t pi;
+        if (depth-- <= 0)
+            pi = median_of_medians(a + lo, n);
+        else if (n >= SAMPLE_MIN)
+            pi = floyd_rivest_pivot(a, lo, hi, ranks[nranks / 2], depth);
+        else
+            pi = choose_pivot(a + lo, n);
+        size_t m = lo + partition(a + lo, n, pi);
+        /* Ranks [0, nl) are left of m; [nr, nranks) are right of it */
+        size_t nl = lower_bound(ranks, ranks + nranks, m) - ranks;
+        size_t nr = (nl < nranks && ranks[nl] == m) ? nl + 1 : nl;
+        /* Recurse on the smaller side and loop on the larger */
+        if (m - lo < hi - m)
+        {
+            select_ranks(a, lo, m, ranks, nl, depth);
+            lo = m + 1;
+            ranks += nr;
+            nranks -= nr;
+        }
+        else
+        {
+            select_ranks(a, m + 1, hi, ranks + nr, nranks - nr, depth);
+            hi = m;
+            nranks = nl;
+        }
+    }
+    if (nranks > 0)
+        insertion_sort(a + lo, hi - lo);
+}
+
+/* Run f(t) for t = 0..nthreads-1, t = 0 in this thread */
+template<class F>
+static void run_threads(int nthreads, F f)
+{
+    vector<thread> threads;
+    for (int t = 1; t < nthreads; t++)
+        threads.emplace_back(f, t);
+    f(0);
+    for (auto &th : threads)
+        th.join();
+}
+
+/*
+** Three-way partition of a[0..n) about the value p, using tmp[0..n):
+** afterwards a[0..lt) < p, a[lt..gt) == p and a[gt..n) > p.
+*/
+template<class T>
+static void par_partition(T *a, size_t n, T p, T *tmp, int nthreads, size_t &lt, size_t &gt)
+{
+    vector<size_t> counts(3 * nthreads);
+    auto chunk = [n, nthreads](int t) { return (size_t)((unsigned long long)n * t / nthreads); };
+
+    run_threads(nthreads, [&](int t) {
+        size_t c[3] = { 0, 0, 0 };
+        for (size_t i = chunk(t); i < chunk(t + 1); i++)
+            c[(a[i] < p) ? 0 : (p < a[i]) ? 2 : 1]++;
+        for (int k = 0; k < 3; k++)
+            counts[3 * t + k] = c[k];
+    });
+
+    /* Exclusive prefix sums, region by region, then thread by thread */
+    vector<size_t> offsets(3 * nthreads);
+    size_t sum = 0;
+    size_t starts[3];
+    for (int k = 0; k < 3; k++)
+    {
+        starts[k] = sum;
+        for (int t = 0; t < nthreads; t++)
+        {
+            offsets[3 * t + k] = sum;
+            sum += counts[3 * t + k];
+        }
+    }
+    lt = starts[1];
+    gt = starts[2];
+
+    run_threads(nthreads, [&](int t) {
+        size_t o[3] = { offsets[3 * t], offsets[3 * t + 1], offsets[3 * t + 2] };
+        for (size_t i = chunk(t); i < chunk(t + 1); i++)
+        {
+            T v = a[i];
+            tmp[o[(v < p) ? 0 : (p < v) ? 2 : 1]++] = v;
+        }
+    });
+    run_threads(nthreads, [&](int t) {
+        copy(tmp + chunk(t), tmp + chunk(t + 1), a + chunk(t));
+    });
+}
+
+template<class T>
+static void par_select(T *a, size_t lo, size_t hi, const size_t *ranks, size_t nranks,
+                       T *tmp, int nthreads, int depth)
+{
+    if (nranks == 0)
+        return;
+    size_t n = hi - lo;
+    if (nthreads <= 1 || n < par_min)
+    {
+        select_ranks(a, lo, hi, ranks, nranks, depth);
+        return;
+    }
+    size_t pi = (depth-- > 0) ? floyd_rivest_pivot(a, lo, hi, ranks[nranks / 2], depth)
+                              : median_of_medians(a + lo, n);
+    size_t lt, gt;
+    par_partition(a + lo, n, a[lo + pi], tmp + lo, nthreads, lt, gt);
+    lt += lo;
+    gt += lo;
+    size_t nl = lower_bound(ranks, ranks + nranks, lt) - ranks;
+    size_t nr = lower_bound(ranks, ranks + nranks, gt) - ranks;
+    par_select(a, lo, lt, ranks, nl, tmp, nthreads, depth);
+    par_select(a, gt, hi, ranks + nr, nranks - nr, tmp, nthreads, depth);
+}
+
+template<class T>
+void multi_select(T *a, size_t n, vector<size_t> ranks, int nthreads = 1)
+{
+    sort(ranks.begin(), ranks.end());
+    ranks.erase(unique(ranks.begin(), ranks.end()), ranks.end());
+    while (!ranks.empty() && ranks.back() >= n)
+        ranks.pop_back();
+    if (ranks.empty())
+        return;
+    if (nthreads > 1 && n >= par_min)
+    {
+        unique_ptr<T[]> tmp(new T[n]);     // Not value-initialised, unlike vector
+        par_select(a, 0, n, ranks.data(), ranks.size(), tmp.get(), nthreads, depth_limit(n));
+    }
+    else
+        select_ranks(a, 0, n, ranks.data(), ranks.size(), depth_limit(n));
+}
+
+template<class T>
+class KLLSketch
+{
+public:
+    explicit KLLSketch(size_t k = 200, uint64_t seed = 1)
+        : k(max(k, (size_t)8)), n(0), size(0), levels(1), rng(seed | 1)
+    {
+        max_size = capacity(0);
+    }
+
+    void insert(T x)
+    {
+        levels[0].push_back(x);
+        n++;
+        if (++size >= max_size)
+            compress();
+    }
+
+    void merge(const KLLSketch &other)
+    {
+        while (levels.size() < other.levels.size())
+            levels.emplace_back();
+        for (size_t h = 0; h < other.levels.size(); h++)
+            levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+        n += other.n;
+        size += other.size;
+        update_max_size();
+        while (size >= max_size)
+            compress();
+    }
+
+    /* Estimate of the value of rank q * (n - 1) */
+    T quantile(double q) const
+    {
+        vector<pair<T, uint64_t>> items;
+        items.reserve(size);
+        for (size_t h = 0; h < levels.size(); h++)
+        {
+            for (const T &v : levels[h])
+                items.emplace_back(v, (uint64_t)1 << h);
+        }
+        assert(!items.empty());
+        sort(items.begin(), items.end());
+        double rank = q * (n - 1);
+        uint64_t cum = 0;
+        for (const auto &it : items)
+        {
+            cum += it.second;
+            if (cum > rank)
+                return it.first;
+        }
+        return items.back().first;
+    }
+
+    uint64_t count() const { return n; }
+    size_t retained() const { return size; }
+
+private:
+    size_t capacity(size_t h) const
+    {
+        double depth = (double)(levels.size() - 1 - h);
+        size_t cap = (size_t)ceil(k * pow(2.0 / 3.0, depth));
+        return max(cap, (size_t)2);
+    }
+
+    void update_max_size()
+    {
+        max_size = 0;
+        for (size_t h = 0; h < levels.size(); h++)
+            max_size += capacity(h);
+    }
+
+    /* Compact the lowest full level into the one above */
+    void compress()
+    {
+        for (size_t h = 0; h < levels.size(); h++)
+        {
+            if (levels[h].size() < capacity(h))
+                continue;
+            if (h + 1 == levels.size())
+            {
+                levels.emplace_back();
+                update_max_size();
+            }
+            vector<T> &src = levels[h];
+            vector<T> &dst = levels[h + 1];
+            sort(src.begin(), src.end());
+            /* An odd element out stays at this level */
+            size_t even = src.size() & ~(size_t)1;
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            for (size_t i = rng & 1; i < even; i += 2)
+                dst.push_back(src[i]);
+            size -= even / 2;
+            if (even < src.size())
+                src[0] = src[even];
+            src.resize(src.size() - even);
+            return;
+        }
+    }
+
+    size_t k;
+    uint64_t n;
+    size_t size;
+    size_t max_size;
+    vector<vector<T>> levels;
+    uint64_t rng;
+};
+
+/* Check that a[r] has the right value and a is partitioned about it */
+template<class T>
+static bool check_ranks(const T *a, size_t n, const vector<size_t> &ranks, const vector<T> &sorted)
+{
+    for (size_t r : ranks)
+    {
+        if (r >= n)
+            continue;
+        if (a[r] != sorted[r])
+            return false;
+        for (size_t i = 0; i < r; i++)
+        {
+            if (a[r] < a[i])
+                return false;
+        }
+        for (size_t i = r + 1; i < n; i++)
+        {
+            if (a[i] < a[r])
+                return false;
+        }
+    }
+    vector<T> b(a, a + n);
+    sort(b.begin(), b.end());
+    return b == sorted;
+}
+
+static int run_tests(int nthreads)
+{
+    mt19937_64 gen(20938023);
+    size_t tests = 0;
+    size_t failures = 0;
+    size_t saved_par_min = par_min;
+    par_min = 64;
+
+    for (size_t n = 1; n <= 600; n += (n < 100) ? 1 : 37)
+    {
+        for (int range : { 3, 1000, 1000000 })
+        {
+            for (int trial = 0; trial < 8; trial++)
+            {
+                vector<int> data(n);
+                for (auto &v : data)
+                    v = (int)(gen() % range);
+                if (trial == 1)
+                    sort(data.begin(), data.end());
+                if (trial == 2)
+                    sort(data.rbegin(), data.rend());
+                vector<int> sorted(data);
+                sort(sorted.begin(), sorted.end());
+                vector<size_t> ranks;
+                size_t nranks = 1 + gen() % 6;
+                for (size_t i = 0; i < nranks; i++)
+                    ranks.push_back(gen() % n);
+
+                /* Plain, median of medians only, and parallel */
+                vector<int> a(data);
+                multi_select(a.data(), n, ranks, 1);
+                bool ok = check_ranks(a.data(), n, ranks, sorted);
+
+                vector<size_t> rs(ranks);
+                sort(rs.begin(), rs.end());
+                rs.erase(unique(rs.begin(), rs.end()), rs.end());
+                a = data;
+                select_ranks(a.data(), 0, n, rs.data(), rs.size(), 0);
+                ok = ok && check_ranks(a.data(), n, ranks, sorted);
+
+                a = data;
+                multi_select(a.data(), n, ranks, max(nthreads, 3));
+                ok = ok && check_ranks(a.data(), n, ranks, sorted);
+
+                tests++;
+                if (!ok)
+                {
+                    failures++;
+                    cout << "FAIL: n = " << n << ", range = " << range
+                         << ", trial = " << trial << "\n";
+                }
+            }
+        }
+    }
+
+    /* KLL: every estimate within a few percent of rank on 10^6 values */
+    const size_t n = 1000000;
+    vector<double> data(n);
+    for (auto &v : data)
+        v = (double)(gen() % 100000);
+    KLLSketch<double> s1(200, 1), s2(200, 2);
+    for (size_t i = 0; i < n; i++)
+        ((i < n / 2) ? s1 : s2).insert(data[i]);
+    s1.merge(s2);
+    sort(data.begin(), data.end());
+    for (double q = 0.0; q <= 1.0; q += 0.01)
+    {
+        double v = s1.quantile(q);
+        double r0 = lower_bound(data.begin(), data.end(), v) - data.begin();
+        double r1 = upper_bound(data.begin(), data.end(), v) - data.begin();
+        double target = q * (n - 1);
+        double err = (target < r0) ? r0 - target : (target >= r1) ? target - r1 + 1 : 0;
+        tests++;
+        if (err / n > 0.03 || s1.count() != n)
+        {
+            failures++;
+            cout << "FAIL: KLL q = " << q << ", rank error = " << err / n << "\n";
+        }
+    }
+
+    par_min = saved_par_min;
+    cout << tests << " tests, " << failures << " failures\n";
+    cout << ((failures == 0) ? "== PASS ==" : "** FAIL **") << "\n";
+    return (failures == 0) ? 0 : 1;
+}
+
+static const double quantiles[] = { 0.50, 0.90, 0.99, 0.999 };
+static const char *const labels[] = { "p50", "p90", "p99", "p99.9" };
+enum { NUM_QUANTILES = sizeof(quantiles) / sizeof(quantiles[0]) };
+
+static size_t rank_of(double q, size_t n)
+{
+    return (size_t)(q * (n - 1));
+}
+
+static void report(const char *name, double secs, const double *values, const char *extra = "")
+{
+    cout << left << setw(10) << name << right << fixed << setprecision(3)
+         << setw(9) << secs << " s";
+    for (int i = 0; i < NUM_QUANTILES; i++)
+        cout << setw(12) << setprecision(3) << values[i];
+    cout << extra << "\n";
+}
+
+static double seconds_since(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static const char usage[] = "Usage: multisel [-ht][-j threads][-k kll-k][-n count][-s seed]\n";
+
+enum { MAX_THREADS = 1024 };
+static const size_t MAX_KLL_K = 1000000;
+static const double MAX_COUNT = 1e12;
+
+[[noreturn]] static void bad_option(const char *what, const char *arg, const char *range)
+{
+    cerr << "multisel: invalid " << what << " '" << arg << "' (" << range << ")\n" << usage;
+    exit(1);
+}
+
+/* An integer in lo..hi, or exit */
+static unsigned long long scan_number(const char *what, const char *arg,
+                                      unsigned long long lo, unsigned long long hi)
+{
+    char *end;
+    errno = 0;
+    unsigned long long v = strtoull(arg, &end, 0);
+    if (end == arg || *end != '\0' || errno != 0 || strchr(arg, '-') != 0 || v < lo || v > hi)
+        bad_option(what, arg, (to_string(lo) + ".." + to_string(hi)).c_str());
+    return v;
+}
+
+/* A count such as 10000 or 1e9: a whole number from 2 to MAX_COUNT */
+static size_t scan_count(const char *arg)
+{
+    char *end;
+    errno = 0;
+    double v = strtod(arg, &end);
+    if (end == arg || *end != '\0' || errno != 0 || !(v >= 2 && v <= MAX_COUNT) || v != floor(v))
+        bad_option("count", arg, "2..1e12");
+    return (size_t)v;
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = 10000000;
+    size_t kll_k = 200;
+    int nthreads = (int)thread::hardware_concurrency();
+    uint64_t seed = 20938023;
+    bool test = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hj:k:n:s:t")) != -1)
+    {
+        switch (opt)
+        {
+        case 'j':
+            nthreads = (int)scan_number("thread count", optarg, 1, MAX_THREADS);
+            break;
+        case 'k':
+            kll_k = scan_number("KLL k", optarg, 8, MAX_KLL_K);
+            break;
+        case 'n':
+            n = scan_count(optarg);             // Allows 1e9
+            break;
+        case 's':
+            seed = scan_number("seed", optarg, 0, UINT64_MAX);
+            break;
+        case 't':
+            test = true;
+            break;
+        case 'h':
+            cout << usage;
+            return 0;
+        default:
+            cerr << usage;
+            return 1;
+        }
+    }
+    if (nthreads < 1)
+        nthreads = 1;
+    if (test)
+        return run_tests(nthreads);
+    if (n < 2)
+    {
+        cerr << usage;
+        return 1;
+    }
+
+    cout << "Generating " << n << " lognormal values (threads = " << nthreads << ")\n";
+    vector<double> data(n);
+    mt19937_64 gen(seed);
+    lognormal_distribution<double> dist(0.0, 1.0);
+    for (auto &v : data)
+        v = 1000.0 * dist(gen);
+
+    vector<size_t> ranks;
+    for (double q : quantiles)
+        ranks.push_back(rank_of(q, n));
+
+    cout << left << setw(10) << "method" << right << setw(11) << "time";
+    for (const char *label : labels)
+        cout << setw(12) << label;
+    cout << "\n";
+
+    double exact[NUM_QUANTILES];
+    vector<double> a(data);
+    auto start = chrono::steady_clock::now();
+    sort(a.begin(), a.end());
+    double t = seconds_since(start);
+    for (int i = 0; i < NUM_QUANTILES; i++)
+        exact[i] = a[ranks[i]];
+    report("sort", t, exact);
+    vector<double> sorted;
+    sorted.swap(a);
+
+    double values[NUM_QUANTILES];
+    bool ok = true;
+    a = data;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < NUM_QUANTILES; i++)
+    {
+        nth_element(a.begin(), a.begin() + ranks[i], a.end());
+        values[i] = a[ranks[i]];
+    }
+    t = seconds_since(start);
+    report("nth", t, values);
+    ok = ok && equal(values, values + NUM_QUANTILES, exact);
+
+    a = data;
+    start = chrono::steady_clock::now();
+    multi_select(a.data(), n, ranks, 1);
+    t = seconds_since(start);
+    for (int i = 0; i < NUM_QUANTILES; i++)
+        values[i] = a[ranks[i]];
+    report("multi", t, values);
+    ok = ok && equal(values, values + NUM_QUANTILES, exact);
+
+    a = data;
+    start = chrono::steady_clock::now();
+    multi_select(a.data(), n, ranks, nthreads);
+    t = seconds_since(start);
+    for (int i = 0; i < NUM_QUANTILES; i++)
+        values[i] = a[ranks[i]];
+    report("multi-par", t, values);
+    ok = ok && equal(values, values + NUM_QUANTILES, exact);
+
+    KLLSketch<double> sketch(kll_k, seed);
+    start = chrono::steady_clock::now();
+    for (double v : data)
+        sketch.insert(v);
+    for (int i = 0; i < NUM_QUANTILES; i++)
+        values[i] = sketch.quantile(quantiles[i]);
+    t = seconds_since(start);
+    report("kll", t, values);
+    cout << "kll: k = " << kll_k << ", " << sketch.retained() << " values kept; rank error:";
+    for (int i = 0; i < NUM_QUANTILES; i++)
+    {
+        size_t r0 = lower_bound(sorted.begin(), sorted.end(), values[i]) - sorted.begin();
+        size_t r1 = upper_bound(sorted.begin(), sorted.end(), values[i]) - sorted.begin();
+        size_t target = ranks[i];
+        size_t err = (target < r0) ? r0 - target : (target >= r1) ? target - r1 + 1 : 0;
+        cout << ' ' << setprecision(4) << 100.0 * err / n << '%';
+    }
+    cout << "\n";
+
+    cout << (ok ? "== PASS ==" : "** FAIL **") << "\n";
+    return ok ? 0 : 1;
+}
@@ -15,7 +15,7 @@ template<typename T>
 static void check_partition(T *a, size_t n, size_t rank)
 {
     int ok = 1;
-    assert(rank >= 0 && rank <= n);
+    assert(rank <= n);
     for (size_t i = 0; i < rank; i++)
     {
         if (a[i] > a[rank])
@@ -91,9 +91,9 @@ T quickSelect(T *a, size_t n, size_t k)
 {
     while (n > 1)
     {
-        assert(k >= 0 && k < n);
+        assert(k < n);
         size_t j = partition(a, n);
-        assert(j >= 0 && j < n);
+        assert(j < n);
         if (k < j)
             n = j;
         else if (k > j)
@@ -13,6 +13,7 @@
 
 /* SO 3514-7784 */
 
+#include "posixver.h"
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -242,7 +243,19 @@ int BinSearch_E(int N, const int X[N], int T)
 
 /* Test support code */
 
-#include "timer.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "bench.h"
+#include "bsbatch.h"
+#include "bsindex.h"
+#include "bslearn.h"
+#include "jlss.h"
+#include "radixsort.h"
+#include "stderr.h"
+#include "xorshift.h"
 
 /* random -n 10000 10000 29999 | sort | commalist -l 70 */
 /* Roughly half the numbers between 10000 and 30000 are present */
@@ -1274,40 +1287,730 @@ static int BinSearch_D1(int size, const int array[size], int value)
 }
 
 typedef int (*BinSearch)(int size, const int data[size], int value);
+typedef long (*IndexSearch)(const BSIndex *index, int value);
+typedef void (*BatchSearch)(const int *array, size_t n, const int *keys, size_t m,
+                            long *results);
+typedef struct SearchCase SearchCase;
+typedef Pair (*RangeSearch)(const SearchCase *sc, int value);
 
-static void time_search(const char *a_name, int size, const int array[size],
-                        BinSearch function)
+/*
+** Each search function is a case for the benchmark harness in bench.h.
+** By default, a run searches for every value from just below the
+** smallest to just above the largest number in the array, summing the
+** values found; the check compares that sum with the one from
+** BinSearch_A.  With -n, a run searches for a set of random values in
+** a large random array instead, and the sum is compared with the one
+** from BinSearch_B.  The index searches (bsindex.h) use an index built
+** from the array before the runs.  The batch searches (bsbatch.h) are
+** given all the values at once, as an array, and the results are
+** summed afterwards.  The range searches sum the first and last
+** positions of each value instead, and are checked against BinSearch_D.
+*/
+
+struct SearchCase
+{
+    BinSearch   function;
+    IndexSearch ifunction;      /* Used if index is not null */
+    const BSIndex *index;
+    BatchSearch bfunction;      /* Used if not null */
+    long       *results;        /* Space for bfunction */
+    RangeSearch rfunction;      /* Used if not null */
+    const BSLearn *learn;
+    int         size;
+    const int  *array;
+    const int  *queries;        /* Null: every value in range */
+    int         nqueries;
+    long long   vsum;
+    long long   expect;
+};
+
+static inline long long search_one(const SearchCase *sc, int value)
+{
+    long index;
+    if (sc->rfunction != 0)
+    {
+        Pair p = (*sc->rfunction)(sc, value);
+        return p.lo + p.hi;
+    }
+    else if (sc->index != 0)
+        index = (*sc->ifunction)(sc->index, value);
+    else
+        index = (*sc->function)(sc->size, sc->array, value);
+    return (index == -1) ? index : sc->array[index];
+}
+
+static long long search_all(const SearchCase *sc)
 {
-    Clock clk;
-    clk_init(&clk);
-    int x0 = array[0] - 1;
-    int x1 = array[size-1] + 2;
     long long vsum = 0;
 
-    clk_start(&clk);
-    for (int i = x0; i < x1; i++)
+    if (sc->bfunction != 0)
+    {
+        (*sc->bfunction)(sc->array, sc->size, sc->queries, sc->nqueries, sc->results);
+        for (int i = 0; i < sc->nqueries; i++)
+            vsum += (sc->results[i] == -1) ? -1 : sc->array[sc->results[i]];
+    }
+    else if (sc->queries != 0)
+    {
+        for (int i = 0; i < sc->nqueries; i++)
+            vsum += search_one(sc, sc->queries[i]);
+    }
+    else
+    {
+        int x0 = sc->array[0] - 1;
+        int x1 = sc->array[sc->size-1] + 2;
+        for (int i = x0; i < x1; i++)
+            vsum += search_one(sc, i);
+    }
+    return vsum;
+}
+
+static void search_run(void *ctx)
+{
+    SearchCase *sc = ctx;
+    sc->vsum = search_all(sc);
+}
+
+static int search_check(void *ctx)
+{
+    SearchCase *sc = ctx;
+    return sc->vsum != sc->expect;
+}
+
+static const struct
+{
+    const char *name;
+    BinSearch   function;
+} searches[] =
+{
+    { "BinSearch_A", BinSearch_A  },
+    { "BinSearch_B", BinSearch_B  },
+    { "BinSearch_C", BinSearch_C  },
+    { "BinSearch_D", BinSearch_D1 },
+    { "BinSearch_E", BinSearch_E  },
+};
+enum { NUM_SEARCHES = sizeof(searches) / sizeof(searches[0]) };
+
+static const struct
+{
+    const char *name;
+    BSIndexType type;
+    IndexSearch function;
+} isearches[] =
+{
+    { "Eytzinger_B", BSI_EYTZINGER, bsi_first },
+    { "Eytzinger_C", BSI_EYTZINGER, bsi_last  },
+    { "STree_B",     BSI_STREE,     bsi_first },
+    { "STree_C",     BSI_STREE,     bsi_last  },
+};
+enum { NUM_ISEARCHES = sizeof(isearches) / sizeof(isearches[0]) };
+
+static const struct
+{
+    const char *name;
+    BatchSearch function;
+} bsearches[] =
+{
+    { "Batch_B",       bsearch_batch        },
+    { "Batch_B_sort",  bsearch_batch_sorted },
+};
+enum { NUM_BSEARCHES = sizeof(bsearches) / sizeof(bsearches[0]) };
+
+static Pair range_binsearch(const SearchCase *sc, int value)
+{
+    return BinSearch_D(sc->size, sc->array, value);
+}
+
+static Pair range_learned(const SearchCase *sc, int value)
+{
+    long lo;
+    long hi;
+    bsl_range(sc->learn, value, &lo, &hi);
+    return (Pair){ .lo = (int)lo, .hi = (int)hi };
+}
+
+static const struct
+{
+    const char *name;
+    RangeSearch function;
+} rsearches[] =
+{
+    { "Range_BinD",    range_binsearch },
+    { "Range_Learned", range_learned   },
+};
+enum { NUM_RSEARCHES = sizeof(rsearches) / sizeof(rsearches[0]) };
+
+static Bench *bench;
+static bool verbose = false;
+static int learn_error = 0;     /* Learned index error window; 0 for default */
+
+typedef enum { DIST_RANDOM, DIST_LUMPY, DIST_CLUSTERED } Distribution;
+static const char * const dist_names[] = { "random", "lumpy", "clustered" };
+static Distribution dist = DIST_RANDOM;
+
+/*
+** Add and run a case for each search over array (and the queries, if
+** any); return the number of cases that failed.  The batch searches
+** need the queries in an array, so without any they get every value
+** in range, as the other searches do.
+*/
+static int run_searches(int size, const int *array, const int *queries, int nqueries,
+                         const char *param)
+{
+    SearchCase cases[NUM_SEARCHES + NUM_ISEARCHES + NUM_BSEARCHES + NUM_RSEARCHES];
+    BSIndex *index[2];
+    SearchCase ref = { .function = BinSearch_B, .size = size, .array = array,
+                       .queries = queries, .nqueries = nqueries };
+    long long expect = search_all(&ref);
+    double searched = (queries != 0) ? nqueries : array[size-1] + 2 - (array[0] - 1);
+    int *values = 0;
+    int ncases = 0;
+
+    if (queries == 0)
+    {
+        int x0 = array[0] - 1;
+        nqueries = array[size-1] + 2 - x0;
+        values = malloc(nqueries * sizeof(int));
+        if (values == 0)
+            err_error("out of memory for %d values\n", nqueries);
+        for (int i = 0; i < nqueries; i++)
+            values[i] = x0 + i;
+    }
+    long *results = malloc(nqueries * sizeof(long));
+    if (results == 0)
+        err_error("out of memory for %d results\n", nqueries);
+
+    for (int i = 0; i < 2; i++)
+    {
+        index[i] = bsi_create((i == 0) ? BSI_EYTZINGER : BSI_STREE, size, array);
+        if (index[i] == 0)
+            err_error("out of memory building an index of %d numbers\n", size);
+    }
+    for (int i = 0; i < NUM_SEARCHES; i++)
+    {
+        /* BinSearch_A and BinSearch_D are not worth the time on large arrays */
+        if (queries != 0 && (searches[i].function == BinSearch_A ||
+                             searches[i].function == BinSearch_D1))
+            continue;
+        cases[ncases] = (SearchCase){ .function = searches[i].function, .size = size,
+                                      .array = array, .queries = queries,
+                                      .nqueries = nqueries, .expect = expect };
+        BenchCase bc = { searches[i].name, param, 0, search_run, search_check,
+                         &cases[ncases], searched, "searches" };
+        bench_add(bench, &bc);
+        ncases++;
+    }
+    for (int i = 0; i < NUM_ISEARCHES; i++)
+    {
+        const BSIndex *ip = index[isearches[i].type == BSI_STREE];
+        cases[ncases] = (SearchCase){ .ifunction = isearches[i].function, .index = ip,
+                                      .size = size, .array = array, .queries = queries,
+                                      .nqueries = nqueries, .expect = expect };
+        BenchCase bc = { isearches[i].name, param, 0, search_run, search_check,
+                         &cases[ncases], searched, "searches" };
+        bench_add(bench, &bc);
+        ncases++;
+    }
+    for (int i = 0; i < NUM_BSEARCHES; i++)
+    {
+        cases[ncases] = (SearchCase){ .bfunction = bsearches[i].function,
+                                      .results = results, .size = size, .array = array,
+                                      .queries = (queries != 0) ? queries : values,
+                                      .nqueries = nqueries, .expect = expect };
+        BenchCase bc = { bsearches[i].name, param, 0, search_run, search_check,
+                         &cases[ncases], searched, "searches" };
+        bench_add(bench, &bc);
+        ncases++;
+    }
+
+    BSLearn *learn = bsl_create(size, array, learn_error);
+    if (learn == 0)
+        err_error("out of memory building a learned index of %d numbers\n", size);
+    SearchCase rref = { .rfunction = range_binsearch, .size = size, .array = array,
+                        .queries = queries, .nqueries = nqueries };
+    long long rexpect = search_all(&rref);
+    for (int i = 0; i < NUM_RSEARCHES; i++)
+    {
+        cases[ncases] = (SearchCase){ .rfunction = rsearches[i].function, .learn = learn,
+                                      .size = size, .array = array, .queries = queries,
+                                      .nqueries = nqueries, .expect = rexpect };
+        BenchCase bc = { rsearches[i].name, param, 0, search_run, search_check,
+                         &cases[ncases], searched, "searches" };
+        bench_add(bench, &bc);
+        ncases++;
+    }
+
+    int nfailed = bench_run(bench);
+    if (verbose)
+        fprintf(stderr, "Learned index: %zu points, %zu bytes%s\n", bsl_points(learn),
+               bsl_size(learn), bsl_fallback(learn) ? " (S-tree fallback)" : "");
+    bsl_destroy(learn);
+    for (int i = 0; i < 2; i++)
+        bsi_destroy(index[i]);
+    free(results);
+    free(values);
+    return nfailed;
+}
+
+static uint64_t rng_state = XORSHIFT64_SEED;
+
+/*
+** Runs of min_run..min_run+span-1 numbers a step of 0 or 1 apart, with
+** a random jump between runs, spanning about half the range of int.
+** Returns the range of the numbers (the largest plus one).
+*/
+static uint64_t fill_runs(int *array, int n, int min_run, int span)
+{
+    uint64_t jump = (uint64_t)INT_MAX / n * ((2 * min_run + span - 1) / 2);
+    uint64_t value = 0;
+    int run = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (run-- == 0)
+        {
+            run = min_run - 1 + (int)(xorshift64(&rng_state) % span);
+            value += xorshift64(&rng_state) % jump;
+        }
+        else
+            value += xorshift64(&rng_state) % 2;
+        array[i] = (int)value;
+    }
+    return value + 1;
+}
+
+/*
+** Runs of 1..16 numbers: lumpy, but the spline still fits it with
+** about one point per 200 keys, and beats a binary search.
+*/
+static uint64_t fill_lumpy(int *array, int n)
+{
+    return fill_runs(array, n, 1, 16);
+}
+
+/*
+** Runs of 65..128 numbers: each run is a step in the key distribution
+** of more than twice the default error window, so the spline needs two
+** points per run, more than one per BSL_MIN_KEYS keys, and the learned
+** index falls back to the S-tree.
+*/
+static uint64_t fill_clustered(int *array, int n)
+{
+    return fill_runs(array, n, 2 * BSL_DEFAULT_ERROR + 1, 64);
+}
+
+/*
+** A sorted array of n random numbers in 0..2n-1 (so, as with numbers[],
+** roughly half the values in range are present, some more than once),
+** or, with -d lumpy or -d clustered, from fill_lumpy() or
+** fill_clustered(), searched for NUM_QUERIES random values in the same
+** range.
+*/
+enum { NUM_QUERIES = 1 << 20 };
+
+static int run_large(int n)
+{
+    int *array = malloc(n * sizeof(int));
+    int *queries = malloc(NUM_QUERIES * sizeof(int));
+    if (array == 0 || queries == 0)
+        err_error("out of memory for %d numbers\n", n);
+    uint64_t range = 2 * (uint64_t)n;
+    if (dist == DIST_LUMPY)
+        range = fill_lumpy(array, n);
+    else if (dist == DIST_CLUSTERED)
+        range = fill_clustered(array, n);
+    else
+    {
+        for (int i = 0; i < n; i++)
+            array[i] = (int)(xorshift64(&rng_state) % range);
+        if (!radix_sort_i32(array, n))
+            err_error("out of memory sorting %d numbers\n", n);
+    }
+    for (int i = 0; i < NUM_QUERIES; i++)
+        queries[i] = (int)(xorshift64(&rng_state) % range);
+
+    char param[32];
+    snprintf(param, sizeof(param), "n=%d %s", n, dist_names[dist]);
+    int nfailed = run_searches(n, array, queries, NUM_QUERIES, param);
+    free(queries);
+    free(array);
+    return nfailed;
+}
+
+/* Check the index searches for target against a linear scan */
+static int test_target(const BSIndex *index, const int *array, int n, int t)
+{
+    size_t lb = 0;
+    size_t ub = 0;
+    while (lb < (size_t)n && array[lb] < t)
+        lb++;
+    while (ub < (size_t)n && array[ub] <= t)
+        ub++;
+    long first = (lb < (size_t)n && array[lb] == t) ? (long)lb : -1;
+    long last = (ub > 0 && array[ub-1] == t) ? (long)ub - 1 : -1;
+    if (bsi_lower_bound(index, t) == lb && bsi_upper_bound(index, t) == ub &&
+        bsi_first(index, t) == first && bsi_last(index, t) == last)
+        return 0;
+    printf("n=%d target %d: lower %zu (%zu) upper %zu (%zu) first %ld (%ld) last %ld (%ld)\n",
+           n, t, bsi_lower_bound(index, t), lb, bsi_upper_bound(index, t), ub,
+           bsi_first(index, t), first, bsi_last(index, t), last);
+    return 1;
+}
+
+/*
+** Compare every index search with a linear scan, for each value in the
+** array and the values either side of it, and the extremes.
+*/
+static int test_index(const int *array, int n, BSIndexType type)
+{
+    BSIndex *index = bsi_create(type, n, array);
+    int errors = 0;
+
+    if (index == 0)
+        err_error("out of memory building an index of %d numbers\n", n);
+    errors += test_target(index, array, n, INT_MIN);
+    errors += test_target(index, array, n, 0);
+    errors += test_target(index, array, n, INT_MAX);
+    for (int i = 0; i < n && errors < 10; i++)
+    {
+        if (i > 0 && array[i] == array[i-1])
+            continue;
+        if (array[i] > INT_MIN)
+            errors += test_target(index, array, n, array[i] - 1);
+        errors += test_target(index, array, n, array[i]);
+        if (array[i] < INT_MAX)
+            errors += test_target(index, array, n, array[i] + 1);
+    }
+    bsi_destroy(index);
+    return errors;
+}
+
+/*
+** Compare the batch searches with a linear scan, for the same values as
+** test_index(), in reverse order so that sorting the batch matters.
+*/
+static int test_batch(const int *array, int n)
+{
+    int m = 3 * n + 3;
+    int *keys = malloc(m * sizeof(int));
+    long *results = malloc(m * sizeof(long));
+    int errors = 0;
+
+    if (keys == 0 || results == 0)
+        err_error("out of memory for %d keys\n", m);
+    int nkeys = 0;
+    keys[nkeys++] = INT_MAX;
+    keys[nkeys++] = INT_MIN;
+    keys[nkeys++] = 0;
+    for (int i = n - 1; i >= 0; i--)
+    {
+        if (array[i] < INT_MAX)
+            keys[nkeys++] = array[i] + 1;
+        keys[nkeys++] = array[i];
+        if (array[i] > INT_MIN)
+            keys[nkeys++] = array[i] - 1;
+    }
+    for (int i = 0; i < NUM_BSEARCHES; i++)
+    {
+        (*bsearches[i].function)(array, n, keys, nkeys, results);
+        for (int j = 0; j < nkeys && errors < 10; j++)
+        {
+            long first = -1;
+            for (int k = 0; k < n && array[k] <= keys[j]; k++)
+            {
+                if (array[k] == keys[j])
+                {
+                    first = k;
+                    break;
+                }
+            }
+            if (results[j] != first)
+            {
+                printf("%s: n=%d target %d: first %ld (%ld)\n", bsearches[i].name,
+                       n, keys[j], results[j], first);
+                errors++;
+            }
+        }
+    }
+    free(keys);
+    free(results);
+    return errors;
+}
+
+/* Reference lower bound: first i with array[i] >= t, or n */
+static size_t ref_lower_bound(const int *array, size_t n, int t)
+{
+    size_t lo = 0;
+    size_t hi = n;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (array[mid] < t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Check the learned index for target against ref_lower_bound() */
+static int test_learned_target(const BSLearn *learn, const int *array, int n, int t)
+{
+    size_t lb = ref_lower_bound(array, n, t);
+    size_t ub = (t == INT_MAX) ? (size_t)n : ref_lower_bound(array, n, t + 1);
+    long lo = (lb < ub) ? (long)lb : -1;
+    long hi = (lb < ub) ? (long)ub - 1 : -1;
+    long r_lo;
+    long r_hi;
+    bsl_range(learn, t, &r_lo, &r_hi);
+    if (bsl_lower_bound(learn, t) == lb && bsl_upper_bound(learn, t) == ub &&
+        r_lo == lo && r_hi == hi)
+        return 0;
+    printf("learned n=%d target %d: lower %zu (%zu) upper %zu (%zu) range %ld..%ld (%ld..%ld)\n",
+           n, t, bsl_lower_bound(learn, t), lb, bsl_upper_bound(learn, t), ub,
+           r_lo, r_hi, lo, hi);
+    return 1;
+}
+
+static int test_learned_targets(const BSLearn *learn, const int *array, int n)
+{
+    int errors = 0;
+    errors += test_learned_target(learn, array, n, INT_MIN);
+    errors += test_learned_target(learn, array, n, 0);
+    errors += test_learned_target(learn, array, n, INT_MAX);
+    for (int i = 0; i < n && errors < 10; i++)
+    {
+        if (i > 0 && array[i] == array[i-1])
+            continue;
+        if (array[i] > INT_MIN)
+            errors += test_learned_target(learn, array, n, array[i] - 1);
+        errors += test_learned_target(learn, array, n, array[i]);
+        if (array[i] < INT_MAX)
+            errors += test_learned_target(learn, array, n, array[i] + 1);
+    }
+    return errors;
+}
+
+/*
+** Check the learned index, and a copy saved to a file and loaded back;
+** expect is 1 if it should fit a spline, 0 if it should fall back to
+** the S-tree, and -1 if either will do.
+*/
+static int test_learned(const int *array, int n, int error, int expect)
+{
+    BSLearn *learn = bsl_create(n, array, error);
+    if (learn == 0)
+        err_error("out of memory building a learned index of %d numbers\n", n);
+    int errors = test_learned_targets(learn, array, n);
+    if (expect != -1 && bsl_fallback(learn) == expect)
     {
-        int index = (*function)(size, array, i);
-        vsum += (index == -1) ? index : array[index];
+        printf("learned n=%d error %d: %zu points, fallback %s\n", n, error,
+               bsl_points(learn), bsl_fallback(learn) ? "used" : "not used");
+        errors++;
     }
-    clk_stop(&clk);
-    char buffer[32];
-    printf("%s: (%d)  %lld   %s\n", a_name, size, vsum,
-           clk_elapsed_us(&clk, buffer, sizeof(buffer)));
+
+    FILE *fp = tmpfile();
+    if (fp == 0)
+        err_syserr("failed to create temporary file\n");
+    if (bsl_save(learn, fp) != 0)
+        err_syserr("failed to save learned index\n");
+    rewind(fp);
+    BSLearn *copy = bsl_load(fp, n, array);
+    if (copy == 0 || bsl_points(copy) != bsl_points(learn) ||
+        bsl_fallback(copy) != bsl_fallback(learn))
+    {
+        printf("learned n=%d: saved index did not load back\n", n);
+        errors++;
+    }
+    else
+        errors += test_learned_targets(copy, array, n);
+    bsl_destroy(copy);
+
+    /* A saved index does not load for a different array */
+    if (n > 1)
+    {
+        rewind(fp);
+        copy = bsl_load(fp, n - 1, array);
+        if (copy != 0)
+        {
+            printf("learned n=%d: saved index loaded for the wrong array\n", n);
+            errors++;
+        }
+        bsl_destroy(copy);
+    }
+    fclose(fp);
+    bsl_destroy(learn);
+    return errors;
 }
 
-int main(void)
+static int test_indexes(void)
 {
+    enum { MAX_TEST = 600 };
+    int array[MAX_TEST];
+    int errors = 0;
+
+    for (int n = 0; n < MAX_TEST; n += (n < 300) ? 1 : 37)
+    {
+        for (int spread = 1; spread <= 4; spread++)
+        {
+            for (int i = 0; i < n; i++)
+                array[i] = (int)(xorshift64(&rng_state) % (n / spread + 1));
+            if (n > 2 && spread == 4)
+            {
+                array[0] = INT_MIN;
+                array[n-1] = INT_MAX;
+            }
+            if (!radix_sort_i32(array, n))
+                err_error("out of memory sorting %d numbers\n", n);
+            errors += test_index(array, n, BSI_EYTZINGER);
+            errors += test_index(array, n, BSI_STREE);
+            errors += test_batch(array, n);
+            errors += test_learned(array, n, (spread == 1) ? 1 : 0, -1);
+        }
+    }
+    errors += test_index(numbers, NUM_NUMBERS, BSI_EYTZINGER);
+    errors += test_index(numbers, NUM_NUMBERS, BSI_STREE);
+    for (int n = 1; n < 20000; n = n * 3 / 2 + 1)
+    {
+        int *data = malloc(n * sizeof(int));
+        if (data == 0)
+            err_error("out of memory for %d numbers\n", n);
+        for (int i = 0; i < n; i++)
+            data[i] = 2 * i;
+        errors += test_index(data, n, BSI_EYTZINGER);
+        errors += test_index(data, n, BSI_STREE);
+        if (n < 2000)
+            errors += test_batch(data, n);
+        errors += test_learned(data, n, 0, n >= 2 * BSL_MIN_KEYS);
+        free(data);
+    }
+    errors += test_learned(numbers, NUM_NUMBERS, 0, 1);
+    for (int e = 1; e <= 64; e *= 4)
+    {
+        enum { BIG_TEST = 200000 };
+        int *data = malloc(BIG_TEST * sizeof(int));
+        if (data == 0)
+            err_error("out of memory for %d numbers\n", BIG_TEST);
+        for (int i = 0; i < BIG_TEST; i++)
+            data[i] = (int)(xorshift64(&rng_state) % (2 * BIG_TEST));
+        if (!radix_sort_i32(data, BIG_TEST))
+            err_error("out of memory sorting %d numbers\n", BIG_TEST);
+        errors += test_learned(data, BIG_TEST, e, (e >= 64) ? 1 : -1);
+        fill_lumpy(data, BIG_TEST);
+        errors += test_learned(data, BIG_TEST, e, (e <= 4) ? 0 : -1);
+        fill_clustered(data, BIG_TEST);
+        errors += test_learned(data, BIG_TEST, e, (e <= 16) ? 0 : -1);
+        free(data);
+    }
+    printf("%s (S-tree node search: %s)\n", (errors == 0) ? "== PASS ==" : "** FAIL **",
+           bsi_isa());
+    return errors;
+}
+
+static int scan_size(const char *arg)
+{
+    char *end;
+    errno = 0;
+    size_t size = strtosize_scaled(arg, &end, 0, false);
+    if (end == arg || *end != '\0' || errno != 0 || size == 0 || size > INT_MAX / 2)
+        err_error("invalid size '%s' (1..%d)\n", arg, INT_MAX / 2);
+    return (int)size;
+}
+
+static const char usestr[] =
+    "[-hCtv][-d random|lumpy|clustered][-e error][-f text|csv|json][-n size][-r runs]";
+static const char optstr[] = "Cd:e:f:hn:r:tv";
+static const char hlpstr[] =
+    "  -C          Do not read hardware counters\n"
+    "  -d dist     Distribution of the numbers for -n: random (default),\n"
+    "              lumpy (small clusters, which the learned index fits), or\n"
+    "              clustered (large clusters, which make it use the S-tree)\n"
+    "  -e error    Error window of the learned index (default 32)\n"
+    "  -f format   Output format: text, csv or json (default text)\n"
+    "  -h          Print this help and exit\n"
+    "  -n size     Search a random array of this size, e.g. 1K or 100M\n"
+    "              (repeatable; default: the built-in numbers)\n"
+    "  -r runs     Minimum timed runs per search (default 10)\n"
+    "  -t          Test the index, batch and learned searches and exit\n"
+    "  -v          Report the size of the learned index on standard error\n"
+    ;
+
+int main(int argc, char **argv)
+{
+    enum { MAX_SIZES = 16 };
+    int sizes[MAX_SIZES];
+    int nsizes = 0;
+    int runs = 10;
+    int opt;
+
+    err_setarg0(argv[0]);
+    bench = bench_create("binsearch-speed");
+    while ((opt = getopt(argc, argv, optstr)) != -1)
+    {
+        switch (opt)
+        {
+        case 'C':
+            bench_set_counters(bench, 0);
+            break;
+        case 'd':
+        {
+            size_t i;
+            for (i = 0; i < sizeof(dist_names) / sizeof(dist_names[0]); i++)
+            {
+                if (strcmp(optarg, dist_names[i]) == 0)
+                    break;
+            }
+            if (i >= sizeof(dist_names) / sizeof(dist_names[0]))
+                err_error("unknown distribution '%s' (use random, lumpy or clustered)\n", optarg);
+            dist = (Distribution)i;
+            break;
+        }
+        case 'e':
+            learn_error = atoi(optarg);
+            if (learn_error < 1)
+                err_error("error window '%s' should be at least 1\n", optarg);
+            break;
+        case 'f':
+            if (bench_set_format_name(bench, optarg) != 0)
+                err_error("unknown format '%s' (use text, csv or json)\n", optarg);
+            break;
+        case 'n':
+            if (nsizes >= MAX_SIZES)
+                err_error("too many sizes (maximum %d)\n", MAX_SIZES);
+            sizes[nsizes++] = scan_size(optarg);
+            break;
+        case 'r':
+            runs = atoi(optarg);
+            if (runs < 1)
+                err_error("number of runs '%s' should be at least 1\n", optarg);
+            break;
+        case 't':
+            return (test_indexes() == 0) ? 0 : 1;
+        case 'v':
+            verbose = true;
+            break;
+        case 'h':
+            err_help(usestr, hlpstr);
+            /*NOTREACHED*/
+        default:
+            err_usage(usestr);
+            /*NOTREACHED*/
+        }
+    }
+    if (optind != argc)
+        err_usage(usestr);
+
     check_sorted("numbers", NUM_NUMBERS, numbers);
+    bench_set_runs(bench, runs, 1000);
 
-    for (int i = 0; i < 10; i++)
+    int rc = 0;
+    if (nsizes == 0)
     {
-        time_search("BinSearch_A", NUM_NUMBERS, numbers, BinSearch_A);
-        time_search("BinSearch_B", NUM_NUMBERS, numbers, BinSearch_B);
-        time_search("BinSearch_C", NUM_NUMBERS, numbers, BinSearch_C);
-        time_search("BinSearch_D", NUM_NUMBERS, numbers, BinSearch_D1);
-        time_search("BinSearch_E", NUM_NUMBERS, numbers, BinSearch_E);
+        char param[32];
+        snprintf(param, sizeof(param), "n=%d", NUM_NUMBERS);
+        rc += run_searches(NUM_NUMBERS, numbers, 0, 0, param);
     }
+    for (int i = 0; i < nsizes; i++)
+        rc += run_large(sizes[i]);
 
-    return 0;
+    bench_destroy(bench);
+    return (rc == 0) ? 0 : 1;
 }
@@ -0,0 +1,51 @@
+/*
+@(#)File:           bsbatch.h
+@(#)Purpose:        Batched, interleaved binary search of a sorted int array
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#ifndef JLSS_ID_BSBATCH_H
+#define JLSS_ID_BSBATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>     /* size_t */
+
+/*
+** One binary search of an array much bigger than the cache waits for
+** memory at nearly every probe, and the next probe depends on the one
+** before, so the processor has nothing else to do.  Searches for
+** different keys are independent, though.  bsearch_batch() advances a
+** group of searches together, one probe each per step, and prefetches
+** the next probe of each as soon as it is known, so the memory latency
+** of the group's probes overlaps.  All the searches in the array of n
+** take the same number of steps, so the lock-step loop has no
+** data-dependent branches.
+**
+** bsearch_batch_sorted() first sorts the keys (remembering where they
+** came from), so that successive groups search nearby parts of the
+** array and share the cache lines of the upper levels of the search.
+** That pays when the batch is large compared with the array, or the
+** keys are clustered.  If it cannot allocate the space to sort the
+** keys, it searches them in the order given.
+**
+** For each keys[i], results[i] is set to the index of the first
+** element of the array equal to keys[i], as BinSearch_B in
+** modbinsearch.c, or -1 if there is none.
+*/
+
+extern void bsearch_batch(const int *array, size_t n, const int *keys, size_t m,
+                          long *results);
+extern void bsearch_batch_sorted(const int *array, size_t n, const int *keys, size_t m,
+                                 long *results);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JLSS_ID_BSBATCH_H */
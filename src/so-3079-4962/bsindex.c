@@ -0,0 +1,428 @@
+/*
+@(#)File:           bsindex.c
+@(#)Purpose:        Cache-friendly search indexes (Eytzinger, S-tree) for sorted int arrays
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#include "posixver.h"
+#include "bsindex.h"
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BSINDEX_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__)
+#define PREFETCH(addr)  __builtin_prefetch(addr)
+#else
+#define PREFETCH(addr)  ((void)0)
+#endif
+
+enum { CACHE_LINE = 64 };
+enum { STREE_B = 16 };          /* Keys per node: one cache line of ints */
+enum { STREE_MAX_HEIGHT = 16 }; /* 17^16 keys is plenty */
+
+enum { ISA_SCALAR, ISA_SSE2, ISA_AVX2 };
+
+struct BSIndex
+{
+    BSIndexType type;
+    int         isa;            /* S-tree node search */
+    size_t      n;
+    const int  *data;           /* The sorted array */
+    int        *keys;           /* Eytzinger: keys[1..n]; S-tree: all layers */
+    size_t      nkeys;
+    int         height;         /* Levels (Eytzinger) or layers (S-tree) */
+    size_t      last_level;     /* Eytzinger: index of first node of last level */
+    size_t      offset[STREE_MAX_HEIGHT];   /* S-tree: start of each layer */
+};
+
+/* Position of the most significant set bit of k > 0 */
+static inline int msb(size_t k)
+{
+#if defined(__GNUC__)
+    return (int)(sizeof(unsigned long long) * CHAR_BIT - 1) - __builtin_clzll(k);
+#else
+    int b = 0;
+    while (k >>= 1)
+        b++;
+    return b;
+#endif
+}
+
+/* Number of trailing one bits in k */
+static inline int trailing_ones(size_t k)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(~(unsigned long long)k);
+#else
+    int b = 0;
+    while (k & 1)
+        k >>= 1, b++;
+    return b;
+#endif
+}
+
+static int *alloc_keys(size_t nkeys)
+{
+    void *space;
+    if (posix_memalign(&space, CACHE_LINE, nkeys * sizeof(int)) != 0)
+        return 0;
+    return space;
+}
+
+/* -- Eytzinger layout */
+
+/* Fill the subtree rooted at k in order from data[i...]; return the next i */
+static size_t eytz_build(int *keys, const int *data, size_t n, size_t i, size_t k)
+{
+    if (k <= n)
+    {
+        i = eytz_build(keys, data, n, i, 2 * k);
+        keys[k] = data[i++];
+        i = eytz_build(keys, data, n, i, 2 * k + 1);
+    }
+    return i;
+}
+
+/*
+** Position in the sorted array of the key at node k.  In a perfect tree
+** of the same height, the node at depth d that is j-th on its level has
+** in-order rank (2j + 1) * 2^(height-1-d) - 1; the nodes missing from
+** the end of the last level must then be discounted, and the leaf at
+** index m of the last level would have had rank 2 * (m - last_level).
+*/
+static inline size_t eytz_rank(const BSIndex *index, size_t k)
+{
+    int d = msb(k);
+    size_t r = ((2 * (k - ((size_t)1 << d)) + 1) << (index->height - 1 - d)) - 1;
+    size_t before = index->last_level + (r + 1) / 2 - 1;
+    if (before > index->n)
+        r -= before - index->n;
+    return r;
+}
+
+/*
+** The descent goes left while the key is not less than the target
+** (lower bound) or not greater than it (upper bound), and ends below a
+** leaf.  The bits of k then record the turns taken: the answer is the
+** node where the search last went left, found by removing the trailing
+** right turns (one bits) and that left turn.
+*/
+#define EYTZ_SEARCH(name, cmp) \
+static inline size_t name(const BSIndex *index, int target) \
+{ \
+    const int *keys = index->keys; \
+    size_t n = index->n; \
+    size_t k = 1; \
+    while (k <= n) \
+    { \
+        PREFETCH(keys + STREE_B * k); \
+        k = 2 * k + (keys[k] cmp target); \
+    } \
+    k >>= trailing_ones(k) + 1; \
+    return (k == 0) ? n : eytz_rank(index, k); \
+}
+
+EYTZ_SEARCH(eytz_lower_bound, <)
+EYTZ_SEARCH(eytz_upper_bound, <=)
+
+static bool eytz_create(BSIndex *index)
+{
+    size_t n = index->n;
+    index->nkeys = n + 1;
+    if ((index->keys = alloc_keys(index->nkeys)) == 0)
+        return false;
+    index->keys[0] = INT_MIN;   /* Not used */
+    eytz_build(index->keys, index->data, n, 0, 1);
+    index->height = (n == 0) ? 0 : msb(n) + 1;
+    index->last_level = (n == 0) ? 0 : (size_t)1 << (index->height - 1);
+    return true;
+}
+
+/* -- S-tree (static B+ tree) layout */
+
+static inline size_t stree_blocks(size_t n)
+{
+    size_t b = (n + STREE_B - 1) / STREE_B;
+    return (b == 0) ? 1 : b;
+}
+
+/* Keys in the layer above one of n keys */
+static inline size_t stree_prev_keys(size_t n)
+{
+    return (stree_blocks(n) + STREE_B) / (STREE_B + 1) * STREE_B;
+}
+
+static bool stree_create(BSIndex *index)
+{
+    size_t n = index->n;
+    size_t size = n;
+    int h = 0;
+
+    index->offset[0] = 0;
+    for (;;)
+    {
+        if (h + 1 >= STREE_MAX_HEIGHT)
+            return false;
+        index->offset[h + 1] = index->offset[h] + stree_blocks(size) * STREE_B;
+        h++;
+        if (size <= STREE_B)
+            break;
+        size = stree_prev_keys(size);
+    }
+    index->height = h;
+    index->nkeys = index->offset[h];
+    if ((index->keys = alloc_keys(index->nkeys)) == 0)
+        return false;
+
+    int *keys = index->keys;
+    memcpy(keys, index->data, n * sizeof(int));
+    for (size_t i = n; i < index->offset[1]; i++)
+        keys[i] = INT_MAX;
+    /* Key j of node k on layer h is the first key of leaf (17k + j + 1) * 17^(h-1) */
+    size_t scale = 1;
+    for (h = 1; h < index->height; h++)
+    {
+        for (size_t i = 0; i < index->offset[h + 1] - index->offset[h]; i++)
+        {
+            size_t k = i / STREE_B;
+            size_t j = i % STREE_B;
+            size_t leaf = (k * (STREE_B + 1) + j + 1) * scale;
+            keys[index->offset[h] + i] = (leaf < (n + STREE_B - 1) / STREE_B) ?
+                                         keys[leaf * STREE_B] : INT_MAX;
+        }
+        scale *= STREE_B + 1;
+    }
+    return true;
+}
+
+/* Count the keys of a node that are less than (lt) or at most (le) target */
+static inline unsigned scalar_rank_lt(const int *node, int target)
+{
+    unsigned count = 0;
+    for (int j = 0; j < STREE_B; j++)
+        count += (node[j] < target);
+    return count;
+}
+
+static inline unsigned scalar_rank_le(const int *node, int target)
+{
+    unsigned count = 0;
+    for (int j = 0; j < STREE_B; j++)
+        count += (node[j] <= target);
+    return count;
+}
+
+/*
+** After descending through the internal layers, k is the offset of a
+** leaf, and k plus the rank within the leaf is the position; a position
+** in the padding means every key is smaller, so the answer is n.
+*/
+#define STREE_SEARCH(name, rank, attr) \
+static inline attr size_t name(const BSIndex *index, int target) \
+{ \
+    const int *keys = index->keys; \
+    size_t k = 0; \
+    for (int h = index->height - 1; h > 0; h--) \
+    { \
+        unsigned i = rank(keys + index->offset[h] + k, target); \
+        k = k * (STREE_B + 1) + i * STREE_B; \
+    } \
+    size_t pos = k + rank(keys + k, target); \
+    return (pos < index->n) ? pos : index->n; \
+}
+
+STREE_SEARCH(scalar_lower_bound, scalar_rank_lt, )
+STREE_SEARCH(scalar_upper_bound, scalar_rank_le, )
+
+#ifdef BSINDEX_X86
+
+#define AVX2 __attribute__((target("avx2,popcnt")))
+
+/* SSE2 is part of x86-64, so it needs no target attribute there */
+static inline unsigned sse2_mask(__m128i m0, __m128i m1, __m128i m2, __m128i m3)
+{
+    __m128i m = _mm_packs_epi16(_mm_packs_epi32(m0, m1), _mm_packs_epi32(m2, m3));
+    return (unsigned)_mm_movemask_epi8(m);
+}
+
+static inline unsigned sse2_rank_lt(const int *node, int target)
+{
+    const __m128i *v = (const __m128i *)node;
+    __m128i t = _mm_set1_epi32(target);
+    return __builtin_popcount(sse2_mask(_mm_cmpgt_epi32(t, _mm_load_si128(v + 0)),
+                                        _mm_cmpgt_epi32(t, _mm_load_si128(v + 1)),
+                                        _mm_cmpgt_epi32(t, _mm_load_si128(v + 2)),
+                                        _mm_cmpgt_epi32(t, _mm_load_si128(v + 3))));
+}
+
+static inline unsigned sse2_rank_le(const int *node, int target)
+{
+    const __m128i *v = (const __m128i *)node;
+    __m128i t = _mm_set1_epi32(target);
+    return STREE_B - __builtin_popcount(sse2_mask(_mm_cmpgt_epi32(_mm_load_si128(v + 0), t),
+                                                  _mm_cmpgt_epi32(_mm_load_si128(v + 1), t),
+                                                  _mm_cmpgt_epi32(_mm_load_si128(v + 2), t),
+                                                  _mm_cmpgt_epi32(_mm_load_si128(v + 3), t)));
+}
+
+static inline AVX2 unsigned avx2_mask(__m256i m0, __m256i m1)
+{
+    unsigned lo = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(m0));
+    unsigned hi = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(m1));
+    return lo | (hi << 8);
+}
+
+static inline AVX2 unsigned avx2_rank_lt(const int *node, int target)
+{
+    const __m256i *v = (const __m256i *)node;
+    __m256i t = _mm256_set1_epi32(target);
+    return __builtin_popcount(avx2_mask(_mm256_cmpgt_epi32(t, _mm256_load_si256(v + 0)),
+                                        _mm256_cmpgt_epi32(t, _mm256_load_si256(v + 1))));
+}
+
+static inline AVX2 unsigned avx2_rank_le(const int *node, int target)
+{
+    const __m256i *v = (const __m256i *)node;
+    __m256i t = _mm256_set1_epi32(target);
+    return STREE_B - __builtin_popcount(avx2_mask(_mm256_cmpgt_epi32(_mm256_load_si256(v + 0), t),
+                                                  _mm256_cmpgt_epi32(_mm256_load_si256(v + 1), t)));
+}
+
+STREE_SEARCH(sse2_lower_bound, sse2_rank_lt, )
+STREE_SEARCH(sse2_upper_bound, sse2_rank_le, )
+STREE_SEARCH(avx2_lower_bound, avx2_rank_lt, AVX2)
+STREE_SEARCH(avx2_upper_bound, avx2_rank_le, AVX2)
+
+static int choose_isa(void)
+{
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+        return ISA_AVX2;
+    return ISA_SSE2;
+}
+
+#else
+
+#define sse2_lower_bound(i, t)  scalar_lower_bound(i, t)
+#define sse2_upper_bound(i, t)  scalar_upper_bound(i, t)
+#define avx2_lower_bound(i, t)  scalar_lower_bound(i, t)
+#define avx2_upper_bound(i, t)  scalar_upper_bound(i, t)
+
+static int choose_isa(void)
+{
+    return ISA_SCALAR;
+}
+
+#endif /* BSINDEX_X86 */
+
+static inline size_t stree_lower_bound(const BSIndex *index, int target)
+{
+    switch (index->isa)
+    {
+    case ISA_AVX2:
+        return avx2_lower_bound(index, target);
+    case ISA_SSE2:
+        return sse2_lower_bound(index, target);
+    default:
+        return scalar_lower_bound(index, target);
+    }
+}
+
+/* Padding is INT_MAX, so no target is less than it */
+static inline size_t stree_upper_bound(const BSIndex *index, int target)
+{
+    if (target == INT_MAX)
+        return index->n;
+    switch (index->isa)
+    {
+    case ISA_AVX2:
+        return avx2_upper_bound(index, target);
+    case ISA_SSE2:
+        return sse2_upper_bound(index, target);
+    default:
+        return scalar_upper_bound(index, target);
+    }
+}
+
+/* -- Interface */
+
+BSIndex *bsi_create(BSIndexType type, size_t n, const int *data)
+{
+    BSIndex *index = malloc(sizeof(*index));
+    if (index == 0)
+        return 0;
+    memset(index, 0, sizeof(*index));
+    index->type = type;
+    index->isa = choose_isa();
+    index->n = n;
+    index->data = data;
+    bool ok = (type == BSI_EYTZINGER) ? eytz_create(index) : stree_create(index);
+    if (!ok)
+    {
+        free(index->keys);
+        free(index);
+        return 0;
+    }
+    return index;
+}
+
+void bsi_destroy(BSIndex *index)
+{
+    if (index != 0)
+    {
+        free(index->keys);
+        free(index);
+    }
+}
+
+size_t bsi_lower_bound(const BSIndex *index, int target)
+{
+    if (index->type == BSI_EYTZINGER)
+        return eytz_lower_bound(index, target);
+    return stree_lower_bound(index, target);
+}
+
+size_t bsi_upper_bound(const BSIndex *index, int target)
+{
+    if (index->type == BSI_EYTZINGER)
+        return eytz_upper_bound(index, target);
+    return stree_upper_bound(index, target);
+}
+
+long bsi_first(const BSIndex *index, int target)
+{
+    size_t i = bsi_lower_bound(index, target);
+    return (i < index->n && index->data[i] == target) ? (long)i : -1;
+}
+
+long bsi_last(const BSIndex *index, int target)
+{
+    size_t i = bsi_upper_bound(index, target);
+    return (i > 0 && index->data[i - 1] == target) ? (long)i - 1 : -1;
+}
+
+size_t bsi_size(const BSIndex *index)
+{
+    return sizeof(*index) + index->nkeys * sizeof(int);
+}
+
+const char *bsi_isa(void)
+{
+    switch (choose_isa())
+    {
+    case ISA_AVX2:
+        return "avx2";
+    case ISA_SSE2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
@@ -0,0 +1,82 @@
+/*
+@(#)File:           bsindex.h
+@(#)Purpose:        Cache-friendly search indexes (Eytzinger, S-tree) for sorted int arrays
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#ifndef JLSS_ID_BSINDEX_H
+#define JLSS_ID_BSINDEX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>     /* size_t */
+
+/*
+** A binary search of a large sorted array misses the cache at nearly
+** every probe once it gets below the first few levels, because each
+** probe is far from the last one.  An index built once from the array
+** stores the same keys in an order that suits the search:
+**
+** BSI_EYTZINGER stores the keys in breadth-first order of the implicit
+** binary search tree (the layout of a binary heap): the root at 1 and
+** the children of k at 2k and 2k+1.  The descent is branchless, and
+** the 16 descendants of k four levels down are adjacent, in one cache
+** line (including the grandchildren, which are fetched when the search
+** is two levels above them), so each step prefetches that line and the
+** memory latency of four levels is overlapped.
+**
+** BSI_STREE is a static B+ tree with 16 keys to a node (one cache line)
+** and 17 children.  The leaves are the sorted keys themselves; the keys
+** in an internal node are the smallest keys of its second to last
+** children.  Each node is searched by comparing all 16 keys with the
+** target at once (SSE2 or AVX2, chosen at run time; a portable loop on
+** other machines) and counting the keys that are smaller, so the search
+** touches one cache line per level and makes no unpredictable branches.
+**
+** Both indexes copy the keys and use about as much memory again as the
+** array (the S-tree 1/16 more), but the array itself must outlive the
+** index, which uses it to check for the target in bsi_first() and
+** bsi_last().  The results are positions in the sorted array, with the
+** same meanings as in modbinsearch.c:
+**
+** bsi_lower_bound(): the first i with data[i] >= target, or n if none.
+** bsi_upper_bound(): the first i with data[i] > target, or n if none.
+** bsi_first():       the first i with data[i] == target, as BinSearch_B
+**                    in modbinsearch.c, or -1 if target is absent.
+** bsi_last():        the last i with data[i] == target, as BinSearch_C
+**                    in modbinsearch.c, or -1 if target is absent.
+**
+** bsi_create() returns a null pointer if it cannot allocate the index.
+** bsi_isa() reports the node search the S-tree uses: "avx2", "sse2" or
+** "scalar".
+*/
+
+typedef enum BSIndexType
+{
+    BSI_EYTZINGER,
+    BSI_STREE
+} BSIndexType;
+
+typedef struct BSIndex BSIndex;
+
+extern BSIndex *bsi_create(BSIndexType type, size_t n, const int *data);
+extern void     bsi_destroy(BSIndex *index);
+
+extern size_t   bsi_lower_bound(const BSIndex *index, int target);
+extern size_t   bsi_upper_bound(const BSIndex *index, int target);
+extern long     bsi_first(const BSIndex *index, int target);
+extern long     bsi_last(const BSIndex *index, int target);
+
+extern size_t   bsi_size(const BSIndex *index);     /* Bytes used */
+extern const char *bsi_isa(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JLSS_ID_BSINDEX_H */
@@ -0,0 +1,459 @@
+/*
+@(#)File:           bslearn.c
+@(#)Purpose:        Learned (piecewise linear) index for sorted int arrays
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#include "posixver.h"
+#include "bslearn.h"
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bsindex.h"
+
+enum { MAX_RADIX_BITS = 20 };
+enum { MIN_POINTS = 64 };       /* Initial space for spline points */
+
+static const char magic[8] = "BSLEARN1";
+
+struct BSLearn
+{
+    size_t      n;
+    const int  *data;           /* The sorted array */
+    int         error;          /* Error window */
+    size_t      npoints;
+    size_t      maxpoints;
+    int        *keys;           /* Spline points: keys[i], pos[i] */
+    size_t     *pos;
+    double     *slope;          /* Of the segment from point i to point i+1 */
+    int         shift;          /* Radix table: keys[0] + (p << shift) */
+    uint32_t   *radix;          /* First point at or after prefix p */
+    size_t      nradix;
+    BSIndex    *stree;          /* Fallback */
+};
+
+/*
+** State of the greedy fit: the current segment starts at the base
+** point, and the cone of slopes from there that keep every point since
+** within the error window narrows with each point.  The point before
+** one that falls outside the cone ends the segment and starts the next.
+*/
+typedef struct Fit
+{
+    BSLearn    *index;
+    size_t      limit;          /* Most points before giving up */
+    bool        started;
+    bool        cone;
+    int         base_x;
+    size_t      base_y;
+    int         last_x;
+    size_t      last_y;
+    double      upper;
+    double      lower;
+} Fit;
+
+/* Position of the most significant set bit of k > 0 */
+static inline int msb(uint64_t k)
+{
+    int b = 0;
+    while (k >>= 1)
+        b++;
+    return b;
+}
+
+static inline double slope(int x0, double y0, int x1, double y1)
+{
+    return (y1 - y0) / ((double)x1 - (double)x0);
+}
+
+static bool add_point(BSLearn *index, int x, size_t y)
+{
+    if (index->npoints >= index->maxpoints)
+    {
+        size_t maxpoints = 2 * index->maxpoints;
+        int *keys = realloc(index->keys, maxpoints * sizeof(*keys));
+        if (keys == 0)
+            return false;
+        index->keys = keys;
+        size_t *pos = realloc(index->pos, maxpoints * sizeof(*pos));
+        if (pos == 0)
+            return false;
+        index->pos = pos;
+        index->maxpoints = maxpoints;
+    }
+    index->keys[index->npoints] = x;
+    index->pos[index->npoints] = y;
+    index->npoints++;
+    return true;
+}
+
+static void set_cone(Fit *fit, int x, size_t y)
+{
+    double e = fit->index->error;
+    fit->upper = slope(fit->base_x, fit->base_y, x, y + e);
+    fit->lower = slope(fit->base_x, fit->base_y, x, y - e);
+    fit->cone = true;
+}
+
+/* Feed the next point; false if the fit has run out of points (or space) */
+static bool fit_point(Fit *fit, int x, size_t y)
+{
+    if (!fit->started)
+    {
+        fit->started = true;
+        fit->base_x = x;
+        fit->base_y = y;
+        if (!add_point(fit->index, x, y))
+            return false;
+    }
+    else if (!fit->cone)
+        set_cone(fit, x, y);
+    else
+    {
+        double s = slope(fit->base_x, fit->base_y, x, y);
+        if (s > fit->upper || s < fit->lower)
+        {
+            if (fit->index->npoints >= fit->limit ||
+                !add_point(fit->index, fit->last_x, fit->last_y))
+                return false;
+            fit->base_x = fit->last_x;
+            fit->base_y = fit->last_y;
+            set_cone(fit, x, y);
+        }
+        else
+        {
+            double e = fit->index->error;
+            double u = slope(fit->base_x, fit->base_y, x, y + e);
+            double l = slope(fit->base_x, fit->base_y, x, y - e);
+            if (u < fit->upper)
+                fit->upper = u;
+            if (l > fit->lower)
+                fit->lower = l;
+        }
+    }
+    fit->last_x = x;
+    fit->last_y = y;
+    return true;
+}
+
+/*
+** The lower bound of every target in (a, b], where a and b are
+** successive distinct keys, is the position of the first b; fitting
+** both ends of that interval bounds the error for every target in it,
+** since the spline is monotonic.
+*/
+static bool fit_spline(BSLearn *index)
+{
+    Fit fit = { .index = index, .limit = index->n / BSL_MIN_KEYS };
+    const int *data = index->data;
+
+    for (size_t i = 0; i < index->n; i++)
+    {
+        if (i > 0 && data[i] == data[i-1])
+            continue;
+        if (i > 0 && data[i-1] + 1 < data[i] && !fit_point(&fit, data[i-1] + 1, i))
+            return false;
+        if (!fit_point(&fit, data[i], i))
+            return false;
+    }
+    if (fit.last_x != fit.base_x && !add_point(index, fit.last_x, fit.last_y))
+        return false;
+    return index->npoints <= fit.limit;
+}
+
+static inline uint32_t offset(const BSLearn *index, int key)
+{
+    return (uint32_t)key - (uint32_t)index->keys[0];
+}
+
+/* Slopes and the radix table, from the spline points */
+static bool finish_spline(BSLearn *index)
+{
+    size_t np = index->npoints;
+    index->slope = malloc(np * sizeof(*index->slope));
+    if (index->slope == 0)
+        return false;
+    for (size_t i = 0; i + 1 < np; i++)
+        index->slope[i] = slope(index->keys[i], index->pos[i],
+                                index->keys[i+1], index->pos[i+1]);
+    index->slope[np-1] = 0.0;
+
+    int bits = msb(np) + 2;
+    if (bits > MAX_RADIX_BITS)
+        bits = MAX_RADIX_BITS;
+    uint32_t span = offset(index, index->keys[np-1]);
+    int span_bits = (span == 0) ? 0 : msb(span) + 1;
+    index->shift = (span_bits > bits) ? span_bits - bits : 0;
+    index->nradix = (span >> index->shift) + 2;
+    index->radix = malloc(index->nradix * sizeof(*index->radix));
+    if (index->radix == 0)
+        return false;
+    size_t i = 0;
+    for (size_t p = 0; p < index->nradix; p++)
+    {
+        while (i < np && (offset(index, index->keys[i]) >> index->shift) < p)
+            i++;
+        index->radix[p] = (uint32_t)i;
+    }
+    return true;
+}
+
+static void free_spline(BSLearn *index)
+{
+    free(index->keys);
+    free(index->pos);
+    free(index->slope);
+    free(index->radix);
+    index->keys = 0;
+    index->pos = 0;
+    index->slope = 0;
+    index->radix = 0;
+    index->npoints = 0;
+    index->maxpoints = 0;
+}
+
+static BSLearn *new_index(size_t n, const int *data, int error)
+{
+    BSLearn *index = calloc(1, sizeof(*index));
+    if (index == 0)
+        return 0;
+    index->n = n;
+    index->data = data;
+    index->error = (error > 0) ? error : BSL_DEFAULT_ERROR;
+    return index;
+}
+
+static BSLearn *make_fallback(BSLearn *index)
+{
+    free_spline(index);
+    index->stree = bsi_create(BSI_STREE, index->n, index->data);
+    if (index->stree == 0)
+    {
+        free(index);
+        return 0;
+    }
+    return index;
+}
+
+BSLearn *bsl_create(size_t n, const int *data, int error)
+{
+    BSLearn *index = new_index(n, data, error);
+    if (index == 0)
+        return 0;
+    index->maxpoints = MIN_POINTS;
+    index->keys = malloc(index->maxpoints * sizeof(*index->keys));
+    index->pos = malloc(index->maxpoints * sizeof(*index->pos));
+    if (index->keys == 0 || index->pos == 0 || !fit_spline(index) ||
+        index->npoints < 2 || !finish_spline(index))
+        return make_fallback(index);
+    return index;
+}
+
+void bsl_destroy(BSLearn *index)
+{
+    if (index != 0)
+    {
+        free_spline(index);
+        bsi_destroy(index->stree);
+        free(index);
+    }
+}
+
+/* First i in [lo, hi) with data[i] >= target, or hi; lo < hi */
+static inline size_t window_lower_bound(const int *data, size_t lo, size_t hi, int target)
+{
+    size_t base = lo;
+    size_t len = hi - lo;
+    while (len > 1)
+    {
+        size_t half = len / 2;
+        base = (data[base + half] < target) ? base + half : base;
+        len -= half;
+    }
+    return base + (data[base] < target);
+}
+
+size_t bsl_lower_bound(const BSLearn *index, int target)
+{
+    if (index->stree != 0)
+        return bsi_lower_bound(index->stree, target);
+
+    const int *data = index->data;
+    size_t n = index->n;
+    if (target <= data[0])
+        return 0;
+    if (target > data[n-1])
+        return n;
+
+    /* The spline point at or before target */
+    const int *keys = index->keys;
+    size_t p = offset(index, target) >> index->shift;
+    size_t lo = index->radix[p];
+    size_t hi = index->radix[p+1];
+    if (lo > 0)
+        lo--;
+    while (hi - lo > 1)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (keys[mid] <= target)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    /* The window round the prediction; rounding may cost a place */
+    double guess = index->pos[lo] + ((double)target - keys[lo]) * index->slope[lo];
+    size_t e = index->error + 1;
+    size_t g = (guess < 0.0) ? 0 : (size_t)guess;
+    size_t w0 = (g > e) ? g - e : 0;
+    size_t w1 = (g + e + 1 < n) ? g + e + 1 : n;
+    if (w0 >= w1)
+        w0 = (w1 > 0) ? w1 - 1 : 0;
+    size_t r = window_lower_bound(data, w0, w1, target);
+    if ((w0 == 0 || data[w0-1] < target) && (r < w1 || w1 == n || data[w1] >= target))
+        return r;
+    return window_lower_bound(data, 0, n, target);
+}
+
+size_t bsl_upper_bound(const BSLearn *index, int target)
+{
+    if (target == INT_MAX)
+        return index->n;
+    return bsl_lower_bound(index, target + 1);
+}
+
+bool bsl_range(const BSLearn *index, int target, long *lo, long *hi)
+{
+    size_t lb = bsl_lower_bound(index, target);
+    if (lb >= index->n || index->data[lb] != target)
+    {
+        *lo = *hi = -1;
+        return false;
+    }
+    *lo = (long)lb;
+    *hi = (long)bsl_upper_bound(index, target) - 1;
+    return true;
+}
+
+size_t bsl_points(const BSLearn *index)
+{
+    return index->npoints;
+}
+
+size_t bsl_size(const BSLearn *index)
+{
+    if (index->stree != 0)
+        return sizeof(*index) + bsi_size(index->stree);
+    return sizeof(*index) + index->npoints * (sizeof(int) + sizeof(size_t) + sizeof(double)) +
+           index->nradix * sizeof(uint32_t);
+}
+
+bool bsl_fallback(const BSLearn *index)
+{
+    return index->stree != 0;
+}
+
+/*
+** Saved format: the magic string, then 64-bit little-endian numbers:
+** n, error, fallback flag, first and last keys of the array, number of
+** points, and the key and position of each point.  The slopes and the
+** radix table are recalculated on loading.
+*/
+
+static bool put_u64(FILE *fp, uint64_t v)
+{
+    unsigned char b[8];
+    for (int i = 0; i < 8; i++)
+        b[i] = (unsigned char)(v >> (8 * i));
+    return fwrite(b, sizeof(b), 1, fp) == 1;
+}
+
+static bool get_u64(FILE *fp, uint64_t *v)
+{
+    unsigned char b[8];
+    if (fread(b, sizeof(b), 1, fp) != 1)
+        return false;
+    *v = 0;
+    for (int i = 0; i < 8; i++)
+        *v |= (uint64_t)b[i] << (8 * i);
+    return true;
+}
+
+static inline uint64_t key_u64(int key)
+{
+    return (uint32_t)key;
+}
+
+int bsl_save(const BSLearn *index, FILE *fp)
+{
+    size_t n = index->n;
+    bool ok = fwrite(magic, sizeof(magic), 1, fp) == 1 &&
+              put_u64(fp, n) &&
+              put_u64(fp, (uint64_t)index->error) &&
+              put_u64(fp, index->stree != 0) &&
+              put_u64(fp, (n > 0) ? key_u64(index->data[0]) : 0) &&
+              put_u64(fp, (n > 0) ? key_u64(index->data[n-1]) : 0) &&
+              put_u64(fp, index->npoints);
+    for (size_t i = 0; ok && i < index->npoints; i++)
+        ok = put_u64(fp, key_u64(index->keys[i])) && put_u64(fp, index->pos[i]);
+    return (ok && fflush(fp) == 0) ? 0 : -1;
+}
+
+BSLearn *bsl_load(FILE *fp, size_t n, const int *data)
+{
+    char m[sizeof(magic)];
+    uint64_t h[6];
+
+    if (fread(m, sizeof(m), 1, fp) != 1 || memcmp(m, magic, sizeof(magic)) != 0)
+        return 0;
+    for (int i = 0; i < 6; i++)
+    {
+        if (!get_u64(fp, &h[i]))
+            return 0;
+    }
+    if (h[0] != n || h[1] == 0 || h[1] > INT_MAX || h[2] > 1)
+        return 0;
+    if (n > 0 && (h[3] != key_u64(data[0]) || h[4] != key_u64(data[n-1])))
+        return 0;
+
+    BSLearn *index = new_index(n, data, (int)h[1]);
+    if (index == 0)
+        return 0;
+    if (h[2] != 0)
+        return make_fallback(index);
+    if (h[5] < 2 || h[5] > n)
+    {
+        free(index);
+        return 0;
+    }
+    index->maxpoints = h[5];
+    index->keys = malloc(index->maxpoints * sizeof(*index->keys));
+    index->pos = malloc(index->maxpoints * sizeof(*index->pos));
+    bool ok = (index->keys != 0 && index->pos != 0);
+    for (size_t i = 0; ok && i < index->maxpoints; i++)
+    {
+        uint64_t key;
+        uint64_t pos;
+        ok = get_u64(fp, &key) && get_u64(fp, &pos) && key <= UINT32_MAX && pos <= n;
+        if (ok)
+        {
+            index->keys[i] = (int)(uint32_t)key;
+            index->pos[i] = pos;
+            ok = (i == 0 || (index->keys[i] > index->keys[i-1] &&
+                             index->pos[i] >= index->pos[i-1]));
+        }
+        index->npoints = i + ok;
+    }
+    ok = ok && index->keys[0] == data[0] && index->keys[index->npoints-1] == data[n-1] &&
+         finish_spline(index);
+    if (!ok)
+    {
+        bsl_destroy(index);
+        return 0;
+    }
+    return index;
+}
@@ -0,0 +1,85 @@
+/*
+@(#)File:           bslearn.h
+@(#)Purpose:        Learned (piecewise linear) index for sorted int arrays
+@(#)Author:         J Leffler
+@(#)Copyright:      (C) JLSS 2026
+*/
+
+/*TABSTOP=4*/
+
+#ifndef JLSS_ID_BSLEARN_H
+#define JLSS_ID_BSLEARN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>     /* size_t */
+#include <stdio.h>      /* FILE */
+
+/*
+** When the keys are spread smoothly (timestamps, serial numbers), the
+** position of a key in the sorted array is close to a linear function
+** of the key over long stretches, so interpolation gets close to the
+** answer without probing the array at all.  This index is a linear
+** spline (as in RadixSpline) through selected points (key, position):
+** for every target, interpolating between the points either side
+** predicts the lower bound of the target to within the error window
+** given to bsl_create(), and a binary search of that window of the
+** array finishes the job.  A radix table on the leading bits of the
+** key finds the spline points either side in a step or two.
+**
+** The index is built in one pass over the array (a greedy "shrinking
+** cone" fit), and takes space in proportion to the number of points,
+** which for smooth data is a small fraction of the number of keys.
+** If the fit needs more than one point for every BSL_MIN_KEYS keys
+** (the keys are lumpy, or the array is small), bsl_create() gives up
+** on the spline and builds an S-tree (bsindex.h) instead; the searches
+** work as before, and bsl_fallback() reports that it happened.  Each
+** search also checks its window, and searches the whole array if the
+** prediction was wrong, so a damaged or mismatched index is slow, not
+** wrong.
+**
+** The results are positions in the sorted array:
+**
+** bsl_lower_bound(): the first i with data[i] >= target, or n if none.
+** bsl_upper_bound(): the first i with data[i] > target, or n if none.
+** bsl_range():       the first and last i with data[i] == target, as
+**                    BinSearch_D in modbinsearch.c; *lo and *hi are set
+**                    to -1 (and it returns false) if target is absent.
+**
+** bsl_save() writes the spline to a file (in a byte order independent
+** format), returning 0 on success and -1 on failure.  bsl_load() reads
+** it back for use with the same array, and returns a null pointer if
+** the file is not a saved index or does not match the array.  The
+** array must outlive the index, as with bsindex.h.
+**
+** bsl_create() returns a null pointer if it cannot allocate the index.
+** An error window of 0 selects BSL_DEFAULT_ERROR.
+*/
+
+enum { BSL_DEFAULT_ERROR = 32 };
+enum { BSL_MIN_KEYS = 64 };
+
+typedef struct BSLearn BSLearn;
+
+extern BSLearn *bsl_create(size_t n, const int *data, int error);
+extern void     bsl_destroy(BSLearn *index);
+
+extern size_t   bsl_lower_bound(const BSLearn *index, int target);
+extern size_t   bsl_upper_bound(const BSLearn *index, int target);
+extern bool     bsl_range(const BSLearn *index, int target, long *lo, long *hi);
+
+extern int      bsl_save(const BSLearn *index, FILE *fp);
+extern BSLearn *bsl_load(FILE *fp, size_t n, const int *data);
+
+extern size_t   bsl_points(const BSLearn *index);   /* Spline points */
+extern size_t   bsl_size(const BSLearn *index);     /* Bytes used */
+extern bool     bsl_fallback(const BSLearn *index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JLSS_ID_BSLEARN_H */
@@ -0,0 +1,49 @@
+#!/bin/bash
+#
+# Check sortfile2 against sort(1): one file, several files (some empty,
+# some with an unterminated last line, which must not be joined to the
+# first line of the next file), and memory budgets small enough to
+# spill many runs and need several merge passes.
+#
+# Usage: sortfile-test.sh [lines]
+
+lines=${1:-200000}
+data=sortfile-test.$$
+trap 'rm -f $data.*' 0 1 2 3 13 15
+
+perl -e '
+    srand(20260101);
+    for my $i (1..$ARGV[0]) {
+        print join("", map { chr(97 + int(rand(4))) } 0..int(rand(20))), "\n";
+    }' "$lines" > $data.big
+
+printf 'x\na' > $data.f1
+printf 'c\n' > $data.f2
+printf '' > $data.f3
+printf 'b\nzz' > $data.f4
+printf 'y' > $data.f5
+
+export LC_ALL=C
+status=0
+
+check()
+{
+    local opts="$1"
+    shift
+    # Join the files the way sort(1) reads them: each gets a newline
+    for f in "$@"; do perl -pe 's/([^\n])\z/$1\n/' $f; done | sort > $data.1
+    ./sortfile2 $opts "$@" > $data.2
+    if cmp -s $data.1 $data.2
+    then result=ok
+    else result=FAIL; status=1
+    fi
+    printf "%-16s %-4s %s\n" "${opts:---}" "$result" "$(echo "$@" | sed "s/$data.//g")"
+}
+
+check ""             $data.f1 $data.f2
+check ""             $data.f3 $data.f1 $data.f3 $data.f4 $data.f5
+check ""             $data.big
+check "-S 200K"      $data.big
+check "-S 200K -m 2" $data.big $data.f1 $data.big $data.f5
+check "-S 128K"      $data.f1 $data.big $data.f4 $data.f2
+exit $status
@@ -1,70 +1,696 @@
 /*
 ** Originally a demonstration that a comparator in an SO answer was incorrect.
-** Now a simple demonstration of reading a file and sorting.
+** Now an external sort: sorts lines of text (in byte order) from files
+** much larger than memory.
+**
+** Run generation: a reader thread fills one of two arenas (each half of
+** the memory budget) with whole lines while the main thread sorts the
+** other and writes it as a run, so reading overlaps sorting and writing.
+** Runs are appended to a single temporary spill file (unlinked as soon as
+** it is created, so nothing is left behind), recorded as offset and
+** length.  If the whole input fits in one arena, it is sorted in memory
+** and no spill file is used.
+**
+** Merging: up to fan-in runs at a time are merged with a heap of sources
+** (after so-1881-2266/merge.c), each source reading its run through its
+** own large buffer, so every read is a large sequential read of part of
+** a run.  When there are more runs than the fan-in, intermediate passes
+** merge groups of runs into a new spill file until one final pass can
+** write the output.  The arenas are freed before merging starts, so the
+** merge buffers have the whole memory budget to themselves.
 */
 
 #include "posixver.h"
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "jlss.h"
+#include "stderr.h"
+
+enum { IO_BLOCK = 1024 * 1024 };        /* Largest read; stdio buffer size */
+enum { MIN_RUNBUF = 64 * 1024 };        /* Smallest merge buffer per run */
+enum { DEF_FANIN = 128 };               /* Default maximum fan-in */
+
+typedef struct Line
+{
+    uint64_t    prefix;     /* First 8 bytes, big-endian, zero padded */
+    size_t      offset;     /* Start of line in arena */
+    size_t      length;     /* Length excluding newline */
+} Line;
+
+typedef struct Arena
+{
+    char       *data;       /* Lines, each followed by a newline */
+    size_t      size;       /* Space allocated for data */
+    size_t      used;       /* Bytes of complete lines in data */
+    Line       *lines;
+    size_t      maxlines;
+    size_t      nlines;
+    int         full;       /* Filled by reader, not yet sorted */
+    int         last;       /* No more input after this arena */
+} Arena;
+
+typedef struct Run
+{
+    off_t       offset;
+    off_t       length;
+} Run;
+
+/* A temporary file holding a sequence of runs */
+typedef struct Spill
+{
+    FILE       *fp;
+    Run        *runs;
+    size_t      nruns;
+    size_t      maxruns;
+} Spill;
+
+/* One run being merged */
+typedef struct Source
+{
+    int         fd;
+    off_t       pos;        /* Next file offset to read */
+    off_t       end;        /* End of run */
+    char       *buf;
+    size_t      bufsize;
+    size_t      start;      /* Start of unconsumed data in buf */
+    size_t      fill;       /* End of data in buf */
+    const char *line;       /* Current line (0 at end of run) */
+    size_t      length;
+    uint64_t    prefix;
+} Source;
+
+typedef struct Reader
+{
+    char      **files;      /* File names; "-" is standard input */
+    int         nfiles;
+    int         index;      /* Current file */
+    FILE       *fp;
+    char       *carry;      /* Incomplete line from the previous arena */
+    size_t      ncarry;
+    size_t      maxcarry;
+    size_t      budget;     /* Bytes per arena, data plus lines */
+    size_t      block;      /* Bytes per read */
+    Arena       arena[2];
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+} Reader;
+
+static size_t mem_budget = 64 * 1024 * 1024;
+static size_t max_fanin = DEF_FANIN;
+static const char *tmpdir = 0;
+static int verbose = 0;
+
+static const char *arena_base;  /* Arena data while sorting lines */
+
+static void *xmalloc(size_t size)
+{
+    void *space = malloc(size);
+    if (space == 0)
+        err_error("out of memory (%zu bytes requested)\n", size);
+    return space;
+}
+
+static void *xrealloc(void *old, size_t size)
+{
+    void *space = realloc(old, size);
+    if (space == 0)
+        err_error("out of memory (%zu bytes requested)\n", size);
+    return space;
+}
+
+static uint64_t line_prefix(const char *line, size_t length)
+{
+    uint64_t prefix = 0;
+    size_t n = (length < 8) ? length : 8;
+    for (size_t i = 0; i < n; i++)
+        prefix |= (uint64_t)(unsigned char)line[i] << (56 - 8 * i);
+    return prefix;
+}
+
+/* Byte order; a line sorts before any longer line it is a prefix of */
+static int cmp_lines(uint64_t p1, const char *l1, size_t n1,
+                     uint64_t p2, const char *l2, size_t n2)
+{
+    if (p1 != p2)
+        return (p1 < p2) ? -1 : +1;
+    size_t n = (n1 < n2) ? n1 : n2;
+    if (n > 8)
+    {
+        int rc = memcmp(l1 + 8, l2 + 8, n - 8);
+        if (rc != 0)
+            return rc;
+    }
+    return (n1 > n2) - (n1 < n2);
+}
 
-/* Correct comparator */
 static int compare(const void *p_lhs, const void *p_rhs)
 {
-    const char *lhs = *(char **)p_lhs;
-    const char *rhs = *(char **)p_rhs;
-    return strcmp(lhs, rhs);
+    const Line *lhs = p_lhs;
+    const Line *rhs = p_rhs;
+    return cmp_lines(lhs->prefix, arena_base + lhs->offset, lhs->length,
+                     rhs->prefix, arena_base + rhs->offset, rhs->length);
 }
 
-/* Lines in array are terminated by a newline */
-static void dump_array(const char *tag, size_t size, char *array[size])
+/* -- Run generation -- */
+
+static void arena_addline(Arena *arena, size_t offset, size_t length)
 {
-    printf("%s:\n", tag);
-    for (size_t i = 0; i < size; i++)
-        printf("%.2zu: %s", i, array[i]);
+    if (arena->nlines == arena->maxlines)
+    {
+        arena->maxlines = (arena->maxlines + 1024) * 2;
+        arena->lines = xrealloc(arena->lines, arena->maxlines * sizeof(Line));
+    }
+    Line *line = &arena->lines[arena->nlines++];
+    line->prefix = line_prefix(arena->data + offset, length);
+    line->offset = offset;
+    line->length = length;
 }
 
-int main(void)
+/*
+** Read the next block of input; returns 0 at the end of each file, and
+** then the next call starts on the next file.  The input is finished
+** when rd->index reaches rd->nfiles.
+*/
+static size_t reader_read(Reader *rd, char *buffer, size_t size)
+{
+    if (rd->index >= rd->nfiles)
+        return 0;
+    if (rd->fp == 0)
+    {
+        const char *name = rd->files[rd->index];
+        if (strcmp(name, "-") == 0)
+            rd->fp = stdin;
+        else if ((rd->fp = fopen(name, "r")) == 0)
+            err_syserr("failed to open file %s for reading: ", name);
+    }
+    size_t nbytes = fread(buffer, 1, size, rd->fp);
+    if (nbytes > 0)
+        return nbytes;
+    if (ferror(rd->fp))
+        err_syserr("failed to read file %s: ", rd->files[rd->index]);
+    if (rd->fp != stdin)
+        fclose(rd->fp);
+    rd->fp = 0;
+    rd->index++;
+    return 0;
+}
+
+/*
+** Fill an arena with complete lines: the incomplete line carried over
+** from the previous arena, then input until the data and the line index
+** together reach the budget.  The incomplete line at the end is carried
+** over to the next arena; at the end of each file it gets a newline,
+** so it is not joined to the first line of the next file.
+*/
+static void reader_fill(Reader *rd, Arena *arena)
 {
-    char **ptrs = 0;
-    size_t numptrs = 0;
-    char  *buffer = 0;
-    size_t buflen = 0;
-    size_t count = 0;
+    size_t scan = 0;        /* Start of the next line to find */
+    int eof = 0;
 
-    while (getline(&buffer, &buflen, stdin) != -1)
+    arena->used = 0;
+    arena->nlines = 0;
+    if (arena->size < rd->ncarry + rd->block + 1)
     {
-        if (count == numptrs)
+        arena->size = rd->ncarry + rd->block + 1;
+        arena->data = xrealloc(arena->data, arena->size);
+    }
+    if (rd->ncarry > 0)
+        memcpy(arena->data, rd->carry, rd->ncarry);
+    size_t fill = rd->ncarry;
+
+    while (!eof)
+    {
+        /* Index the complete lines read so far */
+        char *nl;
+        while ((nl = memchr(arena->data + scan, '\n', fill - scan)) != 0)
+        {
+            size_t end = (size_t)(nl - arena->data);
+            arena_addline(arena, scan, end - scan);
+            scan = end + 1;
+        }
+        arena->used = scan;
+        if (scan + arena->nlines * sizeof(Line) >= rd->budget)
+            break;
+
+        /* Read more, growing the arena up to the budget (or beyond, for a long line) */
+        if (arena->size - fill < rd->block + 1)
         {
-            size_t newnum = (numptrs + 2) * 2;
-            void *newptrs = realloc(ptrs, newnum * sizeof(*ptrs));
-            if (newptrs == 0)
+            if (arena->nlines > 0 && fill + rd->block + 1 > rd->budget)
+                break;
+            size_t size = (arena->size * 2 < rd->budget) ? arena->size * 2 : rd->budget;
+            if (size < fill + rd->block + 1)
+                size = fill + rd->block + 1;
+            arena->size = size;
+            arena->data = xrealloc(arena->data, arena->size);
+        }
+        size_t nbytes = reader_read(rd, arena->data + fill, rd->block);
+        if (nbytes == 0)
+        {
+            eof = (rd->index >= rd->nfiles);
+            if (fill > scan)
             {
-                fprintf(stderr, "Out of memory (%zu bytes requested)\n", newnum * sizeof(*ptrs));
-                exit(1);
+                arena->data[fill++] = '\n';
+                arena_addline(arena, scan, fill - 1 - scan);
+                scan = fill;
             }
-            ptrs = newptrs;
-            numptrs = newnum;
+            arena->used = scan;
+        }
+        fill += nbytes;
+    }
+
+    rd->ncarry = fill - arena->used;
+    if (rd->ncarry > rd->maxcarry)
+    {
+        rd->maxcarry = rd->ncarry;
+        rd->carry = xrealloc(rd->carry, rd->maxcarry);
+    }
+    memcpy(rd->carry, arena->data + arena->used, rd->ncarry);
+    arena->last = eof;
+}
+
+/* Free the arenas and the carry buffer once all runs are made */
+static void reader_release(Reader *rd)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        free(rd->arena[i].data);
+        free(rd->arena[i].lines);
+    }
+    free(rd->carry);
+}
+
+static void *reader_main(void *arg)
+{
+    Reader *rd = arg;
+
+    for (int i = 0; ; i ^= 1)
+    {
+        Arena *arena = &rd->arena[i];
+        pthread_mutex_lock(&rd->lock);
+        while (arena->full)
+            pthread_cond_wait(&rd->cond, &rd->lock);
+        pthread_mutex_unlock(&rd->lock);
+
+        reader_fill(rd, arena);
+
+        pthread_mutex_lock(&rd->lock);
+        arena->full = 1;
+        pthread_cond_signal(&rd->cond);
+        pthread_mutex_unlock(&rd->lock);
+        if (arena->last)
+            break;
+    }
+    return 0;
+}
+
+static Spill *spill_create(void)
+{
+    const char *dir = tmpdir;
+    if (dir == 0 && (dir = getenv("TMPDIR")) == 0)
+        dir = "/tmp";
+    size_t len = strlen(dir) + sizeof("/sortfile2.XXXXXX");
+    char *name = xmalloc(len);
+    snprintf(name, len, "%s/sortfile2.XXXXXX", dir);
+    int fd = mkstemp(name);
+    if (fd < 0)
+        err_syserr("failed to create temporary file %s: ", name);
+    unlink(name);
+    free(name);
+
+    Spill *spill = xmalloc(sizeof(*spill));
+    if ((spill->fp = fdopen(fd, "w+")) == 0)
+        err_syserr("failed to fdopen temporary file: ");
+    setvbuf(spill->fp, 0, _IOFBF, IO_BLOCK);
+    spill->runs = 0;
+    spill->nruns = 0;
+    spill->maxruns = 0;
+    return spill;
+}
+
+static void spill_destroy(Spill *spill)
+{
+    fclose(spill->fp);
+    free(spill->runs);
+    free(spill);
+}
+
+static void spill_addrun(Spill *spill, off_t offset, off_t length)
+{
+    if (spill->nruns == spill->maxruns)
+    {
+        spill->maxruns = (spill->maxruns + 16) * 2;
+        spill->runs = xrealloc(spill->runs, spill->maxruns * sizeof(Run));
+    }
+    spill->runs[spill->nruns].offset = offset;
+    spill->runs[spill->nruns].length = length;
+    spill->nruns++;
+}
+
+/* Append the offset of the end of the data written so far */
+static off_t spill_tell(Spill *spill)
+{
+    off_t pos = ftello(spill->fp);
+    if (pos < 0)
+        err_syserr("failed to get position in temporary file: ");
+    return pos;
+}
+
+static void write_lines(FILE *fp, const Arena *arena)
+{
+    for (size_t i = 0; i < arena->nlines; i++)
+    {
+        const Line *line = &arena->lines[i];
+        if (fwrite(arena->data + line->offset, 1, line->length + 1, fp) != line->length + 1)
+            err_syserr("short write: ");
+    }
+}
+
+/*
+** Sort each arena as the reader fills it.  Returns the spill file of
+** runs, or 0 if all the input fitted in one arena and has been written
+** to the output.
+*/
+static Spill *make_runs(Reader *rd, FILE *out)
+{
+    Spill *spill = 0;
+    pthread_t reader;
+
+    if (pthread_create(&reader, 0, reader_main, rd) != 0)
+        err_syserr("failed to create reader thread: ");
+
+    for (int i = 0; ; i ^= 1)
+    {
+        Arena *arena = &rd->arena[i];
+        pthread_mutex_lock(&rd->lock);
+        while (!arena->full)
+            pthread_cond_wait(&rd->cond, &rd->lock);
+        pthread_mutex_unlock(&rd->lock);
+
+        arena_base = arena->data;
+        qsort(arena->lines, arena->nlines, sizeof(Line), compare);
+        if (spill == 0 && arena->last)
+            write_lines(out, arena);
+        else if (arena->nlines > 0)
+        {
+            if (spill == 0)
+                spill = spill_create();
+            off_t start = spill_tell(spill);
+            write_lines(spill->fp, arena);
+            spill_addrun(spill, start, spill_tell(spill) - start);
+        }
+        int last = arena->last;
+
+        pthread_mutex_lock(&rd->lock);
+        arena->full = 0;
+        pthread_cond_signal(&rd->cond);
+        pthread_mutex_unlock(&rd->lock);
+        if (last)
+            break;
+    }
+
+    if (pthread_join(reader, 0) != 0)
+        err_syserr("failed to join reader thread: ");
+    if (spill != 0 && fflush(spill->fp) != 0)
+        err_syserr("failed to write temporary file: ");
+    return spill;
+}
+
+/* -- Merging -- */
+
+/* Make the next line of the run current; line is 0 at end of run */
+static void source_next(Source *src)
+{
+    for (;;)
+    {
+        char *data = src->buf + src->start;
+        char *nl = memchr(data, '\n', src->fill - src->start);
+        if (nl != 0)
+        {
+            src->line = data;
+            src->length = (size_t)(nl - data);
+            src->prefix = line_prefix(data, src->length);
+            src->start += src->length + 1;
+            return;
         }
-        ptrs[count++] = buffer;
-        buffer = 0;
-        buflen = 0;
+        if (src->pos >= src->end)
+        {
+            /* Runs end with a newline, so nothing can be left over */
+            assert(src->start == src->fill);
+            src->line = 0;
+            return;
+        }
+        /* Keep the partial line, growing the buffer if it fills it */
+        memmove(src->buf, data, src->fill - src->start);
+        src->fill -= src->start;
+        src->start = 0;
+        if (src->fill == src->bufsize)
+        {
+            src->bufsize *= 2;
+            src->buf = xrealloc(src->buf, src->bufsize);
+        }
+        size_t want = src->bufsize - src->fill;
+        if ((off_t)want > src->end - src->pos)
+            want = (size_t)(src->end - src->pos);
+        ssize_t nbytes = pread(src->fd, src->buf + src->fill, want, src->pos);
+        if (nbytes < 0 && errno == EINTR)
+            continue;
+        if (nbytes <= 0)
+            err_syserr("failed to read temporary file: ");
+        src->fill += (size_t)nbytes;
+        src->pos += nbytes;
     }
+}
 
-    free(buffer);
+static int src_compare(const Source *sources, size_t i1, size_t i2)
+{
+    const Source *s1 = &sources[i1];
+    const Source *s2 = &sources[i2];
+    return cmp_lines(s1->prefix, s1->line, s1->length,
+                     s2->prefix, s2->line, s2->length);
+}
+
+/* Heap in heap[1..hi] of indexes into sources, as in so-1881-2266/merge.c */
+static void siftup(size_t *heap, size_t lo, size_t hi, const Source *sources)
+{
+    size_t i = hi;
+    while (i > lo)
+    {
+        size_t p = i / 2;
+        if (src_compare(sources, heap[p], heap[i]) <= 0)
+            break;
+        size_t t = heap[p];
+        heap[p] = heap[i];
+        heap[i] = t;
+        i = p;
+    }
+}
 
-    dump_array("Before sorting", count, ptrs);
-    qsort(ptrs, count, sizeof(char *), compare);
-    dump_array("After sort", count, ptrs);
+static void siftdown(size_t *heap, size_t lo, size_t hi, const Source *sources)
+{
+    size_t i = lo;
+    for (;;)
+    {
+        size_t c = 2 * i;
+        if (c > hi)
+            break;
+        if (c + 1 <= hi && src_compare(sources, heap[c+1], heap[c]) < 0)
+            c++;
+        if (src_compare(sources, heap[i], heap[c]) <= 0)
+            break;
+        size_t t = heap[c];
+        heap[c] = heap[i];
+        heap[i] = t;
+        i = c;
+    }
+}
+
+/* Merge runs[0..nruns-1] of the spill file to the output stream */
+static void merge_runs(Spill *in, const Run *runs, size_t nruns, FILE *out)
+{
+    Source *sources = xmalloc(nruns * sizeof(Source));
+    size_t *heap = xmalloc((nruns + 1) * sizeof(size_t));
+    size_t bufsize = mem_budget / (nruns + 1);
+    size_t heap_size = 0;
+
+    if (bufsize < MIN_RUNBUF)
+        bufsize = MIN_RUNBUF;
+    for (size_t i = 0; i < nruns; i++)
+    {
+        Source *src = &sources[i];
+        src->fd = fileno(in->fp);
+        src->pos = runs[i].offset;
+        src->end = runs[i].offset + runs[i].length;
+        src->bufsize = bufsize;
+        src->buf = xmalloc(bufsize);
+        src->start = 0;
+        src->fill = 0;
+        source_next(src);
+        if (src->line != 0)
+        {
+            heap[++heap_size] = i;
+            siftup(heap, 1, heap_size, sources);
+        }
+    }
+
+    while (heap_size > 0)
+    {
+        Source *src = &sources[heap[1]];
+        if (fwrite(src->line, 1, src->length + 1, out) != src->length + 1)
+            err_syserr("short write: ");
+        source_next(src);
+        if (src->line == 0)
+            heap[1] = heap[heap_size--];
+        if (heap_size > 0)
+            siftdown(heap, 1, heap_size, sources);
+    }
+
+    for (size_t i = 0; i < nruns; i++)
+        free(sources[i].buf);
+    free(sources);
+    free(heap);
+}
+
+/*
+** Merge passes: while there are more runs than the fan-in allows,
+** merge groups of runs into a new spill file; then merge the rest to
+** the output.  Returns the number of passes.
+*/
+static int merge_all(Spill *spill, FILE *out)
+{
+    size_t fanin = mem_budget / MIN_RUNBUF - 1;
+    int passes = 0;
+
+    if (fanin > max_fanin)
+        fanin = max_fanin;
+    if (fanin < 2)
+        fanin = 2;
+    while (spill->nruns > fanin)
+    {
+        Spill *next = spill_create();
+        for (size_t i = 0; i < spill->nruns; i += fanin)
+        {
+            size_t n = spill->nruns - i;
+            if (n > fanin)
+                n = fanin;
+            off_t start = spill_tell(next);
+            merge_runs(spill, &spill->runs[i], n, next->fp);
+            spill_addrun(next, start, spill_tell(next) - start);
+        }
+        if (fflush(next->fp) != 0)
+            err_syserr("failed to write temporary file: ");
+        spill_destroy(spill);
+        spill = next;
+        passes++;
+        if (verbose)
+            err_remark("merge pass %d: %zu runs remain\n", passes, spill->nruns);
+    }
+    merge_runs(spill, spill->runs, spill->nruns, out);
+    spill_destroy(spill);
+    return passes + 1;
+}
+
+/* Memory size in bytes, with an optional K, M or G suffix */
+static size_t scan_size(const char *arg)
+{
+    char *end;
+    errno = 0;
+    size_t size = strtosize_scaled(arg, &end, 0, true);
+    if (end == arg || *end != '\0' || errno != 0 || size < 2 * MIN_RUNBUF)
+        err_error("invalid memory size '%s' (at least 128K)\n", arg);
+    return size;
+}
+
+/* Maximum number of runs merged at once, at least 2 */
+static size_t scan_fanin(const char *arg)
+{
+    char *end;
+    errno = 0;
+    long fanin = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || errno != 0 || fanin < 2)
+        err_error("invalid fan-in '%s' (at least 2)\n", arg);
+    return (size_t)fanin;
+}
+
+static const char usestr[] = "[-hvV][-m fanin][-S size][-T tmpdir] [file ...]";
+static const char optstr[] = "hm:S:T:vV";
+static const char hlpstr[] =
+    "  -h          Print this help and exit\n"
+    "  -m fanin    Maximum number of runs merged at once (default 128)\n"
+    "  -S size     Memory budget, e.g. 512M (default 64M)\n"
+    "  -T tmpdir   Directory for temporary files (default $TMPDIR or /tmp)\n"
+    "  -v          Report runs and merge passes on standard error\n"
+    "  -V          Print version information and exit\n"
+    ;
+
+int main(int argc, char **argv)
+{
+    static char *std_input[] = { "-" };
+    int opt;
+
+    err_setarg0(argv[0]);
+    while ((opt = getopt(argc, argv, optstr)) != -1)
+    {
+        switch (opt)
+        {
+        case 'm':
+            max_fanin = scan_fanin(optarg);
+            break;
+        case 'S':
+            mem_budget = scan_size(optarg);
+            break;
+        case 'T':
+            tmpdir = optarg;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        case 'h':
+            err_help(usestr, hlpstr);
+            /*NOTREACHED*/
+        case 'V':
+            err_version("SORTFILE2", "2.0");
+            /*NOTREACHED*/
+        default:
+            err_usage(usestr);
+            /*NOTREACHED*/
+        }
+    }
+
+    Reader rd = { 0 };
+    if (optind < argc)
+    {
+        rd.files = &argv[optind];
+        rd.nfiles = argc - optind;
+    }
+    else
+    {
+        rd.files = std_input;
+        rd.nfiles = 1;
+    }
+    rd.budget = mem_budget / 2;
+    rd.block = (rd.budget / 4 < IO_BLOCK) ? rd.budget / 4 : IO_BLOCK;
+    pthread_mutex_init(&rd.lock, 0);
+    pthread_cond_init(&rd.cond, 0);
 
-    for (size_t i = 0; i < count; i++)
-        free(ptrs[i]);
-    free(ptrs);
+    setvbuf(stdout, 0, _IOFBF, IO_BLOCK);
+    Spill *spill = make_runs(&rd, stdout);
+    reader_release(&rd);
+    size_t nruns = (spill == 0) ? 0 : spill->nruns;
+    int passes = (spill == 0) ? 0 : merge_all(spill, stdout);
+    if (fflush(stdout) != 0)
+        err_syserr("failed to write standard output: ");
+    if (verbose)
+        err_remark("%zu runs, %d merge passes\n", nruns, passes);
 
-    /* Avoid an 'in use at exit (reachable)' record in valgrind */
-    /* Mac OS X El Capitan 10.11.4, Valgrind 3.12.0.SVN */
-    /* macOS High Sierra 10.13.4, Valgrind 3.14.0.GIT */
-    fclose(stdin);
+    pthread_mutex_destroy(&rd.lock);
+    pthread_cond_destroy(&rd.cond);
 
     return 0;
 }
@@ -1,9 +1,21 @@
-#include <assert.h>
+#include "posixver.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
-#include "timer.h"
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bench.h"
+#include "jlss.h"
+#include "pdqsort.h"
+#include "radixsort.h"
+#include "sortnet.h"
+#include "stderr.h"
+#include "xorshift.h"
 
 typedef int Data;
 static size_t swap_count = 0;
@@ -45,6 +57,46 @@ static void quick_sort(Data a[], int n)
     kvik_sort(a, 0, n-1);
 }
 
+/*
+** As kvik_sort(), but partitions of up to SORTNET_MAX elements are
+** sorted by a vectorised sorting network (whose compares and swaps are
+** not counted).
+*/
+static void kvik_net_sort(Data a[], int l, int d)
+{
+    if (d - l + 1 <= SORTNET_MAX)
+    {
+        sortnet_i32((int32_t *)&a[l], d - l + 1);
+        return;
+    }
+
+    int k = l;
+    swap(&a[l], &a[(l + d) / 2]);
+
+    for (int i = l + 1; i <= d; i++)
+    {
+        inc_comps();
+        if (a[i] < a[l])
+            swap(&a[++k], &a[i]);
+    }
+    swap(&a[l], &a[k]);
+
+    kvik_net_sort(a, l, k-1);
+    kvik_net_sort(a, k+1, d);
+}
+
+static void quick_net_sort(Data a[], int n)
+{
+    kvik_net_sort(a, 0, n-1);
+}
+
+/* Only for n <= SORTNET_MAX */
+static void network_sort(Data a[], int n)
+{
+    if (!sortnet_i32((int32_t *)a, n))
+        err_error("too many elements for sorting network (n = %d)\n", n);
+}
+
 static void selection_sort(Data a[], int n)
 {
     for (int i = 0; i < n - 1; i++)
@@ -92,6 +144,22 @@ static void bubble_sort(Data a[], int n)
     }
 }
 
+/* No compares or swaps to count */
+static void radix_sort(Data a[], int n)
+{
+    if (!radix_sort_i32((int32_t *)a, n))
+        err_error("out of memory in radix sort (n = %d)\n", n);
+}
+
+/* Compares are counted; elements are moved rather than swapped */
+#define PDQ_LESS(a, b) (inc_comps(), (a) < (b))
+PDQSORT_DEFINE(pdq_sort_data, Data, PDQ_LESS, true)
+
+static void pdq_sort(Data a[], int n)
+{
+    pdq_sort_data(a, n);
+}
+
 static void fill_random(Data a[], int n)
 {
     for (int i = 0; i < n; i++)
@@ -101,7 +169,7 @@ static void fill_random(Data a[], int n)
 static void fill_ascending(Data a[], int n)
 {
     for (int i = 0; i < n; i++)
-        a[i] = rand();
+        a[i] = i;
 }
 
 static void fill_descending(Data a[], int n)
@@ -147,7 +215,7 @@ static int check_sort(Data a[], int n)
     {
         if (a[i] > a[i+1])
         {
-            printf("Sort fail: a[%d] = %d; a[%d] = %d\n", i, a[i], i+1, a[i+1]);
+            fprintf(stderr, "Sort fail: a[%d] = %d; a[%d] = %d\n", i, a[i], i+1, a[i+1]);
             rc = 1;
         }
     }
@@ -173,12 +241,22 @@ static FuncInfo fillers[] =
 };
 enum { NUM_FILLERS = sizeof(fillers) / sizeof(fillers[0]) };
 
-static FuncInfo sorters[] =
+/* Counters are reported only for the sorters that keep them */
+static const struct
 {
-    { "Quick",      quick_sort      },
-    { "Bubble",     bubble_sort     },
-    { "Insertion",  insertion_sort  },
-    { "Selection",  selection_sort  },
+    const char *name;
+    Function    func;
+    bool        compares;   /* Counts compares */
+    bool        swaps;      /* Counts swaps */
+} sorters[] =
+{
+    { "Quick",      quick_sort,     true,  true  },
+    { "Radix",      radix_sort,     false, false },
+    { "PDQ",        pdq_sort,       true,  false },
+    { "QuickNet",   quick_net_sort, true,  true  },
+    { "Bubble",     bubble_sort,    true,  true  },
+    { "Insertion",  insertion_sort, true,  true  },
+    { "Selection",  selection_sort, true,  true  },
 };
 enum { NUM_SORTERS = sizeof(sorters) / sizeof(sorters[0]) };
 
@@ -189,39 +267,90 @@ static int sizes[] =
 };
 enum { NUM_SIZES = sizeof(sizes) / sizeof(sizes[0]) };
 
-static void test1(void)
+/*
+** Each (data set, sorter) pair is a case for the benchmark harness in
+** bench.h: setup copies the unsorted data into the work array and
+** clears the counters, run sorts it, and check verifies the result
+** and records the comparison and swap counts as case metrics.
+*/
+
+static Bench *bench;
+
+typedef struct SortCase
+{
+    Function    sorter;
+    const Data *data;       /* Unsorted input */
+    Data       *work;       /* Sorted in place */
+    int         n;
+    bool        compares;   /* Report comp_count */
+    bool        swaps;      /* Report swap_count */
+} SortCase;
+
+static void sort_setup(void *ctx)
+{
+    SortCase *sc = ctx;
+    memmove(sc->work, sc->data, sc->n * sizeof(Data));
+    swap_count = 0;
+    comp_count = 0;
+}
+
+static void sort_run(void *ctx)
+{
+    SortCase *sc = ctx;
+    (*sc->sorter)(sc->work, sc->n);
+}
+
+static bool per_element = false;
+
+/* Compares and swaps, per element with -e, for sorters that count them */
+static void count_metrics(size_t n, bool compares, bool swaps)
+{
+    double scale = (per_element && n > 0) ? 1.0 / n : 1.0;
+    if (compares)
+        bench_metric(bench, "compares", comp_count * scale);
+    if (swaps)
+        bench_metric(bench, "swaps", swap_count * scale);
+}
+
+static int sort_check(void *ctx)
+{
+    SortCase *sc = ctx;
+    count_metrics(sc->n, sc->compares, sc->swaps);
+    return check_sort(sc->work, sc->n);
+}
+
+static void add_case(SortCase *sc, const char *sorter, const char *param)
 {
-    Clock clk;
-    clk_init(&clk);
-    printf("%7s %18s %9s %14s %14s %4s %11s\n",
-           "Number", "Filler", "Sorter", "Compares", "Swaps", "", "Time");
+    BenchCase bc = { sorter, param, sort_setup, sort_run, sort_check,
+                     sc, sc->n, "elements" };
+    bench_add(bench, &bc);
+}
 
+static void test1(void)
+{
     for (int i = 0; i < NUM_SIZES; i++)
     {
-        size_t nbytes = sizes[i] * sizeof(Data);
-        Data *a0 = malloc(nbytes);
-        Data *a1 = malloc(nbytes);
+        int n = sizes[i];
+        Data *data[NUM_FILLERS];
+        Data *work = malloc(n * sizeof(Data));
+        SortCase cases[NUM_FILLERS][NUM_SORTERS];
         for (int j = 0; j < NUM_FILLERS; j++)
         {
-            (*fillers[j].func)(a0, sizes[i]);
+            data[j] = malloc(n * sizeof(Data));
+            (*fillers[j].func)(data[j], n);
             for (int k = 0; k < NUM_SORTERS; k++)
             {
-                char buffer[32];
-                memmove(a1, a0, nbytes);
-                swap_count = 0;
-                comp_count = 0;
-                clk_start(&clk);
-                (*sorters[k].func)(a1, sizes[i]);
-                clk_stop(&clk);
-                int rc = check_sort(a1, sizes[i]);
-                printf("%7d %18s %9s %14zu %14zu %4s %11s\n",
-                    sizes[i], fillers[j].name, sorters[k].name, comp_count, swap_count,
-                    (rc == 0) ? "PASS" : "FAIL",
-                    clk_elapsed_us(&clk, buffer, sizeof(buffer)));
+                char param[64];
+                cases[j][k] = (SortCase){ sorters[k].func, data[j], work, n,
+                                          sorters[k].compares, sorters[k].swaps };
+                snprintf(param, sizeof(param), "%s n=%d", fillers[j].name, n);
+                add_case(&cases[j][k], sorters[k].name, param);
             }
         }
-        free(a0);
-        free(a1);
+        bench_run(bench);
+        for (int j = 0; j < NUM_FILLERS; j++)
+            free(data[j]);
+        free(work);
     }
 }
 
@@ -245,68 +374,30 @@ static void test1(void)
 
 typedef void (*ExtraFiller)(Data a[], int n, int m);
 
-typedef struct SortType
-{
-    ExtraFiller  filler_func;
-    const char  *filler_name;
-    Function     sorter_func;
-    const char  *sorter_name;
-    const char  *tag;
-    int          m_param;
-} SortType;
-
-static void framework2(Data a[], int n, const SortType *sort)
+static int make_copy(const Data x[], Data a[], int n)
 {
-    Clock clk;
-    clk_init(&clk);
-//    printf("%7s %18s %9s %14s %14s %4s %11s\n",
-//            "Number", "Filler", "Sorter", "Compares", "Swaps", "", "Time");
-
-    char buffer[32];
-    swap_count = 0;
-    comp_count = 0;
-    clk_start(&clk);
-    (*sort->sorter_func)(a, n);
-    clk_stop(&clk);
-    int rc = check_sort(a, n);
-//    printf("%7d %18s %9s %14zu %14zu %4s %11s\n",
-//            sizes[i], fillers[j].name, sorters[k].name, comp_count, swap_count,
-//            (rc == 0) ? "PASS" : "FAIL",
-//            clk_elapsed_us(&clk, buffer, sizeof(buffer)));
-//    printf("%7s %18s %18s %13s %6s %14s %14s %4s %11s\n",
-//            "Number", "Sorter", "Filler", "Extra", "M", "Compares", "Swaps", "", "Time");
-    printf("%7d %18s %18s %13s %6d %14zu %14zu %4s %11s\n",
-            n, sort->sorter_name, sort->filler_name, sort->tag, sort->m_param,
-            comp_count, swap_count, (rc == 0) ? "PASS" : "FAIL",
-            clk_elapsed_us(&clk, buffer, sizeof(buffer)));
-}
-
-static void test_copy(Data x[], int n, const SortType *sort)
-{
-    Data a[n];
     for (int i = 0; i < n; i++)
         a[i] = x[i];
-    framework2(a, n, sort);
+    return n;
 }
 
-static void test_reverse(Data x[], int lo, int hi, const SortType *sort)
+/*
+** a = the first hi - lo elements of x, reversed; as in the original
+** test_reverse(), lo and hi only set the length of the test array.
+*/
+static int make_reverse(const Data x[], Data a[], int lo, int hi)
 {
     int n = hi - lo;
-    assert(n > 0);
-    Data a[n];
     for (int i = 0; i < n; i++)
-    {
         a[n-1-i] = x[i];
-    }
-    framework2(a, n, sort);
+    return n;
 }
 
-static void test_dither(Data x[], int n, const SortType *sort)
+static int make_dither(const Data x[], Data a[], int n)
 {
-    int a[n];
     for (int i = 0; i < n; i++)
         a[i] = x[i] + (i % 5);
-    framework2(a, n, sort);
+    return n;
 }
 
 static void fill_sawtooth(Data a[], int n, int m)
@@ -359,58 +450,648 @@ static ExtraInfo xfiller[] =
 };
 enum { NUM_XFILLERS = sizeof(xfiller) / sizeof(xfiller[0]) };
 
+enum { NUM_EXTRAS = 5 };
+static const char *extras[NUM_EXTRAS] =
+{
+    "Full Plain", "Full Reversed", "1st Half Revd", "2nd Half Revd",
+    "Full Dithered",
+};
+
 static void test2(void)
 {
     int  sizes[] = { 1000, 10239, 10240, 10241 };
     enum { NUM_SIZES = sizeof(sizes) / sizeof(sizes[0]) };
-    SortType sort;
-
-    printf("%7s %18s %18s %13s %6s %14s %14s %4s %11s\n",
-            "Number", "Sorter", "Filler", "Extra", "M", "Compares", "Swaps", "", "Time");
 
     for (int i = 0; i < NUM_SORTERS; i++)
     {
-        //printf("Sorter: %s\n", sorters[i].name);
-        sort.sorter_func = sorters[i].func;
-        sort.sorter_name = sorters[i].name;
         for (int n0 = 0; n0 < NUM_SIZES; n0++)
         {
             int n = sizes[n0];
-            Data x[n];       // Use malloc/free for better valgrind support?
-            //printf("Sample Size: %d\n", n);
+            Data *x = malloc(n * sizeof(Data));
+            Data *work = malloc(n * sizeof(Data));
+            Data *data[NUM_EXTRAS];
+            for (int e = 0; e < NUM_EXTRAS; e++)
+                data[e] = malloc(n * sizeof(Data));
             for (int m = 1; m < 2 * n; m *= 2)
             {
-                //printf("M: %d\n", m);
-                sort.m_param = m;
                 for (int d0 = 0; d0 < NUM_XFILLERS; d0++)
                 {
-                    sort.filler_func = xfiller[d0].func;
-                    sort.filler_name = xfiller[d0].name;
-                    //printf("Filler: %s\n", sort.filler_name);
-                    (*sort.filler_func)(x, n, m);
-                    sort.tag = "Full Plain";
-                    test_copy(x, n, &sort);          /* work on a copy of x */
-                    sort.tag = "Full Reversed";
-                    test_reverse(x, 0, n, &sort);    /* on a reversed copy */
-                    sort.tag = "1st Half Revd";
-                    test_reverse(x, 0, n/2, &sort);  /* front half reversed */
-                    sort.tag = "2nd Half Revd";
-                    test_reverse(x, n/2, n, &sort);  /* back half reversed */
-                    //test_sort(x, n, &sort);        /* an ordered copy */
-                    sort.tag = "Full Dithered";
-                    test_dither(x, n, &sort);        /* add i%5 to x[i] */
+                    SortCase cases[NUM_EXTRAS];
+                    int ns[NUM_EXTRAS];
+                    (*xfiller[d0].func)(x, n, m);
+                    ns[0] = make_copy(x, data[0], n);           /* work on a copy of x */
+                    ns[1] = make_reverse(x, data[1], 0, n);     /* on a reversed copy */
+                    ns[2] = make_reverse(x, data[2], 0, n/2);   /* front half reversed */
+                    ns[3] = make_reverse(x, data[3], n/2, n);   /* back half reversed */
+                    ns[4] = make_dither(x, data[4], n);         /* add i%5 to x[i] */
+                    for (int e = 0; e < NUM_EXTRAS; e++)
+                    {
+                        char param[64];
+                        cases[e] = (SortCase){ sorters[i].func, data[e], work, ns[e],
+                                               sorters[i].compares, sorters[i].swaps };
+                        snprintf(param, sizeof(param), "%s m=%d %s n=%d",
+                                 xfiller[d0].name, m, extras[e], ns[e]);
+                        add_case(&cases[e], sorters[i].name, param);
+                    }
+                    bench_run(bench);
                 }
             }
+            for (int e = 0; e < NUM_EXTRAS; e++)
+                free(data[e]);
+            free(work);
+            free(x);
         }
     }
 }
 
-int main(void)
+/*
+** Small arrays: the sorting network against the sorters that are good
+** at small n, for every size the network handles.  Each run sorts
+** SMALL_SETS arrays, freshly filled with random data by the setup (which
+** is not timed), so the branch predictor cannot learn the data.
+*/
+static FuncInfo small_sorters[] =
+{
+    { "Network",    network_sort    },
+    { "Insertion",  insertion_sort  },
+    { "PDQ",        pdq_sort        },
+};
+enum { NUM_SMALL_SORTERS = sizeof(small_sorters) / sizeof(small_sorters[0]) };
+enum { SMALL_SETS = 1000 };
+
+static void small_setup(void *ctx)
+{
+    SortCase *sc = ctx;
+    fill_random(sc->work, sc->n * SMALL_SETS);
+    swap_count = 0;
+    comp_count = 0;
+}
+
+static void small_run(void *ctx)
 {
-    if (1)
+    SortCase *sc = ctx;
+    for (int i = 0; i < SMALL_SETS; i++)
+        (*sc->sorter)(sc->work + i * sc->n, sc->n);
+}
+
+static int small_check(void *ctx)
+{
+    SortCase *sc = ctx;
+    int rc = 0;
+    for (int i = 0; i < SMALL_SETS; i++)
+        rc |= check_sort(sc->work + i * sc->n, sc->n);
+    return rc;
+}
+
+static void test3(void)
+{
+    static const int sizes[] = { 4, 8, 12, 16, 24, 32, 48, 64 };
+    enum { NUM_SIZES = sizeof(sizes) / sizeof(sizes[0]) };
+    Data *work = malloc(SORTNET_MAX * SMALL_SETS * sizeof(Data));
+    if (work == 0)
+        err_error("out of memory for %d small arrays\n", SMALL_SETS);
+
+    for (int i = 0; i < NUM_SIZES; i++)
+    {
+        int n = sizes[i];
+        SortCase cases[NUM_SMALL_SORTERS];
+        for (int k = 0; k < NUM_SMALL_SORTERS; k++)
+        {
+            char param[64];
+            cases[k] = (SortCase){ small_sorters[k].func, 0, work, n, false, false };
+            snprintf(param, sizeof(param), "Random n=%d x %d (%s)", n, SMALL_SETS, sortnet_isa());
+            BenchCase bc = { small_sorters[k].name, param, small_setup, small_run,
+                             small_check, &cases[k], SMALL_SETS, "arrays" };
+            bench_add(bench, &bc);
+        }
+        bench_run(bench);
+    }
+    free(work);
+}
+
+/*
+** Test set 4: large arrays of several key types.  The sorters that are
+** O(n log n) whatever the data -- PDQ, the C library qsort() and, for
+** the numeric types, Radix -- sort each key type filled by each of the
+** fillers of test set 1, at sizes up to 10^9 elements.  The data and
+** the work array are files mapped into memory, so arrays bigger than
+** main memory can be sorted (slowly); with -D, the data files are kept
+** in that directory and reused by later runs, which saves generating
+** them again.  Otherwise, the files are created in $TMPDIR (or /tmp)
+** and removed at once, so they vanish when the program exits.
+**
+** The key types are 32-bit and 64-bit integers, doubles, fixed-length
+** strings of 16 bytes (compared with memcmp()) and 64-byte records with
+** a 64-bit integer key, which is what sorting an array of structures
+** costs.  Every type is filled from the same sequence of 64-bit values,
+** so the shape of the data is the same for every type.
+*/
+
+typedef struct Str16
+{
+    char        s[16];
+} Str16;
+
+typedef struct Rec64
+{
+    int64_t     key;
+    uint64_t    payload[7];
+} Rec64;
+
+static inline bool i32_less(int32_t a, int32_t b) { return a < b; }
+static inline bool i64_less(int64_t a, int64_t b) { return a < b; }
+static inline bool f64_less(double a, double b) { return a < b; }
+static inline bool str_less(Str16 a, Str16 b) { return memcmp(a.s, b.s, sizeof(a.s)) < 0; }
+static inline bool rec_less(Rec64 a, Rec64 b) { return a.key < b.key; }
+
+static inline void i32_make(int32_t *p, int64_t v) { *p = (int32_t)v; }
+static inline void i64_make(int64_t *p, int64_t v) { *p = v; }
+static inline void f64_make(double *p, int64_t v) { *p = (double)v; }
+
+/* Hex digits of v with the sign bit flipped: memcmp() order is numeric order */
+static inline void str_make(Str16 *p, int64_t v)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    uint64_t u = (uint64_t)v ^ UINT64_C(0x8000000000000000);
+    for (int i = sizeof(p->s); i-- > 0; u >>= 4)
+        p->s[i] = hex[u & 0xF];
+}
+
+static inline void rec_make(Rec64 *p, int64_t v)
+{
+    p->key = v;
+    for (int i = 0; i < 7; i++)
+        p->payload[i] = (uint64_t)v * (i + 1);
+}
+
+typedef int64_t (*Filler64)(size_t i, size_t n);
+
+/*
+** KEYTYPE_DEFINE(name, type, less, branchless) defines, for the type
+** with the given less function and name_make() function:
+**     name_pdq(), name_qsort()     - sorters that count compares
+**     name_fill()                  - fill an array using a Filler64
+**     name_check()                 - check an array is sorted
+*/
+#define KEYTYPE_DEFINE(name, type, less, branchless) \
+\
+static inline bool name##_cless(type a, type b) \
+{ \
+    inc_comps(); \
+    return less(a, b); \
+} \
+\
+PDQSORT_DEFINE(name##_pdq_sort, type, name##_cless, branchless) \
+\
+static bool name##_pdq(void *data, size_t n) \
+{ \
+    name##_pdq_sort(data, n); \
+    return true; \
+} \
+\
+static int name##_compare(const void *v1, const void *v2) \
+{ \
+    const type *p1 = v1; \
+    const type *p2 = v2; \
+    inc_comps(); \
+    return less(*p1, *p2) ? -1 : less(*p2, *p1) ? +1 : 0; \
+} \
+\
+static bool name##_qsort(void *data, size_t n) \
+{ \
+    qsort(data, n, sizeof(type), name##_compare); \
+    return true; \
+} \
+\
+static void name##_fill(void *data, size_t n, Filler64 filler) \
+{ \
+    type *a = data; \
+    for (size_t i = 0; i < n; i++) \
+        name##_make(&a[i], (*filler)(i, n)); \
+} \
+\
+static int name##_check(const void *data, size_t n) \
+{ \
+    const type *a = data; \
+    for (size_t i = 1; i < n; i++) \
+    { \
+        if (less(a[i], a[i-1])) \
+        { \
+            fprintf(stderr, "Sort fail: %s: a[%zu] < a[%zu]\n", #name, i, i-1); \
+            return 1; \
+        } \
+    } \
+    return 0; \
+}
+
+KEYTYPE_DEFINE(i32, int32_t, i32_less, true)
+KEYTYPE_DEFINE(i64, int64_t, i64_less, true)
+KEYTYPE_DEFINE(f64, double,  f64_less, true)
+KEYTYPE_DEFINE(str, Str16,   str_less, false)
+KEYTYPE_DEFINE(rec, Rec64,   rec_less, false)
+
+/* No compares to count */
+static bool i32_radix(void *data, size_t n) { return radix_sort_i32(data, n); }
+static bool i64_radix(void *data, size_t n) { return radix_sort_i64(data, n); }
+static bool f64_radix(void *data, size_t n) { return radix_sort_dbl(data, n); }
+
+typedef bool (*LargeSorter)(void *data, size_t n);
+
+/* None of the large sorters counts swaps */
+enum { NUM_LARGE_SORTERS = 3 };
+static const struct
+{
+    const char *name;
+    bool        compares;   /* Counts compares */
+} large_sorters[NUM_LARGE_SORTERS] =
+{
+    { "PDQ",   true  },
+    { "Qsort", true  },
+    { "Radix", false },
+};
+
+typedef struct KeyType
+{
+    const char *name;
+    size_t      size;
+    void      (*fill)(void *data, size_t n, Filler64 filler);
+    int       (*check)(const void *data, size_t n);
+    LargeSorter sorters[NUM_LARGE_SORTERS];     /* Null if not applicable */
+} KeyType;
+
+static const KeyType keytypes[] =
+{
+    { "i32", sizeof(int32_t), i32_fill, i32_check, { i32_pdq, i32_qsort, i32_radix } },
+    { "i64", sizeof(int64_t), i64_fill, i64_check, { i64_pdq, i64_qsort, i64_radix } },
+    { "f64", sizeof(double),  f64_fill, f64_check, { f64_pdq, f64_qsort, f64_radix } },
+    { "str", sizeof(Str16),   str_fill, str_check, { str_pdq, str_qsort, 0         } },
+    { "rec", sizeof(Rec64),   rec_fill, rec_check, { rec_pdq, rec_qsort, 0         } },
+};
+enum { NUM_KEYTYPES = sizeof(keytypes) / sizeof(keytypes[0]) };
+
+/* The fillers of test set 1, as values for any key type */
+static uint64_t rng_state;
+
+static int64_t value_random(size_t i, size_t n)
+{
+    (void)i;
+    (void)n;
+    return (int64_t)xorshift64(&rng_state);
+}
+
+static int64_t value_ascending(size_t i, size_t n)
+{
+    (void)n;
+    return (int64_t)i;
+}
+
+static int64_t value_descending(size_t i, size_t n)
+{
+    (void)n;
+    return -(int64_t)i;
+}
+
+static int64_t value_fwdorganpipe(size_t i, size_t n)
+{
+    return (int64_t)((i < n - 1 - i) ? i : n - 1 - i);
+}
+
+static int64_t value_revorganpipe(size_t i, size_t n)
+{
+    return (int64_t)(n / 2) - value_fwdorganpipe(i, n);
+}
+
+static int64_t value_uniform(size_t i, size_t n)
+{
+    (void)i;
+    (void)n;
+    return 1;
+}
+
+static const struct
+{
+    const char *name;
+    const char *tag;        /* For file names */
+    Filler64    func;
+} fillers64[] =
+{
+    { "Random",             "random", value_random        },
+    { "Ascending",          "asc",    value_ascending     },
+    { "Descending",         "desc",   value_descending    },
+    { "Forward Organ Pipe", "fwdop",  value_fwdorganpipe  },
+    { "Reverse Organ Pipe", "revop",  value_revorganpipe  },
+    { "Uniform",            "unif",   value_uniform       },
+};
+enum { NUM_FILLERS64 = sizeof(fillers64) / sizeof(fillers64[0]) };
+
+enum { MAX_LARGE_SIZES = 16 };
+static size_t large_sizes[MAX_LARGE_SIZES] = { 100000, 1000000, 10000000 };
+static int num_large_sizes = 3;
+static bool large_types[NUM_KEYTYPES];
+static const char *data_dir = 0;
+
+/* No warm-up run for arrays this big: the setup copy warms them anyway */
+enum { LARGE_NO_WARMUP = 10000000 };
+
+enum { MAX_PATHLEN = 1024 };
+
+/*
+** Map a file of size bytes, read-write and shared.  Given a directory,
+** the named file in it is used, and is kept.  If it does not exist or
+** is the wrong size, *fresh is set and a new temporary file in the same
+** directory is mapped instead, with its name left in tmp; once it is
+** filled, keep_file() renames it into place, so a run interrupted while
+** filling never leaves a file that later runs would take as valid.
+** Without a name, a temporary file is created and removed.
+*/
+static void *map_file(const char *dir, const char *name, size_t size, bool *fresh,
+                      char tmp[MAX_PATHLEN])
+{
+    char path[MAX_PATHLEN];
+    int fd = -1;
+
+    *fresh = true;
+    if (dir != 0 && name != 0)
+    {
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+        if ((fd = open(path, O_RDWR)) >= 0)
+        {
+            struct stat sb;
+            if (fstat(fd, &sb) == 0 && (size_t)sb.st_size == size)
+                *fresh = false;
+            else
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+        else if (errno != ENOENT)
+            err_syserr("failed to open data file %s: ", path);
+        if (fd < 0)
+        {
+            if (snprintf(tmp, MAX_PATHLEN, "%s.XXXXXX", path) >= MAX_PATHLEN)
+                err_error("data file name %s is too long\n", path);
+            if ((fd = mkstemp(tmp)) < 0)
+                err_syserr("failed to create data file %s: ", tmp);
+            if (fchmod(fd, 0644) != 0)
+                err_syserr("failed to set mode of data file %s: ", tmp);
+            snprintf(path, sizeof(path), "%s", tmp);
+        }
+    }
+    else
+    {
+        const char *tmpdir = getenv("TMPDIR");
+        if (dir == 0)
+            dir = (tmpdir != 0 && *tmpdir != '\0') ? tmpdir : "/tmp";
+        snprintf(path, sizeof(path), "%s/sorttest.XXXXXX", dir);
+        if ((fd = mkstemp(path)) < 0)
+            err_syserr("failed to create temporary file %s: ", path);
+        unlink(path);
+    }
+    if (*fresh && ftruncate(fd, (off_t)size) != 0)
+        err_syserr("failed to set size of %s to %zu bytes: ", path, size);
+    void *addr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+        err_syserr("failed to map %zu bytes of %s: ", size, path);
+    close(fd);
+    return addr;
+}
+
+/* Give a filled data file from map_file() its real name */
+static void keep_file(const char *dir, const char *name, const char *tmp)
+{
+    char path[MAX_PATHLEN];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    if (rename(tmp, path) != 0)
+        err_syserr("failed to rename %s to %s: ", tmp, path);
+}
+
+typedef struct LargeCase
+{
+    LargeSorter sorter;
+    const KeyType *type;
+    const void *data;       /* Unsorted input */
+    void       *work;       /* Sorted in place */
+    size_t      n;
+    bool        compares;   /* The sorter counts compares */
+    bool        ok;         /* The sorter had the memory it needed */
+} LargeCase;
+
+static void large_setup(void *ctx)
+{
+    LargeCase *lc = ctx;
+    memmove(lc->work, lc->data, lc->n * lc->type->size);
+    swap_count = 0;
+    comp_count = 0;
+}
+
+static void large_run(void *ctx)
+{
+    LargeCase *lc = ctx;
+    lc->ok = (*lc->sorter)(lc->work, lc->n);
+}
+
+static int large_check(void *ctx)
+{
+    LargeCase *lc = ctx;
+    count_metrics(lc->n, lc->compares, false);
+    if (!lc->ok)
+    {
+        fprintf(stderr, "Sort fail: out of memory (n = %zu)\n", lc->n);
+        return 1;
+    }
+    return (*lc->type->check)(lc->work, lc->n);
+}
+
+static void test4(int warmup)
+{
+    for (int t = 0; t < NUM_KEYTYPES; t++)
+    {
+        const KeyType *kt = &keytypes[t];
+        if (!large_types[t])
+            continue;
+        for (int i = 0; i < num_large_sizes; i++)
+        {
+            size_t n = large_sizes[i];
+            size_t size = n * kt->size;
+            bool fresh;
+            char tmp[MAX_PATHLEN];
+            void *work = map_file(data_dir, 0, size, &fresh, tmp);
+            bench_set_warmup(bench, (n >= LARGE_NO_WARMUP) ? 0 : warmup);
+            for (int j = 0; j < NUM_FILLERS64; j++)
+            {
+                char name[64];
+                snprintf(name, sizeof(name), "sorttest-%s-%s-%zu.dat",
+                         kt->name, fillers64[j].tag, n);
+                void *data = map_file(data_dir, name, size, &fresh, tmp);
+                if (fresh)
+                {
+                    rng_state = XORSHIFT64_SEED;
+                    (*kt->fill)(data, n, fillers64[j].func);
+                    if (data_dir != 0)
+                        keep_file(data_dir, name, tmp);
+                }
+                LargeCase cases[NUM_LARGE_SORTERS];
+                for (int k = 0; k < NUM_LARGE_SORTERS; k++)
+                {
+                    if (kt->sorters[k] == 0)
+                        continue;
+                    char param[64];
+                    cases[k] = (LargeCase){ kt->sorters[k], kt, data, work, n,
+                                           large_sorters[k].compares, true };
+                    snprintf(param, sizeof(param), "%s %s n=%zu",
+                             kt->name, fillers64[j].name, n);
+                    BenchCase bc = { large_sorters[k].name, param, large_setup, large_run,
+                                     large_check, &cases[k], (double)n, "elements" };
+                    bench_add(bench, &bc);
+                }
+                bench_run(bench);
+                munmap(data, size);
+            }
+            munmap(work, size);
+        }
+    }
+    bench_set_warmup(bench, warmup);
+}
+
+static size_t scan_size(const char *arg)
+{
+    char *end;
+    errno = 0;
+    size_t size = strtosize_scaled(arg, &end, 0, false);
+    if (end == arg || *end != '\0' || errno != 0 || size == 0)
+        err_error("invalid size '%s'\n", arg);
+    return size;
+}
+
+static void set_key_type(const char *arg)
+{
+    for (int t = 0; t < NUM_KEYTYPES; t++)
+    {
+        if (strcmp(arg, keytypes[t].name) == 0)
+        {
+            large_types[t] = true;
+            return;
+        }
+    }
+    err_error("unknown key type '%s' (use i32, i64, f64, str or rec)\n", arg);
+}
+
+static const char usestr[] =
+    "[-hCe1234][-D dir][-f text|csv|json][-k type][-n size][-r runs][-t seconds]";
+static const char optstr[] = "1234CD:ef:hk:n:r:t:";
+static const char hlpstr[] =
+    "  -1          Run the basic test (sizes 1..30000, six fillers)\n"
+    "  -2          Run the Bentley & McIlroy test\n"
+    "  -3          Run the small-array test (sorting network, n = 4..64)\n"
+    "  -4          Run the large-array test (key types, sizes up to 10^9)\n"
+    "              (Default: run the first three tests)\n"
+    "  -C          Do not read hardware counters\n"
+    "  -D dir      Keep the data files for test 4 in dir, and reuse them\n"
+    "  -e          Report counters, compares and swaps per element\n"
+    "  -f format   Output format: text, csv or json (default text)\n"
+    "  -h          Print this help and exit\n"
+    "  -k type     Key type for test 4: i32, i64, f64, str or rec\n"
+    "              (Repeatable; default all five)\n"
+    "  -n size     Size for test 4, e.g. 100M or 1G (repeatable;\n"
+    "              default 100K, 1M and 10M)\n"
+    "  -r runs     Minimum timed runs per case (default 3)\n"
+    "  -t seconds  Time limit per case (default 0.5)\n"
+    ;
+
+int main(int argc, char **argv)
+{
+    int run1 = 0;
+    int run2 = 0;
+    int run3 = 0;
+    int run4 = 0;
+    int nsizes = 0;
+    int runs = 3;
+    double limit = 0.5;
+    int opt;
+
+    err_setarg0(argv[0]);
+    bench = bench_create("sorttest");
+    while ((opt = getopt(argc, argv, optstr)) != -1)
+    {
+        switch (opt)
+        {
+        case '1':
+            run1 = 1;
+            break;
+        case '2':
+            run2 = 1;
+            break;
+        case '3':
+            run3 = 1;
+            break;
+        case '4':
+            run4 = 1;
+            break;
+        case 'C':
+            bench_set_counters(bench, 0);
+            break;
+        case 'D':
+            data_dir = optarg;
+            break;
+        case 'e':
+            per_element = true;
+            bench_set_per_item(bench, 1);
+            break;
+        case 'f':
+            if (bench_set_format_name(bench, optarg) != 0)
+                err_error("unknown format '%s' (use text, csv or json)\n", optarg);
+            break;
+        case 'k':
+            set_key_type(optarg);
+            break;
+        case 'n':
+            if (nsizes >= MAX_LARGE_SIZES)
+                err_error("too many sizes (maximum %d)\n", MAX_LARGE_SIZES);
+            large_sizes[nsizes++] = scan_size(optarg);
+            break;
+        case 'r':
+            runs = atoi(optarg);
+            if (runs < 1)
+                err_error("number of runs '%s' should be at least 1\n", optarg);
+            break;
+        case 't':
+            limit = atof(optarg);
+            if (limit <= 0.0)
+                err_error("time limit '%s' should be positive\n", optarg);
+            break;
+        case 'h':
+            err_help(usestr, hlpstr);
+            /*NOTREACHED*/
+        default:
+            err_usage(usestr);
+            /*NOTREACHED*/
+        }
+    }
+    if (optind != argc)
+        err_usage(usestr);
+    if (run1 + run2 + run3 + run4 == 0)
+        run1 = run2 = run3 = 1;
+    if (nsizes > 0)
+        num_large_sizes = nsizes;
+    bool any_type = false;
+    for (int t = 0; t < NUM_KEYTYPES; t++)
+        any_type |= large_types[t];
+    for (int t = 0; t < NUM_KEYTYPES; t++)
+        large_types[t] |= !any_type;
+
+    bench_set_warmup(bench, 1);
+    bench_set_runs(bench, runs, 100);
+    bench_set_time_limit(bench, limit);
+    if (run1)
         test1();
-    if (1)
+    if (run2)
         test2();
+    if (run3)
+        test3();
+    if (run4)
+        test4(1);
+    bench_destroy(bench);
     return(0);
 }
 